@@ -78,17 +78,55 @@ struct xnheap_range {
 	size_t size;
 };
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+
+#define XNHEAP_MAG_DEPTH	CONFIG_XENO_OPT_HEAP_MAGAZINE_DEPTH
+
+/*
+ * Per-CPU cache of free blocks for a single bucket size. Only the
+ * owner CPU hits the magazine in the common case, the lock is there
+ * for draining from remote CPUs when the heap runs out of memory.
+ */
+struct xnheap_magazine {
+	int count;
+	void *blocks[XNHEAP_MAG_DEPTH];
+};
+
+struct xnheap_pcache {
+	DECLARE_XNLOCK(lock);
+	struct xnheap_magazine mags[XNHEAP_MAX_BUCKETS];
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long refills;
+	unsigned long flushes;
+	/* Bytes held by this CPU's magazines. */
+	size_t cached;
+};
+
+#endif /* CONFIG_XENO_OPT_HEAP_MAGAZINES */
+
+struct xnheap_tlsf;
+
 struct xnheap {
 	void *membase;
+#ifdef CONFIG_XENO_OPT_HEAP_TLSF
+	struct xnheap_tlsf *tlsf;
+#else
 	struct rb_root addr_tree;
 	struct rb_root size_tree;
 	struct xnheap_pgentry *pagemap;
+	u32 buckets[XNHEAP_MAX_BUCKETS];
+#endif
 	size_t usable_size;
 	size_t used_size;
-	u32 buckets[XNHEAP_MAX_BUCKETS];
 	char name[XNOBJECT_NAME_LEN];
 	DECLARE_XNLOCK(lock);
 	struct list_head next;
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	struct xnheap_pcache __percpu *pcache;
+	/* One bit per XNHEAP_MIN_ALIGN unit, set for cached blocks. */
+	unsigned long *cachemap;
+#endif
 };
 
 extern struct xnheap cobalt_heap;
@@ -107,16 +145,20 @@ size_t xnheap_get_size(const struct xnheap *heap)
 	return heap->usable_size;
 }
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+size_t xnheap_get_used(const struct xnheap *heap);
+#else
 static inline
 size_t xnheap_get_used(const struct xnheap *heap)
 {
 	return heap->used_size;
 }
+#endif
 
 static inline
 size_t xnheap_get_free(const struct xnheap *heap)
 {
-	return heap->usable_size - heap->used_size;
+	return heap->usable_size - xnheap_get_used(heap);
 }
 
 int xnheap_init(struct xnheap *heap,
@@ -124,6 +166,19 @@ int xnheap_init(struct xnheap *heap,
 
 void xnheap_destroy(struct xnheap *heap);
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+int xnheap_enable_magazines(struct xnheap *heap);
+
+void xnheap_drain_magazines(struct xnheap *heap);
+#else
+static inline int xnheap_enable_magazines(struct xnheap *heap)
+{
+	return 0;
+}
+
+static inline void xnheap_drain_magazines(struct xnheap *heap) { }
+#endif
+
 void *xnheap_alloc(struct xnheap *heap, size_t size);
 
 void xnheap_free(struct xnheap *heap, void *block);
@@ -51,6 +51,7 @@ struct xnpipe_mh {
 };
 
 struct xnpipe_state;
+struct vm_area_struct;
 
 struct xnpipe_operations {
 	void (*output)(struct xnpipe_mh *mh, void *xstate);
@@ -59,6 +60,7 @@ struct xnpipe_operations {
 	void (*free_ibuf)(void *buf, void *xstate);
 	void (*free_obuf)(void *buf, void *xstate);
 	void (*release)(void *xstate);
+	int (*mmap)(struct vm_area_struct *vma, void *xstate);
 };
 
 struct xnpipe_state {
@@ -22,12 +22,15 @@
 #include <linux/types.h>
 #include <linux/atomic.h>
 #include <linux/rbtree.h>
+#include <linux/list.h>
 #include <cobalt/kernel/heap.h>
 
 struct cobalt_umm {
 	struct xnheap heap;
 	atomic_t refcount;
 	void (*release)(struct cobalt_umm *umm);
+	int node;		/* NUMA node of the backing memory */
+	struct list_head next;
 };
 
 struct cobalt_ppd {
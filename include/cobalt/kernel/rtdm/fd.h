@@ -162,6 +162,54 @@ ssize_t rtdm_recvmsg_handler(struct rtdm_fd *fd, struct user_msghdr *msg, int fl
  */
 ssize_t rtdm_sendmsg_handler(struct rtdm_fd *fd, const struct user_msghdr *msg, int flags);
 
+/**
+ * Batched receive message handler
+ *
+ * @param[in] fd File descriptor
+ * @param[in,out] mmsg Array of message descriptors as passed by the
+ * user, automatically mirrored to safe kernel memory in case of user
+ * mode call
+ * @param[in] vlen Number of entries in @a mmsg
+ * @param[in] flags Message flags as passed by the user, possibly
+ * including MSG_WAITFORONE
+ *
+ * The handler receives up to @a vlen messages in a row, filling in
+ * the @a msg_len field of each entry it processed. It should stop
+ * after the first message carrying MSG_OOB.
+ *
+ * @return On success, the number of messages received. A count lower
+ * than @a vlen ends the batch. On failure return either -ENOSYS, to
+ * request that the messages be received one by one via the
+ * recvmsg_rt() handler, or another negative error code.
+ *
+ * @see @c recvmmsg() in Linux.
+ */
+int rtdm_recvmmsg_handler(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			  unsigned int vlen, int flags);
+
+/**
+ * Batched transmit message handler
+ *
+ * @param[in] fd File descriptor
+ * @param[in,out] mmsg Array of message descriptors as passed by the
+ * user, automatically mirrored to safe kernel memory in case of user
+ * mode call
+ * @param[in] vlen Number of entries in @a mmsg
+ * @param[in] flags Message flags as passed by the user
+ *
+ * The handler sends up to @a vlen messages in a row, filling in the
+ * @a msg_len field of each entry it processed.
+ *
+ * @return On success, the number of messages sent. A count lower
+ * than @a vlen ends the batch. On failure return either -ENOSYS, to
+ * request that the messages be sent one by one via the sendmsg_rt()
+ * handler, or another negative error code.
+ *
+ * @see @c sendmmsg() in Linux.
+ */
+int rtdm_sendmmsg_handler(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			  unsigned int vlen, int flags);
+
 /**
  * Select handler
  *
@@ -277,6 +325,12 @@ struct rtdm_fd_ops {
 	/** See rtdm_sendmsg_handler(). */
 	ssize_t (*sendmsg_nrt)(struct rtdm_fd *fd,
 			       const struct user_msghdr *msg, int flags);
+	/** See rtdm_recvmmsg_handler(). */
+	int (*recvmmsg_rt)(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			   unsigned int vlen, int flags);
+	/** See rtdm_sendmmsg_handler(). */
+	int (*sendmmsg_rt)(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			   unsigned int vlen, int flags);
 	/** See rtdm_select_handler(). */
 	int (*select)(struct rtdm_fd *fd,
 		      struct xnselector *selector,
@@ -369,7 +423,7 @@ ssize_t rtdm_fd_recvmsg(int ufd, struct user_msghdr *msg, int flags);
 
 int __rtdm_fd_recvmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
 		       unsigned int flags, void __user *u_timeout,
-		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user **u_mmsg_p),
 		       int (*put_mmsg)(void __user **u_mmsg_p, const struct mmsghdr *mmsg),
 		       int (*get_timespec)(struct timespec *ts, const void __user *u_ts));
 
@@ -378,7 +432,7 @@ ssize_t rtdm_fd_sendmsg(int ufd, const struct user_msghdr *msg,
 
 int __rtdm_fd_sendmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
 		       unsigned int flags,
-		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user **u_mmsg_p),
 		       int (*put_mmsg)(void __user **u_mmsg_p, const struct mmsghdr *mmsg));
 
 int rtdm_fd_mmap(int ufd, struct _rtdm_mmap_request *rma,
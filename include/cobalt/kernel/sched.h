@@ -113,6 +113,10 @@ struct xnsched {
 	/*!< Currently active account */
 	xnstat_exectime_t *current_account;
 #endif
+#ifdef CONFIG_XENO_OPT_SCHED_TRACE
+	/*!< Context switch trace ring. */
+	struct xnsched_trace_ring *trace;
+#endif
 };
 
 DECLARE_PER_CPU(struct xnsched, nksched);
@@ -398,6 +402,47 @@ static inline void xnsched_reset_watchdog(struct xnsched *sched)
 }
 #endif /* CONFIG_XENO_OPT_WATCHDOG */
 
+#ifdef CONFIG_XENO_OPT_SCHED_TRACE
+
+struct xnsched_trace_ring;
+
+int xnsched_init_trace(void);
+
+void xnsched_cleanup_trace(void);
+
+void __xnsched_trace_switch(struct xnsched *sched,
+			    struct xnthread *prev, struct xnthread *next);
+
+static inline void xnsched_trace_switch(struct xnsched *sched,
+					struct xnthread *prev,
+					struct xnthread *next)
+{
+	if (sched->trace)
+		__xnsched_trace_switch(sched, prev, next);
+}
+
+static inline void xnsched_trace_wakeup(struct xnthread *thread)
+{
+	thread->wakeup_date = xnclock_read_raw(&nkclock);
+}
+
+#else /* !CONFIG_XENO_OPT_SCHED_TRACE */
+
+static inline int xnsched_init_trace(void)
+{
+	return 0;
+}
+
+static inline void xnsched_cleanup_trace(void) { }
+
+static inline void xnsched_trace_switch(struct xnsched *sched,
+					struct xnthread *prev,
+					struct xnthread *next) { }
+
+static inline void xnsched_trace_wakeup(struct xnthread *thread) { }
+
+#endif /* !CONFIG_XENO_OPT_SCHED_TRACE */
+
 bool xnsched_set_effective_priority(struct xnthread *thread,
 				    int prio);
 
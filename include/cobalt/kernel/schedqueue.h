@@ -19,6 +19,7 @@
 #ifndef _COBALT_KERNEL_SCHEDQUEUE_H
 #define _COBALT_KERNEL_SCHEDQUEUE_H
 
+#include <linux/bitmap.h>
 #include <cobalt/kernel/list.h>
 
 /**
@@ -28,21 +29,26 @@
 
 #define XNSCHED_CLASS_WEIGHT_FACTOR	1024
 
-#ifdef CONFIG_XENO_OPT_SCALABLE_SCHED
-
-#include <linux/bitmap.h>
-
 /*
  * Multi-level priority queue, suitable for handling the runnable
- * thread queue of the core scheduling class with O(1) property. We
- * only manage a descending queuing order, i.e. highest numbered
- * priorities come first.
+ * thread queues of the scheduling classes with O(1) property. The
+ * non-empty priority levels are indexed by a two-level bitmap: each
+ * bit of the upper level tells whether the matching word of the
+ * lower level has any bit set, so that the highest priority level is
+ * found with two bit scans. We only manage a descending queuing
+ * order, i.e. highest numbered priorities come first.
  */
 #define XNSCHED_MLQ_LEVELS  260	/* i.e. XNSCHED_CORE_NR_PRIO */
+#define XNSCHED_MLQ_LONGS   BITS_TO_LONGS(XNSCHED_MLQ_LEVELS)
+
+#if XNSCHED_MLQ_LONGS > BITS_PER_LONG
+#error "XNSCHED_MLQ_LEVELS is too high"
+#endif
 
 struct xnsched_mlq {
 	int elems;
-	DECLARE_BITMAP(prio_map, XNSCHED_MLQ_LEVELS);
+	unsigned long himap;
+	unsigned long lomap[XNSCHED_MLQ_LONGS];
 	struct list_head heads[XNSCHED_MLQ_LEVELS];
 };
 
@@ -66,39 +72,16 @@ static inline int xnsched_emptyq_p(struct xnsched_mlq *q)
 	return q->elems == 0;
 }
 
+/* Index of the highest priority level, the queue must not be empty. */
 static inline int xnsched_weightq(struct xnsched_mlq *q)
 {
-	return find_first_bit(q->prio_map, XNSCHED_MLQ_LEVELS);
+	int hi = __ffs(q->himap);
+
+	return hi * BITS_PER_LONG + __ffs(q->lomap[hi]);
 }
 
 typedef struct xnsched_mlq xnsched_queue_t;
 
-#else /* ! CONFIG_XENO_OPT_SCALABLE_SCHED */
-
-typedef struct list_head xnsched_queue_t;
-
-#define xnsched_initq(__q)			INIT_LIST_HEAD(__q)
-#define xnsched_emptyq_p(__q)			list_empty(__q)
-#define xnsched_addq(__q, __t)			list_add_prilf(__t, __q, cprio, rlink)
-#define xnsched_addq_tail(__q, __t)		list_add_priff(__t, __q, cprio, rlink)
-#define xnsched_delq(__q, __t)			(void)(__q), list_del(&(__t)->rlink)
-#define xnsched_getq(__q)							\
-	({									\
-		struct xnthread *__t = NULL;					\
-		if (!list_empty(__q))						\
-			__t = list_get_entry(__q, struct xnthread, rlink);	\
-		__t;								\
-	})
-#define xnsched_weightq(__q)						\
-	({								\
-		struct xnthread *__t;					\
-		__t = list_first_entry(__q, struct xnthread, rlink);	\
-		__t->cprio;						\
-	})
-	
-
-#endif /* !CONFIG_XENO_OPT_SCALABLE_SCHED */
-
 struct xnthread *xnsched_findq(xnsched_queue_t *q, int prio);
 
 /** @} */
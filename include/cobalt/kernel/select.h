@@ -32,6 +32,9 @@
 #define XNSELECT_EXCEPT    2
 #define XNSELECT_MAX_TYPES 3
 
+/* Selector is a poll set, see xnselector_init_pollset(). */
+#define XNSELECT_POLLSET   0x1
+
 struct xnselector {
 	struct xnsynch synchbase;
 	struct fds {
@@ -40,6 +43,8 @@ struct xnselector {
 	} fds [XNSELECT_MAX_TYPES];
 	struct list_head destroy_link;
 	struct list_head bindings; /* only used by xnselector_destroy */
+	struct list_head ready;	   /* ready bindings (poll set only) */
+	unsigned int flags;
 };
 
 #define __NFDBITS__	(8 * sizeof(unsigned long))
@@ -94,6 +99,12 @@ struct xnselect_binding {
 	unsigned int bit_index;
 	struct list_head link;  /* link in selected fds list. */
 	struct list_head slink; /* link in selector list */
+	struct list_head rlink; /* link in selector ready list */
+};
+
+struct xnselect_ready {
+	unsigned int index;
+	unsigned int type;
 };
 
 void xnselect_init(struct xnselect *select_block);
@@ -130,12 +141,26 @@ void xnselect_destroy(struct xnselect *select_block);
 
 int xnselector_init(struct xnselector *selector);
 
+int xnselector_init_pollset(struct xnselector *selector);
+
 int xnselect(struct xnselector *selector,
 	     fd_set *out_fds[XNSELECT_MAX_TYPES],
 	     fd_set *in_fds[XNSELECT_MAX_TYPES],
 	     int nfds,
 	     xnticks_t timeout, xntmode_t timeout_mode);
 
+int xnselect_poll(struct xnselector *selector,
+		  struct xnselect_ready *ready, int nr,
+		  xnticks_t timeout, xntmode_t timeout_mode);
+
+int xnselect_unbind_types(struct xnselector *selector,
+			  unsigned int index, unsigned int types);
+
+int xnselect_unbind(struct xnselector *selector, unsigned int index);
+
+bool xnselect_bound_p(struct xnselector *selector,
+		      unsigned int type, unsigned int index);
+
 void xnselector_destroy(struct xnselector *selector);
 
 int xnselect_mount(void);
@@ -172,6 +172,11 @@ int xnsynch_flush(struct xnsynch *synch, int reason);
 
 void xnsynch_requeue_sleeper(struct xnthread *thread);
 
+int xnsynch_requeue_sleepers(struct xnsynch *from, struct xnsynch *to,
+			     struct xnthread *owner, int nr);
+
+bool xnsynch_acquire_requeued(struct xnsynch *synch);
+
 void xnsynch_forget_sleeper(struct xnthread *thread);
 
 /** @} */
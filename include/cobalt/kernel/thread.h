@@ -175,6 +175,10 @@ struct xnthread {
 		xnstat_exectime_t lastperiod; /* Interval marker for execution time reports */
 	} stat;
 
+#ifdef CONFIG_XENO_OPT_SCHED_TRACE
+	xnticks_t wakeup_date;	/* Last wakeup (raw clock), 0 once resumed */
+#endif
+
 	struct xnselector *selector;    /* For select. */
 
 	xnhandle_t handle;	/* Handle in registry */
@@ -187,6 +187,67 @@ typedef struct { } xntimerq_it_t;
 #define xntimerq_it_begin(q,i)	((void) (i), xntimerq_head(q))
 #define xntimerq_it_next(q,i,h) ((void) (i), xntimerq_next((q),(h)))
 
+#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
+
+#include <linux/rbtree.h>
+#include <linux/bitmap.h>
+
+/*
+ * Timers due within the wheel window, i.e. [base, base + span), are
+ * hashed to a slot depending on their date, each slot covering
+ * 2^XNTIMER_WHEEL_SHIFT clock ticks. Slots are kept sorted by date,
+ * so that the heading timer is exactly the first entry of the first
+ * busy slot following the base. Timers due past the window are
+ * parked in an overflow tree, from which they are pulled into the
+ * wheel as the base moves forward.
+ */
+#define XNTIMER_WHEEL_SLOTS	256
+#define XNTIMER_WHEEL_SHIFT	CONFIG_XENO_OPT_TIMER_WHEEL_SHIFT
+#define XNTIMER_WHEEL_SPAN	((xnticks_t)XNTIMER_WHEEL_SLOTS << XNTIMER_WHEEL_SHIFT)
+
+typedef struct {
+	unsigned long long date;
+	unsigned prio;
+	/* Wheel slot, or -1 if parked in the overflow tree. */
+	int slot;
+	union {
+		struct list_head link;
+		struct rb_node node;
+	};
+} xntimerh_t;
+
+#define xntimerh_date(h) ((h)->date)
+#define xntimerh_prio(h) ((h)->prio)
+#define xntimerh_init(h) do { } while (0)
+
+typedef struct {
+	xnticks_t base;
+	DECLARE_BITMAP(map, XNTIMER_WHEEL_SLOTS);
+	struct list_head slots[XNTIMER_WHEEL_SLOTS];
+	struct rb_root overflow;
+	xntimerh_t *head;
+} xntimerq_t;
+
+void xntimerq_init(xntimerq_t *q);
+
+#define xntimerq_destroy(q) do { } while (0)
+#define xntimerq_empty(q) ((q)->head == NULL)
+
+#define xntimerq_head(q) ((q)->head)
+
+xntimerh_t *xntimerq_next(xntimerq_t *q, xntimerh_t *h);
+
+#define xntimerq_second(q, h) xntimerq_next(q, h)
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder);
+
+void xntimerq_remove(xntimerq_t *q, xntimerh_t *holder);
+
+typedef struct { } xntimerq_it_t;
+
+#define xntimerq_it_begin(q,i)	((void) (i), xntimerq_head(q))
+#define xntimerq_it_next(q,i,h) ((void) (i), xntimerq_next((q),(h)))
+
 #else /* CONFIG_XENO_OPT_TIMER_LIST */
 
 typedef struct xntlholder xntimerh_t;
@@ -21,6 +21,9 @@
 #ifndef _COBALT_MQUEUE_H
 #define _COBALT_MQUEUE_H
 
+#include <errno.h>
+#include <boilerplate/atomic.h>
+#include <cobalt/uapi/mqueue.h>
 #include <cobalt/wrappers.h>
 
 #ifdef __cplusplus
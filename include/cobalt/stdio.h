@@ -102,6 +102,12 @@ int rt_fprintf(FILE *stream, const char *format, ...);
 
 int rt_printf(const char *format, ...);
 
+int rt_vfprintf_bin(FILE *stream, const char *format, va_list args);
+
+int rt_fprintf_bin(FILE *stream, const char *format, ...);
+
+int rt_printf_bin(const char *format, ...);
+
 int rt_puts(const char *s);
 
 int rt_fputs(const char *s, FILE *stream);
@@ -23,6 +23,7 @@
 #include <pthread.h>
 #include <sched.h>
 #include <semaphore.h>
+#include <mqueue.h>
 #include <errno.h>
 #include <stdio.h>
 #include <time.h>
@@ -37,10 +38,15 @@
 #include <cobalt/uapi/thread.h>
 #include <cobalt/uapi/cond.h>
 #include <cobalt/uapi/sem.h>
+#include <cobalt/uapi/batch.h>
 #include <cobalt/ticks.h>
 
 #define cobalt_commit_memory(p) __cobalt_commit_memory(p, sizeof(*p))
 
+typedef struct cobalt_batch {
+	struct cobalt_batch_ring *ring;
+} cobalt_batch_t;
+
 struct cobalt_tsd_hook {
 	void (*create_tsd)(void);
 	void (*delete_tsd)(void);
@@ -127,6 +133,31 @@ int cobalt_event_destroy(cobalt_event_t *event);
 int cobalt_sem_inquire(sem_t *sem, struct cobalt_sem_info *info,
 		       pid_t *waitlist, size_t waitsz);
 
+int cobalt_batch_init(cobalt_batch_t *batch, unsigned int size);
+
+void cobalt_batch_destroy(cobalt_batch_t *batch);
+
+int cobalt_batch_sem_post(cobalt_batch_t *batch, sem_t *sem);
+
+int cobalt_batch_event_post(cobalt_batch_t *batch,
+			    cobalt_event_t *event, unsigned int bits);
+
+int cobalt_batch_mq_send(cobalt_batch_t *batch, mqd_t mqd,
+			 const char *buf, size_t len, unsigned int prio);
+
+int cobalt_batch_read(cobalt_batch_t *batch,
+		      int fd, void *buf, size_t len);
+
+int cobalt_batch_write(cobalt_batch_t *batch,
+		       int fd, const void *buf, size_t len);
+
+int cobalt_batch_ioctl(cobalt_batch_t *batch,
+		       int fd, unsigned int request, void *arg);
+
+int cobalt_batch_submit(cobalt_batch_t *batch, int flags);
+
+long cobalt_batch_result(cobalt_batch_t *batch, int slot);
+
 int cobalt_sched_weighted_prio(int policy,
 			       const struct sched_param_ex *param_ex);
 
@@ -22,6 +22,7 @@
 #define _COBALT_SYS_SELECT_H
 
 #include <cobalt/wrappers.h>
+#include <cobalt/uapi/select.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,6 +32,14 @@ COBALT_DECL(int, select(int __nfds, fd_set *__restrict __readfds,
 			fd_set *__restrict __writefds,
 			fd_set *__restrict __exceptfds,
 			struct timeval *__restrict __timeout));
+
+int pollset_create_np(void);
+
+int pollset_ctl_np(int psfd, int op, int fd, unsigned int events);
+
+int pollset_wait_np(int psfd, struct cobalt_pollset_event *events,
+		    int maxevents, const struct timespec *timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,51 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_BATCH_H
+#define _COBALT_UAPI_BATCH_H
+
+#include <cobalt/uapi/kernel/types.h>
+
+/*
+ * A batch ring is a single-producer/single-consumer array of
+ * syscall requests: userland queues entries at @tail, the kernel
+ * runs them from @head on, storing the completion status of each
+ * request into its own slot. Only a few non-blocking services are
+ * accepted (see cobalt_batch_*() in libcobalt). A RTDM request the
+ * real-time driver handler declines is left at @head with -ENOSYS
+ * as its status, for userland to issue it as a regular syscall.
+ */
+struct cobalt_batch_entry {
+	__u32 nr;
+	__u32 pad;
+	__u64 args[5];
+	__s64 result;
+};
+
+struct cobalt_batch_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 mask;
+	__u32 pad;
+	struct cobalt_batch_entry entries[0];
+};
+
+/* Max. number of entries in a ring (power of 2). */
+#define COBALT_BATCH_MAXSZ	256
+
+/* Submission flags. */
+#define COBALT_BATCH_STOP	0x1	/* Stop on first error. */
+
+#endif /* !_COBALT_UAPI_BATCH_H */
@@ -0,0 +1,75 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_KERNEL_SCHEDTRACE_H
+#define _COBALT_UAPI_KERNEL_SCHEDTRACE_H
+
+#include <linux/types.h>
+
+#define COBALT_SCHEDTRACE_DEV	"schedtrace"
+
+#define XNSCHED_TRACE_MAGIC	0x58535452 /* "XSTR" */
+
+/* Why the outgoing thread was switched out. */
+#define XNSCHED_TRACE_PREEMPT	0 /* Still runnable */
+#define XNSCHED_TRACE_BLOCK	1 /* Blocked, delayed or suspended */
+#define XNSCHED_TRACE_RELAX	2 /* Switching to secondary mode */
+#define XNSCHED_TRACE_EXIT	3 /* Exiting */
+
+/*
+ * The trace area mapped from COBALT_SCHEDTRACE_DEV starts with this
+ * header, followed by one ring per CPU, ring_stride bytes apart from
+ * ring_offset on. Timestamps and delays are expressed in clock ticks,
+ * clock_freq per second.
+ */
+struct xnsched_trace_header {
+	__u32 magic;
+	__u32 nr_cpus;
+	__u32 nr_entries;
+	__u32 entry_size;
+	__u32 ring_offset;
+	__u32 ring_stride;
+	__u32 map_size;
+	__u32 pad;
+	__u64 clock_freq;
+};
+
+/*
+ * Each ring is written by its own CPU only, readers never write
+ * back. head counts the records ever written to the ring, the
+ * record at position pos is stored in entries[pos % nr_entries].
+ * The writer clears seq before updating a record, then sets it to
+ * pos + 1 when done: a reader copies the record out and accepts it
+ * only if seq read before and after the copy is pos + 1.
+ */
+struct xnsched_trace_entry {
+	__u32 seq;
+	__u32 reason;
+	__u64 timestamp;
+	__u64 delay;		/* Wakeup to resumption of next, 0 if preempted */
+	__u32 prev_handle;
+	__u32 next_handle;
+	__s32 prev_pid;		/* Host pid, 0 for the root thread */
+	__s32 next_pid;
+};
+
+struct xnsched_trace_ring {
+	__u32 cpu;
+	__u32 head;
+	__u32 pad[14];
+	struct xnsched_trace_entry entries[0];
+};
+
+#endif /* !_COBALT_UAPI_KERNEL_SCHEDTRACE_H */
@@ -108,6 +108,8 @@ struct xnthread_user_window {
 	__u32 info;
 	__u32 grant_value;
 	__u32 pp_pending;
+	/* CPU number + 1 while running in primary mode, zero otherwise. */
+	__u32 oncpu;
 };
 
 #endif /* !_COBALT_UAPI_KERNEL_THREAD_H */
@@ -0,0 +1,175 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_MQUEUE_H
+#define _COBALT_UAPI_MQUEUE_H
+
+#include <cobalt/uapi/kernel/types.h>
+
+#define COBALT_MSGPRIOMAX	32768
+
+/*
+ * Creation flag, passed into mq_attr.mq_flags: the message pool and
+ * the priority index are laid out in a memory area processes which
+ * opened the queue may map from their descriptor, so that
+ * uncontended transfers may complete in user-space.
+ */
+#define MQ_MAPPED		0x40000000
+
+/*
+ * Kernel attention bits in cobalt_mq_state.kflags. Transfers must go
+ * through the kernel while any of them is set.
+ */
+#define COBALT_MQ_RWAIT		0x1	/* Receiver(s) pending. */
+#define COBALT_MQ_SWAIT		0x2	/* Sender(s) pending. */
+#define COBALT_MQ_SELECT	0x4	/* Bound to a selector. */
+#define COBALT_MQ_NOTIFY	0x8	/* mq_notify() armed. */
+
+#define COBALT_MQ_NIL		(-1)
+
+struct cobalt_mq_slot {
+	__s32 next;
+	__u32 prio;
+	__u32 len;
+	__u32 pad;
+	char data[0];
+};
+
+/*
+ * All fields are covered by the lock, except kflags which only the
+ * kernel updates. Queued slots are linked in decreasing priority
+ * order from head to tail, FIFO among equal priorities.
+ */
+struct cobalt_mq_state {
+	atomic_t lock;
+	__u32 kflags;
+	__u32 msgsize;
+	__u32 maxmsg;
+	__u32 stride;
+	__u32 nrqueued;
+	__s32 free;
+	__s32 head;
+	__s32 tail;
+	__u32 pad;
+	char slots[0];
+};
+
+/*
+ * The helpers below take the queue geometry from the caller, since
+ * the kernel may not trust the copy living in shared memory. Slot
+ * indices are range-checked for the same reason, -EIO denotes a
+ * corrupted index.
+ */
+static inline struct cobalt_mq_slot *
+cobalt_mq_slot(struct cobalt_mq_state *state, __u32 stride, __s32 n)
+{
+	return (struct cobalt_mq_slot *)(state->slots + n * stride);
+}
+
+static inline int cobalt_mq_get_free(struct cobalt_mq_state *state,
+				     __u32 maxmsg, __u32 stride)
+{
+	__s32 n = state->free;
+
+	if (n == COBALT_MQ_NIL)
+		return -EAGAIN;
+
+	if ((__u32)n >= maxmsg)
+		return -EIO;
+
+	state->free = cobalt_mq_slot(state, stride, n)->next;
+
+	return n;
+}
+
+static inline void cobalt_mq_put_free(struct cobalt_mq_state *state,
+				      __u32 stride, __s32 n)
+{
+	cobalt_mq_slot(state, stride, n)->next = state->free;
+	state->free = n;
+}
+
+static inline int cobalt_mq_enqueue(struct cobalt_mq_state *state,
+				    __u32 maxmsg, __u32 stride, __s32 n)
+{
+	struct cobalt_mq_slot *slot, *p;
+	__s32 prev, next, tail;
+	__u32 prio, count;
+
+	slot = cobalt_mq_slot(state, stride, n);
+	prio = slot->prio;
+	slot->next = COBALT_MQ_NIL;
+	tail = state->tail;
+
+	if (state->head == COBALT_MQ_NIL) {
+		state->head = n;
+		state->tail = n;
+		goto done;
+	}
+
+	if ((__u32)tail >= maxmsg)
+		return -EIO;
+
+	if (cobalt_mq_slot(state, stride, tail)->prio >= prio) {
+		cobalt_mq_slot(state, stride, tail)->next = n;
+		state->tail = n;
+		goto done;
+	}
+
+	/* Insert before the first message of lower priority. */
+	prev = COBALT_MQ_NIL;
+	next = state->head;
+	for (count = 0;; count++) {
+		if ((__u32)next >= maxmsg || count >= maxmsg)
+			return -EIO;
+		p = cobalt_mq_slot(state, stride, next);
+		if (p->prio < prio)
+			break;
+		prev = next;
+		next = p->next;
+	}
+
+	slot->next = next;
+	if (prev == COBALT_MQ_NIL)
+		state->head = n;
+	else
+		cobalt_mq_slot(state, stride, prev)->next = n;
+done:
+	state->nrqueued++;
+
+	return 0;
+}
+
+static inline int cobalt_mq_dequeue(struct cobalt_mq_state *state,
+				    __u32 maxmsg, __u32 stride)
+{
+	__s32 n = state->head, next;
+
+	if (n == COBALT_MQ_NIL)
+		return -EAGAIN;
+
+	if ((__u32)n >= maxmsg)
+		return -EIO;
+
+	next = cobalt_mq_slot(state, stride, n)->next;
+	state->head = next;
+	if (next == COBALT_MQ_NIL)
+		state->tail = COBALT_MQ_NIL;
+	state->nrqueued--;
+
+	return n;
+}
+
+#endif /* !_COBALT_UAPI_MQUEUE_H */
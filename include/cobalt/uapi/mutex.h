@@ -28,6 +28,13 @@ struct cobalt_mutex_state {
 #define COBALT_MUTEX_COND_SIGNAL 0x00000001
 #define COBALT_MUTEX_ERRORCHECK  0x00000002
 	__u32 ceiling;
+	/*
+	 * Offset of the owner's user window into the shared heap,
+	 * maintained by user-space for adaptive mutexes on a
+	 * best-effort basis. Never trusted by the kernel.
+	 */
+	__u32 owner_window;
+#define COBALT_MUTEX_NOWINDOW    (~0U)
 };
 
 union cobalt_mutex_union {
@@ -0,0 +1,36 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_SELECT_H
+#define _COBALT_UAPI_SELECT_H
+
+#include <cobalt/uapi/kernel/types.h>
+
+/* Event bits, mapping to the XNSELECT_* types. */
+#define POLLSET_IN	0x1
+#define POLLSET_OUT	0x2
+#define POLLSET_EXCEPT	0x4
+
+/* Control operations. */
+#define POLLSET_CTL_ADD	1
+#define POLLSET_CTL_DEL	2
+#define POLLSET_CTL_MOD	3
+
+struct cobalt_pollset_event {
+	__u32 events;
+	__s32 fd;
+};
+
+#endif /* !_COBALT_UAPI_SELECT_H */
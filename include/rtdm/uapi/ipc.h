@@ -484,6 +484,142 @@ struct sockaddr_ipc {
 	rtipc_port_t sipc_port;
 };
 
+/** Maximum number of size classes in a socket buffer pool. */
+#define RTIPC_POOL_MAXCLASSES	8
+
+/**
+ * Size class of a socket buffer pool.
+ */
+struct rtipc_pool_class {
+	/** Largest payload a buffer of this class may convey, in bytes. */
+	uint32_t size;
+	/** Number of buffers reserved for this class. */
+	uint32_t count;
+};
+
+/**
+ * Size-class pool configuration structure.
+ *
+ * Passed to the @ref IDDP_POOLSZ "IDDP_POOLSZ" socket option instead
+ * of a plain pool size, for laying out the local pool as a set of
+ * fixed-size buffer classes.
+ */
+struct rtipc_pool_setup {
+	/** Number of valid entries in @a classes. */
+	uint32_t nr_classes;
+	/** Size classes, by strictly increasing payload size. */
+	struct rtipc_pool_class classes[RTIPC_POOL_MAXCLASSES];
+};
+
+/**
+ * Size class statistics.
+ */
+struct rtipc_pool_class_stat {
+	/** Largest payload of this class. */
+	uint32_t size;
+	/** Number of buffers in this class. */
+	uint32_t count;
+	/** Number of free buffers. */
+	uint32_t free;
+	/** Lowest number of free buffers observed. */
+	uint32_t lowat;
+	/** Number of buffers allocated from this class. */
+	uint64_t allocs;
+	/**
+	 * Number of requests fitting this class best, which were
+	 * served by a larger one.
+	 */
+	uint64_t fallbacks;
+	/**
+	 * Number of requests fitting this class best, which found no
+	 * free buffer in this class or any larger one.
+	 */
+	uint64_t misses;
+};
+
+/**
+ * Size-class pool statistics.
+ *
+ * Returned by the @ref IDDP_POOLSTAT "IDDP_POOLSTAT" socket option.
+ */
+struct rtipc_pool_stat {
+	/** Number of valid entries in @a classes, zero if none. */
+	uint32_t nr_classes;
+	uint32_t __pad;
+	/** Per-class statistics. */
+	struct rtipc_pool_class_stat classes[RTIPC_POOL_MAXCLASSES];
+};
+
+/**
+ * Ring configuration structure.
+ *
+ * Passed to the @ref XDDP_RING "XDDP_RING", @ref IDDP_RING
+ * "IDDP_RING" and @ref BUFP_RING "BUFP_RING" socket options for
+ * switching a port to the shared ring mode.
+ */
+struct rtipc_ring_setup {
+	/** Number of slots, must be a power of two. */
+	uint32_t nr_slots;
+	/** Maximum payload size of a slot, in bytes. */
+	uint32_t slot_size;
+};
+
+/**
+ * Shared ring header.
+ *
+ * A ring mapped via mmap() on a ring-mode port starts with this
+ * header, followed by @a nr_slots descriptors of @a slot_stride bytes
+ * each, starting at @a slot_offset. Slot @a n lives at index (@a n &
+ * (@a nr_slots - 1)).
+ *
+ * The ring has a single producer and a single consumer. The producer
+ * fills the slot indexed by @a head, then increments @a head. The
+ * consumer reads the slot indexed by @a tail, then increments @a
+ * tail. Both indices are free-running. Each side must issue a full
+ * memory barrier between updating its own index and reading the
+ * other one.
+ *
+ * Notifications are only required on transitions: a producer which
+ * observes @a tail equal to its previous @a head value after
+ * publishing found the ring empty and must wake up the consumer; a
+ * consumer which observes @a head equal to its previous @a tail value
+ * plus @a nr_slots found the ring full and must wake up the
+ * producer. See the @ref XDDP_RING "XDDP_RING", @ref IDDP_RING
+ * "IDDP_RING" and @ref BUFP_RING "BUFP_RING" options for the
+ * protocol-specific means to do so.
+ */
+struct rtipc_ring_header {
+	/** Producer index. */
+	uint32_t head;
+	uint32_t __pad1[15];
+	/** Consumer index. */
+	uint32_t tail;
+	uint32_t __pad2[15];
+	/** Number of slots (power of two). */
+	uint32_t nr_slots;
+	/** Maximum payload size of a slot. */
+	uint32_t slot_size;
+	/** Distance between two consecutive slots. */
+	uint32_t slot_stride;
+	/** Offset of the first slot from the start of the header. */
+	uint32_t slot_offset;
+	/** Size of the whole mapping. */
+	uint32_t map_size;
+	uint32_t __pad3[11];
+};
+
+/**
+ * Shared ring slot descriptor.
+ */
+struct rtipc_ring_slot {
+	/** Payload length. */
+	uint32_t len;
+	/** Source port, or -1 when written through a mapping. */
+	int32_t from;
+	/** Payload. */
+	char data[0];
+};
+
 #define SOL_XDDP		311
 /**
  * @anchor sockopts_xddp @name XDDP socket options
@@ -648,6 +784,50 @@ struct sockaddr_ipc {
  * RT/non-RT, kernel space only
  */
 #define XDDP_MONITOR		4
+/**
+ * XDDP shared ring mode
+ *
+ * Switches the port to the shared ring mode for the real-time to
+ * Linux direction. Datagrams sent to the port are stored into the
+ * slots of a ring instead of being allocated from the buffer pool and
+ * queued to the message pipe. Messages sent from the Linux domain
+ * still flow through the pipe.
+ *
+ * Both endpoints may map the ring (see struct rtipc_ring_header): the
+ * real-time side by calling mmap() on the socket, the Linux side by
+ * calling mmap() on /dev/rtp@em N. A mapping must start at offset
+ * zero and may not extend past rtipc_ring_header.map_size.
+ *
+ * A real-time producer may either send datagrams normally, in which
+ * case they are copied into the next free slot, or fill the slots
+ * directly through its mapping, then send a zero-length datagram to
+ * the port whenever it observed the empty to non-empty transition.
+ * In both cases, the kernel writes a 32-bit doorbell message
+ * containing the current producer index to the pipe on such
+ * transitions. The Linux consumer reads the slots from its mapping,
+ * and reads or polls /dev/rtp@em N for doorbells once the ring is
+ * empty. Sending to a full ring fails with -EAGAIN, MSG_MORE and
+ * MSG_OOB are not supported in this mode.
+ *
+ * This option must be set before the socket is bound; the ring is
+ * allocated by the @ref bind__AF_RTIPC "bind call".
+ *
+ * @param [in] level @ref sockopts_xddp "SOL_XDDP"
+ * @param [in] optname @b XDDP_RING
+ * @param [in] optval Pointer to struct rtipc_ring_setup
+ * @param [in] optlen sizeof(struct rtipc_ring_setup)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen invalid, or invalid ring geometry)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define XDDP_RING		5
 /** @} */
 
 /**
@@ -745,26 +925,102 @@ struct sockaddr_ipc {
  * was bound. However, multiple configuration calls are allowed prior
  * to the binding; the last value set will be used.
  *
+ * Alternatively, a struct rtipc_pool_setup may be passed, which
+ * lays out the local pool as a set of size classes, each of them
+ * holding a fixed number of buffers. A datagram is stored into a
+ * buffer of the smallest class it fits in, or of the next larger
+ * class having a free buffer. Allocating and releasing buffers then
+ * takes a bounded time, regardless of the traffic pattern. Sending a
+ * datagram larger than the largest class fails with -EMSGSIZE. See
+ * @ref IDDP_POOLSTAT "IDDP_POOLSTAT" for the per-class statistics.
+ *
  * @note: the pool memory is obtained from the host allocator by the
  * @ref bind__AF_RTIPC "bind call".
  *
  * @param [in] level @ref sockopts_iddp "SOL_IDDP"
  * @param [in] optname @b IDDP_POOLSZ
  * @param [in] optval Pointer to a variable of type size_t, containing
- * the required size of the local pool to reserve at binding time
- * @param [in] optlen sizeof(size_t)
+ * the required size of the local pool to reserve at binding time, or
+ * pointer to struct rtipc_pool_setup
+ * @param [in] optlen sizeof(size_t) or sizeof(struct rtipc_pool_setup)
  *
  * @return 0 is returned upon success. Otherwise:
  *
  * - -EFAULT (Invalid data address given)
  * - -EALREADY (socket already bound)
- * - -EINVAL (@a optlen is invalid or *@a optval is zero)
+ * - -EINVAL (@a optlen is invalid, *@a optval is zero, or the size
+ * classes are invalid)
  * .
  *
  * @par Calling context:
  * RT/non-RT
  */
 #define IDDP_POOLSZ		2
+/**
+ * IDDP shared ring mode
+ *
+ * Switches the receiving port to the shared ring mode. Datagrams sent
+ * to the port are copied into the slots of a ring instead of being
+ * allocated from the buffer pool. The local pool, if any, is not used
+ * in this mode.
+ *
+ * The ring can be mapped (see struct rtipc_ring_header) by calling
+ * mmap() either on the bound socket, or on a socket connected to it,
+ * in which case the latter may fill the slots directly. A mapping
+ * must start at offset zero and may not extend past
+ * rtipc_ring_header.map_size. Mapped producers must be unique, and
+ * may not run concurrently with regular senders to the same port.
+ *
+ * The transition notifications are issued with zero-length transfers:
+ * sending a zero-length datagram to the port wakes up the consumer,
+ * receiving with a zero-length buffer from the port wakes up the
+ * senders waiting for free slots, then waits until the ring is not
+ * empty unless MSG_DONTWAIT is given. A sender blocks while the ring
+ * is full, unless MSG_DONTWAIT is given. MSG_OOB is not supported in
+ * this mode.
+ *
+ * This option must be set before the socket is bound; the ring is
+ * allocated by the @ref bind__AF_RTIPC "bind call".
+ *
+ * @param [in] level @ref sockopts_iddp "SOL_IDDP"
+ * @param [in] optname @b IDDP_RING
+ * @param [in] optval Pointer to struct rtipc_ring_setup
+ * @param [in] optlen sizeof(struct rtipc_ring_setup)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen invalid, or invalid ring geometry)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define IDDP_RING		3
+/**
+ * IDDP pool statistics
+ *
+ * Returns the per-class statistics of the local pool of a bound
+ * socket which was given size classes via @ref IDDP_POOLSZ
+ * "IDDP_POOLSZ". @a nr_classes is zero for other sockets.
+ *
+ * @param [in] level @ref sockopts_iddp "SOL_IDDP"
+ * @param [in] optname @b IDDP_POOLSTAT
+ * @param [out] optval Pointer to struct rtipc_pool_stat
+ * @param [in,out] optlen Pointer to a variable containing
+ * sizeof(struct rtipc_pool_stat)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EINVAL (@a optlen is invalid)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define IDDP_POOLSTAT		4
 /** @} */
 
 #define SOL_BUFP		313
@@ -834,6 +1090,54 @@ struct sockaddr_ipc {
  * RT/non-RT
  */
 #define BUFP_BUFSZ		2
+/**
+ * BUFP ring mode
+ *
+ * Switches the receiving port to the shared ring mode. The stream
+ * is conveyed through the slots of a ring instead of the byte
+ * buffer, each write being split into chunks of at most
+ * rtipc_ring_setup.slot_size bytes. Readers and writers no longer
+ * serialize on a common lock, and may only sleep on the empty and
+ * full transitions. @ref BUFP_BUFSZ "BUFP_BUFSZ" is ignored in this
+ * mode.
+ *
+ * Since chunks are consumed as they arrive, the all-or-nothing
+ * semantics of the regular mode do not apply: a read returns as soon
+ * as some data is available, a write with MSG_DONTWAIT returns the
+ * number of bytes which could be queued before the ring filled up.
+ *
+ * The ring can be mapped (see struct rtipc_ring_header) by calling
+ * mmap() either on the bound socket, or on a socket connected to it,
+ * so that data may flow between both endpoints without entering the
+ * kernel. A mapping must start at offset zero and may not extend
+ * past rtipc_ring_header.map_size. Mapped producers must be unique,
+ * and may not run concurrently with regular writers to the same
+ * port; regular writers are serialized with each other.
+ *
+ * The transition notifications are issued with zero-length
+ * transfers: sending zero bytes to the port wakes up the reader,
+ * receiving with a zero-length buffer from the port wakes up the
+ * writers waiting for free slots.
+ *
+ * This option must be set before the socket is bound; the ring is
+ * allocated by the @ref bind__AF_RTIPC "bind call".
+ *
+ * @param [in] level @ref sockopts_bufp "SOL_BUFP"
+ * @param [in] optname @b BUFP_RING
+ * @param [in] optval Pointer to struct rtipc_ring_setup
+ * @param [in] optlen sizeof(struct rtipc_ring_setup)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen invalid, or invalid ring geometry)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define BUFP_RING		3
 /** @} */
 
 /**
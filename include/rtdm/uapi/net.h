@@ -72,4 +72,84 @@
 /* argument construction for RTNET_RTIOC_XMITPARAMS */
 #define SOCK_XMIT_PARAMS(priority, channel) ((priority) | ((channel) << 16))
 
+/*
+ * Mapped frame rings for AF_PACKET sockets.
+ *
+ * RTNET_PACKET_RX_RING and RTNET_PACKET_TX_RING (level SOL_PACKET)
+ * attach a ring of frame_nr frames of frame_size bytes to the socket,
+ * each ring at most once and from non-RT context. A single mmap() at
+ * offset 0 then exposes the RX ring followed by the TX ring, each of
+ * them rounded up to a page boundary.
+ *
+ * Every frame starts with a struct rtnet_packet_frame header, the
+ * payload follows at offset mac. Frame n of a ring is accessed in
+ * order, n modulo frame_nr.
+ *
+ * RX: the stack fills frames owned by the kernel
+ * (RTNET_PACKET_STATUS_KERNEL), then hands them over to the
+ * application (RTNET_PACKET_STATUS_USER), which gives them back once
+ * done. Frames arriving while the next frame is still owned by the
+ * application are dropped and accounted for in RTNET_PACKET_STATISTICS,
+ * RTNET_PACKET_STATUS_LOSING is set on the next frame delivered.
+ * Once an RX ring exists, recvmsg() does not return any data anymore
+ * but waits for the ring to become non-empty, returning 0. It may
+ * return early, the application must recheck the ring anyway. Input
+ * readiness reported by select/poll follows the same rule.
+ *
+ * TX: the application fills available frames
+ * (RTNET_PACKET_STATUS_AVAILABLE), setting len, then marks them
+ * RTNET_PACKET_STATUS_SEND_REQUEST. A sendmsg() call with an empty
+ * message (msg_iovlen == 0) then flushes all requested frames in
+ * order, returning the number of frames sent. Each frame goes to the
+ * interface given by ifindex, or to the bound interface if zero. On
+ * SOCK_DGRAM sockets, addr is the link layer destination and protocol
+ * the link layer protocol (network byte order) to use; raw sockets
+ * carry the link layer header in the payload. Frames the stack could
+ * not send are marked RTNET_PACKET_STATUS_WRONG_FORMAT and not
+ * counted, the next frames remain queued.
+ */
+#ifndef SOL_PACKET
+#define SOL_PACKET			263
+#endif
+
+#define RTNET_PACKET_RX_RING		5
+#define RTNET_PACKET_STATISTICS		6
+#define RTNET_PACKET_TX_RING		13
+
+#define RTNET_PACKET_STATUS_KERNEL	0
+#define RTNET_PACKET_STATUS_USER	1
+#define RTNET_PACKET_STATUS_LOSING	4
+
+#define RTNET_PACKET_STATUS_AVAILABLE	0
+#define RTNET_PACKET_STATUS_SEND_REQUEST 1
+#define RTNET_PACKET_STATUS_WRONG_FORMAT 4
+
+#define RTNET_PACKET_ALIGNMENT		16
+#define RTNET_PACKET_ALIGN(x)		\
+	(((x) + RTNET_PACKET_ALIGNMENT - 1) & ~(RTNET_PACKET_ALIGNMENT - 1))
+
+struct rtnet_packet_req {
+	uint32_t frame_size;	/* multiple of RTNET_PACKET_ALIGNMENT */
+	uint32_t frame_nr;
+};
+
+struct rtnet_packet_frame {
+	uint32_t status;
+	uint32_t len;		/* RX: frame length on the wire, TX: payload */
+	uint32_t snaplen;	/* RX: bytes stored in the frame */
+	uint16_t mac;		/* Offset of the payload in the frame */
+	uint16_t net;		/* Offset of the network header */
+	uint64_t tstamp;	/* RX: arrival time (ns) */
+	int32_t ifindex;
+	uint16_t protocol;	/* Network byte order */
+	uint8_t pkttype;
+	uint8_t halen;
+	uint8_t addr[8];	/* RX: source, TX: destination */
+};
+
+struct rtnet_packet_stats {
+	uint32_t packets;
+	uint32_t drops;
+};
+
 #endif  /* !_RTDM_UAPI_NET_H */
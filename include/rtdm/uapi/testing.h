@@ -61,6 +61,19 @@ typedef struct rttst_tmbench_config {
 	int freeze_max;
 } rttst_tmbench_config_t;
 
+struct rttst_tmqueue_bench {
+	/* Input: number of armed timers, measurement rounds. */
+	__u32 nrtimers;
+	__u32 rounds;
+	/* Output: per-operation cost of the core timer queue. */
+	__s64 insert_avg_ns;
+	__s64 insert_max_ns;
+	__s64 remove_avg_ns;
+	__s64 remove_max_ns;
+	__s64 expire_avg_ns;
+	__s64 expire_max_ns;
+};
+
 struct rttst_swtest_task {
 	unsigned int index;
 	unsigned int flags;
@@ -148,6 +161,9 @@ struct rttst_heap_stathdr {
 #define RTTST_RTIOC_TMBENCH_STOP \
 	_IOWR(RTIOC_TYPE_TESTING, 0x11, struct rttst_overall_bench_res)
 
+#define RTTST_RTIOC_TMBENCH_QUEUE \
+	_IOWR(RTIOC_TYPE_TESTING, 0x12, struct rttst_tmqueue_bench)
+
 #define RTTST_RTIOC_SWTEST_SET_TASKS_COUNT \
 	_IOW(RTIOC_TYPE_TESTING, 0x30, __u32)
 
@@ -70,6 +70,7 @@ __COBALT_CALL32emu_THUNK(monitor_wait)
 __COBALT_CALL32emu_THUNK(event_wait)
 __COBALT_CALL32emu_THUNK(select)
 __COBALT_CALL32x_THUNK(select)
+__COBALT_CALL32emu_THUNK(pollset_wait)
 __COBALT_CALL32emu_THUNK(recvmsg)
 __COBALT_CALL32x_THUNK(recvmsg)
 __COBALT_CALL32emu_THUNK(sendmsg)
@@ -23,6 +23,7 @@
 #include <linux/log2.h>
 #include <linux/bitops.h>
 #include <linux/mm.h>
+#include <linux/percpu.h>
 #include <asm/pgtable.h>
 #include <cobalt/kernel/assert.h>
 #include <cobalt/kernel/heap.h>
@@ -39,6 +40,12 @@
  * The free page list is maintained in rbtrees for fast lookups of
  * multi-page memory ranges, and pages holding bucketed memory have a
  * fast allocation bitmap to manage their blocks internally.
+ *
+ * Alternatively, CONFIG_XENO_OPT_HEAP_TLSF selects a two-level
+ * segregated fit allocator as described in "TLSF: a New Dynamic
+ * Memory Allocator for Real-Time Systems" by M. Masmano, I. Ripoll,
+ * A. Crespo and J. Real (ECRTS 2004), which serves and releases
+ * blocks of any size in bounded time.
  *@{
  */
 struct xnheap cobalt_heap;		/* System heap */
@@ -48,6 +55,8 @@ static LIST_HEAD(heapq);	/* Heap list for v-file dump */
 
 static int nrheaps;
 
+static size_t get_largest_free(struct xnheap *heap);
+
 #ifdef CONFIG_XENO_OPT_VFILE
 
 static struct xnvfile_rev_tag vfile_tag;
@@ -61,6 +70,13 @@ struct vfile_priv {
 struct vfile_data {
 	size_t all_mem;
 	size_t free_mem;
+	size_t largest;
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long refills;
+	unsigned long flushes;
+#endif
 	char name[XNOBJECT_NAME_LEN];
 };
 
@@ -90,6 +106,7 @@ static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 	struct vfile_priv *priv = xnvfile_iterator_priv(it);
 	struct vfile_data *p = data;
 	struct xnheap *heap;
+	spl_t s;
 
 	if (priv->curr == NULL)
 		return 0;	/* We are done. */
@@ -101,25 +118,76 @@ static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 		priv->curr = list_entry(heap->next.next,
 					struct xnheap, next);
 
+	xnlock_get_irqsave(&heap->lock, s);
 	p->all_mem = xnheap_get_size(heap);
 	p->free_mem = xnheap_get_free(heap);
+	p->largest = get_largest_free(heap);
+	xnlock_put_irqrestore(&heap->lock, s);
 	knamecpy(p->name, heap->name);
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	p->hits = p->misses = p->refills = p->flushes = 0;
+	if (heap->pcache) {
+		struct xnheap_pcache *pc;
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			pc = per_cpu_ptr(heap->pcache, cpu);
+			p->hits += pc->hits;
+			p->misses += pc->misses;
+			p->refills += pc->refills;
+			p->flushes += pc->flushes;
+		}
+	}
+#endif
 
 	return 1;
 }
 
+/*
+ * Share of the free memory which cannot be obtained in a single
+ * block, in percent.
+ */
+static unsigned int frag_ratio(struct vfile_data *p)
+{
+	if (p->free_mem == 0)
+		return 0;
+
+	return 100 - (unsigned int)div64_u64((u64)p->largest * 100,
+					     p->free_mem);
+}
+
 static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
 {
 	struct vfile_data *p = data;
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
 	if (p == NULL)
-		xnvfile_printf(it, "%9s %9s  %s\n",
-			       "TOTAL", "FREE", "NAME");
+		xnvfile_printf(it, "%9s %9s %9s %4s  %10s %10s %10s %10s  %s\n",
+			       "TOTAL", "FREE", "LARGEST", "FRAG", "HITS",
+			       "MISSES", "REFILLS", "FLUSHES", "NAME");
 	else
-		xnvfile_printf(it, "%9zu %9zu  %s\n",
+		xnvfile_printf(it, "%9zu %9zu %9zu %3u%%  %10lu %10lu %10lu %10lu  %s\n",
 			       p->all_mem,
 			       p->free_mem,
+			       p->largest,
+			       frag_ratio(p),
+			       p->hits,
+			       p->misses,
+			       p->refills,
+			       p->flushes,
 			       p->name);
+#else
+	if (p == NULL)
+		xnvfile_printf(it, "%9s %9s %9s %4s  %s\n",
+			       "TOTAL", "FREE", "LARGEST", "FRAG", "NAME");
+	else
+		xnvfile_printf(it, "%9zu %9zu %9zu %3u%%  %s\n",
+			       p->all_mem,
+			       p->free_mem,
+			       p->largest,
+			       frag_ratio(p),
+			       p->name);
+#endif
 	return 0;
 }
 
@@ -141,6 +209,333 @@ void xnheap_cleanup_proc(void)
 
 #endif /* CONFIG_XENO_OPT_VFILE */
 
+#ifdef CONFIG_XENO_OPT_HEAP_TLSF
+
+/*
+ * Two-level segregated fit allocator. Free blocks are linked into
+ * lists indexed by size: the first level splits sizes by power of
+ * two, the second level divides each power of two into
+ * TLSF_SL_COUNT linear ranges. Two levels of bitmaps tell which
+ * lists are non-empty, so that a free block large enough for a
+ * request is found with a couple of find-first-set operations.
+ *
+ * Every block starts with a header giving its size and the address
+ * of its physical predecessor, which allows coalescing with both
+ * neighbours in constant time on release. A zero-sized busy block
+ * sits at the end of the heap, so that the last real block always
+ * has a successor.
+ */
+#define TLSF_SL_LOG2		4
+#define TLSF_SL_COUNT		(1 << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT		(TLSF_SL_LOG2 + XNHEAP_MIN_LOG2)
+#define TLSF_FL_MAX		32 /* XNHEAP_MAX_HEAPSZ < 2^32 */
+#define TLSF_FL_COUNT		(TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+#define TLSF_SMALL_SIZE		(1UL << TLSF_FL_SHIFT)
+
+#define TLSF_BLOCK_FREE		0x1
+#define TLSF_PREV_FREE		0x2
+#define TLSF_FLAGS		(TLSF_BLOCK_FREE|TLSF_PREV_FREE)
+
+struct xnheap_tlsf_block {
+	/* Valid only if the previous block is free. */
+	struct xnheap_tlsf_block *prev_phys;
+	/* Overall block size, including this header, plus flags. */
+	size_t size;
+	/* Valid only if this block is free. */
+	struct xnheap_tlsf_block *next_free;
+	struct xnheap_tlsf_block *prev_free;
+};
+
+#define TLSF_HDRSZ	\
+	ALIGN(offsetof(struct xnheap_tlsf_block, next_free), XNHEAP_MIN_ALIGN)
+#define TLSF_MIN_BLOCK	\
+	ALIGN(sizeof(struct xnheap_tlsf_block), XNHEAP_MIN_ALIGN)
+
+struct xnheap_tlsf {
+	u32 fl_bitmap;
+	u32 sl_bitmap[TLSF_FL_COUNT];
+	struct xnheap_tlsf_block *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+};
+
+static inline size_t tlsf_size(struct xnheap_tlsf_block *b)
+{
+	return b->size & ~TLSF_FLAGS;
+}
+
+static inline bool tlsf_is_free(struct xnheap_tlsf_block *b)
+{
+	return b->size & TLSF_BLOCK_FREE;
+}
+
+static inline struct xnheap_tlsf_block *
+tlsf_next_phys(struct xnheap_tlsf_block *b)
+{
+	return (void *)b + tlsf_size(b);
+}
+
+static inline void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+	int f;
+
+	if (size < TLSF_SMALL_SIZE) {
+		*fl = 0;
+		*sl = size >> (TLSF_FL_SHIFT - TLSF_SL_LOG2);
+	} else {
+		f = __fls(size);
+		*sl = (size >> (f - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+		*fl = f - TLSF_FL_SHIFT + 1;
+	}
+}
+
+/*
+ * Round the size up to the next list boundary, so that any block
+ * from the list we pick is large enough.
+ */
+static inline void tlsf_mapping_search(size_t size, int *fl, int *sl)
+{
+	if (size >= TLSF_SMALL_SIZE)
+		size += (1UL << (__fls(size) - TLSF_SL_LOG2)) - 1;
+
+	tlsf_mapping(size, fl, sl);
+}
+
+static void tlsf_insert(struct xnheap_tlsf *t, struct xnheap_tlsf_block *b)
+{
+	struct xnheap_tlsf_block *head;
+	int fl, sl;
+
+	tlsf_mapping(tlsf_size(b), &fl, &sl);
+	head = t->blocks[fl][sl];
+	b->prev_free = NULL;
+	b->next_free = head;
+	if (head)
+		head->prev_free = b;
+	t->blocks[fl][sl] = b;
+	t->fl_bitmap |= 1U << fl;
+	t->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void tlsf_remove(struct xnheap_tlsf *t, struct xnheap_tlsf_block *b)
+{
+	int fl, sl;
+
+	tlsf_mapping(tlsf_size(b), &fl, &sl);
+	if (b->next_free)
+		b->next_free->prev_free = b->prev_free;
+	if (b->prev_free)
+		b->prev_free->next_free = b->next_free;
+	else {
+		t->blocks[fl][sl] = b->next_free;
+		if (b->next_free == NULL) {
+			t->sl_bitmap[fl] &= ~(1U << sl);
+			if (t->sl_bitmap[fl] == 0)
+				t->fl_bitmap &= ~(1U << fl);
+		}
+	}
+}
+
+static struct xnheap_tlsf_block *
+tlsf_search(struct xnheap_tlsf *t, size_t size)
+{
+	u32 fl_map, sl_map;
+	int fl, sl;
+
+	tlsf_mapping_search(size, &fl, &sl);
+	if (fl >= TLSF_FL_COUNT)
+		return NULL;
+
+	sl_map = t->sl_bitmap[fl] & (~0U << sl);
+	if (sl_map == 0) {
+		if (fl + 1 >= TLSF_FL_COUNT)
+			return NULL;
+		fl_map = t->fl_bitmap & (~0U << (fl + 1));
+		if (fl_map == 0)
+			return NULL;
+		fl = __ffs(fl_map);
+		sl_map = t->sl_bitmap[fl];
+	}
+
+	sl = __ffs(sl_map);
+
+	return t->blocks[fl][sl];
+}
+
+static void *tlsf_alloc(struct xnheap *heap, size_t size)
+{
+	struct xnheap_tlsf_block *b, *rem;
+	struct xnheap_tlsf *t = heap->tlsf;
+	size_t bsize;
+
+	if (size > XNHEAP_MAX_HEAPSZ)
+		return NULL;
+
+	bsize = ALIGN(size + TLSF_HDRSZ, XNHEAP_MIN_ALIGN);
+	if (bsize < TLSF_MIN_BLOCK)
+		bsize = TLSF_MIN_BLOCK;
+
+	b = tlsf_search(t, bsize);
+	if (b == NULL)
+		return NULL;
+
+	tlsf_remove(t, b);
+
+	/* Split the remainder off if large enough to be reused. */
+	if (tlsf_size(b) - bsize >= TLSF_MIN_BLOCK) {
+		rem = (void *)b + bsize;
+		rem->size = (tlsf_size(b) - bsize) | TLSF_BLOCK_FREE;
+		rem->prev_phys = b;
+		tlsf_next_phys(rem)->prev_phys = rem;
+		tlsf_insert(t, rem);
+		b->size = bsize | (b->size & TLSF_PREV_FREE);
+	} else {
+		b->size &= ~TLSF_BLOCK_FREE;
+		tlsf_next_phys(b)->size &= ~TLSF_PREV_FREE;
+	}
+
+	heap->used_size += tlsf_size(b);
+
+	return (void *)b + TLSF_HDRSZ;
+}
+
+static struct xnheap_tlsf_block *
+tlsf_check(struct xnheap *heap, void *block)
+{
+	struct xnheap_tlsf_block *b = block - TLSF_HDRSZ;
+	void *limit = heap->membase + heap->usable_size - TLSF_HDRSZ;
+
+	/*
+	 * There is no way to fully validate an arbitrary address in
+	 * constant time, we can only detect obvious misuses.
+	 */
+	if (block < heap->membase + TLSF_HDRSZ || block >= limit ||
+	    ((unsigned long)block & (XNHEAP_MIN_ALIGN - 1)) ||
+	    tlsf_is_free(b) || tlsf_size(b) < TLSF_MIN_BLOCK ||
+	    (void *)tlsf_next_phys(b) > limit)
+		return NULL;
+
+	return b;
+}
+
+static int tlsf_free(struct xnheap *heap, void *block)
+{
+	struct xnheap_tlsf_block *b, *prev, *next;
+	struct xnheap_tlsf *t = heap->tlsf;
+
+	b = tlsf_check(heap, block);
+	if (b == NULL)
+		return -EINVAL;
+
+	heap->used_size -= tlsf_size(b);
+	b->size |= TLSF_BLOCK_FREE;
+
+	if (b->size & TLSF_PREV_FREE) {
+		prev = b->prev_phys;
+		tlsf_remove(t, prev);
+		prev->size += tlsf_size(b);
+		b = prev;
+	}
+
+	next = tlsf_next_phys(b);
+	if (tlsf_is_free(next)) {
+		tlsf_remove(t, next);
+		b->size += tlsf_size(next);
+		next = tlsf_next_phys(b);
+	}
+
+	next->prev_phys = b;
+	next->size |= TLSF_PREV_FREE;
+	tlsf_insert(t, b);
+
+	return 0;
+}
+
+static inline void *__heap_alloc(struct xnheap *heap, size_t size)
+{
+	void *block;
+	spl_t s;
+
+	xnlock_get_irqsave(&heap->lock, s);
+	block = tlsf_alloc(heap, size);
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	return block;
+}
+
+static inline int __heap_free(struct xnheap *heap, void *block)
+{
+	int ret;
+	spl_t s;
+
+	xnlock_get_irqsave(&heap->lock, s);
+	ret = tlsf_free(heap, block);
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	return ret;
+}
+
+static inline ssize_t __heap_check_block(struct xnheap *heap, void *block)
+{
+	struct xnheap_tlsf_block *b;
+	ssize_t ret = -EINVAL;
+	spl_t s;
+
+	xnlock_get_irqsave(&heap->lock, s);
+	b = tlsf_check(heap, block);
+	if (b)
+		ret = tlsf_size(b) - TLSF_HDRSZ;
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	return ret;
+}
+
+static int init_freelists(struct xnheap *heap, void *membase, size_t size)
+{
+	struct xnheap_tlsf_block *b, *sentinel;
+
+	heap->tlsf = kzalloc(sizeof(*heap->tlsf), GFP_KERNEL);
+	if (heap->tlsf == NULL)
+		return -ENOMEM;
+
+	/* A single free block, followed by the busy sentinel. */
+	b = membase;
+	b->prev_phys = NULL;
+	b->size = (size - TLSF_HDRSZ) | TLSF_BLOCK_FREE;
+	sentinel = tlsf_next_phys(b);
+	sentinel->prev_phys = b;
+	sentinel->size = TLSF_PREV_FREE;
+	tlsf_insert(heap->tlsf, b);
+
+	return 0;
+}
+
+static void destroy_freelists(struct xnheap *heap)
+{
+	kfree(heap->tlsf);
+}
+
+/* Heap lock held. */
+static size_t get_largest_free(struct xnheap *heap)
+{
+	struct xnheap_tlsf *t = heap->tlsf;
+	struct xnheap_tlsf_block *b;
+	size_t largest = 0;
+	int fl, sl;
+
+	if (t->fl_bitmap == 0)
+		return 0;
+
+	/* The largest block lives in the highest non-empty list. */
+	fl = __fls(t->fl_bitmap);
+	sl = __fls(t->sl_bitmap[fl]);
+	for (b = t->blocks[fl][sl]; b; b = b->next_free)
+		if (tlsf_size(b) > largest)
+			largest = tlsf_size(b);
+
+	return largest - TLSF_HDRSZ;
+}
+
+#else /* !CONFIG_XENO_OPT_HEAP_TLSF */
+
 enum xnheap_pgtype {
 	page_free =0,
 	page_cont =1,
@@ -511,45 +906,12 @@ static void *add_free_range(struct xnheap *heap,
 	return pagenr_to_addr(heap, pg);
 }
 
-/**
- * @fn void *xnheap_alloc(struct xnheap *heap, size_t size)
- * @brief Allocate a memory block from a memory heap.
- *
- * Allocates a contiguous region of memory from an active memory heap.
- * Such allocation is guaranteed to be time-bounded.
- *
- * @param heap The descriptor address of the heap to get memory from.
- *
- * @param size The size in bytes of the requested block.
- *
- * @return The address of the allocated region upon success, or NULL
- * if no memory is available from the specified heap.
- *
- * @coretags{unrestricted}
- */
-void *xnheap_alloc(struct xnheap *heap, size_t size)
+static void *alloc_block(struct xnheap *heap,
+			 size_t bsize, int log2size)
 {
-	int log2size, ilog, pg, b = -1;
-	size_t bsize;
+	int ilog, pg, b;
 	void *block;
-	spl_t s;
-
-	if (size == 0)
-		return NULL;
 
-	if (size < XNHEAP_MIN_ALIGN) {
-		bsize = size = XNHEAP_MIN_ALIGN;
-		log2size = XNHEAP_MIN_LOG2;
-	} else {
-		log2size = ilog2(size);
-		if (log2size < XNHEAP_PAGE_SHIFT) {
-			if (size & (size - 1))
-				log2size++;
-			bsize = 1 << log2size;
-		} else
-			bsize = ALIGN(size, XNHEAP_PAGE_SIZE);
-	}
-	
 	/*
 	 * Allocate entire pages directly from the pool whenever the
 	 * block is larger or equal to XNHEAP_PAGE_SIZE.  Otherwise,
@@ -562,73 +924,50 @@ void *xnheap_alloc(struct xnheap *heap, size_t size)
 	 * this list, in which case we should immediately add a fresh
 	 * page.
 	 */
-	xnlock_get_irqsave(&heap->lock, s);
-
 	if (bsize >= XNHEAP_PAGE_SIZE)
 		/* Add a range of contiguous free pages. */
-		block = add_free_range(heap, bsize, 0);
-	else {
-		ilog = log2size - XNHEAP_MIN_LOG2;
-		XENO_WARN_ON(MEMORY, ilog < 0 || ilog >= XNHEAP_MAX_BUCKETS);
-		pg = heap->buckets[ilog];
-		/*
-		 * Find a block in the heading page if any. If there
-		 * is none, there won't be any down the list: add a
-		 * new page right away.
-		 */
-		if (pg < 0 || heap->pagemap[pg].map == -1U)
-			block = add_free_range(heap, bsize, log2size);
-		else {
-			b = ffs(~heap->pagemap[pg].map) - 1;
-			/*
-			 * Got one block from the heading per-bucket
-			 * page, tag it as busy in the per-page
-			 * allocation map.
-			 */
-			heap->pagemap[pg].map |= (1U << b);
-			heap->used_size += bsize;
-			block = heap->membase +
-				(pg << XNHEAP_PAGE_SHIFT) +
-				(b << log2size);
-			if (heap->pagemap[pg].map == -1U)
-				move_page_back(heap, pg, log2size);
-		}
-	}
+		return add_free_range(heap, bsize, 0);
 
-	xnlock_put_irqrestore(&heap->lock, s);
+	ilog = log2size - XNHEAP_MIN_LOG2;
+	XENO_WARN_ON(MEMORY, ilog < 0 || ilog >= XNHEAP_MAX_BUCKETS);
+	pg = heap->buckets[ilog];
+	/*
+	 * Find a block in the heading page if any. If there is none,
+	 * there won't be any down the list: add a new page right
+	 * away.
+	 */
+	if (pg < 0 || heap->pagemap[pg].map == -1U)
+		return add_free_range(heap, bsize, log2size);
+
+	b = ffs(~heap->pagemap[pg].map) - 1;
+	/*
+	 * Got one block from the heading per-bucket page, tag it as
+	 * busy in the per-page allocation map.
+	 */
+	heap->pagemap[pg].map |= (1U << b);
+	heap->used_size += bsize;
+	block = heap->membase +
+		(pg << XNHEAP_PAGE_SHIFT) +
+		(b << log2size);
+	if (heap->pagemap[pg].map == -1U)
+		move_page_back(heap, pg, log2size);
 
 	return block;
 }
-EXPORT_SYMBOL_GPL(xnheap_alloc);
 
-/**
- * @fn void xnheap_free(struct xnheap *heap, void *block)
- * @brief Release a block to a memory heap.
- *
- * Releases a memory block to a heap.
- *
- * @param heap The heap descriptor.
- *
- * @param block The block to be returned to the heap.
- *
- * @coretags{unrestricted}
- */
-void xnheap_free(struct xnheap *heap, void *block)
+static int free_block(struct xnheap *heap, void *block)
 {
 	unsigned long pgoff, boff;
 	int log2size, pg, n;
 	size_t bsize;
 	u32 oldmap;
-	spl_t s;
-
-	xnlock_get_irqsave(&heap->lock, s);
 
 	/* Compute the heading page number in the page map. */
 	pgoff = block - heap->membase;
 	pg = pgoff >> XNHEAP_PAGE_SHIFT;
 
 	if (!page_is_valid(heap, pg))
-		goto bad;
+		return -EINVAL;
 	
 	switch (heap->pagemap[pg].type) {
 	case page_list:
@@ -643,10 +982,12 @@ void xnheap_free(struct xnheap *heap, void *block)
 		XENO_WARN_ON(MEMORY, bsize >= XNHEAP_PAGE_SIZE);
 		boff = pgoff & ~XNHEAP_PAGE_MASK;
 		if ((boff & (bsize - 1)) != 0) /* Not at block start? */
-			goto bad;
+			return -EINVAL;
 
 		n = boff >> log2size; /* Block position in page. */
 		oldmap = heap->pagemap[pg].map;
+		if ((oldmap & (1U << n)) == 0) /* Not busy? */
+			return -EINVAL;
 		heap->pagemap[pg].map &= ~(1U << n);
 
 		/*
@@ -666,36 +1007,410 @@ void xnheap_free(struct xnheap *heap, void *block)
 
 	heap->used_size -= bsize;
 
-	xnlock_put_irqrestore(&heap->lock, s);
+	return 0;
+}
 
-	return;
-bad:
-	xnlock_put_irqrestore(&heap->lock, s);
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
 
-	XENO_WARN(MEMORY, 1, "invalid block %p in heap %s",
-		  block, heap->name);
+/*
+ * Per-CPU magazines sit in front of the bucketed allocator. The
+ * common case only involves the magazine of the current CPU for the
+ * requested size class, serialized by a lock nobody else but a
+ * draining CPU ever grabs. When the magazine runs empty (or full),
+ * half of its depth is refilled from (or flushed back to) the heap
+ * under a single acquisition of the heap lock, which is then the
+ * depot all magazines share.
+ *
+ * Lock nesting is always pcache->lock -> heap->lock.
+ */
+
+static inline bool heap_has_magazines(struct xnheap *heap)
+{
+	return heap->pcache != NULL;
 }
-EXPORT_SYMBOL_GPL(xnheap_free);
 
-ssize_t xnheap_check_block(struct xnheap *heap, void *block)
+/*
+ * Blocks sitting in a magazine are still busy in the page map, the
+ * cache map tells them apart from blocks owned by the caller.
+ */
+static inline unsigned long cachemap_bit(struct xnheap *heap, void *block)
 {
-	unsigned long pg, pgoff, boff;
-	ssize_t ret = -EINVAL;
-	size_t bsize;
-	spl_t s;
+	return (block - heap->membase) >> XNHEAP_MIN_LOG2;
+}
 
-	xnlock_get_irqsave(&heap->lock, s);
+static inline bool block_is_cached(struct xnheap *heap, void *block)
+{
+	return heap->cachemap &&
+		test_bit(cachemap_bit(heap, block), heap->cachemap);
+}
 
-	/* Calculate the page number from the block address. */
-	pgoff = block - heap->membase;
-	pg = pgoff >> XNHEAP_PAGE_SHIFT;
-	if (page_is_valid(heap, pg)) {
-		if (heap->pagemap[pg].type == page_list)
-			bsize = heap->pagemap[pg].bsize;
-		else {
-			bsize = (1 << heap->pagemap[pg].type);
-			boff = pgoff & ~XNHEAP_PAGE_MASK;
-			if ((boff & (bsize - 1)) != 0) /* Not at block start? */
+/* pc->lock held. */
+static void *pop_block(struct xnheap *heap, struct xnheap_pcache *pc,
+		       struct xnheap_magazine *mag, size_t bsize)
+{
+	void *block = mag->blocks[--mag->count];
+
+	clear_bit(cachemap_bit(heap, block), heap->cachemap);
+	pc->cached -= bsize;
+
+	return block;
+}
+
+/* pc->lock and heap->lock held. */
+static void flush_block(struct xnheap *heap, struct xnheap_pcache *pc,
+			struct xnheap_magazine *mag, size_t bsize)
+{
+	free_block(heap, pop_block(heap, pc, mag, bsize));
+}
+
+/* pc->lock held, grabs heap->lock. */
+static void drain_pcache(struct xnheap *heap, struct xnheap_pcache *pc)
+{
+	struct xnheap_magazine *mag;
+	int n;
+
+	xnlock_get(&heap->lock);
+	for (n = 0; n < XNHEAP_MAX_BUCKETS; n++) {
+		mag = pc->mags + n;
+		while (mag->count > 0)
+			flush_block(heap, pc, mag,
+				    1U << (n + XNHEAP_MIN_LOG2));
+	}
+	xnlock_put(&heap->lock);
+}
+
+static void drain_local_magazines(struct xnheap *heap)
+{
+	struct xnheap_pcache *pc;
+	spl_t s;
+
+	splhigh(s);
+	pc = raw_cpu_ptr(heap->pcache);
+	xnlock_get(&pc->lock);
+	drain_pcache(heap, pc);
+	xnlock_put(&pc->lock);
+	splexit(s);
+}
+
+static void *magazine_alloc(struct xnheap *heap,
+			    size_t bsize, int log2size)
+{
+	struct xnheap_magazine *mag;
+	struct xnheap_pcache *pc;
+	void *block = NULL;
+	int n;
+	spl_t s;
+
+	splhigh(s);
+	pc = raw_cpu_ptr(heap->pcache);
+	xnlock_get(&pc->lock);
+
+	mag = pc->mags + log2size - XNHEAP_MIN_LOG2;
+	if (mag->count > 0) {
+		pc->hits++;
+		goto out;
+	}
+
+	pc->misses++;
+	xnlock_get(&heap->lock);
+	for (n = 0; n < XNHEAP_MAG_DEPTH / 2; n++) {
+		block = alloc_block(heap, bsize, log2size);
+		if (block == NULL)
+			break;
+		set_bit(cachemap_bit(heap, block), heap->cachemap);
+		mag->blocks[mag->count++] = block;
+		pc->cached += bsize;
+	}
+	xnlock_put(&heap->lock);
+	if (mag->count > 0)
+		pc->refills++;
+out:
+	block = mag->count > 0 ? pop_block(heap, pc, mag, bsize) : NULL;
+
+	xnlock_put(&pc->lock);
+	splexit(s);
+
+	return block;
+}
+
+/*
+ * Returns 0 if @block was cached, -EAGAIN if it should go through
+ * the regular release path (multi-page block), -EINVAL if it is not
+ * a busy block from @heap.
+ */
+static int magazine_free(struct xnheap *heap, void *block)
+{
+	struct xnheap_magazine *mag;
+	struct xnheap_pcache *pc;
+	unsigned long pgoff, boff;
+	int log2size, pg, n;
+	size_t bsize;
+	spl_t s;
+
+	/*
+	 * The page type and busy bit of a busy block are stable
+	 * until that block is released, so we may look them up
+	 * locklessly. A block which is either not busy or already
+	 * cached is being released twice.
+	 */
+	pgoff = block - heap->membase;
+	pg = pgoff >> XNHEAP_PAGE_SHIFT;
+	if (!page_is_valid(heap, pg))
+		return -EINVAL;
+
+	log2size = heap->pagemap[pg].type;
+	if (log2size == page_list)
+		return -EAGAIN;
+
+	if (log2size < XNHEAP_MIN_LOG2 || log2size >= XNHEAP_PAGE_SHIFT)
+		return -EINVAL;
+
+	boff = pgoff & ~XNHEAP_PAGE_MASK;
+	if (boff & ((1 << log2size) - 1))
+		return -EINVAL;
+
+	n = boff >> log2size;
+	if ((READ_ONCE(heap->pagemap[pg].map) & (1U << n)) == 0)
+		return -EINVAL;
+
+	if (test_and_set_bit(cachemap_bit(heap, block), heap->cachemap))
+		return -EINVAL;
+
+	bsize = 1U << log2size;
+
+	splhigh(s);
+	pc = raw_cpu_ptr(heap->pcache);
+	xnlock_get(&pc->lock);
+
+	mag = pc->mags + log2size - XNHEAP_MIN_LOG2;
+	if (mag->count >= XNHEAP_MAG_DEPTH) {
+		xnlock_get(&heap->lock);
+		for (n = 0; n < XNHEAP_MAG_DEPTH / 2; n++)
+			flush_block(heap, pc, mag, bsize);
+		xnlock_put(&heap->lock);
+		pc->flushes++;
+	}
+
+	mag->blocks[mag->count++] = block;
+	pc->cached += bsize;
+
+	xnlock_put(&pc->lock);
+	splexit(s);
+
+	return 0;
+}
+
+/**
+ * @fn void xnheap_drain_magazines(struct xnheap *heap)
+ * @brief Release all blocks cached by the per-CPU magazines.
+ *
+ * Sends all free blocks cached by the per-CPU magazines of @a heap
+ * back to the heap. A failed allocation request only drains the
+ * magazines of the current CPU before retrying, this call may be
+ * used to recover the blocks cached by remote CPUs as well.
+ *
+ * @param heap The heap descriptor.
+ *
+ * @coretags{unrestricted}
+ */
+void xnheap_drain_magazines(struct xnheap *heap)
+{
+	struct xnheap_pcache *pc;
+	int cpu;
+	spl_t s;
+
+	if (!heap_has_magazines(heap))
+		return;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(heap->pcache, cpu);
+		xnlock_get_irqsave(&pc->lock, s);
+		drain_pcache(heap, pc);
+		xnlock_put_irqrestore(&pc->lock, s);
+	}
+}
+EXPORT_SYMBOL_GPL(xnheap_drain_magazines);
+
+/*
+ * Blocks sitting in magazines are free memory from the caller's
+ * standpoint, although the heap still sees them as busy.
+ */
+size_t xnheap_get_used(const struct xnheap *heap)
+{
+	size_t cached = 0;
+	int cpu;
+
+	if (heap->pcache)
+		for_each_possible_cpu(cpu)
+			cached += READ_ONCE(per_cpu_ptr(heap->pcache,
+							cpu)->cached);
+
+	return heap->used_size > cached ? heap->used_size - cached : 0;
+}
+EXPORT_SYMBOL_GPL(xnheap_get_used);
+
+/**
+ * @fn int xnheap_enable_magazines(struct xnheap *heap)
+ * @brief Enable per-CPU magazines for a heap.
+ *
+ * Sets up per-CPU caches of free blocks for each bucketed size class
+ * of @a heap, so that small allocations and releases do not contend
+ * on the heap lock in the common case. This is available with
+ * CONFIG_XENO_OPT_HEAP_MAGAZINES only, and should be reserved to
+ * heaps serving many fixed-size kernel objects, since blocks held
+ * in magazines are not available to other CPUs.
+ *
+ * @param heap The heap descriptor, which must have been initialized
+ * by a call to xnheap_init() before.
+ *
+ * @return 0 is returned upon success, or -ENOMEM if the per-CPU
+ * caches or the map of cached blocks cannot be allocated.
+ *
+ * @coretags{secondary-only}
+ */
+int xnheap_enable_magazines(struct xnheap *heap)
+{
+	struct xnheap_pcache __percpu *pcache;
+	struct xnheap_pcache *pc;
+	unsigned long *cachemap;
+	int cpu;
+
+	secondary_mode_only();
+
+	cachemap = kcalloc(BITS_TO_LONGS(heap->usable_size >> XNHEAP_MIN_LOG2),
+			   sizeof(unsigned long), GFP_KERNEL);
+	if (cachemap == NULL)
+		return -ENOMEM;
+
+	pcache = alloc_percpu(struct xnheap_pcache);
+	if (pcache == NULL) {
+		kfree(cachemap);
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(pcache, cpu);
+		xnlock_init(&pc->lock);
+	}
+
+	heap->cachemap = cachemap;
+	heap->pcache = pcache;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnheap_enable_magazines);
+
+#else /* !CONFIG_XENO_OPT_HEAP_MAGAZINES */
+
+static inline bool heap_has_magazines(struct xnheap *heap)
+{
+	return false;
+}
+
+static inline void *magazine_alloc(struct xnheap *heap,
+				   size_t bsize, int log2size)
+{
+	return NULL;
+}
+
+static inline int magazine_free(struct xnheap *heap, void *block)
+{
+	return -EAGAIN;
+}
+
+static inline void drain_local_magazines(struct xnheap *heap) { }
+
+static inline bool block_is_cached(struct xnheap *heap, void *block)
+{
+	return false;
+}
+
+#endif /* !CONFIG_XENO_OPT_HEAP_MAGAZINES */
+
+static void *__heap_alloc(struct xnheap *heap, size_t size)
+{
+	size_t bsize;
+	void *block;
+	int log2size;
+	spl_t s;
+
+	if (size < XNHEAP_MIN_ALIGN) {
+		bsize = size = XNHEAP_MIN_ALIGN;
+		log2size = XNHEAP_MIN_LOG2;
+	} else {
+		log2size = ilog2(size);
+		if (log2size < XNHEAP_PAGE_SHIFT) {
+			if (size & (size - 1))
+				log2size++;
+			bsize = 1 << log2size;
+		} else
+			bsize = ALIGN(size, XNHEAP_PAGE_SIZE);
+	}
+	
+	if (bsize < XNHEAP_PAGE_SIZE && heap_has_magazines(heap)) {
+		block = magazine_alloc(heap, bsize, log2size);
+		if (block)
+			return block;
+	}
+
+	xnlock_get_irqsave(&heap->lock, s);
+	block = alloc_block(heap, bsize, log2size);
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	/*
+	 * When running out of memory, send the blocks cached by the
+	 * magazines of the current CPU back to the heap, which may
+	 * release pages for reuse, then retry. Remote magazines are
+	 * left alone, walking all CPUs from the allocation path would
+	 * not be time-bounded.
+	 */
+	if (block == NULL && heap_has_magazines(heap)) {
+		drain_local_magazines(heap);
+		xnlock_get_irqsave(&heap->lock, s);
+		block = alloc_block(heap, bsize, log2size);
+		xnlock_put_irqrestore(&heap->lock, s);
+	}
+
+	return block;
+}
+
+static int __heap_free(struct xnheap *heap, void *block)
+{
+	int ret;
+	spl_t s;
+
+	if (heap_has_magazines(heap)) {
+		ret = magazine_free(heap, block);
+		if (ret != -EAGAIN)
+			return ret;
+	}
+
+	xnlock_get_irqsave(&heap->lock, s);
+	ret = free_block(heap, block);
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	return ret;
+}
+
+static ssize_t __heap_check_block(struct xnheap *heap, void *block)
+{
+	unsigned long pg, pgoff, boff;
+	ssize_t ret = -EINVAL;
+	size_t bsize;
+	spl_t s;
+
+	xnlock_get_irqsave(&heap->lock, s);
+
+	/* Calculate the page number from the block address. */
+	pgoff = block - heap->membase;
+	pg = pgoff >> XNHEAP_PAGE_SHIFT;
+	if (page_is_valid(heap, pg) && !block_is_cached(heap, block)) {
+		if (heap->pagemap[pg].type == page_list)
+			bsize = heap->pagemap[pg].bsize;
+		else {
+			bsize = (1 << heap->pagemap[pg].type);
+			boff = pgoff & ~XNHEAP_PAGE_MASK;
+			if ((boff & (bsize - 1)) != 0) /* Not at block start? */
 				goto out;
 		}
 		ret = (ssize_t)bsize;
@@ -705,6 +1420,112 @@ out:
 
 	return ret;
 }
+
+static int init_freelists(struct xnheap *heap, void *membase, size_t size)
+{
+	int n, nrpages;
+
+	/* Reset bucket page lists, all empty. */
+	for (n = 0; n < XNHEAP_MAX_BUCKETS; n++)
+		heap->buckets[n] = -1U;
+
+	nrpages = size >> XNHEAP_PAGE_SHIFT;
+	heap->pagemap = kzalloc(sizeof(struct xnheap_pgentry) * nrpages,
+				GFP_KERNEL);
+	if (heap->pagemap == NULL)
+		return -ENOMEM;
+
+	/*
+	 * The free page pool is maintained as a set of ranges of
+	 * contiguous pages indexed by address and size in rbtrees.
+	 * Initially, we have a single range in those trees covering
+	 * the whole memory we have been given for the heap. Over
+	 * time, that range will be split then possibly re-merged back
+	 * as allocations and deallocations take place.
+	 */
+	heap->size_tree = RB_ROOT;
+	heap->addr_tree = RB_ROOT;
+	heap->membase = membase;
+	release_page_range(heap, membase, size);
+
+	return 0;
+}
+
+static void destroy_freelists(struct xnheap *heap)
+{
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	if (heap->pcache) {
+		free_percpu(heap->pcache);
+		kfree(heap->cachemap);
+	}
+#endif
+	kfree(heap->pagemap);
+}
+
+/*
+ * Heap lock held. Only the free page ranges are considered, the
+ * free slots of pages holding bucketed memory are not.
+ */
+static size_t get_largest_free(struct xnheap *heap)
+{
+	struct rb_node *rb = rb_last(&heap->size_tree);
+
+	return rb ? rb_entry(rb, struct xnheap_range, size_node)->size : 0;
+}
+
+#endif /* !CONFIG_XENO_OPT_HEAP_TLSF */
+
+/**
+ * @fn void *xnheap_alloc(struct xnheap *heap, size_t size)
+ * @brief Allocate a memory block from a memory heap.
+ *
+ * Allocates a contiguous region of memory from an active memory heap.
+ * Such allocation is guaranteed to be time-bounded.
+ *
+ * @param heap The descriptor address of the heap to get memory from.
+ *
+ * @param size The size in bytes of the requested block.
+ *
+ * @return The address of the allocated region upon success, or NULL
+ * if no memory is available from the specified heap.
+ *
+ * @coretags{unrestricted}
+ */
+void *xnheap_alloc(struct xnheap *heap, size_t size)
+{
+	if (size == 0)
+		return NULL;
+
+	return __heap_alloc(heap, size);
+}
+EXPORT_SYMBOL_GPL(xnheap_alloc);
+
+/**
+ * @fn void xnheap_free(struct xnheap *heap, void *block)
+ * @brief Release a block to a memory heap.
+ *
+ * Releases a memory block to a heap.
+ *
+ * @param heap The heap descriptor.
+ *
+ * @param block The block to be returned to the heap.
+ *
+ * @coretags{unrestricted}
+ */
+void xnheap_free(struct xnheap *heap, void *block)
+{
+	int ret;
+
+	ret = __heap_free(heap, block);
+	XENO_WARN(MEMORY, ret, "invalid block %p in heap %s",
+		  block, heap->name);
+}
+EXPORT_SYMBOL_GPL(xnheap_free);
+
+ssize_t xnheap_check_block(struct xnheap *heap, void *block)
+{
+	return __heap_check_block(heap, block);
+}
 EXPORT_SYMBOL_GPL(xnheap_check_block);
 
 /**
@@ -734,41 +1555,27 @@ EXPORT_SYMBOL_GPL(xnheap_check_block);
  */
 int xnheap_init(struct xnheap *heap, void *membase, size_t size)
 {
-	int n, nrpages;
 	spl_t s;
+	int ret;
 
 	secondary_mode_only();
 
  	if (size > XNHEAP_MAX_HEAPSZ || !PAGE_ALIGNED(size))
 		return -EINVAL;
 
-	/* Reset bucket page lists, all empty. */
-	for (n = 0; n < XNHEAP_MAX_BUCKETS; n++)
-		heap->buckets[n] = -1U;
-
 	xnlock_init(&heap->lock);
 
-	nrpages = size >> XNHEAP_PAGE_SHIFT;
-	heap->pagemap = kzalloc(sizeof(struct xnheap_pgentry) * nrpages,
-				GFP_KERNEL);
-	if (heap->pagemap == NULL)
-		return -ENOMEM;
-
 	heap->membase = membase;
 	heap->usable_size = size;
 	heap->used_size = 0;
-		      
-	/*
-	 * The free page pool is maintained as a set of ranges of
-	 * contiguous pages indexed by address and size in rbtrees.
-	 * Initially, we have a single range in those trees covering
-	 * the whole memory we have been given for the heap. Over
-	 * time, that range will be split then possibly re-merged back
-	 * as allocations and deallocations take place.
-	 */
-	heap->size_tree = RB_ROOT;
-	heap->addr_tree = RB_ROOT;
-	release_page_range(heap, membase, size);
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	heap->pcache = NULL;
+	heap->cachemap = NULL;
+#endif
+
+	ret = init_freelists(heap, membase, size);
+	if (ret)
+		return ret;
 
 	/* Default name, override with xnheap_set_name() */
 	ksformat(heap->name, sizeof(heap->name), "(%p)", heap);
@@ -804,7 +1611,7 @@ void xnheap_destroy(struct xnheap *heap)
 	nrheaps--;
 	xnvfile_touch_tag(&vfile_tag);
 	xnlock_put_irqrestore(&nklock, s);
-	kfree(heap->pagemap);
+	destroy_freelists(heap);
 }
 EXPORT_SYMBOL_GPL(xnheap_destroy);
 
@@ -295,6 +295,13 @@ static __init int sys_init(void)
 	}
 	xnheap_set_name(&cobalt_heap, "system heap");
 
+	ret = xnheap_enable_magazines(&cobalt_heap);
+	if (ret) {
+		xnheap_destroy(&cobalt_heap);
+		xnheap_vfree(heapaddr);
+		return ret;
+	}
+
 	for_each_online_cpu(cpu) {
 		sched = &per_cpu(nksched, cpu);
 		xnsched_init(sched, cpu);
@@ -382,10 +389,14 @@ static int __init xenomai_init(void)
 	if (ret)
 		goto cleanup_sys;
 
-	ret = cobalt_init();
+	ret = xnsched_init_trace();
 	if (ret)
 		goto cleanup_rtdm;
 
+	ret = cobalt_init();
+	if (ret)
+		goto cleanup_trace;
+
 	rtdm_fd_init();
 
 	printk(XENO_INFO "Cobalt v%s (%s) %s%s%s%s\n",
@@ -398,6 +409,8 @@ static int __init xenomai_init(void)
 
 	return 0;
 
+cleanup_trace:
+	xnsched_cleanup_trace();
 cleanup_rtdm:
 	rtdm_cleanup();
 cleanup_sys:
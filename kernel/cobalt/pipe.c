@@ -1104,6 +1104,32 @@ static unsigned xnpipe_poll(struct file *file, poll_table *pt)
 	return r_mask | w_mask;
 }
 
+static int xnpipe_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xnpipe_state *state = file->private_data;
+	int (*mmap)(struct vm_area_struct *vma, void *xstate);
+	void *xstate;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if ((state->status & XNPIPE_KERN_CONN) == 0) {
+		xnlock_put_irqrestore(&nklock, s);
+		return -EPIPE;
+	}
+
+	mmap = state->ops.mmap;
+	xstate = state->xstate;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	/*
+	 * The extra state lingers until xnpipe_release() has run, so
+	 * it remains valid while we hold the file open.
+	 */
+	return mmap ? mmap(vma, xstate) : -ENODEV;
+}
+
 static struct file_operations xnpipe_fops = {
 	.read = xnpipe_read,
 	.write = xnpipe_write,
@@ -1111,7 +1137,8 @@ static struct file_operations xnpipe_fops = {
 	.unlocked_ioctl = xnpipe_ioctl,
 	.open = xnpipe_open,
 	.release = xnpipe_release,
-	.fasync = xnpipe_fasync
+	.fasync = xnpipe_fasync,
+	.mmap = xnpipe_mmap,
 };
 
 int xnpipe_mount(void)
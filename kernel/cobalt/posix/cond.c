@@ -207,9 +207,17 @@ static inline int cobalt_cond_timedwait_epilogue(struct xnthread *cur,
 
 	xnlock_get_irqsave(&nklock, s);
 
-	err = __cobalt_mutex_acquire_unchecked(cur, mutex, NULL);
-	if (err == -EINTR)
-		goto unlock_and_return;
+	/*
+	 * Signaled waiters are moved to the wait queue of the mutex
+	 * by cobalt_cond_deferred_signals(), we may have been passed
+	 * its ownership already.
+	 */
+	if (!xnsynch_acquire_requeued(&mutex->synchbase)) {
+		err = __cobalt_mutex_acquire_unchecked(cur, mutex, NULL);
+		if (err == -EINTR)
+			goto unlock_and_return;
+	} else
+		err = 0;
 
 	/*
 	 * Unbind mutex and cond, if no other thread is waiting, if
@@ -379,34 +387,28 @@ COBALT_SYSCALL(cond_wait_epilogue, primary,
 	return err;
 }
 
-int cobalt_cond_deferred_signals(struct cobalt_cond *cond)
-{
+void cobalt_cond_deferred_signals(struct cobalt_cond *cond,
+				  struct xnthread *curr)
+{	/* nklock held, irqs off, curr owns cond->mutex */
 	struct cobalt_cond_state *state;
 	__u32 pending_signals;
-	int need_resched;
 
 	state = cond->state;
 	pending_signals = state->pending_signals;
+	if (pending_signals == 0)
+		return;
 
-	switch(pending_signals) {
-	default:
-		state->pending_signals = 0;
-		need_resched = xnsynch_wakeup_many_sleepers(&cond->synchbase,
-							    pending_signals);
-		break;
-
-	case ~0U:
-		need_resched =
-			xnsynch_flush(&cond->synchbase, 0) == XNSYNCH_RESCHED;
-		state->pending_signals = 0;
-		break;
-
-	case 0:
-		need_resched = 0;
-		break;
-	}
+	state->pending_signals = 0;
 
-	return need_resched;
+	/*
+	 * Rather than waking up the signaled threads only to have
+	 * them contend for the mutex, move them to its wait queue
+	 * directly. Our caller is about to release the mutex, which
+	 * hands it over to the highest priority waiter only.
+	 */
+	xnsynch_requeue_sleepers(&cond->synchbase, &cond->mutex->synchbase,
+				 curr, pending_signals > INT_MAX ?
+				 INT_MAX : pending_signals);
 }
 
 void cobalt_cond_reclaim(struct cobalt_resnode *node, spl_t s)
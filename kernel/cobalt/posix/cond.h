@@ -63,7 +63,8 @@ COBALT_SYSCALL_DECL(cond_wait_epilogue,
 		    (struct cobalt_cond_shadow __user *u_cnd,
 		     struct cobalt_mutex_shadow __user *u_mx));
 
-int cobalt_cond_deferred_signals(struct cobalt_cond *cond);
+void cobalt_cond_deferred_signals(struct cobalt_cond *cond,
+				  struct xnthread *curr);
 
 void cobalt_cond_reclaim(struct cobalt_resnode *node,
 			 spl_t s);
@@ -20,6 +20,7 @@
 #include <linux/err.h>
 #include <linux/fs.h>
 #include <cobalt/kernel/ppd.h>
+#include <cobalt/uapi/select.h>
 #include <xenomai/rtdm/internal.h>
 #include "process.h"
 #include "internal.h"
@@ -99,9 +100,12 @@ static int get_timespec(struct timespec *ts,
 	return cobalt_copy_from_user(ts, u_ts, sizeof(*ts));
 }
 
-static int get_mmsg(struct mmsghdr *mmsg, void __user *u_mmsg)
+static int get_mmsg(struct mmsghdr *mmsg, void __user **u_mmsg_p)
 {
-	return cobalt_copy_from_user(mmsg, u_mmsg, sizeof(*mmsg));
+	struct mmsghdr __user **p = (struct mmsghdr **)u_mmsg_p,
+		*q __user = (*p)++;
+
+	return cobalt_copy_from_user(mmsg, q, sizeof(*mmsg));
 }
 
 static int put_mmsg(void __user **u_mmsg_p, const struct mmsghdr *mmsg)
@@ -340,3 +344,281 @@ out:
 				return -EFAULT;
 	return err;
 }
+
+/*
+ * Poll sets are the scalable counterpart of select(): descriptors are
+ * bound once with pollset_ctl, then pollset_wait only reports the
+ * bindings queued to the ready list of the underlying selector.
+ */
+
+/* Max. number of events returned by a single pollset_wait call. */
+#define COBALT_POLLSET_BATCH	64
+
+struct cobalt_pollset {
+	struct rtdm_fd fd;
+	struct xnselector *selector;
+};
+
+static void pollset_close(struct rtdm_fd *fd)
+{
+	struct cobalt_pollset *pset;
+
+	pset = container_of(fd, struct cobalt_pollset, fd);
+	xnselector_destroy(pset->selector);
+	xnfree(pset);
+}
+
+static struct rtdm_fd_ops pollset_ops = {
+	.close = pollset_close,
+};
+
+COBALT_SYSCALL(pollset_create, lostage, (int flags))
+{
+	struct xnselector *selector;
+	struct cobalt_pollset *pset;
+	int ret, ufd;
+
+	if (flags)
+		return -EINVAL;
+
+	pset = xnmalloc(sizeof(*pset));
+	if (pset == NULL)
+		return -ENOMEM;
+
+	selector = xnmalloc(sizeof(*selector));
+	if (selector == NULL) {
+		ret = -ENOMEM;
+		goto fail_selector;
+	}
+
+	ufd = __rtdm_anon_getfd("[cobalt-pollset]", O_RDWR);
+	if (ufd < 0) {
+		ret = ufd;
+		goto fail_getfd;
+	}
+
+	xnselector_init_pollset(selector);
+	pset->selector = selector;
+
+	ret = rtdm_fd_enter(&pset->fd, ufd, COBALT_POLLSET_MAGIC, &pollset_ops);
+	if (ret < 0)
+		goto fail;
+
+	ret = rtdm_fd_register(&pset->fd, ufd);
+	if (ret < 0)
+		goto fail;
+
+	return ufd;
+fail:
+	__rtdm_anon_putfd(ufd);
+	xnselector_destroy(selector);
+	xnfree(pset);
+
+	return ret;
+fail_getfd:
+	xnfree(selector);
+fail_selector:
+	xnfree(pset);
+
+	return ret;
+}
+
+static inline struct cobalt_pollset *pollset_get(int ufd)
+{
+	struct rtdm_fd *fd;
+
+	fd = rtdm_fd_get(ufd, COBALT_POLLSET_MAGIC);
+	if (IS_ERR(fd)) {
+		int err = PTR_ERR(fd);
+		if (err == -EBADF && cobalt_current_process() == NULL)
+			err = -EPERM;
+		return ERR_PTR(err);
+	}
+
+	return container_of(fd, struct cobalt_pollset, fd);
+}
+
+static inline void pollset_put(struct cobalt_pollset *pset)
+{
+	rtdm_fd_put(&pset->fd);
+}
+
+static inline int pollset_check_events(unsigned int events)
+{
+	if (events == 0 ||
+	    (events & ~(POLLSET_IN|POLLSET_OUT|POLLSET_EXCEPT)))
+		return -EINVAL;
+
+	return 0;
+}
+
+static unsigned int pollset_bound_types(struct xnselector *selector, int fd)
+{
+	unsigned int type, types = 0;
+
+	for (type = 0; type < XNSELECT_MAX_TYPES; type++)
+		if (xnselect_bound_p(selector, type, fd))
+			types |= 1 << type;
+
+	return types;
+}
+
+/* Bind fd for each type in @types, all or nothing. */
+static int pollset_bind_types(struct xnselector *selector,
+			      int fd, unsigned int types)
+{
+	unsigned int type, bound = 0;
+	int ret;
+
+	for (type = 0; type < XNSELECT_MAX_TYPES; type++) {
+		if (!(types & (1 << type)))
+			continue;
+		ret = select_bind_one(selector, type, fd);
+		if (ret) {
+			/* Drop whatever we might have bound so far. */
+			if (bound)
+				xnselect_unbind_types(selector, fd, bound);
+			return ret;
+		}
+		bound |= 1 << type;
+	}
+
+	return 0;
+}
+
+static int pollset_add(struct xnselector *selector,
+		       int fd, unsigned int events)
+{
+	int ret;
+
+	ret = pollset_check_events(events);
+	if (ret)
+		return ret;
+
+	/* xnselect_bind() fails with -EEXIST on duplicates. */
+	return pollset_bind_types(selector, fd, events);
+}
+
+static int pollset_mod(struct xnselector *selector,
+		       int fd, unsigned int events)
+{
+	unsigned int bound;
+	int ret;
+
+	ret = pollset_check_events(events);
+	if (ret)
+		return ret;
+
+	/*
+	 * Bind the new event types before dropping the stale ones,
+	 * so that a failure leaves the former binding in place. If
+	 * a concurrent request bound some of them meanwhile, take a
+	 * fresh snapshot and retry.
+	 */
+	do {
+		bound = pollset_bound_types(selector, fd);
+		if (bound == 0)
+			return -ENOENT;
+		ret = pollset_bind_types(selector, fd, events & ~bound);
+	} while (ret == -EEXIST);
+
+	if (ret)
+		return ret;
+
+	if (bound & ~events)
+		xnselect_unbind_types(selector, fd, bound & ~events);
+
+	return 0;
+}
+
+COBALT_SYSCALL(pollset_ctl, current,
+	       (int psfd, int op, int fd, unsigned int events))
+{
+	struct cobalt_pollset *pset;
+	int ret;
+
+	if (fd < 0 || fd == psfd)
+		return -EINVAL;
+
+	pset = pollset_get(psfd);
+	if (IS_ERR(pset))
+		return PTR_ERR(pset);
+
+	switch (op) {
+	case POLLSET_CTL_ADD:
+		ret = pollset_add(pset->selector, fd, events);
+		break;
+	case POLLSET_CTL_DEL:
+		ret = xnselect_unbind(pset->selector, fd);
+		break;
+	case POLLSET_CTL_MOD:
+		ret = pollset_mod(pset->selector, fd, events);
+		break;
+	default:
+		ret = -EINVAL;
+	}
+
+	pollset_put(pset);
+
+	return ret;
+}
+
+int __cobalt_pollset_wait(int psfd,
+			  struct cobalt_pollset_event __user *u_events,
+			  int maxevents, const struct timespec *ts)
+{
+	struct xnselect_ready ready[COBALT_POLLSET_BATCH];
+	struct cobalt_pollset_event ev;
+	xnticks_t timeout = XN_INFINITE;
+	struct cobalt_pollset *pset;
+	int ret, n;
+
+	if (maxevents <= 0)
+		return -EINVAL;
+
+	if (ts) {
+		if ((unsigned long)ts->tv_nsec >= ONE_BILLION)
+			return -EINVAL;
+		timeout = ts2ns(ts);
+		if (timeout == 0)
+			timeout = XN_NONBLOCK;
+	}
+
+	pset = pollset_get(psfd);
+	if (IS_ERR(pset))
+		return PTR_ERR(pset);
+
+	ret = xnselect_poll(pset->selector, ready,
+			    min(maxevents, COBALT_POLLSET_BATCH),
+			    timeout, XN_RELATIVE);
+
+	for (n = 0; n < ret; n++) {
+		ev.fd = ready[n].index;
+		ev.events = 1 << ready[n].type;
+		if (cobalt_copy_to_user(u_events + n, &ev, sizeof(ev))) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	pollset_put(pset);
+
+	return ret;
+}
+
+COBALT_SYSCALL(pollset_wait, primary,
+	       (int psfd, struct cobalt_pollset_event __user *u_events,
+		int maxevents, const struct timespec __user *u_ts))
+{
+	struct timespec ts;
+	int ret;
+
+	if (u_ts) {
+		ret = cobalt_copy_from_user(&ts, u_ts, sizeof(ts));
+		if (ret)
+			return ret;
+	}
+
+	return __cobalt_pollset_wait(psfd, u_events, maxevents,
+				     u_ts ? &ts : NULL);
+}
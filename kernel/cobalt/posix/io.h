@@ -28,6 +28,12 @@ int __cobalt_first_fd_valid_p(fd_set *fds[XNSELECT_MAX_TYPES], int nfds);
 int __cobalt_select_bind_all(struct xnselector *selector,
 			     fd_set *fds[XNSELECT_MAX_TYPES], int nfds);
 
+struct cobalt_pollset_event;
+
+int __cobalt_pollset_wait(int psfd,
+			  struct cobalt_pollset_event __user *u_events,
+			  int maxevents, const struct timespec *ts);
+
 COBALT_SYSCALL_DECL(open,
 		    (const char __user *u_path, int oflag));
 
@@ -73,4 +79,13 @@ COBALT_SYSCALL_DECL(select,
 		     fd_set __user *u_xfds,
 		     struct timeval __user *u_tv));
 
+COBALT_SYSCALL_DECL(pollset_create, (int flags));
+
+COBALT_SYSCALL_DECL(pollset_ctl,
+		    (int psfd, int op, int fd, unsigned int events));
+
+COBALT_SYSCALL_DECL(pollset_wait,
+		    (int psfd, struct cobalt_pollset_event __user *u_events,
+		     int maxevents, const struct timespec __user *u_ts));
+
 #endif /* !_COBALT_POSIX_IO_H */
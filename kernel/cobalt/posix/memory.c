@@ -22,8 +22,11 @@
 #include <linux/mm.h>
 #include <linux/gfp.h>
 #include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/moduleparam.h>
 #include <rtdm/driver.h>
 #include <cobalt/kernel/vdso.h>
+#include <cobalt/kernel/vfile.h>
 #include "process.h"
 #include "memory.h"
 
@@ -34,6 +37,59 @@
 struct xnvdso *nkvdso;
 EXPORT_SYMBOL_GPL(nkvdso);
 
+/* NUMA node user-mapped heaps are allocated from, -1 for any. */
+static int umm_node_arg = NUMA_NO_NODE;
+module_param_named(umm_node, umm_node_arg, int, 0444);
+
+static LIST_HEAD(umm_list);	/* Heap list for v-file dump */
+
+static DEFINE_MUTEX(umm_lock);
+
+#ifdef CONFIG_XENO_OPT_VFILE
+
+static int umm_vfile_show(struct xnvfile_regular_iterator *it, void *data)
+{
+	struct cobalt_umm *umm;
+
+	xnvfile_printf(it, "%4s %9s  %s\n", "NODE", "SIZE", "NAME");
+
+	mutex_lock(&umm_lock);
+
+	list_for_each_entry(umm, &umm_list, next)
+		xnvfile_printf(it, "%4d %9zu  %s\n", umm->node,
+			       xnheap_get_size(&umm->heap), umm->heap.name);
+
+	mutex_unlock(&umm_lock);
+
+	return 0;
+}
+
+static struct xnvfile_regular_ops umm_vfile_ops = {
+	.show = umm_vfile_show,
+};
+
+static struct xnvfile_regular umm_vfile = {
+	.ops = &umm_vfile_ops,
+};
+
+static inline void init_umm_vfile(void)
+{
+	xnvfile_init_regular("umm", &umm_vfile, &cobalt_vfroot);
+}
+
+static inline void cleanup_umm_vfile(void)
+{
+	xnvfile_destroy_regular(&umm_vfile);
+}
+
+#else /* !CONFIG_XENO_OPT_VFILE */
+
+static inline void init_umm_vfile(void) { }
+
+static inline void cleanup_umm_vfile(void) { }
+
+#endif /* !CONFIG_XENO_OPT_VFILE */
+
 static void umm_vmopen(struct vm_area_struct *vma)
 {
 	struct cobalt_umm *umm = vma->vm_private_data;
@@ -262,6 +318,14 @@ int cobalt_memdev_init(void)
 {
 	int ret;
 
+	if (umm_node_arg != NUMA_NO_NODE &&
+	    (umm_node_arg < 0 || umm_node_arg >= MAX_NUMNODES ||
+	     !node_online(umm_node_arg))) {
+		printk(XENO_WARNING "invalid umm_node=%d, ignored\n",
+		       umm_node_arg);
+		umm_node_arg = NUMA_NO_NODE;
+	}
+
 	ret = cobalt_umm_init(&cobalt_kernel_ppd.umm,
 			      CONFIG_XENO_OPT_SHARED_HEAPSZ * 1024, NULL);
 	if (ret)
@@ -289,6 +353,8 @@ int cobalt_memdev_init(void)
 	if (ret)
 		goto fail_sysmem;
 
+	init_umm_vfile();
+
 	return 0;
 
 fail_sysmem:
@@ -305,6 +371,7 @@ fail_vdso:
 
 void cobalt_memdev_cleanup(void)
 {
+	cleanup_umm_vfile();
 	rtdm_dev_unregister(&sysmem_device);
 	rtdm_dev_unregister(umm_devices + UMM_SHARED);
 	rtdm_dev_unregister(umm_devices + UMM_PRIVATE);
@@ -312,6 +379,23 @@ void cobalt_memdev_cleanup(void)
 	cobalt_umm_destroy(&cobalt_kernel_ppd.umm);
 }
 
+static void *umm_alloc_mem(struct cobalt_umm *umm, u32 size)
+{
+	void *basemem;
+
+	if (xnarch_cache_aliasing())
+		basemem = __vmalloc(size, GFP_KERNEL|__GFP_ZERO,
+				    pgprot_noncached(PAGE_KERNEL));
+	else
+		basemem = vzalloc_node(size, umm_node_arg);
+	if (basemem == NULL)
+		return NULL;
+
+	umm->node = page_to_nid(vmalloc_to_page(basemem));
+
+	return basemem;
+}
+
 int cobalt_umm_init(struct cobalt_umm *umm, u32 size,
 		    void (*release)(struct cobalt_umm *umm))
 {
@@ -321,9 +405,7 @@ int cobalt_umm_init(struct cobalt_umm *umm, u32 size,
 	secondary_mode_only();
 
 	size = PAGE_ALIGN(size);
-	basemem = __vmalloc(size, GFP_KERNEL|__GFP_ZERO,
-			    xnarch_cache_aliasing() ?
-			    pgprot_noncached(PAGE_KERNEL) : PAGE_KERNEL);
+	basemem = umm_alloc_mem(umm, size);
 	if (basemem == NULL)
 		return -ENOMEM;
 
@@ -337,6 +419,10 @@ int cobalt_umm_init(struct cobalt_umm *umm, u32 size,
 	atomic_set(&umm->refcount, 1);
 	smp_mb();
 
+	mutex_lock(&umm_lock);
+	list_add_tail(&umm->next, &umm_list);
+	mutex_unlock(&umm_lock);
+
 	return 0;
 }
 
@@ -345,6 +431,9 @@ void cobalt_umm_destroy(struct cobalt_umm *umm)
 	secondary_mode_only();
 
 	if (atomic_dec_and_test(&umm->refcount)) {
+		mutex_lock(&umm_lock);
+		list_del(&umm->next);
+		mutex_unlock(&umm_lock);
 		xnheap_destroy(&umm->heap);
 		vfree(xnheap_get_membase(&umm->heap));
 		if (umm->release)
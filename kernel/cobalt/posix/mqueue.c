@@ -19,6 +19,7 @@
 #include <stdarg.h>
 #include <linux/slab.h>
 #include <linux/mm.h>
+#include <linux/vmalloc.h>
 #include <linux/sched.h>
 #include <cobalt/kernel/select.h>
 #include <rtdm/fd.h>
@@ -32,7 +33,6 @@
 
 #define COBALT_MSGMAX		65536
 #define COBALT_MSGSIZEMAX	(16*1024*1024)
-#define COBALT_MSGPRIOMAX	32768
 
 struct cobalt_mq {
 	unsigned magic;
@@ -60,6 +60,15 @@ struct cobalt_mq {
 
 	DECLARE_XNSELECT(read_select);
 	DECLARE_XNSELECT(write_select);
+
+	/*
+	 * MQ_MAPPED: pool and index live in a private area, which
+	 * only the holders of a descriptor may map.
+	 */
+	struct cobalt_mq_state *state;
+	size_t mapsize;
+	struct xnsynch lock;
+	unsigned int stride;
 };
 
 struct cobalt_mqd {
@@ -99,10 +108,49 @@ static inline void mq_msg_free(struct cobalt_mq *mq, struct cobalt_msg * msg)
 	list_add(&msg->link, &mq->avail); /* For earliest re-use of the block. */
 }
 
+static int mq_map_init(struct cobalt_mq *mq, const struct mq_attr *attr)
+{
+	struct cobalt_mq_state *state;
+	unsigned int stride, i;
+	u64 size;
+
+	stride = ALIGN(sizeof(struct cobalt_mq_slot) + attr->mq_msgsize,
+		       sizeof(unsigned long));
+	size = sizeof(*state) + (u64)stride * attr->mq_maxmsg;
+	if (size > U32_MAX - PAGE_SIZE)
+		return -ENOSPC;
+
+	state = vmalloc_user(PAGE_ALIGN(size));
+	if (state == NULL)
+		return -ENOSPC;
+
+	atomic_set(&state->lock, XN_NO_HANDLE);
+	state->kflags = 0;
+	state->msgsize = attr->mq_msgsize;
+	state->maxmsg = attr->mq_maxmsg;
+	state->stride = stride;
+	state->nrqueued = 0;
+	state->head = COBALT_MQ_NIL;
+	state->tail = COBALT_MQ_NIL;
+	state->free = COBALT_MQ_NIL;
+	for (i = attr->mq_maxmsg; i > 0; i--)
+		cobalt_mq_put_free(state, stride, i - 1);
+
+	xnsynch_init(&mq->lock, XNSYNCH_PI, &state->lock);
+	mq->state = state;
+	mq->mapsize = PAGE_ALIGN(size);
+	mq->stride = stride;
+	mq->mem = NULL;
+	mq->memsize = 0;
+
+	return 0;
+}
+
 static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 {
 	unsigned i, msgsize, memsize;
 	char *mem;
+	int ret;
 
 	if (attr == NULL)
 		attr = &default_attr;
@@ -115,6 +163,18 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 			return -EINVAL;
 	}
 
+	mq->state = NULL;
+	INIT_LIST_HEAD(&mq->queued);
+	INIT_LIST_HEAD(&mq->avail);
+	mq->nrqueued = 0;
+
+	if (attr->mq_flags & MQ_MAPPED) {
+		ret = mq_map_init(mq, attr);
+		if (ret)
+			return ret;
+		goto init;
+	}
+
 	msgsize = attr->mq_msgsize + sizeof(struct cobalt_msg);
 
 	/* Align msgsize on natural boundary. */
@@ -132,19 +192,16 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 		return -ENOSPC;
 
 	mq->memsize = memsize;
-	INIT_LIST_HEAD(&mq->queued);
-	mq->nrqueued = 0;
-	xnsynch_init(&mq->receivers, XNSYNCH_PRIO, NULL);
-	xnsynch_init(&mq->senders, XNSYNCH_PRIO, NULL);
 	mq->mem = mem;
 
 	/* Fill the pool. */
-	INIT_LIST_HEAD(&mq->avail);
 	for (i = 0; i < attr->mq_maxmsg; i++) {
 		struct cobalt_msg *msg = (struct cobalt_msg *) (mem + i * msgsize);
 		mq_msg_free(mq, msg);
 	}
-
+init:
+	xnsynch_init(&mq->receivers, XNSYNCH_PRIO, NULL);
+	xnsynch_init(&mq->senders, XNSYNCH_PRIO, NULL);
 	mq->attr = *attr;
 	mq->target = NULL;
 	xnselect_init(&mq->read_select);
@@ -163,12 +220,18 @@ static inline void mq_destroy(struct cobalt_mq *mq)
 	xnlock_get_irqsave(&nklock, s);
 	resched = (xnsynch_destroy(&mq->receivers) == XNSYNCH_RESCHED);
 	resched = (xnsynch_destroy(&mq->senders) == XNSYNCH_RESCHED) || resched;
+	if (mq->state)
+		resched = (xnsynch_destroy(&mq->lock) == XNSYNCH_RESCHED) || resched;
 	list_del(&mq->link);
 	xnlock_put_irqrestore(&nklock, s);
 	xnselect_destroy(&mq->read_select);
 	xnselect_destroy(&mq->write_select);
 	xnregistry_remove(mq->handle);
-	xnheap_vfree(mq->mem);
+	if (mq->state)
+		/* Pages still mapped by user-space are pinned by their mappings. */
+		vfree(mq->state);
+	else
+		xnheap_vfree(mq->mem);
 	kfree(mq);
 
 	if (resched)
@@ -196,6 +259,127 @@ static int mq_unref(struct cobalt_mq *mq)
 	return mq_unref_inner(mq, s);
 }
 
+static int mq_map_lock(struct cobalt_mq *mq)
+{
+	struct xnthread *curr = xnthread_current();
+	int ret;
+
+	/* We need a valid thread handle for the fast lock. */
+	if (curr == NULL || curr->handle == XN_NO_HANDLE)
+		return -EPERM;
+
+	if (xnsynch_owner_check(&mq->lock, curr) == 0)
+		return -EDEADLK;
+
+	ret = xnsynch_acquire(&mq->lock, XN_INFINITE, XN_RELATIVE);
+	if (ret) {
+		if (ret & XNBREAK)
+			return -EINTR;
+		return -EBADF;
+	}
+
+	return 0;
+}
+
+static void mq_map_unlock(struct cobalt_mq *mq)
+{
+	xnsynch_release(&mq->lock, xnthread_current());
+	xnsched_run();
+}
+
+/*
+ * Publish the conditions which require the kernel to be involved in
+ * transfers. nklock held, irqs off, caller owns mq->lock.
+ */
+static void mq_map_sync(struct cobalt_mq *mq)
+{
+	__u32 kflags = 0;
+
+	if (xnsynch_pended_p(&mq->receivers))
+		kflags |= COBALT_MQ_RWAIT;
+	if (xnsynch_pended_p(&mq->senders))
+		kflags |= COBALT_MQ_SWAIT;
+	if (!list_empty(&mq->read_select.bindings) ||
+	    !list_empty(&mq->write_select.bindings))
+		kflags |= COBALT_MQ_SELECT;
+	if (mq->target)
+		kflags |= COBALT_MQ_NOTIFY;
+
+	mq->state->kflags = kflags;
+}
+
+/*
+ * Drop mq->lock and sleep on @waitq atomically. The attention bit is
+ * raised before the lock is released, so that user-space defers to
+ * the kernel until the sleeper is woken up.
+ */
+static int mq_map_wait(struct cobalt_mq *mq, struct xnsynch *waitq,
+		       __u32 bit, xnticks_t to, xntmode_t tmode)
+{
+	int info;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	mq->state->kflags |= bit;
+	xnsynch_release(&mq->lock, xnthread_current());
+	info = xnsynch_sleep_on(waitq, to, tmode);
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (info & XNRMID)
+		return -EBADF;
+	if (info & XNTIMEO)
+		return -ETIMEDOUT;
+	if (info & XNBREAK)
+		return -EINTR;
+
+	return 0;
+}
+
+static inline bool mq_readable(struct cobalt_mq *mq)
+{
+	if (mq->state)
+		return mq->state->head != COBALT_MQ_NIL;
+
+	return !list_empty(&mq->queued);
+}
+
+static inline bool mq_writable(struct cobalt_mq *mq)
+{
+	if (mq->state)
+		return mq->state->free != COBALT_MQ_NIL;
+
+	return !list_empty(&mq->avail);
+}
+
+/*
+ * Have user-space defer to the kernel for the next transfers, and
+ * if a transfer is in progress there, force its owner to release
+ * the lock through the kernel, so that the selectors are refreshed
+ * once it completes. nklock held, irqs off, mq->lock not owned by
+ * the caller.
+ */
+static void mq_map_claim_select(struct cobalt_mq *mq)
+{
+	atomic_t *lockp = &mq->state->lock;
+	xnhandle_t h;
+
+	mq->state->kflags |= COBALT_MQ_SELECT;
+	smp_mb();
+
+	do {
+		h = atomic_read(lockp);
+		if (h == XN_NO_HANDLE || xnsynch_fast_is_claimed(h))
+			break;
+	} while (atomic_cmpxchg(lockp, h, xnsynch_fast_claimed(h)) != h);
+}
+
+/* nklock held, irqs off, caller owns mq->lock. */
+static void mq_map_signal_select(struct cobalt_mq *mq)
+{
+	xnselect_signal(&mq->read_select, mq_readable(mq));
+	xnselect_signal(&mq->write_select, mq_writable(mq));
+}
+
 static void mqd_close(struct rtdm_fd *fd)
 {
 	struct cobalt_mqd *mqd = container_of(fd, struct cobalt_mqd, fd);
@@ -222,8 +406,15 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 	} else
 		return -EBADF;
 
-	xnlock_get_irqsave(&nklock, s);
+	/*
+	 * Select handlers may not sleep, so we do not grab mq->lock
+	 * for mapped queues. The readiness state read from the
+	 * mapped header may be stale if a transfer is in progress in
+	 * user-space, in which case mq_map_claim_select() has that
+	 * transfer complete through mq_unlock, which refreshes it.
+	 */
 	mq = mqd->mq;
+	xnlock_get_irqsave(&nklock, s);
 
 	switch(type) {
 	case XNSELECT_READ:
@@ -233,7 +424,7 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 
 		err = xnselect_bind(&mq->read_select, binding,
 				selector, type, index,
-				!list_empty(&mq->queued));
+				mq_readable(mq));
 		if (err)
 			goto unlock_and_error;
 		break;
@@ -245,11 +436,13 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 
 		err = xnselect_bind(&mq->write_select, binding,
 				selector, type, index,
-				!list_empty(&mq->avail));
+				mq_writable(mq));
 		if (err)
 			goto unlock_and_error;
 		break;
 	}
+	if (mq->state)
+		mq_map_claim_select(mq);
 	xnlock_put_irqrestore(&nklock, s);
 	return 0;
 
@@ -259,9 +452,25 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 	return err;
 }
 
+static int mqd_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct cobalt_mqd *mqd = container_of(fd, struct cobalt_mqd, fd);
+	struct cobalt_mq *mq = mqd->mq;
+
+	if (mq->state == NULL)
+		return -ENXIO;
+
+	if (vma->vm_pgoff != 0 ||
+	    vma->vm_end - vma->vm_start > mq->mapsize)
+		return -EINVAL;
+
+	return rtdm_mmap_vmem(vma, mq->state);
+}
+
 static struct rtdm_fd_ops mqd_ops = {
 	.close = mqd_close,
 	.select = mqd_select,
+	.mmap = mqd_mmap,
 };
 
 static inline int mqd_create(struct cobalt_mq *mq, unsigned long flags, int ufd)
@@ -547,12 +756,25 @@ static void mq_release_msg(struct cobalt_mq *mq, struct cobalt_msg *msg)
 	}
 }
 
+/* nklock held, irqs off. */
+static void mq_notify_target(struct cobalt_mq *mq)
+{
+	struct cobalt_sigpending *sigp;
+
+	sigp = cobalt_signal_alloc();
+	if (sigp) {
+		cobalt_copy_siginfo(SI_MESGQ, &sigp->si, &mq->si);
+		if (cobalt_signal_send(mq->target, sigp, 0) <= 0)
+			cobalt_signal_free(sigp);
+	}
+	mq->target = NULL;
+}
+
 static int
 mq_finish_send(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
 {
 	struct cobalt_mqwait_context *mwc;
 	struct xnthread_wait_context *wc;
-	struct cobalt_sigpending *sigp;
 	struct xnthread *thread;
 	struct cobalt_mq *mq;
 	spl_t s;
@@ -578,15 +800,8 @@ mq_finish_send(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
 		 */
 		if (list_is_singular(&mq->queued)) {
 			xnselect_signal(&mq->read_select, 1);
-			if (mq->target) {
-				sigp = cobalt_signal_alloc();
-				if (sigp) {
-					cobalt_copy_siginfo(SI_MESGQ, &sigp->si, &mq->si);
-					if (cobalt_signal_send(mq->target, sigp, 0) <= 0)
-						cobalt_signal_free(sigp);
-				}
-				mq->target = NULL;
-			}
+			if (mq->target)
+				mq_notify_target(mq);
 		}
 	}
 	xnsched_run();
@@ -627,7 +842,7 @@ redo:
 		ret = fetch_timeout(&ts, u_ts);
 		if (ret)
 			return ERR_PTR(ret);
-		if (ts.tv_nsec >= ONE_BILLION)
+		if ((unsigned long)ts.tv_nsec >= ONE_BILLION)
 			return ERR_PTR(-EINVAL);
 		to = ts2ns(&ts) + 1;
 		tmode = XN_REALTIME;
@@ -665,6 +880,191 @@ mq_finish_rcv(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
 	return 0;
 }
 
+static int
+mq_map_send(struct cobalt_mqd *mqd, const void __user *u_buf, size_t len,
+	    unsigned int prio, const void __user *u_ts,
+	    int (*fetch_timeout)(struct timespec *ts,
+				 const void __user *u_ts))
+{
+	struct cobalt_mq *mq = mqd->mq;
+	struct cobalt_mq_state *state = mq->state;
+	unsigned int maxmsg = mq->attr.mq_maxmsg, stride = mq->stride;
+	struct cobalt_mq_slot *slot;
+	xntmode_t tmode = XN_RELATIVE;
+	xnticks_t to = XN_INFINITE;
+	struct timespec ts;
+	unsigned int flags;
+	int n, ret, empty;
+	spl_t s;
+
+	flags = rtdm_fd_flags(&mqd->fd) & COBALT_PERMS_MASK;
+	if (flags != O_WRONLY && flags != O_RDWR)
+		return -EBADF;
+
+	if (len > mq->attr.mq_msgsize)
+		return -EMSGSIZE;
+redo:
+	ret = mq_map_lock(mq);
+	if (ret)
+		return ret;
+
+	n = cobalt_mq_get_free(state, maxmsg, stride);
+	if (n == -EAGAIN) {
+		ret = n;
+		if (rtdm_fd_flags(&mqd->fd) & O_NONBLOCK)
+			goto out;
+
+		if (fetch_timeout) {
+			mq_map_unlock(mq);
+			ret = fetch_timeout(&ts, u_ts);
+			if (ret)
+				return ret;
+			if ((unsigned long)ts.tv_nsec >= ONE_BILLION)
+				return -EINVAL;
+			to = ts2ns(&ts) + 1;
+			tmode = XN_REALTIME;
+			fetch_timeout = NULL;
+			goto redo;
+		}
+
+		ret = mq_map_wait(mq, &mq->senders, COBALT_MQ_SWAIT, to, tmode);
+		if (ret)
+			return ret;
+		goto redo;
+	}
+
+	if (n < 0) {
+		ret = n;
+		goto out;
+	}
+
+	slot = cobalt_mq_slot(state, stride, n);
+	ret = cobalt_copy_from_user(slot->data, u_buf, len);
+	if (ret) {
+		cobalt_mq_put_free(state, stride, n);
+		goto out;
+	}
+	slot->len = len;
+	slot->prio = prio;
+	empty = state->head == COBALT_MQ_NIL;
+	ret = cobalt_mq_enqueue(state, maxmsg, stride, n);
+	if (ret)
+		goto out;
+
+	xnlock_get_irqsave(&nklock, s);
+	/*
+	 * No pipelined handoff in mapped mode, the message is always
+	 * queued, then picked by the receiver once it resumes.
+	 */
+	if (xnsynch_pended_p(&mq->receivers))
+		xnsynch_wakeup_one_sleeper(&mq->receivers);
+	else if (empty && mq->target)
+		mq_notify_target(mq);
+	if (empty)
+		xnselect_signal(&mq->read_select, 1);
+	if (state->free == COBALT_MQ_NIL)
+		xnselect_signal(&mq->write_select, 0);
+	mq_map_sync(mq);
+	xnlock_put_irqrestore(&nklock, s);
+out:
+	mq_map_unlock(mq);
+
+	return ret;
+}
+
+static int
+mq_map_receive(struct cobalt_mqd *mqd, void __user *u_buf, ssize_t *lenp,
+	       unsigned int *priop, const void __user *u_ts,
+	       int (*fetch_timeout)(struct timespec *ts,
+				    const void __user *u_ts))
+{
+	struct cobalt_mq *mq = mqd->mq;
+	struct cobalt_mq_state *state = mq->state;
+	unsigned int maxmsg = mq->attr.mq_maxmsg, stride = mq->stride;
+	struct cobalt_mq_slot *slot;
+	xntmode_t tmode = XN_RELATIVE;
+	xnticks_t to = XN_INFINITE;
+	unsigned int flags, prio;
+	struct timespec ts;
+	int n, ret, full;
+	size_t len;
+	spl_t s;
+
+	flags = rtdm_fd_flags(&mqd->fd) & COBALT_PERMS_MASK;
+	if (flags != O_RDONLY && flags != O_RDWR)
+		return -EBADF;
+
+	if (*lenp < mq->attr.mq_msgsize)
+		return -EMSGSIZE;
+redo:
+	ret = mq_map_lock(mq);
+	if (ret)
+		return ret;
+
+	n = cobalt_mq_dequeue(state, maxmsg, stride);
+	if (n == -EAGAIN) {
+		ret = n;
+		if (rtdm_fd_flags(&mqd->fd) & O_NONBLOCK)
+			goto out;
+
+		if (fetch_timeout) {
+			mq_map_unlock(mq);
+			ret = fetch_timeout(&ts, u_ts);
+			if (ret)
+				return ret;
+			if ((unsigned long)ts.tv_nsec >= ONE_BILLION)
+				return -EINVAL;
+			to = ts2ns(&ts) + 1;
+			tmode = XN_REALTIME;
+			fetch_timeout = NULL;
+			goto redo;
+		}
+
+		ret = mq_map_wait(mq, &mq->receivers, COBALT_MQ_RWAIT, to, tmode);
+		if (ret)
+			return ret;
+		goto redo;
+	}
+
+	if (n < 0) {
+		ret = n;
+		goto out;
+	}
+
+	/*
+	 * Like in the regular mode, a message which cannot be copied
+	 * out is dropped.
+	 */
+	slot = cobalt_mq_slot(state, stride, n);
+	len = ACCESS_ONCE(slot->len);
+	prio = slot->prio;
+	if (len > mq->attr.mq_msgsize)
+		ret = -EIO;
+	else
+		ret = cobalt_copy_to_user(u_buf, slot->data, len);
+	full = state->free == COBALT_MQ_NIL;
+	cobalt_mq_put_free(state, stride, n);
+
+	xnlock_get_irqsave(&nklock, s);
+	if (xnsynch_pended_p(&mq->senders))
+		xnsynch_wakeup_one_sleeper(&mq->senders);
+	if (full)
+		xnselect_signal(&mq->write_select, 1);
+	if (state->head == COBALT_MQ_NIL)
+		xnselect_signal(&mq->read_select, 0);
+	mq_map_sync(mq);
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (ret == 0) {
+		*lenp = len;
+		*priop = prio;
+	}
+out:
+	mq_map_unlock(mq);
+
+	return ret;
+}
+
 static inline int mq_getattr(struct cobalt_mqd *mqd, struct mq_attr *attr)
 {
 	struct cobalt_mq *mq;
@@ -674,7 +1074,12 @@ static inline int mq_getattr(struct cobalt_mqd *mqd, struct mq_attr *attr)
 	*attr = mq->attr;
 	xnlock_get_irqsave(&nklock, s);
 	attr->mq_flags = rtdm_fd_flags(&mqd->fd);
-	attr->mq_curmsgs = mq->nrqueued;
+	if (mq->state)
+		attr->mq_curmsgs = min_t(unsigned int,
+					 ACCESS_ONCE(mq->state->nrqueued),
+					 mq->attr.mq_maxmsg);
+	else
+		attr->mq_curmsgs = mq->nrqueued;
 	xnlock_put_irqrestore(&nklock, s);
 
 	return 0;
@@ -696,8 +1101,14 @@ mq_notify(struct cobalt_mqd *mqd, unsigned index, const struct sigevent *evp)
 	if (xnsched_interrupt_p() || thread == NULL)
 		return -EPERM;
 
-	xnlock_get_irqsave(&nklock, s);
 	mq = mqd->mq;
+	if (mq->state) {
+		err = mq_map_lock(mq);
+		if (err)
+			return err;
+	}
+
+	xnlock_get_irqsave(&nklock, s);
 	if (mq->target && mq->target != thread) {
 		err = -EBUSY;
 		goto unlock_and_error;
@@ -723,11 +1134,14 @@ mq_notify(struct cobalt_mqd *mqd, unsigned index, const struct sigevent *evp)
 		mq->si.si_uid = get_current_uuid();
 	}
 
-	xnlock_put_irqrestore(&nklock, s);
-	return 0;
+	err = 0;
+	if (mq->state)
+		mq_map_sync(mq);
 
       unlock_and_error:
 	xnlock_put_irqrestore(&nklock, s);
+	if (mq->state)
+		mq_map_unlock(mq);
 	return err;
 }
 
@@ -913,6 +1327,11 @@ int __cobalt_mq_timedsend(mqd_t uqd, const void __user *u_buf, size_t len,
 	}
 
 	trace_cobalt_mq_send(uqd, u_buf, len, prio);
+	if (mqd->mq->state) {
+		ret = mq_map_send(mqd, u_buf, len, prio, u_ts, fetch_timeout);
+		goto out;
+	}
+
 	msg = mq_timedsend_inner(mqd, len, u_ts, fetch_timeout);
 	if (IS_ERR(msg)) {
 		ret = PTR_ERR(msg);
@@ -962,6 +1381,14 @@ int __cobalt_mq_timedreceive(mqd_t uqd, void __user *u_buf,
 		goto fail;
 	}
 
+	if (mqd->mq->state) {
+		ret = mq_map_receive(mqd, u_buf, lenp, &prio,
+				     u_ts, fetch_timeout);
+		if (ret)
+			goto fail;
+		goto done;
+	}
+
 	msg = mq_timedrcv_inner(mqd, *lenp, u_ts, fetch_timeout);
 	if (IS_ERR(msg)) {
 		ret = PTR_ERR(msg);
@@ -979,7 +1406,7 @@ int __cobalt_mq_timedreceive(mqd_t uqd, void __user *u_buf,
 	ret = mq_finish_rcv(mqd, msg);
 	if (ret)
 		goto fail;
-
+done:
 	cobalt_mqd_put(mqd);
 
 	if (u_prio && __xn_put_user(prio, u_prio))
@@ -1010,3 +1437,63 @@ COBALT_SYSCALL(mq_timedreceive, primary,
 
 	return ret ?: cobalt_copy_to_user(u_len, &len, sizeof(*u_len));
 }
+
+/*
+ * Return the size of the area to map from a descriptor of a mapped
+ * queue with mmap().
+ */
+COBALT_SYSCALL(mq_getmap, current, (mqd_t uqd, __u32 __user *u_size))
+{
+	struct cobalt_mqd *mqd;
+	struct cobalt_mq *mq;
+	__u32 size = 0;
+	int ret = 0;
+
+	mqd = cobalt_mqd_get(uqd);
+	if (IS_ERR(mqd))
+		return PTR_ERR(mqd);
+
+	mq = mqd->mq;
+	if (mq->state)
+		size = mq->mapsize;
+	else
+		ret = -EINVAL;
+
+	cobalt_mqd_put(mqd);
+
+	return ret ?: cobalt_copy_to_user(u_size, &size, sizeof(size));
+}
+
+/*
+ * Release the lock of a mapped queue acquired from user-space, when
+ * the fast release failed because the kernel claimed it meanwhile.
+ */
+COBALT_SYSCALL(mq_unlock, primary, (mqd_t uqd))
+{
+	struct xnthread *curr = xnthread_current();
+	struct cobalt_mqd *mqd;
+	struct cobalt_mq *mq;
+	int ret = 0;
+	spl_t s;
+
+	mqd = cobalt_mqd_get(uqd);
+	if (IS_ERR(mqd))
+		return PTR_ERR(mqd);
+
+	mq = mqd->mq;
+	if (mq->state == NULL)
+		ret = -EINVAL;
+	else if (xnsynch_owner_check(&mq->lock, curr))
+		ret = -EPERM;
+	else {
+		xnlock_get_irqsave(&nklock, s);
+		if (mq->state->kflags & COBALT_MQ_SELECT)
+			mq_map_signal_select(mq);
+		xnlock_put_irqrestore(&nklock, s);
+		mq_map_unlock(mq);
+	}
+
+	cobalt_mqd_put(mqd);
+
+	return ret;
+}
@@ -22,6 +22,7 @@
 #include <linux/types.h>
 #include <linux/fcntl.h>
 #include <xenomai/posix/syscall.h>
+#include <cobalt/uapi/mqueue.h>
 
 struct mq_attr {
 	long mq_flags;
@@ -71,4 +72,8 @@ COBALT_SYSCALL_DECL(mq_timedreceive,
 COBALT_SYSCALL_DECL(mq_notify,
 		    (mqd_t fd, const struct sigevent *__user evp));
 
+COBALT_SYSCALL_DECL(mq_getmap, (mqd_t uqd, __u32 __user *u_size));
+
+COBALT_SYSCALL_DECL(mq_unlock, (mqd_t uqd));
+
 #endif /* !_COBALT_POSIX_MQUEUE_H */
@@ -58,6 +58,7 @@ static int cobalt_mutex_init_inner(struct cobalt_mutex_shadow *shadow,
 
 	state->flags = (attr->type == PTHREAD_MUTEX_ERRORCHECK
 			? COBALT_MUTEX_ERRORCHECK : 0);
+	state->owner_window = COBALT_MUTEX_NOWINDOW;
 	mutex->attr = *attr;
 	INIT_LIST_HEAD(&mutex->conds);
 
@@ -99,7 +100,6 @@ int cobalt_mutex_release(struct xnthread *curr,
 	struct cobalt_mutex_state *state;
 	struct cobalt_cond *cond;
 	unsigned long flags;
-	int need_resched;
 
 	if (!cobalt_obj_active(mutex, COBALT_MUTEX_MAGIC, struct cobalt_mutex))
 		 return -EINVAL;
@@ -119,18 +119,15 @@ int cobalt_mutex_release(struct xnthread *curr,
 
 	state = container_of(mutex->synchbase.fastlock, struct cobalt_mutex_state, owner);
 	flags = state->flags;
-	need_resched = 0;
 	if ((flags & COBALT_MUTEX_COND_SIGNAL)) {
 		state->flags = flags & ~COBALT_MUTEX_COND_SIGNAL;
 		if (!list_empty(&mutex->conds)) {
 			list_for_each_entry(cond, &mutex->conds, mutex_link)
-				need_resched |=
-				cobalt_cond_deferred_signals(cond);
+				cobalt_cond_deferred_signals(cond, curr);
 		}
 	}
-	need_resched |= xnsynch_release(&mutex->synchbase, curr);
 
-	return need_resched;
+	return xnsynch_release(&mutex->synchbase, curr);
 }
 
 int __cobalt_mutex_timedlock_break(struct cobalt_mutex_shadow __user *u_mx,
@@ -189,6 +186,7 @@ redo:
 	ret = -EBUSY;
 	switch(mutex->attr.type) {
 	case PTHREAD_MUTEX_NORMAL:
+	case PTHREAD_MUTEX_ADAPTIVE_NP:
 		/* Attempting to relock a normal mutex, deadlock. */
 		if (IS_ENABLED(CONFIG_XENO_OPT_DEBUG_POSIX_SYNCHRO))
 			printk(XENO_WARNING
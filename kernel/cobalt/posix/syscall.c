@@ -23,6 +23,7 @@
 #include <linux/kconfig.h>
 #include <linux/unistd.h>
 #include <cobalt/uapi/corectl.h>
+#include <cobalt/uapi/batch.h>
 #include <cobalt/kernel/tree.h>
 #include <cobalt/kernel/vdso.h>
 #include <cobalt/kernel/init.h>
@@ -385,6 +386,10 @@ static COBALT_SYSCALL(extend, lostage, (unsigned int magic))
 	return cobalt_bind_personality(magic);
 }
 
+static COBALT_SYSCALL_DECL(batch,
+			   (struct cobalt_batch_ring __user *u_ring,
+			    unsigned int flags));
+
 static int CoBaLt_ni(void)
 {
 	return -ENOSYS;
@@ -488,6 +493,116 @@ static const int cobalt_sysmodes[] = {
 	__COBALT_CALL_MODES
 };
 
+/*
+ * Services which may be issued from a batch ring. Those must be
+ * able to run from the Xenomai domain, and take no argument needing
+ * 32bit thunking, so that the native handler is valid for all ABI
+ * models. Any of them may still block if the caller did not ask for
+ * non-blocking behavior on the target object, in which case the
+ * batch blocks as well.
+ *
+ * The permission checks of handle_head_syscall() do not depend on
+ * the service for a Xenomai thread, those passed for the batch
+ * itself also hold for its entries. Adaptive services (i.e. RTDM
+ * I/O) the real-time handler declines are not switched to the Linux
+ * stage from the batch though: processing stops at such entry, with
+ * -ENOSYS as its result and the ring head left on it, so that
+ * userland issues it as a regular syscall before submitting the
+ * rest.
+ */
+static inline bool batchable_syscall(unsigned int nr)
+{
+	switch (nr) {
+	case sc_cobalt_sem_post:
+	case sc_cobalt_sem_trywait:
+	case sc_cobalt_sem_broadcast_np:
+	case sc_cobalt_event_sync:
+	case sc_cobalt_mq_timedsend:
+	case sc_cobalt_read:
+	case sc_cobalt_write:
+	case sc_cobalt_ioctl:
+	case sc_cobalt_fcntl:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static COBALT_SYSCALL(batch, primary,
+		      (struct cobalt_batch_ring __user *u_ring,
+		       unsigned int flags))
+{
+	struct cobalt_batch_entry __user *u_entry;
+	struct xnthread *curr = xnthread_current();
+	struct cobalt_batch_entry entry;
+	__u32 head, tail, mask;
+	int count = 0, sysflags;
+	long ret;
+
+	if (flags & ~COBALT_BATCH_STOP)
+		return -EINVAL;
+
+	if (__xn_get_user(head, &u_ring->head) ||
+	    __xn_get_user(tail, &u_ring->tail) ||
+	    __xn_get_user(mask, &u_ring->mask))
+		return -EFAULT;
+
+	if (mask >= COBALT_BATCH_MAXSZ || (mask & (mask + 1)) ||
+	    tail - head > mask + 1)
+		return -EINVAL;
+
+	while (head != tail) {
+		u_entry = &u_ring->entries[head & mask];
+		if (cobalt_copy_from_user(&entry, u_entry,
+				  offsetof(struct cobalt_batch_entry, result)))
+			return -EFAULT;
+
+		sysflags = 0;
+		if (!batchable_syscall(entry.nr))
+			ret = -ENOSYS;
+		else if (entry.nr == sc_cobalt_mq_timedsend && entry.args[4])
+			/* No timed wait from a batch. */
+			ret = -EINVAL;
+		else {
+			sysflags = cobalt_sysmodes[entry.nr];
+			if (XENO_WARN_ON_ONCE(COBALT,
+					      sysflags & __xn_exec_lostage))
+				ret = -ENOSYS;
+			else
+				ret = cobalt_syscalls[entry.nr](entry.args[0],
+								entry.args[1],
+								entry.args[2],
+								entry.args[3],
+								entry.args[4]);
+		}
+
+		if (__xn_put_user((__s64)ret, &u_entry->result))
+			return -EFAULT;
+
+		/* Hand over to the regular syscall path. */
+		if (ret == -ENOSYS && (sysflags & __xn_exec_adaptive))
+			break;
+
+		head++;
+		count++;
+
+		if (ret < 0 && (flags & COBALT_BATCH_STOP))
+			break;
+
+		/*
+		 * Let the regular syscall epilogue process pending
+		 * signals, userland will resubmit what is left.
+		 */
+		if (xnthread_test_info(curr, XNKICKED))
+			break;
+	}
+
+	if (__xn_put_user(head, &u_ring->head))
+		return -EFAULT;
+
+	return count;
+}
+
 static inline int allowed_syscall(struct cobalt_process *process,
 				  struct xnthread *thread,
 				  int sysflags, int nr)
@@ -783,6 +783,23 @@ COBALT_SYSCALL32emu(select, nonrestartable,
 	return err;
 }
 
+COBALT_SYSCALL32emu(pollset_wait, primary,
+		    (int psfd, struct cobalt_pollset_event __user *u_events,
+		     int maxevents, const struct compat_timespec __user *u_ts))
+{
+	struct timespec ts, *tsp = NULL;
+	int ret;
+
+	if (u_ts) {
+		tsp = &ts;
+		ret = sys32_get_timespec(&ts, u_ts);
+		if (ret)
+			return ret;
+	}
+
+	return __cobalt_pollset_wait(psfd, u_events, maxevents, tsp);
+}
+
 COBALT_SYSCALL32emu(recvmsg, handover,
 		    (int fd, struct compat_msghdr __user *umsg,
 		     int flags))
@@ -807,9 +824,12 @@ static int get_timespec32(struct timespec *ts,
 	return sys32_get_timespec(ts, u_ts);
 }
 
-static int get_mmsg32(struct mmsghdr *mmsg, void __user *u_mmsg)
+static int get_mmsg32(struct mmsghdr *mmsg, void __user **u_mmsg_p)
 {
-	return sys32_get_mmsghdr(mmsg, u_mmsg);
+	struct compat_mmsghdr __user **p = (struct compat_mmsghdr **)u_mmsg_p,
+		*q __user = (*p)++;
+
+	return sys32_get_mmsghdr(mmsg, q);
 }
 
 static int put_mmsg32(void __user **u_mmsg_p, const struct mmsghdr *mmsg)
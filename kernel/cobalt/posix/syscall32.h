@@ -190,6 +190,14 @@ COBALT_SYSCALL32emu_DECL(select,
 			  compat_fd_set __user *u_xfds,
 			  struct compat_timeval __user *u_tv));
 
+struct cobalt_pollset_event;
+
+COBALT_SYSCALL32emu_DECL(pollset_wait,
+			 (int psfd,
+			  struct cobalt_pollset_event __user *u_events,
+			  int maxevents,
+			  const struct compat_timespec __user *u_ts));
+
 COBALT_SYSCALL32emu_DECL(recvmsg,
 			 (int fd, struct compat_msghdr __user *umsg,
 			  int flags));
@@ -41,6 +41,7 @@
 #define PTHREAD_MUTEX_NORMAL     0
 #define PTHREAD_MUTEX_RECURSIVE  1
 #define PTHREAD_MUTEX_ERRORCHECK 2
+#define PTHREAD_MUTEX_ADAPTIVE_NP 3
 #define PTHREAD_MUTEX_DEFAULT    0
 
 struct cobalt_thread;
@@ -125,6 +125,9 @@ timerfd_select(struct rtdm_fd *fd, struct xnselector *selector,
 			index, tfd->flags & COBALT_TFD_TICKED);
 	xnlock_put_irqrestore(&nklock, s);
 
+	if (err)
+		xnfree(binding);
+
 	return err;
 }
 
@@ -108,6 +108,30 @@ nanosecs_abs_t rtdm_clock_read_monotonic(void);
 int rtdm_task_init(rtdm_task_t *task, const char *name,
 		   rtdm_task_proc_t task_proc, void *arg,
 		   int priority, nanosecs_rel_t period)
+{
+	return __rtdm_task_init(task, name, task_proc, arg,
+				priority, period, cpu_all_mask);
+}
+
+EXPORT_SYMBOL_GPL(rtdm_task_init);
+
+/**
+ * @brief Initialise and start a real-time task on a set of CPUs
+ *
+ * Same as rtdm_task_init(), except that the task is restricted to the
+ * CPUs in @a affinity which are also part of the Cobalt core affinity.
+ *
+ * @param[in] affinity CPU set the task may run on
+ *
+ * @return 0 on success, otherwise negative error code. -EINVAL is
+ * returned if @a affinity contains no CPU available to Cobalt.
+ *
+ * @coretags{secondary-only, might-switch}
+ */
+int __rtdm_task_init(rtdm_task_t *task, const char *name,
+		     rtdm_task_proc_t task_proc, void *arg,
+		     int priority, nanosecs_rel_t period,
+		     const struct cpumask *affinity)
 {
 	union xnsched_policy_param param;
 	struct xnthread_start_attr sattr;
@@ -117,7 +141,7 @@ int rtdm_task_init(rtdm_task_t *task, const char *name,
 	iattr.name = name;
 	iattr.flags = 0;
 	iattr.personality = &xenomai_personality;
-	iattr.affinity = CPU_MASK_ALL;
+	cpumask_copy(&iattr.affinity, affinity);
 	param.rt.prio = priority;
 
 	err = xnthread_init(task, &iattr, &xnsched_class_rt, &param);
@@ -151,7 +175,7 @@ int rtdm_task_init(rtdm_task_t *task, const char *name,
 	return err;
 }
 
-EXPORT_SYMBOL_GPL(rtdm_task_init);
+EXPORT_SYMBOL_GPL(__rtdm_task_init);
 
 #ifdef DOXYGEN_CPP /* Only used for doxygen doc generation */
 /**
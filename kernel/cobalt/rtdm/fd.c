@@ -598,21 +598,95 @@ static void recvmmsg_timeout_handler(struct xntimer *timer)
 	xnthread_resume(rq->waiter, XNDELAY);
 }
 
+/*
+ * Message headers are pulled in by batches of up to
+ * RTDM_MMSG_MAXBATCH entries, then passed to the native batched
+ * handler if present. Small vectors live on the stack.
+ */
+#define RTDM_MMSG_FASTMAX	8
+#define RTDM_MMSG_MAXBATCH	64
+
+static struct mmsghdr *get_mmsg_vec(struct mmsghdr *mmsg_fast,
+				    unsigned int vlen, unsigned int *batchp)
+{
+	struct mmsghdr *vec;
+
+	if (vlen <= RTDM_MMSG_FASTMAX) {
+		*batchp = vlen;
+		return mmsg_fast;
+	}
+
+	*batchp = min_t(unsigned int, vlen, RTDM_MMSG_MAXBATCH);
+	vec = xnmalloc(sizeof(*vec) * *batchp);
+	if (vec)
+		return vec;
+
+	/* Out of system heap, go slower. */
+	*batchp = RTDM_MMSG_FASTMAX;
+
+	return mmsg_fast;
+}
+
+static inline void put_mmsg_vec(struct mmsghdr *vec,
+				struct mmsghdr *mmsg_fast)
+{
+	if (vec != mmsg_fast)
+		xnfree(vec);
+}
+
+static int fetch_mmsg_vec(struct mmsghdr *vec, unsigned int n,
+			  void __user **u_p, int *errp,
+			  int (*get_mmsg)(struct mmsghdr *mmsg, void __user **u_mmsg_p))
+{
+	int i, ret;
+
+	for (i = 0; i < n; i++) {
+		ret = get_mmsg(&vec[i], u_p);
+		if (ret) {
+			*errp = ret;
+			break;
+		}
+	}
+
+	return i;
+}
+
+static int recvmmsg_slow(struct rtdm_fd *fd, struct mmsghdr *vec,
+			 unsigned int n, int flags)
+{
+	unsigned int i;
+	ssize_t len;
+
+	for (i = 0; i < n; i++) {
+		len = fd->ops->recvmsg_rt(fd, &vec[i].msg_hdr, flags);
+		if (len < 0)
+			return i ?: len;
+		vec[i].msg_len = (unsigned int)len;
+		/* OOB data requires immediate handling. */
+		if (vec[i].msg_hdr.msg_flags & MSG_OOB)
+			return i + 1;
+		if (flags & MSG_WAITFORONE)
+			flags |= MSG_DONTWAIT;
+	}
+
+	return n;
+}
+
 int __rtdm_fd_recvmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
 		       unsigned int flags, void __user *u_timeout,
-		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user **u_mmsg_p),
 		       int (*put_mmsg)(void __user **u_mmsg_p, const struct mmsghdr *mmsg),
 		       int (*get_timespec)(struct timespec *ts, const void __user *u_ts))
 {
+	struct mmsghdr mmsg_fast[RTDM_MMSG_FASTMAX], *vec;
+	void __user *u_get = u_msgvec, *u_put = u_msgvec;
+	int ret = 0, getret, datagrams = 0, i, n, done;
 	struct cobalt_recvmmsg_timer rq;
 	xntmode_t tmode = XN_RELATIVE;
 	struct timespec ts = { 0 };
-	int ret, datagrams = 0;
 	xnticks_t timeout = 0;
-	struct mmsghdr mmsg;
+	unsigned int batch;
 	struct rtdm_fd *fd;
-	void __user *u_p;
-	ssize_t len;
 	spl_t s;
 	
 	if (vlen == 0)
@@ -658,27 +732,43 @@ int __rtdm_fd_recvmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
 	if (fd->oflags & O_NONBLOCK)
 		flags |= MSG_DONTWAIT;
 
-	for (u_p = u_msgvec; vlen > 0; vlen--) {
-		ret = get_mmsg(&mmsg, u_p);
-		if (ret)
+	vec = get_mmsg_vec(mmsg_fast, vlen, &batch);
+
+	while (vlen > 0) {
+		getret = 0;
+		n = fetch_mmsg_vec(vec, min(vlen, batch), &u_get,
+				   &getret, get_mmsg);
+		if (n == 0) {
+			ret = getret;
 			break;
-		len = fd->ops->recvmsg_rt(fd, &mmsg.msg_hdr, flags);
-		if (len < 0) {
-			ret = len;
+		}
+		ret = -ENOSYS;
+		if (fd->ops->recvmmsg_rt)
+			ret = fd->ops->recvmmsg_rt(fd, vec, n, flags);
+		if (ret == -ENOSYS)
+			ret = recvmmsg_slow(fd, vec, n, flags);
+		if (ret < 0)
 			break;
+		done = ret;
+		for (i = 0, ret = 0; i < done; i++) {
+			ret = put_mmsg(&u_put, &vec[i]);
+			if (ret)
+				break;
+			datagrams++;
 		}
-		mmsg.msg_len = (unsigned int)len;
-		ret = put_mmsg(&u_p, &mmsg);
 		if (ret)
 			break;
-		datagrams++;
-		/* OOB data requires immediate handling. */
-		if (mmsg.msg_hdr.msg_flags & MSG_OOB)
-			break;
-		if (flags & MSG_WAITFORONE)
+		if (done > 0 && (flags & MSG_WAITFORONE))
 			flags |= MSG_DONTWAIT;
+		ret = getret;
+		if (ret || done < n ||
+		    (vec[done - 1].msg_hdr.msg_flags & MSG_OOB))
+			break;
+		vlen -= n;
 	}
 
+	put_mmsg_vec(vec, mmsg_fast);
+
 	if (timeout) {
 		xnlock_get_irqsave(&nklock, s);
 		xntimer_destroy(&rq.timer);
@@ -734,16 +824,32 @@ out:
 }
 EXPORT_SYMBOL_GPL(rtdm_fd_sendmsg);
 
+static int sendmmsg_slow(struct rtdm_fd *fd, struct mmsghdr *vec,
+			 unsigned int n, int flags)
+{
+	unsigned int i;
+	ssize_t len;
+
+	for (i = 0; i < n; i++) {
+		len = fd->ops->sendmsg_rt(fd, &vec[i].msg_hdr, flags);
+		if (len < 0)
+			return i ?: len;
+		vec[i].msg_len = (unsigned int)len;
+	}
+
+	return n;
+}
+
 int __rtdm_fd_sendmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
 		       unsigned int flags,
-		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user *u_mmsg),
+		       int (*get_mmsg)(struct mmsghdr *mmsg, void __user **u_mmsg_p),
 		       int (*put_mmsg)(void __user **u_mmsg_p, const struct mmsghdr *mmsg))
 {
-	int ret, datagrams = 0;
-	struct mmsghdr mmsg;
+	struct mmsghdr mmsg_fast[RTDM_MMSG_FASTMAX], *vec;
+	void __user *u_get = u_msgvec, *u_put = u_msgvec;
+	int ret = 0, getret, datagrams = 0, i, n, done;
+	unsigned int batch;
 	struct rtdm_fd *fd;
-	void __user *u_p;
-	ssize_t len;
 	
 	if (vlen == 0)
 		return 0;
@@ -761,22 +867,40 @@ int __rtdm_fd_sendmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
 	if (fd->oflags & O_NONBLOCK)
 		flags |= MSG_DONTWAIT;
 
-	for (u_p = u_msgvec; vlen > 0; vlen--) {
-		ret = get_mmsg(&mmsg, u_p);
-		if (ret)
+	vec = get_mmsg_vec(mmsg_fast, vlen, &batch);
+
+	while (vlen > 0) {
+		getret = 0;
+		n = fetch_mmsg_vec(vec, min(vlen, batch), &u_get,
+				   &getret, get_mmsg);
+		if (n == 0) {
+			ret = getret;
 			break;
-		len = fd->ops->sendmsg_rt(fd, &mmsg.msg_hdr, flags);
-		if (len < 0) {
-			ret = len;
+		}
+		ret = -ENOSYS;
+		if (fd->ops->sendmmsg_rt)
+			ret = fd->ops->sendmmsg_rt(fd, vec, n, flags);
+		if (ret == -ENOSYS)
+			ret = sendmmsg_slow(fd, vec, n, flags);
+		if (ret < 0)
 			break;
+		done = ret;
+		for (i = 0, ret = 0; i < done; i++) {
+			ret = put_mmsg(&u_put, &vec[i]);
+			if (ret)
+				break;
+			datagrams++;
 		}
-		mmsg.msg_len = (unsigned int)len;
-		ret = put_mmsg(&u_p, &mmsg);
 		if (ret)
 			break;
-		datagrams++;
+		ret = getret;
+		if (ret || done < n)
+			break;
+		vlen -= n;
 	}
 
+	put_mmsg_vec(vec, mmsg_fast);
+
 	if (datagrams > 0 && (ret == 0 || ret == -EWOULDBLOCK)) {
 		/* NOTE: SO_ERROR should be honored for other errors. */
 		rtdm_fd_put(fd);
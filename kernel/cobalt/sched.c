@@ -596,14 +596,13 @@ void xnsched_migrate_passive(struct xnthread *thread, struct xnsched *sched)
 	}
 }
 
-#ifdef CONFIG_XENO_OPT_SCALABLE_SCHED
-
 void xnsched_initq(struct xnsched_mlq *q)
 {
 	int prio;
 
 	q->elems = 0;
-	bitmap_zero(q->prio_map, XNSCHED_MLQ_LEVELS);
+	q->himap = 0;
+	bitmap_zero(q->lomap, XNSCHED_MLQ_LEVELS);
 
 	for (prio = 0; prio < XNSCHED_MLQ_LEVELS; prio++)
 		INIT_LIST_HEAD(q->heads + prio);
@@ -614,11 +613,10 @@ static inline int get_qindex(struct xnsched_mlq *q, int prio)
 	XENO_BUG_ON(COBALT, prio < 0 || prio >= XNSCHED_MLQ_LEVELS);
 	/*
 	 * BIG FAT WARNING: We need to rescale the priority level to a
-	 * 0-based range. We use find_first_bit() to scan the bitmap
-	 * which is a bit scan forward operation. Therefore, the lower
-	 * the index value, the higher the priority (since least
-	 * significant bits will be found first when scanning the
-	 * bitmap).
+	 * 0-based range. We use __ffs() to scan the bitmap which is a
+	 * bit scan forward operation. Therefore, the lower the index
+	 * value, the higher the priority (since least significant
+	 * bits will be found first when scanning the bitmap).
 	 */
 	return XNSCHED_MLQ_LEVELS - prio - 1;
 }
@@ -633,8 +631,10 @@ static struct list_head *add_q(struct xnsched_mlq *q, int prio)
 	q->elems++;
 
 	/* New item is not linked yet. */
-	if (list_empty(head))
-		__set_bit(idx, q->prio_map);
+	if (list_empty(head)) {
+		__set_bit(idx, q->lomap);
+		__set_bit(idx / BITS_PER_LONG, &q->himap);
+	}
 
 	return head;
 }
@@ -659,8 +659,11 @@ static void del_q(struct xnsched_mlq *q,
 	list_del(entry);
 	q->elems--;
 
-	if (list_empty(head))
-		__clear_bit(idx, q->prio_map);
+	if (list_empty(head)) {
+		__clear_bit(idx, q->lomap);
+		if (q->lomap[idx / BITS_PER_LONG] == 0)
+			__clear_bit(idx / BITS_PER_LONG, &q->himap);
+	}
 }
 
 void xnsched_delq(struct xnsched_mlq *q, struct xnthread *thread)
@@ -738,47 +741,6 @@ struct xnthread *xnsched_rt_pick(struct xnsched *sched)
 
 #endif /* CONFIG_XENO_OPT_SCHED_CLASSES */
 
-#else /* !CONFIG_XENO_OPT_SCALABLE_SCHED */
-
-struct xnthread *xnsched_findq(struct list_head *q, int prio)
-{
-	struct xnthread *thread;
-
-	if (list_empty(q))
-		return NULL;
-
-	/* Find thread leading a priority group. */
-	list_for_each_entry(thread, q, rlink) {
-		if (prio == thread->cprio)
-			return thread;
-	}
-
-	return NULL;
-}
-
-#ifdef CONFIG_XENO_OPT_SCHED_CLASSES
-
-struct xnthread *xnsched_rt_pick(struct xnsched *sched)
-{
-	struct list_head *q = &sched->rt.runnable;
-	struct xnthread *thread;
-
-	if (list_empty(q))
-		return NULL;
-
-	thread = list_first_entry(q, struct xnthread, rlink);
-	if (unlikely(thread->sched_class != &xnsched_class_rt))
-		return thread->sched_class->sched_pick(sched);
-
-	list_del(&thread->rlink);
-
-	return thread;
-}
-
-#endif /* CONFIG_XENO_OPT_SCHED_CLASSES */
-
-#endif /* !CONFIG_XENO_OPT_SCALABLE_SCHED */
-
 static inline void switch_context(struct xnsched *sched,
 				  struct xnthread *prev, struct xnthread *next)
 {
@@ -935,6 +897,7 @@ reschedule:
 	prev = curr;
 
 	trace_cobalt_switch_context(prev, next);
+	xnsched_trace_switch(sched, prev, next);
 
 	if (xnthread_test_state(next, XNROOT))
 		xnsched_reset_watchdog(sched);
@@ -955,6 +918,13 @@ reschedule:
 
 	xnstat_exectime_switch(sched, &next->stat.account);
 	xnstat_counter_inc(&next->stat.csw);
+#ifdef CONFIG_SMP
+	/* Tell adaptive mutex waiters whether lock owners are running. */
+	if (prev->u_window)
+		prev->u_window->oncpu = 0;
+	if (next->u_window)
+		next->u_window->oncpu = xnsched_cpu(sched) + 1;
+#endif
 
 	switch_context(sched, prev, next);
 
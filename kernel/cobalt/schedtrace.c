@@ -0,0 +1,198 @@
+/*
+ * This file is part of the Xenomai project.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <cobalt/kernel/sched.h>
+#include <cobalt/kernel/thread.h>
+#include <cobalt/kernel/clock.h>
+#include <cobalt/uapi/kernel/schedtrace.h>
+#include <rtdm/driver.h>
+
+/**
+ * @ingroup cobalt_core_sched
+ * @defgroup cobalt_core_schedtrace Context switch trace ring
+ *
+ * Each real-time CPU logs its context switches into a private ring,
+ * with interrupts off. Since a ring has a single writer, records are
+ * published without any lock: a sequence word tells readers whether
+ * the record they copied out was overwritten meanwhile. All rings
+ * live in a single vmalloc'ed area which Linux processes may map
+ * read-only from /dev/rtdm/schedtrace.
+ *
+ *@{
+ */
+
+#define TRACE_NR_ENTRIES	CONFIG_XENO_OPT_SCHED_TRACE_ENTRIES
+
+#if TRACE_NR_ENTRIES < 2 || (TRACE_NR_ENTRIES & (TRACE_NR_ENTRIES - 1))
+#error "CONFIG_XENO_OPT_SCHED_TRACE_ENTRIES must be a power of two"
+#endif
+
+static struct xnsched_trace_header *trace_hdr;
+
+static inline size_t ring_offset(void)
+{
+	return PAGE_ALIGN(sizeof(struct xnsched_trace_header));
+}
+
+static inline size_t ring_stride(void)
+{
+	return PAGE_ALIGN(sizeof(struct xnsched_trace_ring) +
+			  TRACE_NR_ENTRIES * sizeof(struct xnsched_trace_entry));
+}
+
+static inline u32 switch_reason(struct xnthread *prev)
+{
+	if (xnthread_test_state(prev, XNZOMBIE))
+		return XNSCHED_TRACE_EXIT;
+
+	if (xnthread_test_state(prev, XNRELAX))
+		return XNSCHED_TRACE_RELAX;
+
+	if (xnthread_test_state(prev, XNTHREAD_BLOCK_BITS))
+		return XNSCHED_TRACE_BLOCK;
+
+	return XNSCHED_TRACE_PREEMPT;
+}
+
+/* nklock held, irqs off. */
+void __xnsched_trace_switch(struct xnsched *sched,
+			    struct xnthread *prev, struct xnthread *next)
+{
+	struct xnsched_trace_ring *ring = sched->trace;
+	struct xnsched_trace_entry *e;
+	xnticks_t now;
+	u32 pos;
+
+	now = xnclock_read_raw(&nkclock);
+	pos = ring->head;
+	e = ring->entries + (pos & (TRACE_NR_ENTRIES - 1));
+
+	e->seq = 0;
+	smp_wmb();		/* Invalidate before updating. */
+	e->reason = switch_reason(prev);
+	e->timestamp = now;
+	e->delay = next->wakeup_date ? now - next->wakeup_date : 0;
+	e->prev_handle = prev->handle;
+	e->next_handle = next->handle;
+	e->prev_pid = xnthread_host_pid(prev);
+	e->next_pid = xnthread_host_pid(next);
+	smp_wmb();		/* Record contents before validating. */
+	e->seq = pos + 1;
+	ACCESS_ONCE(ring->head) = pos + 1;
+
+	/* Only the first resumption after a wakeup is delayed. */
+	next->wakeup_date = 0;
+}
+
+static int trace_open(struct rtdm_fd *fd, int oflags)
+{
+	if ((oflags & O_ACCMODE) != O_RDONLY)
+		return -EACCES;
+
+	return 0;
+}
+
+static int trace_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff != 0 ||
+	    vma->vm_end - vma->vm_start > trace_hdr->map_size)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EACCES;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return rtdm_mmap_vmem(vma, trace_hdr);
+}
+
+static struct rtdm_driver trace_driver = {
+	.profile_info	=	RTDM_PROFILE_INFO(schedtrace,
+						  RTDM_CLASS_COBALT,
+						  RTDM_SUBCLASS_GENERIC,
+						  0),
+	.device_flags	=	RTDM_NAMED_DEVICE,
+	.device_count	=	1,
+	.ops = {
+		.open		=	trace_open,
+		.mmap		=	trace_mmap,
+	},
+};
+
+static struct rtdm_device trace_device = {
+	.driver = &trace_driver,
+	.label = COBALT_SCHEDTRACE_DEV,
+};
+
+static void release_rings(void)
+{
+	int cpu;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	for_each_realtime_cpu(cpu)
+		xnsched_struct(cpu)->trace = NULL;
+	xnlock_put_irqrestore(&nklock, s);
+
+	/* Pages still mapped by user-space are pinned by their mappings. */
+	vfree(trace_hdr);
+	trace_hdr = NULL;
+}
+
+int xnsched_init_trace(void)
+{
+	struct xnsched_trace_ring *ring;
+	size_t mapsz;
+	int cpu, ret;
+
+	mapsz = ring_offset() + nr_cpu_ids * ring_stride();
+	trace_hdr = vmalloc_user(mapsz);
+	if (trace_hdr == NULL)
+		return -ENOMEM;
+
+	trace_hdr->magic = XNSCHED_TRACE_MAGIC;
+	trace_hdr->nr_cpus = nr_cpu_ids;
+	trace_hdr->nr_entries = TRACE_NR_ENTRIES;
+	trace_hdr->entry_size = sizeof(struct xnsched_trace_entry);
+	trace_hdr->ring_offset = ring_offset();
+	trace_hdr->ring_stride = ring_stride();
+	trace_hdr->map_size = mapsz;
+	trace_hdr->clock_freq = cobalt_pipeline.clock_freq;
+
+	for_each_realtime_cpu(cpu) {
+		ring = (void *)trace_hdr + ring_offset() + cpu * ring_stride();
+		ring->cpu = cpu;
+		xnsched_struct(cpu)->trace = ring;
+	}
+
+	ret = rtdm_dev_register(&trace_device);
+	if (ret)
+		release_rings();
+
+	return ret;
+}
+
+void xnsched_cleanup_trace(void)
+{
+	rtdm_dev_unregister(&trace_device);
+	release_rings();
+}
+
+/** @} */
@@ -45,6 +45,15 @@
  * - a @a struct @a xnselector structure, the selection structure,  passed by
  * the thread calling the xnselect service, where this service does all its
  * housekeeping.
+ *
+ * A selector may alternatively be set up as a poll set by
+ * xnselector_init_pollset(). In this mode, file descriptors are bound
+ * once for all, then each binding is queued to a ready list by
+ * __xnselect_signal() when its state is raised, and dequeued when it
+ * drops. xnselect_poll() merely walks that list, so the cost of
+ * waiting is proportional to the number of ready descriptors instead
+ * of the highest descriptor number, and the __FD_SETSIZE limit does
+ * not apply.
  * @{
  */
 
@@ -99,7 +108,13 @@ static inline int xnselect_wakeup(struct xnselector *selector)
  * the @a binding parameter must have been allocated by the caller outside the
  * locking section.
  *
+ * A poll set holds at most one binding per file descriptor and event
+ * type. Since the check is done in the same locking section as the
+ * binding, concurrent requests for the same pair cannot both succeed.
+ *
  * @retval -EINVAL if @a type or @a index is invalid;
+ * @retval -EEXIST if @a selector is a poll set already bound to @a
+ * index for @a type;
  * @retval 0 otherwise.
  *
  * @coretags{task-unrestricted, might-switch, atomic-entry}
@@ -113,16 +128,34 @@ int xnselect_bind(struct xnselect *select_block,
 {
 	atomic_only();
 
-	if (type >= XNSELECT_MAX_TYPES || index > __FD_SETSIZE)
+	if (type >= XNSELECT_MAX_TYPES)
+		return -EINVAL;
+
+	if (!(selector->flags & XNSELECT_POLLSET) && index > __FD_SETSIZE)
 		return -EINVAL;
 
+	if ((selector->flags & XNSELECT_POLLSET) &&
+	    xnselect_bound_p(selector, type, index))
+		return -EEXIST;
+
 	binding->selector = selector;
 	binding->fd = select_block;
 	binding->type = type;
 	binding->bit_index = index;
+	INIT_LIST_HEAD(&binding->rlink);
 
 	list_add_tail(&binding->slink, &selector->bindings);
 	list_add_tail(&binding->link, &select_block->bindings);
+
+	if (selector->flags & XNSELECT_POLLSET) {
+		if (state) {
+			list_add_tail(&binding->rlink, &selector->ready);
+			if (xnselect_wakeup(selector))
+				xnsched_run();
+		}
+		return 0;
+	}
+
 	__FD_SET__(index, &selector->fds[type].expected);
 	if (state) {
 		__FD_SET__(index, &selector->fds[type].pending);
@@ -144,6 +177,16 @@ int __xnselect_signal(struct xnselect *select_block, unsigned state)
 
 	list_for_each_entry(binding, &select_block->bindings, link) {
 		selector = binding->selector;
+		if (selector->flags & XNSELECT_POLLSET) {
+			if (!state)
+				list_del_init(&binding->rlink);
+			else if (list_empty(&binding->rlink)) {
+				list_add_tail(&binding->rlink, &selector->ready);
+				if (xnselect_wakeup(selector))
+					resched = 1;
+			}
+			continue;
+		}
 		if (state) {
 			if (!__FD_ISSET__(binding->bit_index,
 					&selector->fds[binding->type].pending)) {
@@ -186,6 +229,14 @@ void xnselect_destroy(struct xnselect *select_block)
 	list_for_each_entry_safe(binding, tmp, &select_block->bindings, link) {
 		list_del(&binding->link);
 		selector = binding->selector;
+		/*
+		 * Poll sets silently drop the bindings of a closed
+		 * descriptor, there is nothing left to report.
+		 */
+		if (selector->flags & XNSELECT_POLLSET) {
+			list_del(&binding->rlink);
+			goto unlink;
+		}
 		__FD_CLR__(binding->bit_index,
 			 &selector->fds[binding->type].expected);
 		if (!__FD_ISSET__(binding->bit_index,
@@ -195,6 +246,7 @@ void xnselect_destroy(struct xnselect *select_block)
 			if (xnselect_wakeup(selector))
 				resched = 1;
 		}
+	unlink:
 		list_del(&binding->slink);
 		xnlock_put_irqrestore(&nklock, s);
 		xnfree(binding);
@@ -289,11 +341,206 @@ int xnselector_init(struct xnselector *selector)
 		__FD_ZERO__(&selector->fds[i].pending);
 	}
 	INIT_LIST_HEAD(&selector->bindings);
+	INIT_LIST_HEAD(&selector->ready);
+	selector->flags = 0;
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(xnselector_init);
 
+/**
+ * Initialize a selector structure as a poll set.
+ *
+ * A poll set is waited for with xnselect_poll() instead of
+ * xnselect(). Bindings are not limited to __FD_SETSIZE, and stay in
+ * effect until xnselect_unbind() is called, the bound file
+ * descriptor is closed, or the selector is destroyed.
+ *
+ * @param selector The selector structure to be initialized.
+ *
+ * @retval 0
+ *
+ * @coretags{task-unrestricted}
+ */
+int xnselector_init_pollset(struct xnselector *selector)
+{
+	xnselector_init(selector);
+	selector->flags = XNSELECT_POLLSET;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnselector_init_pollset);
+
+/**
+ * Wait for events on a poll set.
+ *
+ * Collects up to @a nr bindings from the ready list of @a selector,
+ * waiting for one to show up if the list is empty. Collected
+ * bindings are moved to the end of the ready list, so that
+ * descriptors which remain ready do not starve others when more than
+ * @a nr of them are pending.
+ *
+ * @param selector the poll set, initialized by xnselector_init_pollset();
+ * @param ready array receiving the index and type of each ready binding;
+ * @param nr the number of entries available in @a ready;
+ * @param timeout the timeout, whose meaning depends on @a timeout_mode,
+ * XN_NONBLOCK causes an immediate return if nothing is ready;
+ * @param timeout_mode the mode of @a timeout.
+ *
+ * @retval -EINVAL if @a nr is not strictly positive, or @a selector
+ * is not a poll set;
+ * @retval -EINTR if xnselect_poll() was interrupted while waiting;
+ * @retval 0 in case of timeout;
+ * @retval the number of entries stored into @a ready.
+ *
+ * @coretags{primary-only, might-switch}
+ */
+int xnselect_poll(struct xnselector *selector,
+		  struct xnselect_ready *ready, int nr,
+		  xnticks_t timeout, xntmode_t timeout_mode)
+{
+	struct xnselect_binding *binding, *tmp;
+	int info = 0, count = 0;
+	LIST_HEAD(collected);
+	spl_t s;
+
+	if (nr <= 0 || !(selector->flags & XNSELECT_POLLSET))
+		return -EINVAL;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	while (list_empty(&selector->ready)) {
+		if (timeout == XN_NONBLOCK && timeout_mode == XN_RELATIVE)
+			goto out;
+		info = xnsynch_sleep_on(&selector->synchbase,
+					timeout, timeout_mode);
+		if (info & (XNBREAK | XNTIMEO))
+			break;
+	}
+
+	list_for_each_entry_safe(binding, tmp, &selector->ready, rlink) {
+		ready[count].index = binding->bit_index;
+		ready[count].type = binding->type;
+		list_move_tail(&binding->rlink, &collected);
+		if (++count >= nr)
+			break;
+	}
+
+	list_splice_tail(&collected, &selector->ready);
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (count > 0)
+		return count;
+
+	if (info & XNBREAK)
+		return -EINTR;
+
+	return 0; /* Timeout */
+}
+EXPORT_SYMBOL_GPL(xnselect_poll);
+
+/**
+ * Test whether a file descriptor is bound to a poll set.
+ *
+ * @param selector the poll set;
+ * @param type type of events;
+ * @param index index of the file descriptor.
+ *
+ * @return true if a binding exists for @a index and @a type.
+ *
+ * @coretags{unrestricted}
+ */
+bool xnselect_bound_p(struct xnselector *selector,
+		      unsigned int type, unsigned int index)
+{
+	struct xnselect_binding *binding;
+	bool ret = false;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	list_for_each_entry(binding, &selector->bindings, slink) {
+		if (binding->bit_index == index && binding->type == type) {
+			ret = true;
+			break;
+		}
+	}
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(xnselect_bound_p);
+
+/**
+ * Unbind a file descriptor from a poll set for some event types.
+ *
+ * The bindings of the file descriptor for the event types set in @a
+ * types are dropped, others are left untouched. The cost is linear
+ * with the number of bindings, this service is not meant to be
+ * called from a hot path.
+ *
+ * @param selector the poll set;
+ * @param index index of the file descriptor;
+ * @param types mask of event types, bit N standing for type N.
+ *
+ * @retval -ENOENT if no binding exists for @a index and @a types;
+ * @retval 0 otherwise.
+ *
+ * @coretags{task-unrestricted}
+ */
+int xnselect_unbind_types(struct xnselector *selector,
+			  unsigned int index, unsigned int types)
+{
+	struct xnselect_binding *binding, *tmp;
+	LIST_HEAD(dropped);
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	list_for_each_entry_safe(binding, tmp, &selector->bindings, slink) {
+		if (binding->bit_index != index ||
+		    !(types & (1 << binding->type)))
+			continue;
+		list_del(&binding->link);
+		list_del(&binding->rlink);
+		list_move_tail(&binding->slink, &dropped);
+	}
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (list_empty(&dropped))
+		return -ENOENT;
+
+	list_for_each_entry_safe(binding, tmp, &dropped, slink)
+		xnfree(binding);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnselect_unbind_types);
+
+/**
+ * Unbind a file descriptor from a poll set.
+ *
+ * All bindings of the file descriptor for any event type are
+ * dropped, see xnselect_unbind_types().
+ *
+ * @param selector the poll set;
+ * @param index index of the file descriptor.
+ *
+ * @retval -ENOENT if no binding exists for @a index;
+ * @retval 0 otherwise.
+ *
+ * @coretags{task-unrestricted}
+ */
+int xnselect_unbind(struct xnselector *selector, unsigned int index)
+{
+	return xnselect_unbind_types(selector, index,
+				     (1 << XNSELECT_MAX_TYPES) - 1);
+}
+EXPORT_SYMBOL_GPL(xnselect_unbind);
+
 /**
  * Check the state of a number of file descriptors, wait for a state change if
  * no descriptor is ready.
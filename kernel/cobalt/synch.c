@@ -993,6 +993,156 @@ void xnsynch_requeue_sleeper(struct xnthread *thread)
 }
 EXPORT_SYMBOL_GPL(xnsynch_requeue_sleeper);
 
+/**
+ * @fn int xnsynch_requeue_sleepers(struct xnsynch *from, struct xnsynch *to, struct xnthread *owner, int nr);
+ * @brief Move threads sleeping on an object to the wait queue of a lock.
+ *
+ * This service moves up to @a nr threads sleeping on @a from to the
+ * pending queue of @a to, as if they had called xnsynch_acquire()
+ * without timeout on the latter. The requeued threads remain blocked
+ * until xnsynch_release() passes them the ownership of @a to, so that
+ * signaling a crowd of waiters which all have to grab the same lock
+ * next only readies the thread which actually gets it. This is
+ * typically used for implementing condition variables.
+ *
+ * A requeued thread should call xnsynch_acquire_requeued() once it
+ * resumes, in order to find out whether it owns @a to.
+ *
+ * @param from The descriptor address of the ownerless synchronization
+ * object the threads sleep on (XNSYNCH_OWNER not set).
+ *
+ * @param to The descriptor address of the synchronization object
+ * tracking ownership the threads should wait for (XNSYNCH_OWNER set).
+ *
+ * @param owner The descriptor address of the thread currently owning
+ * @a to.
+ *
+ * @param nr The maximum number of threads to requeue.
+ *
+ * @return The number of requeued threads.
+ *
+ * @sideeffect
+ *
+ * - The fast lock of @a to is marked as claimed if any thread was
+ * requeued, so that @a owner has to release it via xnsynch_release().
+ *
+ * - The effective priority of @a owner might be raised as a
+ * consequence of the priority inheritance boost, if @a to is
+ * PI-enabled.
+ *
+ * - The wait timeouts of the requeued threads are cancelled.
+ *
+ * @coretags{unrestricted}
+ */
+int xnsynch_requeue_sleepers(struct xnsynch *from, struct xnsynch *to,
+			     struct xnthread *owner, int nr)
+{
+	struct xnthread *thread, *tmp, *top;
+	int nrequeued = 0;
+	atomic_t *lockp;
+	spl_t s;
+
+	XENO_BUG_ON(COBALT, from->status & XNSYNCH_OWNER);
+	XENO_BUG_ON(COBALT, (to->status & XNSYNCH_OWNER) == 0);
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (list_empty(&from->pendq) || nr <= 0)
+		goto out;
+
+	trace_cobalt_synch_requeue(from, to);
+
+	track_owner(to, owner);
+
+	list_for_each_entry_safe(thread, tmp, &from->pendq, plink) {
+		if (nrequeued >= nr)
+			break;
+		list_del(&thread->plink);
+		if ((to->status & XNSYNCH_PRIO) == 0) /* i.e. FIFO */
+			list_add_tail(&thread->plink, &to->pendq);
+		else
+			list_add_priff(thread, &to->pendq, wprio, plink);
+		thread->wchan = to;
+		/*
+		 * Like for the lock acquisition following a regular
+		 * wakeup, wait for the ownership indefinitely.
+		 */
+		xntimer_stop(&thread->rtimer);
+		nrequeued++;
+	}
+
+	/* Force the owner through the slow release path. */
+	lockp = xnsynch_fastlock(to);
+	atomic_set(lockp, xnsynch_fast_claimed(atomic_read(lockp)));
+
+	if ((to->status & XNSYNCH_PI) == 0)
+		goto out;
+
+	top = list_first_entry(&to->pendq, struct xnthread, plink);
+	if (top->wprio <= owner->wprio)
+		goto out;
+
+	raise_boost_flag(owner);
+
+	if (to->status & XNSYNCH_CLAIMED)
+		list_del(&to->next); /* owner->boosters */
+	else
+		to->status |= XNSYNCH_CLAIMED;
+
+	to->wprio = top->wprio;
+	list_add_priff(to, &owner->boosters, wprio, next);
+	adjust_boost(owner, top);
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	return nrequeued;
+}
+EXPORT_SYMBOL_GPL(xnsynch_requeue_sleepers);
+
+/**
+ * @fn bool xnsynch_acquire_requeued(struct xnsynch *synch);
+ * @brief Complete the acquisition of a lock after a requeue.
+ *
+ * This service should be called by a thread resuming from a sleep it
+ * may have been moved out of by xnsynch_requeue_sleepers(), for
+ * finding out whether it was passed the ownership of @a synch in the
+ * meantime. If not, the caller has to acquire @a synch the regular
+ * way, e.g. because the ownership was stolen by a higher priority
+ * thread before it could resume.
+ *
+ * @param synch The descriptor address of the synchronization object
+ * the caller may have been requeued to.
+ *
+ * @return True if the current thread owns @a synch.
+ *
+ * @coretags{primary-only}
+ */
+bool xnsynch_acquire_requeued(struct xnsynch *synch)
+{
+	struct xnthread *curr = xnthread_current();
+	bool ret = false;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!xnthread_test_info(curr, XNWAKEN) || curr->wwake != synch)
+		goto out;
+
+	curr->wwake = NULL;
+	xnthread_clear_info(curr, XNWAKEN);
+
+	if (xnthread_test_info(curr, XNROBBED))
+		goto out;
+
+	xnthread_get_resource(curr);
+	ret = true;
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(xnsynch_acquire_requeued);
+
 /**
  * @fn struct xnthread *xnsynch_peek_pendq(struct xnsynch *synch);
  * @brief Access the thread leading a synch object wait queue.
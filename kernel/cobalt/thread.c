@@ -192,6 +192,9 @@ int __xnthread_init(struct xnthread *thread,
 	thread->res_count = 0;
 	thread->handle = XN_NO_HANDLE;
 	memset(&thread->stat, 0, sizeof(thread->stat));
+#ifdef CONFIG_XENO_OPT_SCHED_TRACE
+	thread->wakeup_date = 0;
+#endif
 	thread->selector = NULL;
 	INIT_LIST_HEAD(&thread->glink);
 	INIT_LIST_HEAD(&thread->boosters);
@@ -1166,6 +1169,8 @@ recheck_state:
 		goto unlock_and_exit;
 
 clear_wchan:
+	xnsched_trace_wakeup(thread);
+
 	if ((mask & ~XNDELAY) != 0 && thread->wchan != NULL)
 		/*
 		 * If the thread was actually suspended, clear the
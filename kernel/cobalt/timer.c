@@ -951,12 +951,15 @@ void xntimer_release_hardware(void)
 }
 EXPORT_SYMBOL_GPL(xntimer_release_hardware);
 
-#if defined(CONFIG_XENO_OPT_TIMER_RBTREE)
+#if defined(CONFIG_XENO_OPT_TIMER_RBTREE) || defined(CONFIG_XENO_OPT_TIMER_WHEEL)
 static inline bool xntimerh_is_lt(xntimerh_t *left, xntimerh_t *right)
 {
 	return left->date < right->date
 		|| (left->date == right->date && left->prio > right->prio);
 }
+#endif
+
+#if defined(CONFIG_XENO_OPT_TIMER_RBTREE)
 
 void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
 {
@@ -981,6 +984,191 @@ void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
 	rb_link_node(&holder->link, parent, new);
 	rb_insert_color(&holder->link, &q->root);
 }
+EXPORT_SYMBOL_GPL(xntimerq_insert);
+
+#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
+
+#define wheel_slot_of(__date) \
+	((int)(((__date) >> XNTIMER_WHEEL_SHIFT) & (XNTIMER_WHEEL_SLOTS - 1)))
+
+#define wheel_align(__date) \
+	((__date) & ~(((xnticks_t)1 << XNTIMER_WHEEL_SHIFT) - 1))
+
+void xntimerq_init(xntimerq_t *q)
+{
+	int n;
+
+	q->base = 0;
+	q->head = NULL;
+	q->overflow = RB_ROOT;
+	bitmap_zero(q->map, XNTIMER_WHEEL_SLOTS);
+
+	for (n = 0; n < XNTIMER_WHEEL_SLOTS; n++)
+		INIT_LIST_HEAD(q->slots + n);
+}
+EXPORT_SYMBOL_GPL(xntimerq_init);
+
+static void wheel_queue(xntimerq_t *q, xntimerh_t *holder)
+{
+	struct list_head *head;
+	xntimerh_t *p;
+	int slot;
+
+	/*
+	 * Late timers are queued to the base slot, ahead of the
+	 * others since slots are sorted by date.
+	 */
+	if (holder->date < q->base)
+		slot = wheel_slot_of(q->base);
+	else
+		slot = wheel_slot_of(holder->date);
+
+	holder->slot = slot;
+	head = q->slots + slot;
+	__set_bit(slot, q->map);
+
+	/*
+	 * Slots are usually short, and timers are mostly queued in
+	 * increasing date order: scan backwards.
+	 */
+	list_for_each_entry_reverse(p, head, link) {
+		if (!xntimerh_is_lt(holder, p))
+			break;
+	}
+
+	list_add(&holder->link, &p->link);
+}
+
+static void overflow_queue(xntimerq_t *q, xntimerh_t *holder)
+{
+	struct rb_node **new = &q->overflow.rb_node, *parent = NULL;
+	xntimerh_t *i;
+
+	holder->slot = -1;
+
+	while (*new) {
+		i = container_of(*new, xntimerh_t, node);
+		parent = *new;
+		if (xntimerh_is_lt(holder, i))
+			new = &((*new)->rb_left);
+		else
+			new = &((*new)->rb_right);
+	}
+
+	rb_link_node(&holder->node, parent, new);
+	rb_insert_color(&holder->node, &q->overflow);
+}
+
+static xntimerh_t *wheel_first(xntimerq_t *q, int from, int to)
+{
+	int slot;
+
+	slot = find_next_bit(q->map, to, from);
+	if (slot >= to)
+		return NULL;
+
+	return list_first_entry(q->slots + slot, xntimerh_t, link);
+}
+
+static void wheel_advance(xntimerq_t *q)
+{
+	xntimerh_t *h = q->head;
+	struct rb_node *node;
+	xnticks_t base;
+
+	/*
+	 * Move the wheel base to the slot of the heading timer, then
+	 * pull the overflowing timers which now fall within the
+	 * window. Each timer is pulled at most once after it has been
+	 * queued, so this is amortized over insertions.
+	 */
+	base = wheel_align(h->date);
+	if (base <= q->base)
+		return;
+
+	q->base = base;
+
+	while ((node = rb_first(&q->overflow)) != NULL) {
+		h = container_of(node, xntimerh_t, node);
+		if (h->date >= q->base + XNTIMER_WHEEL_SPAN)
+			break;
+		rb_erase(node, &q->overflow);
+		wheel_queue(q, h);
+	}
+}
+
+xntimerh_t *xntimerq_next(xntimerq_t *q, xntimerh_t *h)
+{
+	int base_slot, slot = h->slot;
+	struct rb_node *node;
+	xntimerh_t *next;
+
+	if (slot < 0) {
+		node = rb_next(&h->node);
+		return node ? container_of(node, xntimerh_t, node) : NULL;
+	}
+
+	if (!list_is_last(&h->link, q->slots + slot))
+		return list_entry(h->link.next, xntimerh_t, link);
+
+	/*
+	 * Scan the busy slots following the current one, wrapping
+	 * around the wheel until the base slot is reached.
+	 */
+	base_slot = wheel_slot_of(q->base);
+	if (slot >= base_slot) {
+		next = wheel_first(q, slot + 1, XNTIMER_WHEEL_SLOTS);
+		if (next == NULL)
+			next = wheel_first(q, 0, base_slot);
+	} else
+		next = wheel_first(q, slot + 1, base_slot);
+
+	if (next)
+		return next;
+
+	node = rb_first(&q->overflow);
+
+	return node ? container_of(node, xntimerh_t, node) : NULL;
+}
+EXPORT_SYMBOL_GPL(xntimerq_next);
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
+{
+	/* Restart from the current date if the queue was drained. */
+	if (q->head == NULL)
+		q->base = wheel_align(holder->date);
+
+	if (holder->date < q->base + XNTIMER_WHEEL_SPAN)
+		wheel_queue(q, holder);
+	else
+		overflow_queue(q, holder);
+
+	if (q->head == NULL || xntimerh_is_lt(holder, q->head)) {
+		q->head = holder;
+		wheel_advance(q);
+	}
+}
+EXPORT_SYMBOL_GPL(xntimerq_insert);
+
+void xntimerq_remove(xntimerq_t *q, xntimerh_t *holder)
+{
+	bool heading = holder == q->head;
+
+	if (heading)
+		q->head = xntimerq_next(q, holder);
+
+	if (holder->slot >= 0) {
+		list_del(&holder->link);
+		if (list_empty(q->slots + holder->slot))
+			__clear_bit(holder->slot, q->map);
+	} else
+		rb_erase(&holder->node, &q->overflow);
+
+	if (heading && q->head)
+		wheel_advance(q);
+}
+EXPORT_SYMBOL_GPL(xntimerq_remove);
+
 #endif
 
 /** @} */
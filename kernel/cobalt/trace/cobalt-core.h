@@ -668,6 +668,23 @@ DEFINE_EVENT(synch_post_event, cobalt_synch_forget,
 	TP_ARGS(synch)
 );
 
+TRACE_EVENT(cobalt_synch_requeue,
+	TP_PROTO(struct xnsynch *from, struct xnsynch *to),
+	TP_ARGS(from, to),
+
+	TP_STRUCT__entry(
+		__field(struct xnsynch *, from)
+		__field(struct xnsynch *, to)
+	),
+
+	TP_fast_assign(
+		__entry->from = from;
+		__entry->to = to;
+	),
+
+	TP_printk("from=%p to=%p", __entry->from, __entry->to)
+);
+
 #endif /* _TRACE_COBALT_CORE_H */
 
 /* This part must be outside protection */
@@ -43,6 +43,16 @@
  * for reception at the same time using Bind */
 #define RTCAN_MAX_RECEIVERS  CONFIG_XENO_DRIVERS_CAN_MAX_RECEIVERS
 
+/* Number of hash buckets for filters matching on all standard ID bits */
+#define RTCAN_RECV_HASH_SIZE 64
+#define RTCAN_RECV_HASH_MASK (RTCAN_RECV_HASH_SIZE - 1)
+
+static inline unsigned int rtcan_recv_hash(uint32_t can_id)
+{
+    can_id &= CAN_SFF_MASK;
+    return (can_id ^ (can_id >> 6)) & RTCAN_RECV_HASH_MASK;
+}
+
 /* Suppress handling of refcount if module support is not enabled
  * or modules cannot be unloaded */
 
@@ -149,6 +159,12 @@ struct rtcan_device {
      * locality all list elements are kept in this array. */
     struct rtcan_recv               receivers[RTCAN_MAX_RECEIVERS];
 
+    /* Reception index, rebuilt from the reception list on each change.
+     * Non-inverted filters covering all standard ID bits are hashed by
+     * those bits, all others are kept on the masked list. */
+    struct rtcan_recv               *recv_hash[RTCAN_RECV_HASH_SIZE];
+    struct rtcan_recv               *recv_masked;
+
     /* Indicates the length of the empty list */
     int                             free_entries;
 
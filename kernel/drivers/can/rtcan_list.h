@@ -43,6 +43,9 @@ struct rtcan_recv {
 					     */
     struct rtcan_recv       *next;          /* pointer to next list element
 					     */
+    struct rtcan_recv       *index_next;    /* pointer to next element in
+					     *   the same hash bucket or in
+					     *   the masked filter list */
 };
 
 
@@ -68,6 +68,34 @@ static inline void rtcan_raw_mount_filter(can_filter_t *recv_filter,
 }
 
 
+static inline int rtcan_raw_filter_hashable(can_filter_t *filter)
+{
+    return !(filter->can_mask & CAN_INV_FILTER) &&
+	(filter->can_mask & CAN_SFF_MASK) == CAN_SFF_MASK;
+}
+
+
+/* Rebuild the reception index of a device from its reception list */
+static void rtcan_raw_index_filters(struct rtcan_device *dev)
+{
+    struct rtcan_recv *r, **head;
+    int i;
+
+    for (i = 0; i < RTCAN_RECV_HASH_SIZE; i++)
+	dev->recv_hash[i] = NULL;
+    dev->recv_masked = NULL;
+
+    for (r = dev->recv_list; r != NULL; r = r->next) {
+	if (rtcan_raw_filter_hashable(&r->can_filter))
+	    head = &dev->recv_hash[rtcan_recv_hash(r->can_filter.can_id)];
+	else
+	    head = &dev->recv_masked;
+	r->index_next = *head;
+	*head = r;
+    }
+}
+
+
 int rtcan_raw_check_filter(struct rtcan_socket *sock, int ifindex,
 			   struct rtcan_filter_list *flist)
 {
@@ -191,6 +219,7 @@ int rtcan_raw_add_filter(struct rtcan_socket *sock, int ifindex)
 	/* Adjust rececption list pointer */
 	dev->recv_list = first;
 
+	rtcan_raw_index_filters(dev);
 	rtcan_raw_print_filter(dev);
 	rtcan_dev_dereference(dev);
     }
@@ -250,6 +279,7 @@ void rtcan_raw_remove_filter(struct rtcan_socket *sock)
 	/* Increase free entries counter by length of old filter list */
 	dev->free_entries += sock->flistlen;
 
+	rtcan_raw_index_filters(dev);
 	rtcan_raw_print_filter(dev);
 	rtcan_dev_dereference(dev);
     }
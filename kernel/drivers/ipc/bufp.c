@@ -52,6 +52,9 @@ struct bufp_socket {
 	nanosecs_rel_t rx_timeout;
 	nanosecs_rel_t tx_timeout;
 
+	struct rtipc_ring_setup ringcf;	/* Requested ring geometry */
+	struct rtipc_ring ring;
+
 	struct rtipc_private *priv;
 };
 
@@ -122,6 +125,8 @@ static int bufp_socket(struct rtdm_fd *fd)
 	sk->rx_timeout = RTDM_TIMEOUT_INFINITE;
 	sk->tx_timeout = RTDM_TIMEOUT_INFINITE;
 	*sk->label = 0;
+	memset(&sk->ringcf, 0, sizeof(sk->ringcf));
+	sk->ring.hdr = NULL;
 	rtdm_event_init(&sk->i_event, 0);
 	rtdm_event_init(&sk->o_event, 0);
 	sk->priv = priv;
@@ -137,6 +142,7 @@ static void bufp_close(struct rtdm_fd *fd)
 
 	rtdm_event_destroy(&sk->i_event);
 	rtdm_event_destroy(&sk->o_event);
+	rtipc_ring_destroy(&sk->ring);
 
 	if (test_bit(_BUFP_BOUND, &sk->status)) {
 		if (sk->name.sipc_port > -1) {
@@ -155,6 +161,250 @@ static void bufp_close(struct rtdm_fd *fd)
 	kfree(sk);
 }
 
+static void __bufp_ring_kick(struct bufp_socket *sk)
+{
+	rtdm_lockctx_t s;
+
+	cobalt_atomic_enter(s);
+	xnselect_signal(&sk->priv->recv_block, POLLIN);
+	cobalt_atomic_leave(s);
+
+	rtdm_waitqueue_broadcast(&sk->ring.rxwait);
+}
+
+static void __bufp_ring_release(struct bufp_socket *sk)
+{
+	rtdm_lockctx_t s;
+
+	cobalt_atomic_enter(s);
+	xnselect_signal(&sk->priv->send_block, POLLOUT);
+	cobalt_atomic_leave(s);
+
+	rtdm_waitqueue_broadcast(&sk->ring.txwait);
+}
+
+/* Copy @len bytes from @src to the vector, advancing the latter. */
+static int __bufp_ring_copy_out(struct rtdm_fd *fd,
+				struct iovec *iov, int iovlen,
+				const void *src, size_t len)
+{
+	struct xnbufd bufd;
+	size_t vlen;
+	int nvec, ret;
+
+	for (nvec = 0; nvec < iovlen && len > 0; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = len >= iov[nvec].iov_len ? iov[nvec].iov_len : len;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, (void *)src, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, (void *)src, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			return ret;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		src += vlen;
+		len -= vlen;
+	}
+
+	return 0;
+}
+
+/* Copy @len bytes from the vector to @dst, advancing the former. */
+static int __bufp_ring_copy_in(struct rtdm_fd *fd,
+			       struct iovec *iov, int iovlen,
+			       void *dst, size_t len)
+{
+	struct xnbufd bufd;
+	size_t vlen;
+	int nvec, ret;
+
+	for (nvec = 0; nvec < iovlen && len > 0; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = len >= iov[nvec].iov_len ? iov[nvec].iov_len : len;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(dst, &bufd, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(dst, &bufd, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			return ret;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		dst += vlen;
+		len -= vlen;
+	}
+
+	return 0;
+}
+
+/*
+ * Ring mode receive: pull as many bytes as available up to the
+ * vector length, waiting only for the first one.
+ */
+static ssize_t __bufp_ring_recv(struct rtdm_fd *fd, struct bufp_socket *sk,
+				struct iovec *iov, int iovlen, int flags)
+{
+	struct rtipc_ring *ring = &sk->ring;
+	struct rtipc_ring_slot *slot;
+	ssize_t maxlen, rdlen = 0;
+	rtdm_toseq_t timeout_seq;
+	size_t len, slotlen;
+	rtdm_lockctx_t s;
+	int ret = 0;
+
+	maxlen = rtdm_get_iov_flatlen(iov, iovlen);
+
+	/*
+	 * Zero-length receive: a consumer working on its mapping
+	 * released slots, let the writers know.
+	 */
+	if (maxlen == 0) {
+		__bufp_ring_release(sk);
+		return 0;
+	}
+
+	ret = rtdm_mutex_lock(&ring->rlock);
+	if (ret)
+		return ret;
+
+	rtdm_toseq_init(&timeout_seq, sk->rx_timeout);
+
+	while (rdlen < maxlen) {
+		slot = rtipc_ring_get_rslot(ring);
+		if (slot == NULL) {
+			if (rdlen > 0)
+				break;
+			if (flags & MSG_DONTWAIT) {
+				ret = -EWOULDBLOCK;
+				break;
+			}
+			ret = rtdm_timedwait_condition(&ring->rxwait,
+						       !rtipc_ring_empty(ring),
+						       sk->rx_timeout,
+						       &timeout_seq);
+			if (unlikely(ret == -EIDRM))
+				ret = -ECONNRESET;
+			if (ret)
+				break;
+			continue;
+		}
+
+		slotlen = rtipc_ring_slot_len(ring, slot);
+		len = ring->rdoff < slotlen ? slotlen - ring->rdoff : 0;
+		if (len > maxlen - rdlen)
+			len = maxlen - rdlen;
+
+		ret = __bufp_ring_copy_out(fd, iov, iovlen,
+					   slot->data + ring->rdoff, len);
+		if (ret)
+			break;
+
+		rdlen += len;
+		ring->rdoff += len;
+		if (ring->rdoff < slotlen)
+			break;	/* Keep the rest for the next call. */
+
+		if (rtipc_ring_consume(ring)) /* -> writable */
+			__bufp_ring_release(sk);
+	}
+
+	cobalt_atomic_enter(s);
+	if (rtipc_ring_empty(ring)) /* -> non-readable */
+		xnselect_signal(&sk->priv->recv_block, 0);
+	cobalt_atomic_leave(s);
+
+	rtdm_mutex_unlock(&ring->rlock);
+
+	return rdlen ?: ret;
+}
+
+/*
+ * Ring mode send: split the data into slot-sized chunks, waiting
+ * for free slots unless MSG_DONTWAIT is given, in which case a
+ * short count may be returned. Writers are serialized, so that the
+ * chunks of different messages never interleave.
+ */
+static ssize_t __bufp_ring_send(struct rtdm_fd *fd,
+				struct bufp_socket *sk,
+				struct bufp_socket *rsk,
+				struct iovec *iov, int iovlen, int flags,
+				ssize_t len)
+{
+	struct rtipc_ring *ring = &rsk->ring;
+	struct rtipc_ring_slot *slot;
+	rtdm_toseq_t timeout_seq;
+	rtdm_lockctx_t s;
+	ssize_t wrlen = 0;
+	size_t n;
+	int ret;
+
+	/* Zero-length send: kick the consumer after direct fills. */
+	if (len == 0) {
+		if (!rtipc_ring_empty(ring))
+			__bufp_ring_kick(rsk);
+		return 0;
+	}
+
+	ret = rtdm_mutex_lock(&ring->wlock);
+	if (ret)
+		return ret;
+
+	rtdm_toseq_init(&timeout_seq, sk->tx_timeout);
+
+	while (wrlen < len) {
+		slot = rtipc_ring_get_wslot(ring);
+		if (slot == NULL) {
+			cobalt_atomic_enter(s);
+			if (rtipc_ring_full(ring)) /* -> non-writable */
+				xnselect_signal(&rsk->priv->send_block, 0);
+			cobalt_atomic_leave(s);
+			if (flags & MSG_DONTWAIT) {
+				ret = -EWOULDBLOCK;
+				break;
+			}
+			ret = rtdm_timedwait_condition(&ring->txwait,
+						       !rtipc_ring_full(ring),
+						       sk->tx_timeout,
+						       &timeout_seq);
+			if (unlikely(ret == -EIDRM))
+				ret = -ECONNRESET;
+			if (ret)
+				break;
+			continue;
+		}
+
+		n = len - wrlen;
+		if (n > ring->slot_size)
+			n = ring->slot_size;
+
+		ret = __bufp_ring_copy_in(fd, iov, iovlen, slot->data, n);
+		if (ret)
+			break;
+
+		slot->len = n;
+		slot->from = sk->name.sipc_port;
+		wrlen += n;
+		if (rtipc_ring_produce(ring)) /* -> readable */
+			__bufp_ring_kick(rsk);
+	}
+
+	rtdm_mutex_unlock(&ring->wlock);
+
+	return wrlen ?: ret;
+}
+
 static ssize_t __bufp_readbuf(struct bufp_socket *sk,
 			      struct xnbufd *bufd,
 			      int flags)
@@ -307,6 +557,13 @@ static ssize_t __bufp_recvmsg(struct rtdm_fd *fd,
 	if (!test_bit(_BUFP_BOUND, &sk->status))
 		return -EAGAIN;
 
+	if (sk->ring.hdr) {
+		ret = __bufp_ring_recv(fd, sk, iov, iovlen, flags);
+		if (ret >= 0 && saddr)
+			*saddr = sk->name;
+		return ret;
+	}
+
 	len = rtdm_get_iov_flatlen(iov, iovlen);
 	if (len == 0)
 		return 0;
@@ -545,8 +802,6 @@ static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
 	int nvec;
 
 	len = rtdm_get_iov_flatlen(iov, iovlen);
-	if (len == 0)
-		return 0;
 
 	cobalt_atomic_enter(s);
 	rfd = xnmap_fetch_nocheck(portmap, daddr->sipc_port);
@@ -562,6 +817,17 @@ static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
 		return -ECONNREFUSED;
 	}
 
+	if (rsk->ring.hdr) {
+		ret = __bufp_ring_send(fd, sk, rsk, iov, iovlen, flags, len);
+		rtdm_fd_unlock(rfd);
+		return ret;
+	}
+
+	if (len == 0) {
+		rtdm_fd_unlock(rfd);
+		return 0;
+	}
+
 	/*
 	 * We may only send complete messages, so there is no point in
 	 * accepting messages which are larger than what the buffer
@@ -702,17 +968,24 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 
 	sa->sipc_port = port;
 
-	/*
-	 * The caller must have told us how much memory is needed for
-	 * buffer space via setsockopt(), before we got there.
-	 */
-	if (sk->bufsz == 0)
-		return -ENOBUFS;
+	if (sk->ringcf.nr_slots > 0) {
+		ret = rtipc_ring_init(&sk->ring, &sk->ringcf);
+		if (ret)
+			goto fail;
+	} else {
+		/*
+		 * The caller must have told us how much memory is
+		 * needed for buffer space via setsockopt(), before we
+		 * got there.
+		 */
+		if (sk->bufsz == 0)
+			return -ENOBUFS;
 
-	sk->bufmem = xnheap_vmalloc(sk->bufsz);
-	if (sk->bufmem == NULL) {
-		ret = -ENOMEM;
-		goto fail;
+		sk->bufmem = xnheap_vmalloc(sk->bufsz);
+		if (sk->bufmem == NULL) {
+			ret = -ENOMEM;
+			goto fail;
+		}
 	}
 
 	sk->name = *sa;
@@ -724,7 +997,11 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 		ret = xnregistry_enter(sk->label, sk,
 				       &sk->handle, &__bufp_pnode.node);
 		if (ret) {
-			xnheap_vfree(sk->bufmem);
+			if (sk->bufmem) {
+				xnheap_vfree(sk->bufmem);
+				sk->bufmem = NULL;
+			}
+			rtipc_ring_destroy(&sk->ring);
 			goto fail;
 		}
 	}
@@ -826,6 +1103,7 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 {
 	struct _rtdm_setsockopt_args sopt;
 	struct rtipc_port_label plabel;
+	struct rtipc_ring_setup ringcf;
 	struct timeval tv;
 	rtdm_lockctx_t s;
 	size_t len;
@@ -902,6 +1180,23 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case BUFP_RING:
+		if (sopt.optlen != sizeof(ringcf))
+			return -EINVAL;
+		if (rtipc_get_arg(fd, &ringcf, sopt.optval, sizeof(ringcf)))
+			return -EFAULT;
+		ret = rtipc_ring_check_setup(&ringcf);
+		if (ret)
+			return ret;
+		cobalt_atomic_enter(s);
+		if (test_bit(_BUFP_BOUND, &sk->status) ||
+		    test_bit(_BUFP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else
+			sk->ringcf = ringcf;
+		cobalt_atomic_leave(s);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -1054,8 +1349,13 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd) /* atomic */
 	unsigned int mask = 0;
 	struct rtdm_fd *rfd;
 
-	if (test_bit(_BUFP_BOUND, &sk->status) && sk->fillsz > 0)
-		mask |= POLLIN;
+	if (test_bit(_BUFP_BOUND, &sk->status)) {
+		if (sk->ring.hdr) {
+			if (!rtipc_ring_empty(&sk->ring))
+				mask |= POLLIN;
+		} else if (sk->fillsz > 0)
+			mask |= POLLIN;
+	}
 
 	/*
 	 * If the socket is connected, POLLOUT means that the peer
@@ -1067,7 +1367,10 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd) /* atomic */
 		rfd = xnmap_fetch_nocheck(portmap, sk->peer.sipc_port);
 		if (rfd) {
 			rsk = rtipc_fd_to_state(rfd);
-			if (rsk->fillsz < rsk->bufsz)
+			if (rsk->ring.hdr) {
+				if (!rtipc_ring_full(&rsk->ring))
+					mask |= POLLOUT;
+			} else if (rsk->fillsz < rsk->bufsz)
 				mask |= POLLOUT;
 		}
 	} else
@@ -1076,6 +1379,40 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd) /* atomic */
 	return mask;
 }
 
+static int bufp_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct bufp_socket *sk = priv->state, *rsk;
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+	int ret;
+
+	/* Our own ring as a consumer, or the peer's as a producer. */
+	if (test_bit(_BUFP_BOUND, &sk->status) && sk->ring.hdr)
+		return rtipc_ring_mmap(&sk->ring, vma);
+
+	if (!test_bit(_BUFP_CONNECTED, &sk->status))
+		return -ENXIO;
+
+	cobalt_atomic_enter(s);
+	rfd = xnmap_fetch_nocheck(portmap, sk->peer.sipc_port);
+	if (rfd && rtdm_fd_lock(rfd) < 0)
+		rfd = NULL;
+	cobalt_atomic_leave(s);
+	if (rfd == NULL)
+		return -ECONNRESET;
+
+	rsk = rtipc_fd_to_state(rfd);
+	if (test_bit(_BUFP_BOUND, &rsk->status) && rsk->ring.hdr)
+		ret = rtipc_ring_mmap(&rsk->ring, vma);
+	else
+		ret = -ENXIO;
+
+	rtdm_fd_unlock(rfd);
+
+	return ret;
+}
+
 static int bufp_init(void)
 {
 	portmap = xnmap_create(CONFIG_XENO_OPT_BUFP_NRPORT, 0, 0);
@@ -1104,5 +1441,6 @@ struct rtipc_protocol bufp_proto_driver = {
 		.write = bufp_write,
 		.ioctl = bufp_ioctl,
 		.pollstate = bufp_pollstate,
+		.mmap = bufp_mmap,
 	}
 };
@@ -33,11 +33,44 @@
 struct iddp_message {
 	struct list_head next;
 	int from;
+	int pclass;		/* Size class, -1 if heap-allocated */
 	size_t rdoff;
 	size_t len;
 	char data[];
 };
 
+/*
+ * Size-class pool: each class owns a fixed set of buffers of the same
+ * size, linked into a free list. A request is served by the smallest
+ * class it fits in, or by the next larger class which still has a
+ * free buffer, in bounded time.
+ */
+struct iddp_free_buffer {
+	struct iddp_free_buffer *next;
+};
+
+struct iddp_pool_class {
+	size_t size;		/* Largest payload */
+	size_t stride;
+	unsigned int count;
+	unsigned int free;
+	unsigned int lowat;
+	unsigned long allocs;
+	unsigned long fallbacks;
+	unsigned long misses;
+	struct iddp_free_buffer *freelist;
+};
+
+struct iddp_slab {
+	void *mem;
+	rtdm_lock_t lock;
+	int nr_classes;
+	struct iddp_pool_class classes[RTIPC_POOL_MAXCLASSES];
+};
+
+#define IDDP_SLAB_STRIDE(__size)	\
+	ALIGN(sizeof(struct iddp_message) + (__size), L1_CACHE_BYTES)
+
 struct iddp_socket {
 	int magic;
 	struct sockaddr_ipc name;
@@ -47,6 +80,8 @@ struct iddp_socket {
 	rtdm_waitqueue_t *poolwaitq;
 	rtdm_waitqueue_t privwaitq;
 	size_t poolsz;
+	struct rtipc_pool_setup poolcf;	/* Requested size classes */
+	struct iddp_slab slab;
 	rtdm_sem_t insem;
 	struct list_head inq;
 	u_long status;
@@ -55,6 +90,8 @@ struct iddp_socket {
 	nanosecs_rel_t rx_timeout;
 	nanosecs_rel_t tx_timeout;
 	unsigned long stalls;	/* Buffer stall counter. */
+	struct rtipc_ring_setup ringcf;	/* Requested ring geometry */
+	struct rtipc_ring ring;
 	struct rtipc_private *priv;
 };
 
@@ -108,6 +145,164 @@ static inline void __iddp_init_mbuf(struct iddp_message *mbuf, size_t len)
 	INIT_LIST_HEAD(&mbuf->next);
 }
 
+static int __iddp_check_poolcf(const struct rtipc_pool_setup *cf,
+			       size_t *poolsz_r)
+{
+	u32 size, prev = 0;
+	u64 poolsz = 0;
+	int n;
+
+	if (cf->nr_classes == 0 || cf->nr_classes > RTIPC_POOL_MAXCLASSES)
+		return -EINVAL;
+
+	for (n = 0; n < cf->nr_classes; n++) {
+		size = cf->classes[n].size;
+		if (size <= prev || size > INT_MAX ||
+		    cf->classes[n].count == 0)
+			return -EINVAL;
+		poolsz += (u64)IDDP_SLAB_STRIDE(size) * cf->classes[n].count;
+		if (poolsz > INT_MAX)
+			return -EINVAL;
+		prev = size;
+	}
+
+	*poolsz_r = poolsz;
+
+	return 0;
+}
+
+static int __iddp_init_slab(struct iddp_socket *sk, size_t poolsz)
+{
+	const struct rtipc_pool_setup *cf = &sk->poolcf;
+	struct iddp_slab *slab = &sk->slab;
+	struct iddp_free_buffer *b;
+	struct iddp_pool_class *pc;
+	unsigned int i;
+	void *mem;
+	int n;
+
+	mem = xnheap_vmalloc(poolsz);
+	if (mem == NULL)
+		return -ENOMEM;
+
+	rtdm_lock_init(&slab->lock);
+	slab->nr_classes = cf->nr_classes;
+
+	for (n = 0; n < cf->nr_classes; n++) {
+		pc = slab->classes + n;
+		pc->size = cf->classes[n].size;
+		pc->stride = IDDP_SLAB_STRIDE(pc->size);
+		pc->count = cf->classes[n].count;
+		pc->free = pc->count;
+		pc->lowat = pc->count;
+		pc->allocs = pc->fallbacks = pc->misses = 0;
+		pc->freelist = NULL;
+		for (i = 0; i < pc->count; i++, mem += pc->stride) {
+			b = mem;
+			b->next = pc->freelist;
+			pc->freelist = b;
+		}
+	}
+
+	slab->mem = mem - poolsz;
+
+	return 0;
+}
+
+static void __iddp_destroy_slab(struct iddp_socket *sk)
+{
+	xnheap_vfree(sk->slab.mem);
+	sk->slab.mem = NULL;
+}
+
+static struct iddp_message *
+__iddp_slab_alloc(struct iddp_slab *slab, size_t len, int *pret)
+{
+	struct iddp_pool_class *pc, *best = NULL;
+	struct iddp_message *mbuf = NULL;
+	struct iddp_free_buffer *b;
+	rtdm_lockctx_t s;
+	int n;
+
+	*pret = 0;
+
+	rtdm_lock_get_irqsave(&slab->lock, s);
+
+	for (n = 0; n < slab->nr_classes; n++) {
+		pc = slab->classes + n;
+		if (pc->size < len)
+			continue;
+		if (best == NULL)
+			best = pc;
+		b = pc->freelist;
+		if (b == NULL)
+			continue;
+		pc->freelist = b->next;
+		if (--pc->free < pc->lowat)
+			pc->lowat = pc->free;
+		pc->allocs++;
+		if (pc != best)
+			best->fallbacks++;
+		mbuf = (struct iddp_message *)b;
+		mbuf->pclass = n;
+		break;
+	}
+
+	if (best == NULL)
+		*pret = -EMSGSIZE;
+	else if (mbuf == NULL)
+		best->misses++;
+
+	rtdm_lock_put_irqrestore(&slab->lock, s);
+
+	return mbuf;
+}
+
+static void __iddp_slab_free(struct iddp_slab *slab,
+			     struct iddp_message *mbuf)
+{
+	struct iddp_pool_class *pc = slab->classes + mbuf->pclass;
+	struct iddp_free_buffer *b = (struct iddp_free_buffer *)mbuf;
+	rtdm_lockctx_t s;
+
+	rtdm_lock_get_irqsave(&slab->lock, s);
+	b->next = pc->freelist;
+	pc->freelist = b;
+	pc->free++;
+	rtdm_lock_put_irqrestore(&slab->lock, s);
+}
+
+static void __iddp_slab_stat(struct iddp_slab *slab,
+			     struct rtipc_pool_stat *stat)
+{
+	struct rtipc_pool_class_stat *cs;
+	struct iddp_pool_class *pc;
+	rtdm_lockctx_t s;
+	int n;
+
+	memset(stat, 0, sizeof(*stat));
+
+	if (slab->mem == NULL)
+		return;
+
+	rtdm_lock_get_irqsave(&slab->lock, s);
+
+	stat->nr_classes = slab->nr_classes;
+	for (n = 0; n < slab->nr_classes; n++) {
+		pc = slab->classes + n;
+		cs = stat->classes + n;
+		cs->size = pc->size;
+		cs->count = pc->count;
+		cs->free = pc->free;
+		cs->lowat = pc->lowat;
+		cs->allocs = pc->allocs;
+		cs->fallbacks = pc->fallbacks;
+		cs->misses = pc->misses;
+	}
+
+	rtdm_lock_put_irqrestore(&slab->lock, s);
+}
+
 static struct iddp_message *
 __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 		  nanosecs_rel_t timeout, int flags, int *pret)
@@ -120,7 +315,15 @@ __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 	rtdm_toseq_init(&timeout_seq, timeout);
 
 	for (;;) {
-		mbuf = xnheap_alloc(sk->bufpool, len + sizeof(*mbuf));
+		if (sk->slab.mem) {
+			mbuf = __iddp_slab_alloc(&sk->slab, len, &ret);
+			if (ret)
+				break;
+		} else {
+			mbuf = xnheap_alloc(sk->bufpool, len + sizeof(*mbuf));
+			if (mbuf)
+				mbuf->pclass = -1;
+		}
 		if (mbuf) {
 			__iddp_init_mbuf(mbuf, len);
 			break;
@@ -154,7 +357,10 @@ __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 static void __iddp_free_mbuf(struct iddp_socket *sk,
 			     struct iddp_message *mbuf)
 {
-	xnheap_free(sk->bufpool, mbuf);
+	if (mbuf->pclass >= 0)
+		__iddp_slab_free(&sk->slab, mbuf);
+	else
+		xnheap_free(sk->bufpool, mbuf);
 	rtdm_waitqueue_broadcast(sk->poolwaitq);
 }
 
@@ -169,11 +375,15 @@ static int iddp_socket(struct rtdm_fd *fd)
 	sk->bufpool = &cobalt_heap;
 	sk->poolwaitq = &poolwaitq;
 	sk->poolsz = 0;
+	sk->poolcf.nr_classes = 0;
+	sk->slab.mem = NULL;
 	sk->status = 0;
 	sk->handle = 0;
 	sk->rx_timeout = RTDM_TIMEOUT_INFINITE;
 	sk->tx_timeout = RTDM_TIMEOUT_INFINITE;
 	sk->stalls = 0;
+	memset(&sk->ringcf, 0, sizeof(sk->ringcf));
+	sk->ring.hdr = NULL;
 	*sk->label = 0;
 	INIT_LIST_HEAD(&sk->inq);
 	rtdm_sem_init(&sk->insem, 0);
@@ -194,6 +404,7 @@ static void iddp_close(struct rtdm_fd *fd)
 
 	rtdm_sem_destroy(&sk->insem);
 	rtdm_waitqueue_destroy(&sk->privwaitq);
+	rtipc_ring_destroy(&sk->ring);
 
 	if (test_bit(_IDDP_BOUND, &sk->status)) {
 		if (sk->handle)
@@ -203,6 +414,12 @@ static void iddp_close(struct rtdm_fd *fd)
 			xnmap_remove(portmap, sk->name.sipc_port);
 			cobalt_atomic_leave(s);
 		}
+		if (sk->slab.mem) {
+			/* Unread datagrams live in the slab. */
+			__iddp_destroy_slab(sk);
+			kfree(sk);
+			return;
+		}
 		if (sk->bufpool != &cobalt_heap) {
 			poolmem = xnheap_get_membase(&sk->privpool);
 			poolsz = xnheap_get_size(&sk->privpool);
@@ -224,6 +441,115 @@ static void iddp_close(struct rtdm_fd *fd)
 	return;
 }
 
+static void __iddp_ring_kick(struct iddp_socket *sk)
+{
+	rtdm_lockctx_t s;
+
+	cobalt_atomic_enter(s);
+	xnselect_signal(&sk->priv->recv_block, POLLIN);
+	cobalt_atomic_leave(s);
+
+	rtdm_waitqueue_broadcast(&sk->ring.rxwait);
+}
+
+static ssize_t __iddp_ring_recv(struct rtdm_fd *fd, struct iddp_socket *sk,
+				struct iovec *iov, int iovlen, int flags,
+				struct sockaddr_ipc *saddr)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct rtipc_ring *ring = &sk->ring;
+	ssize_t maxlen, len, wrlen, vlen;
+	rtdm_toseq_t timeout_seq;
+	struct rtipc_ring_slot *slot;
+	struct xnbufd bufd;
+	rtdm_lockctx_t s;
+	size_t rdoff;
+	int nvec, ret;
+
+	maxlen = rtdm_get_iov_flatlen(iov, iovlen);
+
+	/*
+	 * Zero-length receive: a consumer working on its mapping
+	 * released slots, let the senders know, then wait for more
+	 * data.
+	 */
+	if (maxlen == 0)
+		rtdm_waitqueue_broadcast(&ring->txwait);
+
+	ret = rtdm_mutex_lock(&ring->rlock);
+	if (ret)
+		return ret;
+
+	if (flags & MSG_DONTWAIT) {
+		if (rtipc_ring_empty(ring))
+			ret = maxlen ? -EAGAIN : 0;
+	} else {
+		rtdm_toseq_init(&timeout_seq, sk->rx_timeout);
+		ret = rtdm_timedwait_condition(&ring->rxwait,
+					       !rtipc_ring_empty(ring),
+					       sk->rx_timeout, &timeout_seq);
+		if (unlikely(ret == -EIDRM))
+			ret = -ECONNRESET;
+	}
+
+	if (ret || maxlen == 0)
+		goto out;
+
+	slot = rtipc_ring_get_rslot(ring);
+	rdoff = ring->rdoff;
+	len = rtipc_ring_slot_len(ring, slot);
+	len = rdoff < len ? len - rdoff : 0;
+	if (len > maxlen)
+		len = maxlen;
+
+	if (saddr) {
+		saddr->sipc_family = AF_RTIPC;
+		saddr->sipc_port = ACCESS_ONCE(slot->from);
+	}
+
+	for (nvec = 0, wrlen = len; nvec < iovlen && wrlen > 0; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = wrlen >= iov[nvec].iov_len ? iov[nvec].iov_len : wrlen;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, slot->data + rdoff, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, slot->data + rdoff, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			goto out;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		wrlen -= vlen;
+		rdoff += vlen;
+	}
+
+	/* Slot is only partially read: keep it for the next call. */
+	if (rdoff < rtipc_ring_slot_len(ring, slot)) {
+		ring->rdoff = rdoff;
+		ret = len;
+		goto out;
+	}
+
+	if (rtipc_ring_consume(ring))
+		rtdm_waitqueue_broadcast(&ring->txwait);
+
+	ret = len;
+out:
+	cobalt_atomic_enter(s);
+	if (rtipc_ring_empty(ring)) /* -> non-readable */
+		xnselect_signal(&priv->recv_block, 0);
+	cobalt_atomic_leave(s);
+
+	rtdm_mutex_unlock(&ring->rlock);
+
+	return ret;
+}
+
 static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 			      struct iovec *iov, int iovlen, int flags,
 			      struct sockaddr_ipc *saddr)
@@ -241,6 +567,9 @@ static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 	if (!test_bit(_IDDP_BOUND, &sk->status))
 		return -EAGAIN;
 
+	if (sk->ring.hdr)
+		return __iddp_ring_recv(fd, sk, iov, iovlen, flags, saddr);
+
 	maxlen = rtdm_get_iov_flatlen(iov, iovlen);
 	if (maxlen == 0)
 		return 0;
@@ -367,6 +696,33 @@ static ssize_t iddp_recvmsg(struct rtdm_fd *fd,
 	return ret;
 }
 
+/*
+ * Message headers already live in kernel memory. Only the first
+ * receive may block when MSG_WAITFORONE is set, which the
+ * per-message path would reject.
+ */
+static int iddp_recvmmsg(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			 unsigned int vlen, int flags)
+{
+	int n, waitforone = flags & MSG_WAITFORONE;
+	ssize_t ret = 0;
+
+	flags &= ~MSG_WAITFORONE;
+	if (flags & ~MSG_DONTWAIT)
+		return -EINVAL;
+
+	for (n = 0; n < vlen; n++) {
+		ret = iddp_recvmsg(fd, &mmsg[n].msg_hdr, flags);
+		if (ret < 0)
+			break;
+		mmsg[n].msg_len = ret;
+		if (waitforone)
+			flags |= MSG_DONTWAIT;
+	}
+
+	return n ?: ret;
+}
+
 static ssize_t iddp_read(struct rtdm_fd *fd, void *buf, size_t len)
 {
 	struct iovec iov = { .iov_base = buf, .iov_len = len };
@@ -374,42 +730,103 @@ static ssize_t iddp_read(struct rtdm_fd *fd, void *buf, size_t len)
 	return __iddp_recvmsg(fd, &iov, 1, 0, NULL);
 }
 
-static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
-			      struct iovec *iov, int iovlen, int flags,
-			      const struct sockaddr_ipc *daddr)
+static ssize_t __iddp_ring_send(struct rtdm_fd *fd, struct iddp_socket *sk,
+				struct iddp_socket *rsk,
+				struct iovec *iov, int iovlen, int flags,
+				ssize_t len)
 {
-	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	struct iddp_socket *sk = priv->state, *rsk;
-	struct iddp_message *mbuf;
-	ssize_t len, rdlen, vlen;
-	int nvec, wroff, ret;
-	struct rtdm_fd *rfd;
+	struct rtipc_ring *ring = &rsk->ring;
+	struct rtipc_ring_slot *slot;
+	rtdm_toseq_t timeout_seq;
+	ssize_t wrlen, vlen, ret;
 	struct xnbufd bufd;
-	rtdm_lockctx_t s;
+	int nvec;
 
-	len = rtdm_get_iov_flatlen(iov, iovlen);
-	if (len == 0)
+	if (flags & MSG_OOB)
+		return -EINVAL;
+
+	/* Zero-length send: kick the consumer after direct fills. */
+	if (len == 0) {
+		if (!rtipc_ring_empty(ring))
+			__iddp_ring_kick(rsk);
 		return 0;
+	}
+
+	if (len > ring->slot_size)
+		return -EMSGSIZE;
+
+	ret = rtdm_mutex_lock(&ring->wlock);
+	if (ret)
+		return ret;
+
+	if (flags & MSG_DONTWAIT) {
+		if (rtipc_ring_full(ring))
+			ret = -EAGAIN;
+	} else {
+		rtdm_toseq_init(&timeout_seq, sk->tx_timeout);
+		ret = rtdm_timedwait_condition(&ring->txwait,
+					       !rtipc_ring_full(ring),
+					       sk->tx_timeout, &timeout_seq);
+		if (unlikely(ret == -EIDRM))
+			ret = -ECONNRESET;
+	}
+	if (ret)
+		goto out;
+
+	slot = rtipc_ring_get_wslot(ring);
+
+	for (wrlen = 0, nvec = 0; nvec < iovlen && wrlen < len; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = len - wrlen >= iov[nvec].iov_len ?
+			iov[nvec].iov_len : len - wrlen;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(slot->data + wrlen, &bufd, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(slot->data + wrlen, &bufd, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			goto out;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		wrlen += vlen;
+	}
+
+	slot->len = len;
+	slot->from = sk->name.sipc_port;
+	if (rtipc_ring_produce(ring))
+		__iddp_ring_kick(rsk);
+	ret = len;
+out:
+	rtdm_mutex_unlock(&ring->wlock);
+
+	return ret;
+}
+
+static struct rtdm_fd *__iddp_get_port(int port)
+{
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
 
 	cobalt_atomic_enter(s);
-	rfd = xnmap_fetch_nocheck(portmap, daddr->sipc_port);
+	rfd = xnmap_fetch_nocheck(portmap, port);
 	if (rfd && rtdm_fd_lock(rfd) < 0)
 		rfd = NULL;
 	cobalt_atomic_leave(s);
-	if (rfd == NULL)
-		return -ECONNRESET;
 
-	rsk = rtipc_fd_to_state(rfd);
-	if (!test_bit(_IDDP_BOUND, &rsk->status)) {
-		rtdm_fd_unlock(rfd);
-		return -ECONNREFUSED;
-	}
+	return rfd;
+}
 
-	mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout, flags, &ret);
-	if (unlikely(ret)) {
-		rtdm_fd_unlock(rfd);
-		return ret;
-	}
+static int __iddp_fill_mbuf(struct rtdm_fd *fd, struct iddp_message *mbuf,
+			    struct iovec *iov, int iovlen, ssize_t len)
+{
+	ssize_t rdlen, vlen;
+	int nvec, wroff, ret;
+	struct xnbufd bufd;
 
 	/* Now, move "len" bytes to mbuf->data from the vector cells */
 	for (nvec = 0, rdlen = len, wroff = 0;
@@ -427,13 +844,66 @@ static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
 			xnbufd_unmap_kread(&bufd);
 		}
 		if (ret < 0)
-			goto fail;
+			return ret;
 		iov[nvec].iov_base += vlen;
 		iov[nvec].iov_len -= vlen;
 		rdlen -= vlen;
 		wroff += vlen;
 	}
 
+	return 0;
+}
+
+static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
+			      struct iovec *iov, int iovlen, int flags,
+			      const struct sockaddr_ipc *daddr)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iddp_socket *sk = priv->state, *rsk;
+	struct iddp_message *mbuf;
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+	ssize_t len;
+	int ret;
+
+	len = rtdm_get_iov_flatlen(iov, iovlen);
+
+	/*
+	 * Zero-length sends are no-ops, except to ring-mode ports
+	 * where they wake up the consumer; we have to look up the
+	 * destination to tell.
+	 */
+	rfd = __iddp_get_port(daddr->sipc_port);
+	if (rfd == NULL)
+		return len ? -ECONNRESET : 0;
+
+	rsk = rtipc_fd_to_state(rfd);
+	if (!test_bit(_IDDP_BOUND, &rsk->status)) {
+		rtdm_fd_unlock(rfd);
+		return len ? -ECONNREFUSED : 0;
+	}
+
+	if (rsk->ring.hdr) {
+		ret = __iddp_ring_send(fd, sk, rsk, iov, iovlen, flags, len);
+		rtdm_fd_unlock(rfd);
+		return ret;
+	}
+
+	if (len == 0) {
+		rtdm_fd_unlock(rfd);
+		return 0;
+	}
+
+	mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout, flags, &ret);
+	if (unlikely(ret)) {
+		rtdm_fd_unlock(rfd);
+		return ret;
+	}
+
+	ret = __iddp_fill_mbuf(fd, mbuf, iov, iovlen, len);
+	if (ret < 0)
+		goto fail;
+
 	cobalt_atomic_enter(s);
 
 	/*
@@ -466,40 +936,51 @@ fail:
 	return ret;
 }
 
-static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
-			    const struct user_msghdr *msg, int flags)
+static int __iddp_get_daddr(struct rtdm_fd *fd, struct iddp_socket *sk,
+			    const struct user_msghdr *msg,
+			    struct sockaddr_ipc *daddr)
 {
-	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
-	struct iddp_socket *sk = priv->state;
-	struct sockaddr_ipc daddr;
-	ssize_t ret;
-
-	if (flags & ~(MSG_OOB | MSG_DONTWAIT))
-		return -EINVAL;
-
 	if (msg->msg_name) {
 		if (msg->msg_namelen != sizeof(struct sockaddr_ipc))
 			return -EINVAL;
 
 		/* Fetch the destination address to send to. */
-		if (rtipc_get_arg(fd, &daddr, msg->msg_name, sizeof(daddr)))
+		if (rtipc_get_arg(fd, daddr, msg->msg_name, sizeof(*daddr)))
 			return -EFAULT;
 
-		if (daddr.sipc_port < 0 ||
-		    daddr.sipc_port >= CONFIG_XENO_OPT_IDDP_NRPORT)
+		if (daddr->sipc_port < 0 ||
+		    daddr->sipc_port >= CONFIG_XENO_OPT_IDDP_NRPORT)
 			return -EINVAL;
 	} else {
 		if (msg->msg_namelen != 0)
 			return -EINVAL;
-		daddr = sk->peer;
-		if (daddr.sipc_port < 0)
+		*daddr = sk->peer;
+		if (daddr->sipc_port < 0)
 			return -EDESTADDRREQ;
 	}
 
 	if (msg->msg_iovlen >= UIO_MAXIOV)
 		return -EINVAL;
 
+	return 0;
+}
+
+static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
+			    const struct user_msghdr *msg, int flags)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
+	struct iddp_socket *sk = priv->state;
+	struct sockaddr_ipc daddr;
+	ssize_t ret;
+
+	if (flags & ~(MSG_OOB | MSG_DONTWAIT))
+		return -EINVAL;
+
+	ret = __iddp_get_daddr(fd, sk, msg, &daddr);
+	if (ret)
+		return ret;
+
 	/* Copy I/O vector in */
 	ret = rtdm_get_iovec(fd, &iov, msg, iov_fast);
 	if (ret)
@@ -515,6 +996,153 @@ static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
 	return rtdm_put_iovec(fd, iov, msg, iov_fast) ?: ret;
 }
 
+/*
+ * Queue a run of filled buffers to @rsk at once. The scheduler is
+ * locked while the input semaphore is posted, so that the receiver
+ * is readied only once for the whole run.
+ */
+static void __iddp_post_mbufs(struct iddp_socket *sk,
+			      struct iddp_socket *rsk,
+			      struct list_head *mbufs)
+{
+	struct iddp_message *mbuf, *tmp;
+	rtdm_lockctx_t s;
+
+	if (list_empty(mbufs))
+		return;
+
+	cobalt_atomic_enter(s);
+
+	if (list_empty(&rsk->inq)) /* -> readable */
+		xnselect_signal(&rsk->priv->recv_block, POLLIN);
+
+	xnsched_lock();
+
+	list_for_each_entry_safe(mbuf, tmp, mbufs, next) {
+		list_del(&mbuf->next);
+		mbuf->from = sk->name.sipc_port;
+		list_add_tail(&mbuf->next, &rsk->inq);
+		rtdm_sem_up(&rsk->insem);
+	}
+
+	xnsched_unlock(); /* Will resched. */
+
+	cobalt_atomic_leave(s);
+}
+
+static int iddp_sendmmsg(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			 unsigned int vlen, int flags)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
+	struct iddp_socket *sk = priv->state, *rsk = NULL;
+	struct rtdm_fd *rfd = NULL;
+	struct sockaddr_ipc daddr;
+	struct iddp_message *mbuf;
+	struct user_msghdr *msg;
+	int n, ret = 0, port = -1;
+	LIST_HEAD(mbufs);
+	ssize_t len;
+
+	/* OOB messages jump the queue, send them one by one. */
+	if (flags & MSG_OOB)
+		return -ENOSYS;
+
+	if (flags & ~MSG_DONTWAIT)
+		return -EINVAL;
+
+	for (n = 0; n < vlen; n++) {
+		msg = &mmsg[n].msg_hdr;
+		ret = __iddp_get_daddr(fd, sk, msg, &daddr);
+		if (ret)
+			break;
+
+		if (rfd && daddr.sipc_port != port) {
+			__iddp_post_mbufs(sk, rsk, &mbufs);
+			rtdm_fd_unlock(rfd);
+			rfd = NULL;
+		}
+
+		if (rfd == NULL) {
+			port = daddr.sipc_port;
+			rfd = __iddp_get_port(port);
+			if (rfd == NULL) {
+				ret = -ECONNRESET;
+				break;
+			}
+			rsk = rtipc_fd_to_state(rfd);
+			if (rsk->ring.hdr) {
+				/* Ring-mode ports have their own path. */
+				rtdm_fd_unlock(rfd);
+				rfd = NULL;
+				len = iddp_sendmsg(fd, msg, flags);
+				if (len < 0) {
+					ret = len;
+					break;
+				}
+				mmsg[n].msg_len = len;
+				continue;
+			}
+			if (!test_bit(_IDDP_BOUND, &rsk->status)) {
+				ret = -ECONNREFUSED;
+				break;
+			}
+		}
+
+		ret = rtdm_get_iovec(fd, &iov, msg, iov_fast);
+		if (ret)
+			break;
+
+		len = rtdm_get_iov_flatlen(iov, msg->msg_iovlen);
+		if (len == 0) {
+			rtdm_drop_iovec(iov, iov_fast);
+			mmsg[n].msg_len = 0;
+			continue;
+		}
+
+		/*
+		 * We may not wait for buffer space while holding
+		 * buffers the receiver cannot see yet: post them
+		 * first if the pool runs dry.
+		 */
+		mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout,
+					 flags | MSG_DONTWAIT, &ret);
+		if (ret == -EAGAIN && (flags & MSG_DONTWAIT) == 0) {
+			__iddp_post_mbufs(sk, rsk, &mbufs);
+			mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout,
+						 flags, &ret);
+		}
+		if (unlikely(ret)) {
+			rtdm_drop_iovec(iov, iov_fast);
+			break;
+		}
+
+		ret = __iddp_fill_mbuf(fd, mbuf, iov, msg->msg_iovlen, len);
+		if (ret) {
+			__iddp_free_mbuf(rsk, mbuf);
+			rtdm_drop_iovec(iov, iov_fast);
+			break;
+		}
+
+		/* Copy updated I/O vector back */
+		ret = rtdm_put_iovec(fd, iov, msg, iov_fast);
+		if (ret) {
+			__iddp_free_mbuf(rsk, mbuf);
+			break;
+		}
+
+		list_add_tail(&mbuf->next, &mbufs);
+		mmsg[n].msg_len = len;
+	}
+
+	if (rfd) {
+		__iddp_post_mbufs(sk, rsk, &mbufs);
+		rtdm_fd_unlock(rfd);
+	}
+
+	return n ?: ret;
+}
+
 static ssize_t iddp_write(struct rtdm_fd *fd,
 			  const void *buf, size_t len)
 {
@@ -568,7 +1196,13 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 	 * setsockopt() before we got there.
 	 */
 	poolsz = sk->poolsz;
-	if (poolsz > 0) {
+	if (sk->poolcf.nr_classes > 0) {
+		ret = __iddp_init_slab(sk, poolsz);
+		if (ret)
+			goto fail;
+		sk->poolwaitq = &sk->privwaitq;
+		poolsz = 0;	/* No private heap. */
+	} else if (poolsz > 0) {
 		poolsz = PAGE_ALIGN(poolsz);
 		poolmem = xnheap_vmalloc(poolsz);
 		if (poolmem == NULL) {
@@ -586,6 +1220,12 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 		sk->bufpool = &sk->privpool;
 	}
 
+	if (sk->ringcf.nr_slots > 0) {
+		ret = rtipc_ring_init(&sk->ring, &sk->ringcf);
+		if (ret)
+			goto fail_freeheap;
+	}
+
 	sk->name = *sa;
 	/* Set default destination if unset at binding time. */
 	if (sk->peer.sipc_port < 0)
@@ -595,11 +1235,8 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 		ret = xnregistry_enter(sk->label, sk,
 				       &sk->handle, &__iddp_pnode.node);
 		if (ret) {
-			if (poolsz > 0) {
-				xnheap_destroy(&sk->privpool);
-				xnheap_vfree(poolmem);
-			}
-			goto fail;
+			rtipc_ring_destroy(&sk->ring);
+			goto fail_freeheap;
 		}
 	}
 
@@ -611,6 +1248,16 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 	cobalt_atomic_leave(s);
 
 	return 0;
+fail_freeheap:
+	if (poolsz > 0) {
+		xnheap_destroy(&sk->privpool);
+		xnheap_vfree(poolmem);
+		sk->poolwaitq = &poolwaitq;
+		sk->bufpool = &cobalt_heap;
+	} else if (sk->slab.mem) {
+		__iddp_destroy_slab(sk);
+		sk->poolwaitq = &poolwaitq;
+	}
 fail:
 	xnmap_remove(portmap, port);
 	clear_bit(_IDDP_BINDING, &sk->status);
@@ -700,6 +1347,8 @@ static int __iddp_setsockopt(struct iddp_socket *sk,
 {
 	struct _rtdm_setsockopt_args sopt;
 	struct rtipc_port_label plabel;
+	struct rtipc_ring_setup ringcf;
+	struct rtipc_pool_setup poolcf;
 	struct timeval tv;
 	rtdm_lockctx_t s;
 	size_t len;
@@ -739,7 +1388,16 @@ static int __iddp_setsockopt(struct iddp_socket *sk,
 	switch (sopt.optname) {
 
 	case IDDP_POOLSZ:
-		ret = rtipc_get_length(fd, &len, sopt.optval, sopt.optlen);
+		if (sopt.optlen == sizeof(poolcf)) {
+			if (rtipc_get_arg(fd, &poolcf, sopt.optval,
+					  sizeof(poolcf)))
+				return -EFAULT;
+			ret = __iddp_check_poolcf(&poolcf, &len);
+		} else {
+			poolcf.nr_classes = 0;
+			ret = rtipc_get_length(fd, &len, sopt.optval,
+					       sopt.optlen);
+		}
 		if (ret)
 			return ret;
 		if (len == 0)
@@ -752,8 +1410,10 @@ static int __iddp_setsockopt(struct iddp_socket *sk,
 		if (test_bit(_IDDP_BOUND, &sk->status) ||
 		    test_bit(_IDDP_BINDING, &sk->status))
 			ret = -EALREADY;
-		else
+		else {
 			sk->poolsz = len;
+			sk->poolcf = poolcf;
+		}
 		cobalt_atomic_leave(s);
 		break;
 
@@ -776,6 +1436,23 @@ static int __iddp_setsockopt(struct iddp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case IDDP_RING:
+		if (sopt.optlen != sizeof(ringcf))
+			return -EINVAL;
+		if (rtipc_get_arg(fd, &ringcf, sopt.optval, sizeof(ringcf)))
+			return -EFAULT;
+		ret = rtipc_ring_check_setup(&ringcf);
+		if (ret)
+			return ret;
+		cobalt_atomic_enter(s);
+		if (test_bit(_IDDP_BOUND, &sk->status) ||
+		    test_bit(_IDDP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else
+			sk->ringcf = ringcf;
+		cobalt_atomic_leave(s);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -789,6 +1466,7 @@ static int __iddp_getsockopt(struct iddp_socket *sk,
 {
 	struct _rtdm_getsockopt_args sopt;
 	struct rtipc_port_label plabel;
+	struct rtipc_pool_stat pstat;
 	struct timeval tv;
 	rtdm_lockctx_t s;
 	socklen_t len;
@@ -841,6 +1519,14 @@ static int __iddp_getsockopt(struct iddp_socket *sk,
 			return -EFAULT;
 		break;
 
+	case IDDP_POOLSTAT:
+		if (len < sizeof(pstat))
+			return -EINVAL;
+		__iddp_slab_stat(&sk->slab, &pstat);
+		if (rtipc_put_arg(fd, sopt.optval, &pstat, sizeof(pstat)))
+			return -EFAULT;
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -946,8 +1632,13 @@ static unsigned int iddp_pollstate(struct rtdm_fd *fd) /* atomic */
 	unsigned int mask = 0;
 	struct rtdm_fd *rfd;
 
-	if (test_bit(_IDDP_BOUND, &sk->status) && !list_empty(&sk->inq))
-		mask |= POLLIN;
+	if (test_bit(_IDDP_BOUND, &sk->status)) {
+		if (sk->ring.hdr) {
+			if (!rtipc_ring_empty(&sk->ring))
+				mask |= POLLIN;
+		} else if (!list_empty(&sk->inq))
+			mask |= POLLIN;
+	}
 
 	/*
 	 * If the socket is connected, POLLOUT means that the peer
@@ -970,6 +1661,40 @@ static unsigned int iddp_pollstate(struct rtdm_fd *fd) /* atomic */
 	return mask;
 }
 
+static int iddp_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iddp_socket *sk = priv->state, *rsk;
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+	int ret;
+
+	/* Our own ring as a consumer, or the peer's as a producer. */
+	if (test_bit(_IDDP_BOUND, &sk->status) && sk->ring.hdr)
+		return rtipc_ring_mmap(&sk->ring, vma);
+
+	if (!test_bit(_IDDP_CONNECTED, &sk->status))
+		return -ENXIO;
+
+	cobalt_atomic_enter(s);
+	rfd = xnmap_fetch_nocheck(portmap, sk->peer.sipc_port);
+	if (rfd && rtdm_fd_lock(rfd) < 0)
+		rfd = NULL;
+	cobalt_atomic_leave(s);
+	if (rfd == NULL)
+		return -ECONNRESET;
+
+	rsk = rtipc_fd_to_state(rfd);
+	if (test_bit(_IDDP_BOUND, &rsk->status) && rsk->ring.hdr)
+		ret = rtipc_ring_mmap(&rsk->ring, vma);
+	else
+		ret = -ENXIO;
+
+	rtdm_fd_unlock(rfd);
+
+	return ret;
+}
+
 struct rtipc_protocol iddp_proto_driver = {
 	.proto_name = "iddp",
 	.proto_statesz = sizeof(struct iddp_socket),
@@ -980,9 +1705,12 @@ struct rtipc_protocol iddp_proto_driver = {
 		.close = iddp_close,
 		.recvmsg = iddp_recvmsg,
 		.sendmsg = iddp_sendmsg,
+		.recvmmsg = iddp_recvmmsg,
+		.sendmmsg = iddp_sendmmsg,
 		.read = iddp_read,
 		.write = iddp_write,
 		.ioctl = iddp_ioctl,
 		.pollstate = iddp_pollstate,
+		.mmap = iddp_mmap,
 	}
 };
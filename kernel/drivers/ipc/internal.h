@@ -49,6 +49,10 @@ struct rtipc_protocol {
 				   struct user_msghdr *msg, int flags);
 		ssize_t (*sendmsg)(struct rtdm_fd *fd,
 				   const struct user_msghdr *msg, int flags);
+		int (*recvmmsg)(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+				unsigned int vlen, int flags);
+		int (*sendmmsg)(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+				unsigned int vlen, int flags);
 		ssize_t (*read)(struct rtdm_fd *fd,
 				void *buf, size_t len);
 		ssize_t (*write)(struct rtdm_fd *fd,
@@ -56,6 +60,8 @@ struct rtipc_protocol {
 		int (*ioctl)(struct rtdm_fd *fd,
 			     unsigned int request, void *arg);
 		unsigned int (*pollstate)(struct rtdm_fd *fd);
+		int (*mmap)(struct rtdm_fd *fd,
+			    struct vm_area_struct *vma);
 	} proto_ops;
 };
 
@@ -116,6 +122,67 @@ int rtipc_get_arg(struct rtdm_fd *fd, void *dst, const void *src,
 int rtipc_put_arg(struct rtdm_fd *fd, void *dst, const void *src,
 		  size_t len);
 
+struct rtipc_ring {
+	struct rtipc_ring_header *hdr;
+	void *slots;
+	u32 mask;
+	u32 stride;
+	u32 slot_size;
+	size_t mapsz;
+	/* Bytes already pulled from the current read slot. */
+	size_t rdoff;
+	rtdm_mutex_t wlock;
+	rtdm_mutex_t rlock;
+	rtdm_waitqueue_t rxwait;
+	rtdm_waitqueue_t txwait;
+};
+
+static inline struct rtipc_ring_slot *
+rtipc_ring_slot(struct rtipc_ring *ring, u32 idx)
+{
+	return ring->slots + (idx & ring->mask) * ring->stride;
+}
+
+static inline bool rtipc_ring_empty(struct rtipc_ring *ring)
+{
+	return ACCESS_ONCE(ring->hdr->head) == ACCESS_ONCE(ring->hdr->tail);
+}
+
+static inline bool rtipc_ring_full(struct rtipc_ring *ring)
+{
+	return ACCESS_ONCE(ring->hdr->head) -
+		ACCESS_ONCE(ring->hdr->tail) > ring->mask;
+}
+
+/*
+ * Slot lengths live in shared memory, never trust them beyond the
+ * slot capacity.
+ */
+static inline size_t rtipc_ring_slot_len(struct rtipc_ring *ring,
+					 struct rtipc_ring_slot *slot)
+{
+	u32 len = ACCESS_ONCE(slot->len);
+
+	return len > ring->slot_size ? ring->slot_size : len;
+}
+
+int rtipc_ring_check_setup(const struct rtipc_ring_setup *setup);
+
+int rtipc_ring_init(struct rtipc_ring *ring,
+		    const struct rtipc_ring_setup *setup);
+
+void rtipc_ring_destroy(struct rtipc_ring *ring);
+
+int rtipc_ring_mmap(struct rtipc_ring *ring, struct vm_area_struct *vma);
+
+struct rtipc_ring_slot *rtipc_ring_get_wslot(struct rtipc_ring *ring);
+
+bool rtipc_ring_produce(struct rtipc_ring *ring);
+
+struct rtipc_ring_slot *rtipc_ring_get_rslot(struct rtipc_ring *ring);
+
+bool rtipc_ring_consume(struct rtipc_ring *ring);
+
 extern struct rtipc_protocol xddp_proto_driver;
 
 extern struct rtipc_protocol iddp_proto_driver;
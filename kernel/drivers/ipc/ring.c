@@ -0,0 +1,180 @@
+/**
+ * This file is part of the Xenomai project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/cache.h>
+#include <rtdm/ipc.h>
+#include "internal.h"
+
+#define RTIPC_RING_MAXSLOTS	65536
+#define RTIPC_RING_MAXSLOTSZ	65536
+#define RTIPC_RING_MAXMAPSZ	(64 << 20)
+
+static inline size_t ring_stride(const struct rtipc_ring_setup *setup)
+{
+	return ALIGN(sizeof(struct rtipc_ring_slot) + setup->slot_size,
+		     SMP_CACHE_BYTES);
+}
+
+static inline size_t ring_offset(void)
+{
+	return ALIGN(sizeof(struct rtipc_ring_header), SMP_CACHE_BYTES);
+}
+
+int rtipc_ring_check_setup(const struct rtipc_ring_setup *setup)
+{
+	u32 nr = setup->nr_slots;
+
+	if (nr < 2 || nr > RTIPC_RING_MAXSLOTS || (nr & (nr - 1)))
+		return -EINVAL;
+
+	if (setup->slot_size == 0 || setup->slot_size > RTIPC_RING_MAXSLOTSZ)
+		return -EINVAL;
+
+	if (PAGE_ALIGN(ring_offset() + (u64)nr * ring_stride(setup)) >
+	    RTIPC_RING_MAXMAPSZ)
+		return -EINVAL;
+
+	return 0;
+}
+
+int rtipc_ring_init(struct rtipc_ring *ring,
+		    const struct rtipc_ring_setup *setup)
+{
+	struct rtipc_ring_header *hdr;
+	size_t stride, mapsz;
+	int ret;
+
+	ret = rtipc_ring_check_setup(setup);
+	if (ret)
+		return ret;
+
+	stride = ring_stride(setup);
+	mapsz = PAGE_ALIGN(ring_offset() + setup->nr_slots * stride);
+	hdr = vmalloc_user(mapsz);
+	if (hdr == NULL)
+		return -ENOMEM;
+
+	hdr->nr_slots = setup->nr_slots;
+	hdr->slot_size = setup->slot_size;
+	hdr->slot_stride = stride;
+	hdr->slot_offset = ring_offset();
+	hdr->map_size = mapsz;
+
+	ring->hdr = hdr;
+	ring->slots = (void *)hdr + ring_offset();
+	ring->mask = setup->nr_slots - 1;
+	ring->stride = stride;
+	ring->slot_size = setup->slot_size;
+	ring->mapsz = mapsz;
+	ring->rdoff = 0;
+	rtdm_mutex_init(&ring->wlock);
+	rtdm_mutex_init(&ring->rlock);
+	rtdm_waitqueue_init(&ring->rxwait);
+	rtdm_waitqueue_init(&ring->txwait);
+
+	return 0;
+}
+
+void rtipc_ring_destroy(struct rtipc_ring *ring)
+{
+	if (ring->hdr == NULL)
+		return;
+
+	rtdm_waitqueue_destroy(&ring->txwait);
+	rtdm_waitqueue_destroy(&ring->rxwait);
+	rtdm_mutex_destroy(&ring->rlock);
+	rtdm_mutex_destroy(&ring->wlock);
+	/*
+	 * Pages still mapped by user-space are pinned by their
+	 * mappings, so they outlive this call.
+	 */
+	vfree(ring->hdr);
+	ring->hdr = NULL;
+}
+
+int rtipc_ring_mmap(struct rtipc_ring *ring, struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff != 0 ||
+	    vma->vm_end - vma->vm_start > ring->mapsz)
+		return -EINVAL;
+
+	return rtdm_mmap_vmem(vma, ring->hdr);
+}
+
+/* Caller holds ring->wlock. */
+struct rtipc_ring_slot *rtipc_ring_get_wslot(struct rtipc_ring *ring)
+{
+	struct rtipc_ring_header *hdr = ring->hdr;
+	u32 head = ACCESS_ONCE(hdr->head);
+
+	if (head - ACCESS_ONCE(hdr->tail) > ring->mask)
+		return NULL;	/* full */
+
+	return rtipc_ring_slot(ring, head);
+}
+
+/*
+ * Publish the slot obtained from rtipc_ring_get_wslot(). Returns
+ * true if the ring was found empty, in which case the consumer has to
+ * be notified.
+ */
+bool rtipc_ring_produce(struct rtipc_ring *ring)
+{
+	struct rtipc_ring_header *hdr = ring->hdr;
+	u32 head = hdr->head;
+
+	smp_wmb();		/* Slot contents before head. */
+	ACCESS_ONCE(hdr->head) = head + 1;
+	smp_mb();		/* Head before reading tail. */
+
+	return ACCESS_ONCE(hdr->tail) == head;
+}
+
+/* Caller holds ring->rlock. */
+struct rtipc_ring_slot *rtipc_ring_get_rslot(struct rtipc_ring *ring)
+{
+	struct rtipc_ring_header *hdr = ring->hdr;
+	u32 tail = ACCESS_ONCE(hdr->tail);
+
+	if (ACCESS_ONCE(hdr->head) == tail)
+		return NULL;	/* empty */
+
+	smp_rmb();		/* Head before slot contents. */
+
+	return rtipc_ring_slot(ring, tail);
+}
+
+/*
+ * Release the slot obtained from rtipc_ring_get_rslot(). Returns true
+ * if the ring was found full, in which case the producer has to be
+ * notified.
+ */
+bool rtipc_ring_consume(struct rtipc_ring *ring)
+{
+	struct rtipc_ring_header *hdr = ring->hdr;
+	u32 tail = hdr->tail;
+
+	smp_mb();		/* Slot contents before tail. */
+	ACCESS_ONCE(hdr->tail) = tail + 1;
+	ring->rdoff = 0;
+	smp_mb();		/* Tail before reading head. */
+
+	return ACCESS_ONCE(hdr->head) - tail > ring->mask;
+}
@@ -57,6 +57,10 @@ struct xddp_socket {
 	nanosecs_rel_t timeout;	/* connect()/recvmsg() timeout */
 	size_t reqbufsz;	/* Requested streaming buffer size */
 
+	struct rtipc_ring_setup ringcf;	/* Requested ring geometry */
+	struct rtipc_ring ring;
+	struct xddp_message *doorbell;
+
 	int (*monitor)(struct rtdm_fd *fd, int event, long arg);
 	struct rtipc_private *priv;
 };
@@ -73,6 +77,7 @@ static struct rtdm_fd *portmap[CONFIG_XENO_OPT_PIPE_NRDEV]; /* indexes RTDM fild
 #define _XDDP_BINDING   2
 #define _XDDP_BOUND     3
 #define _XDDP_CONNECTED 4
+#define _XDDP_DOORBELL  5
 
 #ifdef CONFIG_XENO_OPT_VFILE
 
@@ -148,6 +153,14 @@ static void __xddp_free_handler(void *buf, void *skarg) /* nklock free */
 	struct xddp_socket *sk = skarg;
 	rtdm_lockctx_t s;
 
+	if (buf == sk->doorbell) {
+		/* The doorbell was consumed, it may ring again. */
+		rtdm_lock_get_irqsave(&sk->lock, s);
+		__clear_bit(_XDDP_DOORBELL, &sk->status);
+		rtdm_lock_put_irqrestore(&sk->lock, s);
+		return;
+	}
+
 	if (buf != sk->buffer) {
 		xnheap_free(sk->bufpool, buf);
 		return;
@@ -200,6 +213,16 @@ static int __xddp_input_handler(struct xnpipe_mh *mh, int retval, void *skarg) /
 	return retval;
 }
 
+static int __xddp_mmap_handler(struct vm_area_struct *vma, void *skarg)
+{
+	struct xddp_socket *sk = skarg;
+
+	if (sk->ring.hdr == NULL)
+		return -ENXIO;
+
+	return rtipc_ring_mmap(&sk->ring, vma);
+}
+
 static void __xddp_release_handler(void *skarg) /* nklock free */
 {
 	struct xddp_socket *sk = skarg;
@@ -211,8 +234,14 @@ static void __xddp_release_handler(void *skarg) /* nklock free */
 		poolsz = xnheap_get_size(&sk->privpool);
 		xnheap_destroy(&sk->privpool);
 		xnheap_vfree(poolmem);
-	} else if (sk->buffer)
-		xnfree(sk->buffer);
+	} else {
+		if (sk->buffer)
+			xnfree(sk->buffer);
+		if (sk->doorbell)
+			xnfree(sk->doorbell);
+	}
+
+	rtipc_ring_destroy(&sk->ring);
 
 	kfree(sk);
 }
@@ -238,6 +267,9 @@ static int xddp_socket(struct rtdm_fd *fd)
 	sk->curbufsz = 0;
 	sk->reqbufsz = 0;
 	sk->monitor = NULL;
+	memset(&sk->ringcf, 0, sizeof(sk->ringcf));
+	sk->ring.hdr = NULL;
+	sk->doorbell = NULL;
 	rtdm_lock_init(&sk->lock);
 	sk->priv = priv;
 
@@ -459,6 +491,95 @@ out:
 	return outbytes;
 }
 
+static void __xddp_ring_doorbell(struct xddp_socket *sk)
+{
+	struct xddp_message *mbuf = sk->doorbell;
+	rtdm_lockctx_t s;
+	ssize_t ret;
+
+	/*
+	 * A single doorbell may be pending on the output queue: the
+	 * consumer drains the ring after reading it, which covers any
+	 * slot published until the free handler rearms it.
+	 */
+	rtdm_lock_get_irqsave(&sk->lock, s);
+
+	if (!__test_and_set_bit(_XDDP_DOORBELL, &sk->status)) {
+		*(u32 *)mbuf->data = ACCESS_ONCE(sk->ring.hdr->head);
+		ret = xnpipe_send(sk->minor, &mbuf->mh,
+				  sizeof(*mbuf) + sizeof(u32), XNPIPE_NORMAL);
+		if (ret < 0)
+			__clear_bit(_XDDP_DOORBELL, &sk->status);
+	}
+
+	rtdm_lock_put_irqrestore(&sk->lock, s);
+}
+
+static ssize_t __xddp_ring_send(struct rtdm_fd *fd, struct xddp_socket *rsk,
+				struct iovec *iov, int iovlen, int flags,
+				ssize_t len, int from)
+{
+	struct rtipc_ring *ring = &rsk->ring;
+	struct rtipc_ring_slot *slot;
+	ssize_t wrlen, vlen, ret;
+	struct xnbufd bufd;
+	int nvec;
+
+	if (flags & (MSG_MORE | MSG_OOB))
+		return -EINVAL;
+
+	/* Zero-length send: kick the consumer after direct fills. */
+	if (len == 0) {
+		if (!rtipc_ring_empty(ring))
+			__xddp_ring_doorbell(rsk);
+		return 0;
+	}
+
+	if (len > ring->slot_size)
+		return -EMSGSIZE;
+
+	ret = rtdm_mutex_lock(&ring->wlock);
+	if (ret)
+		return ret;
+
+	slot = rtipc_ring_get_wslot(ring);
+	if (slot == NULL) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	for (wrlen = 0, nvec = 0; nvec < iovlen && wrlen < len; nvec++) {
+		if (iov[nvec].iov_len == 0)
+			continue;
+		vlen = len - wrlen >= iov[nvec].iov_len ?
+			iov[nvec].iov_len : len - wrlen;
+		if (rtdm_fd_is_user(fd)) {
+			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(slot->data + wrlen, &bufd, vlen);
+			xnbufd_unmap_uread(&bufd);
+		} else {
+			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
+			ret = xnbufd_copy_to_kmem(slot->data + wrlen, &bufd, vlen);
+			xnbufd_unmap_kread(&bufd);
+		}
+		if (ret < 0)
+			goto out;
+		iov[nvec].iov_base += vlen;
+		iov[nvec].iov_len -= vlen;
+		wrlen += vlen;
+	}
+
+	slot->len = len;
+	slot->from = from;
+	if (rtipc_ring_produce(ring))
+		__xddp_ring_doorbell(rsk);
+	ret = len;
+out:
+	rtdm_mutex_unlock(&ring->wlock);
+
+	return ret;
+}
+
 static ssize_t __xddp_sendmsg(struct rtdm_fd *fd,
 			      struct iovec *iov, int iovlen, int flags,
 			      const struct sockaddr_ipc *daddr)
@@ -474,12 +595,15 @@ static ssize_t __xddp_sendmsg(struct rtdm_fd *fd,
 	rtdm_lockctx_t s;
 
 	len = rtdm_get_iov_flatlen(iov, iovlen);
-	if (len == 0)
-		return 0;
 
 	from = sk->name.sipc_port;
 	to = daddr->sipc_port;
 
+	/*
+	 * Zero-length sends are no-ops, except to ring-mode ports
+	 * where they ring the doorbell; we have to look up the
+	 * destination to tell.
+	 */
 	cobalt_atomic_enter(s);
 	rfd = portmap[to];
 	if (rfd && rtdm_fd_lock(rfd) < 0)
@@ -487,12 +611,23 @@ static ssize_t __xddp_sendmsg(struct rtdm_fd *fd,
 	cobalt_atomic_leave(s);
 
 	if (rfd == NULL)
-		return -ECONNRESET;
+		return len ? -ECONNRESET : 0;
 
 	rsk = rtipc_fd_to_state(rfd);
 	if (!test_bit(_XDDP_BOUND, &rsk->status)) {
 		rtdm_fd_unlock(rfd);
-		return -ECONNREFUSED;
+		return len ? -ECONNREFUSED : 0;
+	}
+
+	if (rsk->ring.hdr) {
+		ret = __xddp_ring_send(fd, rsk, iov, iovlen, flags, len, from);
+		rtdm_fd_unlock(rfd);
+		return ret;
+	}
+
+	if (len == 0) {
+		rtdm_fd_unlock(rfd);
+		return 0;
 	}
 
 	sublen = len;
@@ -718,6 +853,18 @@ static int __xddp_bind_socket(struct rtipc_private *priv,
 		sk->curbufsz = sk->reqbufsz;
 	}
 
+	if (sk->ringcf.nr_slots > 0) {
+		sk->doorbell = xnheap_alloc(sk->bufpool,
+					    sizeof(*sk->doorbell) + sizeof(u32));
+		if (sk->doorbell == NULL) {
+			ret = -ENOMEM;
+			goto fail_freebuf;
+		}
+		ret = rtipc_ring_init(&sk->ring, &sk->ringcf);
+		if (ret)
+			goto fail_freebuf;
+	}
+
 	sk->fd = rtdm_private_to_fd(priv);
 
 	ops.output = &__xddp_output_handler;
@@ -726,11 +873,23 @@ static int __xddp_bind_socket(struct rtipc_private *priv,
 	ops.free_ibuf = &__xddp_free_handler;
 	ops.free_obuf = &__xddp_free_handler;
 	ops.release = &__xddp_release_handler;
+	ops.mmap = &__xddp_mmap_handler;
 
 	ret = xnpipe_connect(sa->sipc_port, &ops, sk);
 	if (ret < 0) {
 		if (ret == -EBUSY)
 			ret = -EADDRINUSE;
+		rtipc_ring_destroy(&sk->ring);
+	fail_freebuf:
+		if (sk->doorbell) {
+			xnheap_free(sk->bufpool, sk->doorbell);
+			sk->doorbell = NULL;
+		}
+		if (sk->buffer) {
+			xnheap_free(sk->bufpool, sk->buffer);
+			sk->buffer = NULL;
+			sk->curbufsz = 0;
+		}
 	fail_freeheap:
 		if (poolsz > 0) {
 			xnheap_destroy(&sk->privpool);
@@ -855,6 +1014,7 @@ static int __xddp_setsockopt(struct xddp_socket *sk,
 	int (*monitor)(struct rtdm_fd *fd, int event, long arg);
 	struct _rtdm_setsockopt_args sopt;
 	struct rtipc_port_label plabel;
+	struct rtipc_ring_setup ringcf;
 	struct timeval tv;
 	rtdm_lockctx_t s;
 	size_t len;
@@ -948,6 +1108,23 @@ static int __xddp_setsockopt(struct xddp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case XDDP_RING:
+		if (sopt.optlen != sizeof(ringcf))
+			return -EINVAL;
+		if (rtipc_get_arg(fd, &ringcf, sopt.optval, sizeof(ringcf)))
+			return -EFAULT;
+		ret = rtipc_ring_check_setup(&ringcf);
+		if (ret)
+			return ret;
+		cobalt_atomic_enter(s);
+		if (test_bit(_XDDP_BOUND, &sk->status) ||
+		    test_bit(_XDDP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else
+			sk->ringcf = ringcf;
+		cobalt_atomic_leave(s);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -1114,6 +1291,17 @@ static unsigned int xddp_pollstate(struct rtdm_fd *fd) /* atomic */
 	return mask;
 }
 
+static int xddp_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct xddp_socket *sk = priv->state;
+
+	if (!test_bit(_XDDP_BOUND, &sk->status))
+		return -EAGAIN;
+
+	return __xddp_mmap_handler(vma, sk);
+}
+
 struct rtipc_protocol xddp_proto_driver = {
 	.proto_name = "xddp",
 	.proto_statesz = sizeof(struct xddp_socket),
@@ -1126,5 +1314,6 @@ struct rtipc_protocol xddp_proto_driver = {
 		.write = xddp_write,
 		.ioctl = xddp_ioctl,
 		.pollstate = xddp_pollstate,
+		.mmap = xddp_mmap,
 	}
 };
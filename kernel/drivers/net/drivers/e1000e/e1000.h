@@ -339,11 +339,13 @@ struct e1000_adapter {
 	 * Rx
 	 */
 	bool (*clean_rx) (struct e1000_adapter *adapter,
-			  nanosecs_abs_t *time_stamp)
+			  nanosecs_abs_t *time_stamp,
+			  int *work_done, int work_to_do)
 						____cacheline_aligned_in_smp;
 	void (*alloc_rx_buf) (struct e1000_adapter *adapter,
 			      int cleaned_count, gfp_t gfp);
 	struct e1000_ring *rx_ring;
+	struct rtdev_poll rx_poll;
 
 	u32 rx_int_delay;
 	u32 rx_abs_int_delay;
@@ -662,12 +662,16 @@ map_skb:
 /**
  * e1000_clean_rx_irq - Send received data up the network stack; legacy
  * @adapter: board private structure
+ * @time_stamp: reception date
+ * @work_done: incremented with the number of frames received
+ * @work_to_do: maximum number of frames to receive
  *
  * the return value indicates whether actual cleaning was done, there
  * is no guarantee that everything was cleaned
  **/
 static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
-			       nanosecs_abs_t *time_stamp)
+			       nanosecs_abs_t *time_stamp,
+			       int *work_done, int work_to_do)
 {
 	struct rtnet_device *netdev = adapter->netdev;
 	struct e1000_ring *rx_ring = adapter->rx_ring;
@@ -687,6 +691,9 @@ static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
 	while (staterr & E1000_RXD_STAT_DD) {
 		struct rtskb *skb;
 
+		if (*work_done >= work_to_do)
+			break;
+		(*work_done)++;
 		rmb();	/* read descriptor and rx_buffer_info after status DD */
 
 		skb = buffer_info->skb;
@@ -724,12 +731,14 @@ static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
 			buffer_info->skb = skb;
 			if (staterr & E1000_RXD_STAT_EOP)
 				adapter->flags2 &= ~FLAG2_IS_DISCARDING;
+			adapter->rx_poll.stats.drops++;
 			goto next_desc;
 		}
 
 		if (staterr & E1000_RXDEXT_ERR_FRAME_ERR_MASK) {
 			/* recycle */
 			buffer_info->skb = skb;
+			adapter->rx_poll.stats.drops++;
 			goto next_desc;
 		}
 
@@ -924,6 +933,120 @@ static void e1000e_downshift_workaround(struct work_struct *work)
 	e1000e_gig_downshift_workaround_ich8lan(&adapter->hw);
 }
 
+/**
+ * e1000_rtdev_poll - Rx polling callback
+ * @poll: rtdev polling context of the Rx ring
+ * @budget: count of how many packets we should handle
+ **/
+static int e1000_rtdev_poll(struct rtdev_poll *poll, int budget)
+{
+	struct e1000_adapter *adapter =
+		container_of(poll, struct e1000_adapter, rx_poll);
+	nanosecs_abs_t time_stamp = rtdm_clock_read();
+	int work_done = 0;
+
+	if (adapter->clean_rx(adapter, &time_stamp, &work_done, budget))
+		rt_mark_stack_mgr(adapter->netdev);
+
+	return work_done;
+}
+
+static u32 e1000_rx_ims(struct e1000_adapter *adapter)
+{
+	if (adapter->msix_entries)
+		return adapter->rx_ring->ims_val;
+
+	return E1000_IMS_RXT0 | E1000_IMS_RXDMT0;
+}
+
+/**
+ * e1000_rtdev_poll_irq_enable - unmask Rx interrupts after polling
+ * @poll: rtdev polling context of the Rx ring
+ *
+ * Tx and link interrupts keep reading ICR while Rx causes are
+ * masked, which clears any Rx cause latched meanwhile. Re-check the
+ * ring once unmasked, and raise the Rx interrupt by software if a
+ * frame is already waiting.
+ **/
+static void e1000_rtdev_poll_irq_enable(struct rtdev_poll *poll)
+{
+	struct e1000_adapter *adapter =
+		container_of(poll, struct e1000_adapter, rx_poll);
+	struct e1000_ring *rx_ring = adapter->rx_ring;
+	struct e1000_hw *hw = &adapter->hw;
+	union e1000_rx_desc_extended *rx_desc;
+	u32 ims;
+
+	if (test_bit(__E1000_DOWN, &adapter->state))
+		return;
+
+	ims = e1000_rx_ims(adapter);
+	ew32(IMS, ims);
+	e1e_flush();
+
+	rx_desc = E1000_RX_DESC_EXT(*rx_ring, rx_ring->next_to_clean);
+	if (le32_to_cpu(rx_desc->wb.upper.status_error) & E1000_RXD_STAT_DD)
+		ew32(ICS, ims & ~E1000_IMS_RXDMT0);
+}
+
+static void e1000_rtdev_poll_irq_disable(struct rtdev_poll *poll)
+{
+	struct e1000_adapter *adapter =
+		container_of(poll, struct e1000_adapter, rx_poll);
+	struct e1000_hw *hw = &adapter->hw;
+
+	ew32(IMC, e1000_rx_ims(adapter));
+}
+
+/**
+ * e1000_rx_irq - Rx interrupt processing
+ * @adapter: board private structure
+ *
+ * In polling mode, Rx interrupts are masked and the ring is handed
+ * over to its poll task, which unmasks them when done. Otherwise the
+ * whole ring is drained, the poll budget only applies to the task:
+ * frames left behind would wait for the next Rx interrupt.
+ **/
+static void e1000_rx_irq(struct e1000_adapter *adapter)
+{
+	struct rtdev_poll *poll = &adapter->rx_poll;
+
+	if (!rtdev_poll_sched(poll))
+		rtdev_poll_run_irq(poll, INT_MAX);
+}
+
+/**
+ * e1000_set_itr_usecs - set a fixed interrupt rate
+ * @netdev: network interface device structure
+ * @usecs: minimum interval between interrupts, 0 for dynamic ITR
+ **/
+static int e1000_set_itr_usecs(struct rtnet_device *netdev, unsigned int usecs)
+{
+	struct e1000_adapter *adapter = netdev->priv;
+	struct e1000_hw *hw = &adapter->hw;
+
+	if (usecs > 10000)
+		return -EINVAL;
+
+	if (usecs) {
+		adapter->itr = 1000000 / usecs;
+		adapter->itr_setting = adapter->itr;
+	} else {
+		/* dynamic mode, as with the default InterruptThrottleRate */
+		adapter->itr = 20000;
+		adapter->itr_setting = 3;
+	}
+
+	if (adapter->msix_entries) {
+		/* written on the next Rx interrupt */
+		adapter->rx_ring->itr_val = adapter->itr;
+		adapter->rx_ring->set_itr = 1;
+	} else
+		ew32(ITR, 1000000000 / (adapter->itr * 256));
+
+	return 0;
+}
+
 /**
  * e1000_intr_msi - Interrupt Handler
  * @irq: interrupt number
@@ -934,7 +1057,6 @@ static int e1000_intr_msi(rtdm_irq_t *irq_handle)
 	struct e1000_adapter *adapter =
 		rtdm_irq_get_arg(irq_handle, struct e1000_adapter);
 	struct e1000_hw *hw = &adapter->hw;
-	nanosecs_abs_t time_stamp = rtdm_clock_read();
 	u32 icr = er32(ICR);
 
 	/*
@@ -972,8 +1094,7 @@ static int e1000_intr_msi(rtdm_irq_t *irq_handle)
 		/* Ring was not completely cleaned, so fire another interrupt */
 		ew32(ICS, adapter->tx_ring->ims_val);
 
-	if (e1000_clean_rx_irq(adapter, &time_stamp))
-		rt_mark_stack_mgr(adapter->netdev);
+	e1000_rx_irq(adapter);
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -988,7 +1109,6 @@ static int e1000_intr(rtdm_irq_t *irq_handle)
 	struct e1000_adapter *adapter =
 		rtdm_irq_get_arg(irq_handle, struct e1000_adapter);
 	struct e1000_hw *hw = &adapter->hw;
-	nanosecs_abs_t time_stamp = rtdm_clock_read();
 	u32 rctl, icr = er32(ICR);
 
 	if (!icr || test_bit(__E1000_DOWN, &adapter->state))
@@ -1039,8 +1159,7 @@ static int e1000_intr(rtdm_irq_t *irq_handle)
 		/* Ring was not completely cleaned, so fire another interrupt */
 		ew32(ICS, adapter->tx_ring->ims_val);
 
-	if (e1000_clean_rx_irq(adapter, &time_stamp))
-		rt_mark_stack_mgr(adapter->netdev);
+	e1000_rx_irq(adapter);
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -1100,7 +1219,6 @@ static int e1000_intr_msix_rx(rtdm_irq_t *irq_handle)
 {
 	struct e1000_adapter *adapter =
 		rtdm_irq_get_arg(irq_handle, struct e1000_adapter);
-	nanosecs_abs_t time_stamp = rtdm_clock_read();
 
 	/* Write the ITR value calculated at the end of the
 	 * previous interrupt.
@@ -1111,8 +1229,7 @@ static int e1000_intr_msix_rx(rtdm_irq_t *irq_handle)
 		adapter->rx_ring->set_itr = 0;
 	}
 
-	if (e1000_clean_rx_irq(adapter, &time_stamp))
-		rt_mark_stack_mgr(adapter->netdev);
+	e1000_rx_irq(adapter);
 
 	return RTDM_IRQ_HANDLED;
 }
@@ -1276,6 +1393,7 @@ static int e1000_request_msix(struct e1000_adapter *adapter)
 			       adapter);
 	if (err)
 		goto out;
+	rtdev_set_queue_irq_affinity(netdev, 0, &adapter->rx_irq_handle);
 	adapter->rx_ring->itr_register = E1000_EITR_82574(vector);
 	adapter->rx_ring->itr_val = adapter->itr;
 	vector++;
@@ -1292,6 +1410,7 @@ static int e1000_request_msix(struct e1000_adapter *adapter)
 			       adapter);
 	if (err)
 		goto out;
+	rtdev_set_queue_irq_affinity(netdev, 0, &adapter->tx_irq_handle);
 	adapter->tx_ring->itr_register = E1000_EITR_82574(vector);
 	adapter->tx_ring->itr_val = adapter->itr;
 	vector++;
@@ -1331,8 +1450,11 @@ static int e1000_request_irq(struct e1000_adapter *adapter)
 		err = rtdm_irq_request(&adapter->irq_handle,
 				       adapter->pdev->irq, e1000_intr_msi,
 				       0, netdev->name, adapter);
-		if (!err)
+		if (!err) {
+			rtdev_set_queue_irq_affinity(netdev, 0,
+						     &adapter->irq_handle);
 			return err;
+		}
 
 		/* fall back to legacy interrupt */
 		e1000e_reset_interrupt_capability(adapter);
@@ -2454,6 +2576,8 @@ int e1000e_up(struct e1000_adapter *adapter)
 
 	clear_bit(__E1000_DOWN, &adapter->state);
 
+	rtdev_poll_enable(&adapter->rx_poll);
+
 	if (adapter->msix_entries)
 		e1000_configure_msix(adapter);
 	e1000_irq_enable(adapter);
@@ -2515,6 +2639,8 @@ void e1000e_down(struct e1000_adapter *adapter)
 
 	e1000_irq_disable(adapter);
 
+	rtdev_poll_disable(&adapter->rx_poll);
+
 	del_timer_sync(&adapter->watchdog_timer);
 	del_timer_sync(&adapter->phy_info_timer);
 
@@ -2775,6 +2901,8 @@ static int e1000_open(struct rtnet_device *netdev)
 	/* From here on the code is the same as e1000e_up() */
 	clear_bit(__E1000_DOWN, &adapter->state);
 
+	rtdev_poll_enable(&adapter->rx_poll);
+
 	e1000_irq_enable(adapter);
 
 	rtnetif_start_queue(netdev);
@@ -3988,6 +4116,7 @@ static int e1000_probe(struct pci_dev *pdev,
 	netdev->open = e1000_open;
 	netdev->stop = e1000_close;
 	netdev->hard_start_xmit = e1000_xmit_frame;
+	netdev->set_itr = e1000_set_itr_usecs;
 	//netdev->get_stats = e1000_get_stats;
 	netdev->map_rtskb = e1000_map_rtskb;
 	netdev->unmap_rtskb = e1000_unmap_rtskb;
@@ -4158,6 +4287,12 @@ static int e1000_probe(struct pci_dev *pdev,
 	if (!(adapter->flags & FLAG_HAS_AMT))
 		e1000e_get_hw_control(adapter);
 
+	err = rtdev_add_poll(netdev, &adapter->rx_poll, e1000_rtdev_poll,
+			     e1000_rtdev_poll_irq_enable,
+			     e1000_rtdev_poll_irq_disable);
+	if (err)
+		goto err_register;
+
 	strncpy(netdev->name, "rteth%d", sizeof(netdev->name) - 1);
 	err = rt_register_rtnetdev(netdev);
 	if (err)
@@ -4174,6 +4309,7 @@ static int e1000_probe(struct pci_dev *pdev,
 	return 0;
 
 err_register:
+	rtdev_del_poll(&adapter->rx_poll);
 	rtdm_nrtsig_destroy(&adapter->downshift_sig);
 	rtdm_nrtsig_destroy(&adapter->mod_timer_sig);
 	if (!(adapter->flags & FLAG_HAS_AMT))
@@ -4240,6 +4376,7 @@ static void e1000_remove(struct pci_dev *pdev)
 	if (!down)
 		clear_bit(__E1000_DOWN, &adapter->state);
 	rt_unregister_rtnetdev(netdev);
+	rtdev_del_poll(&adapter->rx_poll);
 
 	if (pci_dev_run_wake(pdev))
 		pm_runtime_get_noresume(&pdev->dev);
@@ -274,6 +274,8 @@ struct igb_q_vector {
 
 	struct igb_ring_container rx, tx;
 
+	struct rtdev_poll poll;	/* RX processing context */
+
 	struct rcu_head rcu;	/* to avoid race with update stats on free */
 	char name[IFNAMSIZ + 9];
 
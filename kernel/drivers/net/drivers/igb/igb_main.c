@@ -83,16 +83,6 @@
 #define NETIF_F_HW_VLAN_FILTER 0
 #endif
 
-#ifdef  IGB_MAX_TX_QUEUES
-#undef  IGB_MAX_TX_QUEUES
-#define IGB_MAX_TX_QUEUES 1
-#endif
-
-#ifdef  IGB_MAX_RX_QUEUES
-#undef  IGB_MAX_RX_QUEUES
-#define IGB_MAX_RX_QUEUES 1
-#endif
-
 #ifdef CONFIG_IGB_NAPI
 #undef CONFIG_IGB_NAPI
 #endif
@@ -143,6 +133,10 @@ static int InterruptThrottle = 0;
 module_param(InterruptThrottle, uint, 0);
 MODULE_PARM_DESC(InterruptThrottle, "Throttle interrupts (boolean, false by default)");
 
+static unsigned int RSSQueues = 0;
+module_param(RSSQueues, uint, 0);
+MODULE_PARM_DESC(RSSQueues, "Number of RX/TX queue pairs (0: one per real-time CPU)");
+
 static const struct pci_device_id igb_pci_tbl[] = {
 	{ PCI_VDEVICE(INTEL, E1000_DEV_ID_I354_BACKPLANE_1GBPS) },
 	{ PCI_VDEVICE(INTEL, E1000_DEV_ID_I354_SGMII) },
@@ -208,14 +202,17 @@ static void igb_watchdog(unsigned long);
 static void igb_watchdog_task(struct work_struct *);
 static netdev_tx_t igb_xmit_frame(struct rtskb *skb, struct rtnet_device *);
 static struct net_device_stats *igb_get_stats(struct rtnet_device *);
+static int igb_set_itr_usecs(struct rtnet_device *, unsigned int);
 static int igb_intr(rtdm_irq_t *irq_handle);
 static int igb_intr_msi(rtdm_irq_t *irq_handle);
 static void igb_nrtsig_watchdog(rtdm_nrtsig_t *sig, void *data);
 static irqreturn_t igb_msix_other(int irq, void *);
 static int igb_msix_ring(rtdm_irq_t *irq_handle);
 static void igb_poll(struct igb_q_vector *);
+static int igb_rtdev_poll(struct rtdev_poll *, int);
+static void igb_rtdev_poll_done(struct rtdev_poll *);
 static bool igb_clean_tx_irq(struct igb_q_vector *);
-static bool igb_clean_rx_irq(struct igb_q_vector *, int);
+static int igb_clean_rx_irq(struct igb_q_vector *, int);
 static int igb_ioctl(struct rtnet_device *, struct ifreq *ifr, int cmd);
 static void igb_reset_task(struct work_struct *);
 static void igb_vlan_mode(struct rtnet_device *netdev,
@@ -886,6 +883,12 @@ static int igb_request_msix(struct igb_adapter *adapter)
 				igb_msix_ring, 0, q_vector->name, q_vector);
 		if (err)
 			goto err_free;
+
+		rtdev_set_queue_irq_affinity(netdev, q_vector->rx.ring ?
+				q_vector->rx.ring->queue_index :
+				q_vector->tx.ring ?
+				q_vector->tx.ring->queue_index : 0,
+				&adapter->msix_irq_handle[vector]);
 	}
 
 	igb_configure_msix(adapter);
@@ -915,6 +918,9 @@ static void igb_free_q_vector(struct igb_adapter *adapter, int v_idx)
 
 	adapter->q_vector[v_idx] = NULL;
 
+	if (q_vector)
+		rtdev_del_poll(&q_vector->poll);
+
 	/* igb_get_stats64() might access the rings on this vector,
 	 * we must wait a grace period before freeing it.
 	 */
@@ -1078,7 +1084,7 @@ static int igb_alloc_q_vector(struct igb_adapter *adapter,
 {
 	struct igb_q_vector *q_vector;
 	struct igb_ring *ring;
-	int ring_count, size;
+	int ring_count, size, err;
 
 	/* igb only supports 1 Tx and/or 1 Rx queue per vector */
 	if (txr_count > 1 || rxr_count > 1)
@@ -1092,8 +1098,10 @@ static int igb_alloc_q_vector(struct igb_adapter *adapter,
 	q_vector = adapter->q_vector[v_idx];
 	if (!q_vector)
 		q_vector = kzalloc(size, GFP_KERNEL);
-	else
+	else {
+		rtdev_del_poll(&q_vector->poll);
 		memset(q_vector, 0, size);
+	}
 	if (!q_vector)
 		return -ENOMEM;
 
@@ -1101,6 +1109,12 @@ static int igb_alloc_q_vector(struct igb_adapter *adapter,
 	adapter->q_vector[v_idx] = q_vector;
 	q_vector->adapter = adapter;
 
+	/* the vector interrupt is auto-masked, no irq_disable hook */
+	err = rtdev_add_poll(adapter->netdev, &q_vector->poll, igb_rtdev_poll,
+			     igb_rtdev_poll_done, NULL);
+	if (err)
+		return err;
+
 	/* initialize work limits */
 	q_vector->tx.work_limit = adapter->tx_work_limit;
 
@@ -1296,6 +1310,7 @@ static int igb_request_irq(struct igb_adapter *adapter)
 		err = igb_init_interrupt_scheme(adapter, false);
 		if (err)
 			goto request_done;
+		rtdev_set_queues(netdev, adapter->num_tx_queues, 0);
 
 		igb_setup_all_tx_resources(adapter);
 		igb_setup_all_rx_resources(adapter);
@@ -1590,12 +1605,16 @@ static void igb_check_swap_media(struct igb_adapter *adapter)
 int igb_up(struct igb_adapter *adapter)
 {
 	struct e1000_hw *hw = &adapter->hw;
+	int i;
 
 	/* hardware has been reset, we need to reload some things */
 	igb_configure(adapter);
 
 	clear_bit(__IGB_DOWN, &adapter->state);
 
+	for (i = 0; i < adapter->num_q_vectors; i++)
+		rtdev_poll_enable(&adapter->q_vector[i]->poll);
+
 	if (adapter->flags & IGB_FLAG_HAS_MSIX)
 		igb_configure_msix(adapter);
 	else
@@ -1623,6 +1642,7 @@ void igb_down(struct igb_adapter *adapter)
 	struct rtnet_device *netdev = adapter->netdev;
 	struct e1000_hw *hw = &adapter->hw;
 	u32 tctl, rctl;
+	int i;
 
 	/* signal that we're down so the interrupt handler does not
 	 * reschedule our watchdog timer
@@ -1646,6 +1666,9 @@ void igb_down(struct igb_adapter *adapter)
 
 	igb_irq_disable(adapter);
 
+	for (i = 0; i < adapter->num_q_vectors; i++)
+		rtdev_poll_disable(&adapter->q_vector[i]->poll);
+
 	adapter->flags &= ~IGB_FLAG_NEED_LINK_UPDATE;
 
 	del_timer_sync(&adapter->watchdog_timer);
@@ -2063,6 +2086,7 @@ static int igb_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	netdev->stop = igb_close;
 	netdev->hard_start_xmit = igb_xmit_frame;
 	netdev->get_stats = igb_get_stats;
+	netdev->set_itr = igb_set_itr_usecs;
 	netdev->map_rtskb = igb_map_rtskb;
 	netdev->unmap_rtskb = igb_unmap_rtskb;
 	netdev->do_ioctl = igb_ioctl;
@@ -2102,6 +2126,12 @@ static int igb_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	if (err)
 		goto err_sw_init;
 
+	/* give each queue pair its own buffer pool and xmit lock */
+	err = rtdev_set_queues(netdev, adapter->num_tx_queues,
+			       2 * IGB_DEFAULT_RXD + IGB_DEFAULT_TXD);
+	if (err)
+		goto err_sw_init;
+
 	igb_get_bus_info_pcie(hw);
 
 	hw->phy.autoneg_wait_to_complete = false;
@@ -2490,8 +2520,29 @@ static void igb_init_queue_configuration(struct igb_adapter *adapter)
 	struct e1000_hw *hw = &adapter->hw;
 	u32 max_rss_queues;
 
-	max_rss_queues = 1;
-	adapter->rss_queues = max_rss_queues;
+	/* Determine the maximum number of RSS queues supported. */
+	switch (hw->mac.type) {
+	case e1000_i211:
+		max_rss_queues = IGB_MAX_RX_QUEUES_I211;
+		break;
+	case e1000_82575:
+	case e1000_i210:
+		max_rss_queues = IGB_MAX_RX_QUEUES_82575;
+		break;
+	default:
+		max_rss_queues = IGB_MAX_RX_QUEUES;
+		break;
+	}
+	max_rss_queues = min_t(u32, max_rss_queues, MAX_RT_DEV_QUEUES);
+
+	/* One queue pair per real-time CPU, unless told otherwise. */
+	if (RSSQueues)
+		adapter->rss_queues = min_t(u32, max_rss_queues, RSSQueues);
+	else
+		adapter->rss_queues = min_t(u32, max_rss_queues,
+				cpumask_weight(&cobalt_cpu_affinity));
+	if (adapter->rss_queues == 0)
+		adapter->rss_queues = 1;
 
 	/* Determine if we need to pair queues. */
 	switch (hw->mac.type) {
@@ -2598,7 +2649,7 @@ static int __igb_open(struct rtnet_device *netdev, bool resuming)
 	struct igb_adapter *adapter = rtnetdev_priv(netdev);
 	struct e1000_hw *hw = &adapter->hw;
 	struct pci_dev *pdev = adapter->pdev;
-	int err;
+	int err, i;
 
 	/* disallow open during test */
 	if (test_bit(__IGB_TESTING, &adapter->state)) {
@@ -2637,6 +2688,9 @@ static int __igb_open(struct rtnet_device *netdev, bool resuming)
 	/* From here on the code is the same as igb_up() */
 	clear_bit(__IGB_DOWN, &adapter->state);
 
+	for (i = 0; i < adapter->num_q_vectors; i++)
+		rtdev_poll_enable(&adapter->q_vector[i]->poll);
+
 	/* Clear any pending interrupts. */
 	rd32(E1000_ICR);
 
@@ -4181,7 +4235,12 @@ netdev_tx_t igb_xmit_frame_ring(struct rtskb *skb,
 static inline struct igb_ring *igb_tx_queue_mapping(struct igb_adapter *adapter,
 						    struct rtskb *skb)
 {
-	return adapter->tx_ring[0];
+	unsigned int r_idx = skb->queue_mapping;
+
+	if (r_idx >= adapter->num_tx_queues)
+		r_idx = 0;
+
+	return adapter->tx_ring[r_idx];
 }
 
 static netdev_tx_t igb_xmit_frame(struct rtskb *skb,
@@ -4486,6 +4545,38 @@ static void igb_write_itr(struct igb_q_vector *q_vector)
 	q_vector->set_itr = 0;
 }
 
+/**
+ *  igb_set_itr_usecs - set a fixed interrupt rate on all vectors
+ *  @netdev: network interface device structure
+ *  @usecs: minimum interval between interrupts, 0 for dynamic ITR
+ *
+ *  The new rate is written on the next interrupt of each vector.
+ **/
+static int igb_set_itr_usecs(struct rtnet_device *netdev, unsigned int usecs)
+{
+	struct igb_adapter *adapter = rtnetdev_priv(netdev);
+	struct igb_q_vector *q_vector;
+	int i;
+
+	if (usecs && (usecs < IGB_MIN_ITR_USECS || usecs > IGB_MAX_ITR_USECS))
+		return -EINVAL;
+
+	/* settings 1-3 select dynamic modes, fixed values are kept in
+	 * EITR units of 0.25us
+	 */
+	adapter->rx_itr_setting = usecs ? usecs << 2 : IGB_DEFAULT_ITR;
+	adapter->tx_itr_setting = adapter->rx_itr_setting;
+
+	for (i = 0; i < adapter->num_q_vectors; i++) {
+		q_vector = adapter->q_vector[i];
+		q_vector->itr_val = usecs ? adapter->rx_itr_setting :
+			IGB_START_ITR;
+		q_vector->set_itr = 1;
+	}
+
+	return 0;
+}
+
 static int igb_msix_ring(rtdm_irq_t *ih)
 {
 	struct igb_q_vector *q_vector =
@@ -4575,17 +4666,45 @@ static void igb_ring_irq_enable(struct igb_q_vector *q_vector)
 }
 
 /**
- *  igb_poll - NAPI Rx polling callback
- *  @napi: napi polling structure
+ *  igb_rtdev_poll - Tx/Rx polling callback
+ *  @poll: rtdev polling context of the vector
  *  @budget: count of how many packets we should handle
  **/
-static void igb_poll(struct igb_q_vector *q_vector)
+static int igb_rtdev_poll(struct rtdev_poll *poll, int budget)
 {
+	struct igb_q_vector *q_vector =
+		container_of(poll, struct igb_q_vector, poll);
+	int work_done = 0;
+
 	if (q_vector->tx.ring)
 		igb_clean_tx_irq(q_vector);
 
 	if (q_vector->rx.ring)
-		igb_clean_rx_irq(q_vector, 64);
+		work_done = igb_clean_rx_irq(q_vector, budget);
+
+	return work_done;
+}
+
+static void igb_rtdev_poll_done(struct rtdev_poll *poll)
+{
+	igb_ring_irq_enable(container_of(poll, struct igb_q_vector, poll));
+}
+
+/**
+ *  igb_poll - vector interrupt processing
+ *  @q_vector: interrupting vector
+ *
+ *  In polling mode, the vector is left masked and handed over to
+ *  its poll task, which re-enables it when done.
+ **/
+static void igb_poll(struct igb_q_vector *q_vector)
+{
+	struct rtdev_poll *poll = &q_vector->poll;
+
+	if (rtdev_poll_sched(poll))
+		return;
+
+	rtdev_poll_run_irq(poll, q_vector->adapter->netdev->poll_budget);
 
 	igb_ring_irq_enable(q_vector);
 }
@@ -4869,7 +4988,7 @@ static void igb_process_skb_fields(struct igb_ring *rx_ring,
 	skb->protocol = rt_eth_type_trans(skb, rx_ring->netdev);
 }
 
-static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
+static int igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 {
 	struct igb_ring *rx_ring = q_vector->rx.ring;
 	unsigned int total_bytes = 0, total_packets = 0;
@@ -4910,8 +5029,10 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 		}
 
 		/* verify the packet layout is correct */
-		if (igb_cleanup_headers(rx_ring, rx_desc, skb))
+		if (igb_cleanup_headers(rx_ring, rx_desc, skb)) {
+			q_vector->poll.stats.drops++;
 			continue;
+		}
 
 		/* probably a little skewed due to removing CRC */
 		total_bytes += skb->len;
@@ -4939,7 +5060,7 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 	if (total_packets)
 		rt_mark_stack_mgr(q_vector->adapter->netdev);
 
-	return total_packets < budget;
+	return total_packets;
 }
 
 static bool igb_alloc_mapped_skb(struct igb_ring *rx_ring,
@@ -4953,7 +5074,8 @@ static bool igb_alloc_mapped_skb(struct igb_ring *rx_ring,
 		return true;
 
 	if (likely(!skb)) {
-		skb = rtnetdev_alloc_rtskb(adapter->netdev,
+		skb = rtdev_queue_alloc_rtskb(adapter->netdev,
+					rx_ring->queue_index,
 					rx_ring->rx_buffer_len + NET_IP_ALIGN);
 		if (!skb) {
 			rx_ring->rx_stats.alloc_failed++;
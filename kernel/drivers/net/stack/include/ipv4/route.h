@@ -37,6 +37,21 @@ struct dest_route {
     struct rtnet_device *rtdev;
 };
 
+/* Output route of the last lookup, see rt_ip_route_output_cached() */
+struct dest_route_cache {
+    rtdm_lock_t         lock;
+    unsigned int        gen;    /* routing tables generation of rt */
+    u32                 daddr;
+    u32                 saddr;
+    struct dest_route   rt;     /* rt.rtdev is not referenced */
+};
+
+static inline void rt_ip_route_cache_init(struct dest_route_cache *cache)
+{
+    rtdm_lock_init(&cache->lock);
+    cache->rt.rtdev = NULL;
+}
+
 
 int rt_ip_route_add_host(u32 addr, unsigned char *dev_addr,
                          struct rtnet_device *rtdev);
@@ -55,6 +70,8 @@ int rt_ip_route_del_host(u32 addr, struct rtnet_device *rtdev);
 int rt_ip_route_get_host(u32 addr, char* if_name, unsigned char *dev_addr,
                          struct rtnet_device *rtdev);
 int rt_ip_route_output(struct dest_route *rt_buf, u32 daddr, u32 saddr);
+int rt_ip_route_output_cached(struct dest_route_cache *cache,
+			      struct dest_route *rt_buf, u32 daddr, u32 saddr);
 
 int __init rt_ip_routing_init(void);
 void rt_ip_routing_release(void);
@@ -27,6 +27,7 @@
 #define __RTDEV_H_
 
 #define MAX_RT_DEVICES                  8
+#define MAX_RT_DEV_QUEUES               8   /* RX/TX queues per device  */
 
 
 #ifdef __KERNEL__
@@ -49,6 +50,24 @@
 #define RTDEV_TX_OK		0
 #define RTDEV_TX_BUSY	1
 
+/* RX processing modes */
+#define RTDEV_RX_IRQ                    0   /* from the interrupt handler */
+#define RTDEV_RX_POLL                   1   /* budgeted, from a poll task */
+
+#define RTDEV_DEF_POLL_BUDGET           64
+#define RTDEV_MAX_POLL_BUDGET           4096
+#define RTDEV_DEF_POLL_BACKOFF          50  /* us, if no ITR is set     */
+
+/* TX queue selection policies */
+#define RTDEV_TXQ_PRIO                  0   /* by socket priority       */
+#define RTDEV_TXQ_HASH                  1   /* by flow hash             */
+
+/* rtdev_poll state bits */
+#define RTDEV_POLL_SCHED                0   /* queue owned by poll task */
+#define RTDEV_POLL_DISABLE              1   /* queue disabled by driver */
+#define RTDEV_POLL_TASK                 2   /* poll task running        */
+#define RTDEV_POLL_STOP                 3   /* queue taken from task    */
+
 enum rtnet_link_state {
 	__RTNET_LINK_STATE_XOFF = 0,
 	__RTNET_LINK_STATE_START,
@@ -60,6 +79,55 @@ enum rtnet_link_state {
 #define RTNET_LINK_STATE_PRESENT (1 << __RTNET_LINK_STATE_PRESENT)
 #define RTNET_LINK_STATE_NOCARRIER (1 << __RTNET_LINK_STATE_NOCARRIER)
 
+struct rtnet_device;
+
+struct rtdev_queue_stats {
+    unsigned long       irqs;       /* queue interrupts             */
+    unsigned long       polls;      /* poll handler runs            */
+    unsigned long       packets;    /* frames received              */
+    unsigned long       drops;      /* frames discarded by driver   */
+};
+
+/***
+ *  rtdev_poll - RX processing context of a device queue
+ *
+ *  poll() processes at most budget frames and returns how many it
+ *  handled. In polling mode, the queue interrupt is kept masked while
+ *  the poll task owns the queue, irq_enable() unmasks it when the queue
+ *  runs dry. irq_disable() may be NULL if the device auto-masks.
+ *  poll() may run from the interrupt handler or from the poll task,
+ *  with IRQs enabled in the latter case.
+ */
+struct rtdev_poll {
+    struct rtnet_device *rtdev;
+    unsigned int        index;
+    int                 (*poll)(struct rtdev_poll *poll, int budget);
+    void                (*irq_enable)(struct rtdev_poll *poll);
+    void                (*irq_disable)(struct rtdev_poll *poll);
+
+    unsigned long       state;
+    rtdm_event_t        event;
+    rtdm_task_t         task;
+
+    struct rtdev_queue_stats stats;
+};
+
+/***
+ *  rtdev_queue - RX/TX queue pair of a device
+ *
+ *  Queue 0 uses the device pool, further queues own a private pool of
+ *  the same size, see rtdev_set_queues(). Every queue pair has its own
+ *  transmission lock, so that senders mapped to different queues do
+ *  not contend.
+ */
+struct rtdev_queue {
+    struct rtskb_pool   *pool;      /* RX buffers and TX compensation */
+    unsigned int        pool_size;
+    rtdm_mutex_t        xmit_mutex; /* protects the TX ring         */
+    int                 irq_cpu;    /* interrupt CPU, -1 if unset   */
+    unsigned long       tx_packets;
+};
+
 /***
  *  rtnet_device
  */
@@ -115,6 +183,9 @@ struct rtnet_device {
     __u32               broadcast_ip; /* broadcast IP in network order */
 
     rtdm_event_t        *stack_event;
+#ifdef CONFIG_XENO_DRIVERS_NET_RX_PERDEV
+    struct rtnet_rx_queue *rx_queue; /* private RX-FIFO and manager  */
+#endif
 
     rtdm_mutex_t        xmit_mutex; /* protects xmit routine        */
     rtdm_lock_t         rtdev_lock; /* management lock              */
@@ -122,8 +193,20 @@ struct rtnet_device {
 
     unsigned int        add_rtskbs; /* additionally allocated global rtskbs */
 
+    /* RX processing policy, protected by nrt_lock */
+    unsigned int        rx_mode;    /* RTDEV_RX_IRQ/POLL            */
+    unsigned int        poll_budget; /* frames per poll run         */
+    unsigned int        itr;        /* min. us between RX irqs, 0=auto */
+    unsigned int        nr_polls;
+    struct rtdev_poll   *polls[MAX_RT_DEV_QUEUES];
+
     struct rtskb_pool   dev_pool;
 
+    /* Hardware queues, set up before registration */
+    unsigned int        num_queues;
+    unsigned int        tx_policy;  /* RTDEV_TXQ_PRIO/HASH          */
+    struct rtdev_queue  queues[MAX_RT_DEV_QUEUES];
+
     /* RTmac related fields */
     struct rtmac_disc   *mac_disc;
     struct rtmac_priv   *mac_priv;
@@ -139,6 +222,8 @@ struct rtnet_device {
     int                 (*hard_start_xmit)(struct rtskb *skb,
 					   struct rtnet_device *dev);
     int                 (*hw_reset)(struct rtnet_device *rtdev);
+    int                 (*set_itr)(struct rtnet_device *rtdev,
+				   unsigned int usecs);
 
     /* Transmission hook, managed by the stack core, RTcap, and RTmac
      *
@@ -235,6 +320,86 @@ int rtdev_map_rtskb(struct rtskb *skb);
 void rtdev_unmap_rtskb(struct rtskb *skb);
 
 struct rtskb *rtnetdev_alloc_rtskb(struct rtnet_device *dev, unsigned int size);
+struct rtskb *rtdev_queue_alloc_rtskb(struct rtnet_device *rtdev,
+				      unsigned int queue, unsigned int size);
+
+int rtdev_set_queues(struct rtnet_device *rtdev, unsigned int num_queues,
+		     unsigned int pool_size);
+int rtdev_queue_cpu(struct rtnet_device *rtdev, unsigned int queue);
+void rtdev_set_queue_irq_affinity(struct rtnet_device *rtdev,
+				  unsigned int queue, rtdm_irq_t *irq_handle);
+
+int rtdev_add_poll(struct rtnet_device *rtdev, struct rtdev_poll *poll,
+		   int (*fn)(struct rtdev_poll *poll, int budget),
+		   void (*irq_enable)(struct rtdev_poll *poll),
+		   void (*irq_disable)(struct rtdev_poll *poll));
+void rtdev_del_poll(struct rtdev_poll *poll);
+
+void rtdev_poll_enable(struct rtdev_poll *poll);
+void rtdev_poll_disable(struct rtdev_poll *poll);
+
+int rtdev_set_rx_mode(struct rtnet_device *rtdev, unsigned int mode);
+int rtdev_set_itr(struct rtnet_device *rtdev, unsigned int usecs);
+
+/***
+ *  rtdev_poll_run - run the poll handler of a queue
+ */
+static inline int rtdev_poll_run(struct rtdev_poll *poll, int budget)
+{
+    int work = poll->poll(poll, budget);
+
+    poll->stats.polls++;
+    poll->stats.packets += work;
+
+    return work;
+}
+
+/***
+ *  rtdev_poll_run_irq - run the poll handler from the queue interrupt
+ *
+ *  For interrupt mode. RTDEV_POLL_SCHED is the queue ownership token
+ *  in both modes: nothing is done if the queue is held elsewhere,
+ *  i.e. by a poll task being stopped, or by the driver. The holder
+ *  re-enables the queue interrupt when releasing it.
+ */
+static inline int rtdev_poll_run_irq(struct rtdev_poll *poll, int budget)
+{
+    int work;
+
+    if (test_and_set_bit(RTDEV_POLL_SCHED, &poll->state))
+	return 0;
+
+    work = rtdev_poll_run(poll, budget);
+
+    smp_mb__before_atomic();
+    clear_bit(RTDEV_POLL_SCHED, &poll->state);
+
+    return work;
+}
+
+/***
+ *  rtdev_poll_sched - hand a queue over to its poll task
+ *
+ *  To be called from the queue interrupt handler. Returns false in
+ *  interrupt mode, the handler then processes the queue by itself
+ *  via rtdev_poll_run_irq(). Otherwise, the queue interrupt must be
+ *  left masked, the poll task unmasks it when done.
+ */
+static inline bool rtdev_poll_sched(struct rtdev_poll *poll)
+{
+    poll->stats.irqs++;
+
+    if (ACCESS_ONCE(poll->rtdev->rx_mode) != RTDEV_RX_POLL)
+	return false;
+
+    if (!test_and_set_bit(RTDEV_POLL_SCHED, &poll->state)) {
+	if (poll->irq_disable)
+	    poll->irq_disable(poll);
+	rtdm_event_signal(&poll->event);
+    }
+
+    return true;
+}
 
 #define rtnetdev_priv(dev) ((dev)->priv)
 
@@ -104,6 +104,34 @@ struct rtnet_core_cmd {
 };
 
 
+/*** rtifconfig rxmode **/
+#define RTNET_RX_MODE_IRQ               0   /* RX in interrupt handler  */
+#define RTNET_RX_MODE_POLL              1   /* budgeted poll task       */
+
+#define RTNET_POLL_SET_MODE             0x0001
+#define RTNET_POLL_SET_BUDGET           0x0002
+#define RTNET_POLL_SET_ITR              0x0004
+
+struct rtnet_queue_stats {
+    __u64       irqs;
+    __u64       polls;
+    __u64       packets;
+    __u64       drops;
+};
+
+struct rtnet_poll_cmd {
+    struct rtnet_ioctl_head head;
+
+    __u32       set_mask;       /* RTNET_POLL_SET_*, 0 to query only */
+    __u32       rx_mode;
+    __u32       budget;         /* frames per poll run */
+    __u32       itr;            /* us between RX interrupts, 0 = auto */
+    __u32       nr_queues;      /* out */
+    __u32       __padding;
+    struct rtnet_queue_stats queue[MAX_RT_DEV_QUEUES];
+};
+
+
 #define RTNET_IOC_NODEV_PARAM           0x80
 
 #define RTNET_IOC_TYPE_CORE             0
@@ -119,5 +147,7 @@ struct rtnet_core_cmd {
 #define IOC_RT_IFINFO                   _IOWR(RTNET_IOC_TYPE_CORE, 2 |  \
                                               RTNET_IOC_NODEV_PARAM,    \
                                               struct rtnet_core_cmd)
+#define IOC_RT_IFPOLL                   _IOWR(RTNET_IOC_TYPE_CORE, 3,   \
+                                              struct rtnet_poll_cmd)
 
 #endif  /* __RTNET_CHRDEV_H_ */
@@ -34,8 +34,11 @@
 #include <rtdm/net.h>
 #include <rtdm/driver.h>
 #include <stack_mgr.h>
+#include <ipv4/route.h>
 
 
+struct rt_packet_ring;
+
 struct rtsocket {
     unsigned short          protocol;
 
@@ -68,12 +71,16 @@ struct rtsocket {
 	    int             reg_index;  /* index in port registry */
 	    u8              tos;
 	    u8              state;
+
+	    struct dest_route_cache rt_cache; /* last output route */
 	} inet;
 
 	/* packet socket specific */
 	struct {
 	    struct rtpacket_type packet_type;
 	    int                  ifindex;
+	    struct rt_packet_ring *rx_ring; /* mapped frame rings */
+	    struct rt_packet_ring *tx_ring;
 	} packet;
     } prot;
 
@@ -89,6 +89,12 @@ rtskbs can be exchanged between pools (rtskb_acquire()). In this case, the
 passed rtskb switches over to from its owning pool to a given pool, but only if
 this pool can pass an empty rtskb from its own queue back.
 
+In front of its queue, every pool keeps a small per-CPU cache of free rtskbs.
+Allocations and releases are served from the cache of the current CPU, the
+shared queue is only locked to refill or flush half a cache at once. To keep
+most of a pool available to all CPUs, the cache depth is limited according to
+the pool size (see rtskb_pool_cache_limit), small pools are not cached at all.
+
 
 5. rtskb Chains
 
@@ -164,6 +170,7 @@ struct rtskb {
 
     struct rtsocket     *sk;        /* assigned socket */
     struct rtnet_device *rtdev;     /* source or destination device */
+    unsigned int        queue_mapping; /* TX queue of rtdev */
 
     nanosecs_abs_t      time_stamp; /* arrival or transmission (RTcap) time */
 
@@ -239,10 +246,21 @@ struct rtskb_pool_lock_ops {
     void (*unlock)(void *cookie);
 };
 
+#define RTSKB_POOL_CACHE_SIZE   16  /* maximum rtskbs per CPU cache */
+
+struct rtskb_pool_cache {
+    rtdm_lock_t         lock;       /* only contended when draining */
+    unsigned int        count;
+    struct rtskb        *skbs[RTSKB_POOL_CACHE_SIZE];
+};
+
 struct rtskb_pool {
     struct rtskb_queue queue;
     const struct rtskb_pool_lock_ops *lock_ops;
     void *lock_cookie;
+    struct rtskb_pool_cache __percpu *cache;
+    unsigned int cache_limit;       /* current per-CPU cache depth  */
+    unsigned int size;              /* rtskbs owned by the pool     */
 };
 
 #define QUEUE_MAX_PRIO          0
@@ -279,6 +297,8 @@ extern unsigned int rtskb_pools_max;    /* maximum number of rtskb pools      */
 extern unsigned int rtskb_amount;       /* current number of allocated rtskbs */
 extern unsigned int rtskb_amount_max;   /* maximum number of allocated rtskbs */
 
+extern void rtskb_pool_cache_stats(unsigned long *hits, unsigned long *misses);
+
 #ifdef CONFIG_XENO_DRIVERS_NET_CHECKED
 extern void rtskb_over_panic(struct rtskb *skb, int len, void *here);
 extern void rtskb_under_panic(struct rtskb *skb, int len, void *here);
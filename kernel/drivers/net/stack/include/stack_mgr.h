@@ -61,6 +61,8 @@ int __rtdev_add_pack(struct rtpacket_type *pt, struct module *module);
     __rtdev_add_pack(pt, THIS_MODULE)
 
 void rtdev_remove_pack(struct rtpacket_type *pt);
+void __rtdev_remove_pack(struct rtpacket_type *pt);
+void rtdev_sync_packs(void);
 
 static inline bool rtdev_lock_pack(struct rtpacket_type *pt)
 {
@@ -79,6 +81,20 @@ void rt_stack_disconnect(struct rtnet_device *rtdev);
 void rt_stack_deliver(struct rtskb *rtskb);
 #endif /* CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK */
 
+#ifdef CONFIG_XENO_DRIVERS_NET_RX_PERDEV
+int rt_stack_rx_queue_create(struct rtnet_device *rtdev);
+void rt_stack_rx_queue_destroy(struct rtnet_device *rtdev);
+#else /* !CONFIG_XENO_DRIVERS_NET_RX_PERDEV */
+static inline int rt_stack_rx_queue_create(struct rtnet_device *rtdev)
+{
+    return 0;
+}
+
+static inline void rt_stack_rx_queue_destroy(struct rtnet_device *rtdev)
+{
+}
+#endif /* CONFIG_XENO_DRIVERS_NET_RX_PERDEV */
+
 int rt_stack_mgr_init(struct rtnet_mgr *mgr);
 void rt_stack_mgr_delete(struct rtnet_mgr *mgr);
 
@@ -92,6 +92,99 @@ MODULE_PARM_DESC(net_hash_key_shift, "destination right shift for "
 		 "network hash key (default: 8)");
 #endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
+/*
+ * Output lookups run without taking the table locks. Route entries
+ * are type-stable (static arrays), so a lookup racing with an update
+ * may follow a stale link, but it never leaves the route arrays:
+ * updaters make the sequence count of a table odd while modifying
+ * it, and lookups start over if any count changed meanwhile. Since
+ * sequence counts only grow, their sum also serves as the generation
+ * of the routing tables for output route caches.
+ *
+ * Lookups further mark themselves in route_readers as long as they
+ * may dereference a device taken from the tables, so that
+ * rt_ip_route_del_all() can wait for them before the device goes
+ * away.
+ */
+static unsigned int         host_table_seq;
+static unsigned int         net_table_seq;
+static DEFINE_PER_CPU(unsigned int, route_readers);
+
+/* Must be called with the table lock held. */
+static inline void rt_route_write_begin(unsigned int *seq)
+{
+    ACCESS_ONCE(*seq) = *seq + 1;
+    smp_wmb();
+}
+
+static inline void rt_route_write_end(unsigned int *seq)
+{
+    smp_wmb();
+    ACCESS_ONCE(*seq) = *seq + 1;
+}
+
+static inline unsigned int rt_route_gen(void)
+{
+    return ACCESS_ONCE(host_table_seq) + ACCESS_ONCE(net_table_seq);
+}
+
+/* Must be called with hard irqs off. */
+static inline void rt_route_reader_enter(void)
+{
+    (*raw_cpu_ptr(&route_readers))++;
+    smp_mb();   /* Pairs with rt_route_sync_readers(). */
+}
+
+static inline void rt_route_reader_exit(void)
+{
+    smp_mb();
+    (*raw_cpu_ptr(&route_readers))++;
+}
+
+static inline unsigned int rt_route_read_begin(void)
+{
+    unsigned int host_seq, net_seq;
+
+
+    for (;;) {
+	host_seq = ACCESS_ONCE(host_table_seq);
+	net_seq  = ACCESS_ONCE(net_table_seq);
+	if (((host_seq | net_seq) & 1) == 0)
+	    break;
+	cpu_relax();
+    }
+
+    smp_rmb();
+
+    return host_seq + net_seq;
+}
+
+static inline int rt_route_read_retry(unsigned int gen)
+{
+    smp_rmb();
+
+    return rt_route_gen() != gen;
+}
+
+/*
+ * Wait for the lookups which may still refer to entries removed from
+ * the tables.
+ */
+static void rt_route_sync_readers(void)
+{
+    unsigned int seq;
+    int cpu;
+
+    smp_mb();
+
+    for_each_online_cpu(cpu) {
+	seq = ACCESS_ONCE(per_cpu(route_readers, cpu));
+	if (seq & 1)
+	    while (ACCESS_ONCE(per_cpu(route_readers, cpu)) == seq)
+		cpu_relax();
+    }
+}
+
 
 
 /***
@@ -569,8 +662,10 @@ int rt_ip_route_add_host(u32 addr, unsigned char *dev_addr,
     while (rt != NULL) {
 	if ((rt->dest_host.ip == addr) &&
 	    (rt->dest_host.rtdev->local_ip == rtdev->local_ip)) {
+	    rt_route_write_begin(&host_table_seq);
 	    rt->dest_host.rtdev = rtdev;
 	    memcpy(rt->dest_host.dev_addr, dev_addr, rtdev->addr_len);
+	    rt_route_write_end(&host_table_seq);
 
 	    if (new_route)
 		rt_free_host_route(new_route);
@@ -584,8 +679,10 @@ int rt_ip_route_add_host(u32 addr, unsigned char *dev_addr,
     }
 
     if (new_route) {
+	rt_route_write_begin(&host_table_seq);
 	new_route->next    = host_hash_tbl[key];
 	host_hash_tbl[key] = new_route;
+	rt_route_write_end(&host_table_seq);
 
 	rtdm_lock_put_irqrestore(&host_table_lock, context);
     } else {
@@ -623,7 +720,9 @@ int rt_ip_route_del_host(u32 addr, struct rtnet_device *rtdev)
     while (rt != NULL) {
 	if ((rt->dest_host.ip == addr) &&
 	    (!rtdev || (rt->dest_host.rtdev->local_ip == rtdev->local_ip))) {
+	    rt_route_write_begin(&host_table_seq);
 	    *last_ptr = rt->next;
+	    rt_route_write_end(&host_table_seq);
 
 	    rt_free_host_route(rt);
 
@@ -666,7 +765,9 @@ void rt_ip_route_del_all(struct rtnet_device *rtdev)
 	host_rt = host_hash_tbl[key];
 	while (host_rt != NULL) {
 	    if (host_rt->dest_host.rtdev == rtdev) {
+		rt_route_write_begin(&host_table_seq);
 		*last_host_ptr = host_rt->next;
+		rt_route_write_end(&host_table_seq);
 
 		rt_free_host_route(host_rt);
 
@@ -684,6 +785,9 @@ void rt_ip_route_del_all(struct rtnet_device *rtdev)
 
     if ((ip = rtdev->local_ip) != 0)
 	rt_ip_route_del_host(ip, rtdev);
+
+    /* lockless lookups may still be referring to rtdev */
+    rt_route_sync_readers();
 }
 
 
@@ -796,7 +900,9 @@ int rt_ip_route_add_net(u32 addr, u32 mask, u32 gw_addr)
     rt = net_hash_tbl[key];
     while (rt != NULL) {
 	if ((rt->dest_net_ip == addr) && (rt->dest_net_mask == mask)) {
+	    rt_route_write_begin(&net_table_seq);
 	    rt->gw_ip = gw_addr;
+	    rt_route_write_end(&net_table_seq);
 
 	    if (new_route)
 		rt_free_net_route(new_route);
@@ -811,8 +917,10 @@ int rt_ip_route_add_net(u32 addr, u32 mask, u32 gw_addr)
     }
 
     if (new_route) {
+	rt_route_write_begin(&net_table_seq);
 	new_route->next = *last_ptr;
 	*last_ptr       = new_route;
+	rt_route_write_end(&net_table_seq);
 
 	rtdm_lock_put_irqrestore(&net_table_lock, context);
 
@@ -853,7 +961,9 @@ int rt_ip_route_del_net(u32 addr, u32 mask)
     rt = net_hash_tbl[key];
     while (rt != NULL) {
 	if ((rt->dest_net_ip == addr) && (rt->dest_net_mask == mask)) {
+	    rt_route_write_begin(&net_table_seq);
 	    *last_ptr = rt->next;
+	    rt_route_write_end(&net_table_seq);
 
 	    rt_free_net_route(rt);
 
@@ -877,112 +987,200 @@ int rt_ip_route_del_net(u32 addr, u32 mask)
 
 
 /***
- *  rt_ip_route_output - looks up output route
+ *  rt_host_route_lookup - looks up host route and references its device
  *
- *  Note: increments refcount on returned rtdev in rt_buf
+ *  Note: must be called from a lookup section (see rt_route_read_begin)
  */
-int rt_ip_route_output(struct dest_route *rt_buf, u32 daddr, u32 saddr)
+static struct rtnet_device *rt_host_route_lookup(struct dest_route *rt_buf,
+						 u32 daddr, u32 saddr)
 {
-    rtdm_lockctx_t      context;
     struct host_route   *host_rt;
-    unsigned int        key;
+    struct rtnet_device *rtdev;
+    int                 n = CONFIG_XENO_DRIVERS_NET_RTIPV4_HOST_ROUTES;
 
-#ifndef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
-    #define DADDR       daddr
-#else
-    #define DADDR       real_daddr
 
-    struct net_route    *net_rt;
-    int                 lookup_gw  = 1;
-    u32                 real_daddr = daddr;
+    host_rt = ACCESS_ONCE(host_hash_tbl[ntohl(daddr) & HOST_HASH_KEY_MASK]);
 
+    /* stale links may send us in circles, bound the walk */
+    while ((host_rt != NULL) && (n-- > 0)) {
+	rtdev = ACCESS_ONCE(host_rt->dest_host.rtdev);
 
-  restart:
-#endif /* !CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
+	if ((host_rt->dest_host.ip == daddr) && (rtdev != NULL) &&
+	    ((saddr == INADDR_ANY) || (rtdev->local_ip == saddr)) &&
+	    rtdev_reference(rtdev)) {
+	    memcpy(rt_buf->dev_addr, &host_rt->dest_host.dev_addr,
+		   sizeof(rt_buf->dev_addr));
+	    return rtdev;
+	}
 
-    key = ntohl(daddr) & HOST_HASH_KEY_MASK;
+	host_rt = ACCESS_ONCE(host_rt->next);
+    }
 
-    rtdm_lock_get_irqsave(&host_table_lock, context);
+    return NULL;
+}
 
-    host_rt = host_hash_tbl[key];
-    if (likely(saddr == INADDR_ANY))
-	while (host_rt != NULL) {
-	    if (host_rt->dest_host.ip == daddr) {
-	      host_route_found:
-		if (!rtdev_reference(host_rt->dest_host.rtdev)) {
-		    rtdm_lock_put_irqrestore(&host_table_lock, context);
-		    goto next;
-		}
 
-		memcpy(rt_buf->dev_addr, &host_rt->dest_host.dev_addr,
-		       sizeof(rt_buf->dev_addr));
-		rt_buf->rtdev = host_rt->dest_host.rtdev;
 
-		rtdm_lock_put_irqrestore(&host_table_lock, context);
+#ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
+/***
+ *  rt_net_route_lookup - looks up gateway to specified host
+ *
+ *  Note: must be called from a lookup section (see rt_route_read_begin)
+ */
+static u32 rt_net_route_lookup(u32 daddr)
+{
+    struct net_route    *net_rt;
+    unsigned int        key;
+    int                 n;
 
-		rt_buf->ip = DADDR;
 
-		return 0;
-	    }
-	  next:
-	    host_rt = host_rt->next;
-	}
-    else
-	while (host_rt != NULL) {
-	    if ((host_rt->dest_host.ip == daddr) &&
-		(host_rt->dest_host.rtdev->local_ip == saddr))
-		goto host_route_found;
-	    host_rt = host_rt->next;
+    key = (ntohl(daddr) >> net_hash_key_shift) & NET_HASH_KEY_MASK;
+
+    for (;;) {
+	n = CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES;
+
+	net_rt = ACCESS_ONCE(net_hash_tbl[key]);
+	while ((net_rt != NULL) && (n-- > 0)) {
+	    if (net_rt->dest_net_ip == (daddr & net_rt->dest_net_mask))
+		return ACCESS_ONCE(net_rt->gw_ip);
+
+	    net_rt = ACCESS_ONCE(net_rt->next);
 	}
 
-    rtdm_lock_put_irqrestore(&host_table_lock, context);
+	/* last try: no hash key */
+	if (key == NET_HASH_TBL_SIZE)
+	    return INADDR_ANY;
+	key = NET_HASH_TBL_SIZE;
+    }
+}
+#endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
-#ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
-    if (lookup_gw) {
-	lookup_gw = 0;
-	key = (ntohl(daddr) >> net_hash_key_shift) & NET_HASH_KEY_MASK;
 
-	rtdm_lock_get_irqsave(&net_table_lock, context);
 
-	net_rt = net_hash_tbl[key];
-	while (net_rt != NULL) {
-	    if (net_rt->dest_net_ip == (daddr & net_rt->dest_net_mask)) {
-		daddr = net_rt->gw_ip;
+/***
+ *  __rt_ip_route_output - looks up output route
+ *
+ *  Returns the generation of the routing tables the lookup was based
+ *  on in *gen.
+ */
+static int __rt_ip_route_output(struct dest_route *rt_buf, u32 daddr,
+				u32 saddr, unsigned int *gen)
+{
+    rtdm_lockctx_t      context;
+    struct rtnet_device *rtdev;
+    u32                 hop;
+    int                 retry;
 
-		rtdm_lock_put_irqrestore(&net_table_lock, context);
 
-		/* start over, now using the gateway ip as destination */
-		goto restart;
-	    }
+    do {
+	hop = daddr;
 
-	    net_rt = net_rt->next;
+	rtdm_lock_irqsave(context);
+	rt_route_reader_enter();
+
+	*gen  = rt_route_read_begin();
+	rtdev = rt_host_route_lookup(rt_buf, hop, saddr);
+
+#ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
+	if (rtdev == NULL) {
+	    /* start over, now using the gateway ip as destination */
+	    hop = rt_net_route_lookup(daddr);
+	    if (hop != INADDR_ANY)
+		rtdev = rt_host_route_lookup(rt_buf, hop, saddr);
+	    else
+		hop = daddr;
 	}
+#endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
-	rtdm_lock_put_irqrestore(&net_table_lock, context);
+	retry = rt_route_read_retry(*gen);
 
-	/* last try: no hash key */
-	rtdm_lock_get_irqsave(&net_table_lock, context);
+	rt_route_reader_exit();
+	rtdm_lock_irqrestore(context);
 
-	net_rt = net_hash_tbl[NET_HASH_TBL_SIZE];
-	while (net_rt != NULL) {
-	    if (net_rt->dest_net_ip == (daddr & net_rt->dest_net_mask)) {
-		daddr = net_rt->gw_ip;
+	if (retry && (rtdev != NULL))
+	    rtdev_dereference(rtdev);
+    } while (retry);
 
-		rtdm_lock_put_irqrestore(&net_table_lock, context);
+    if (rtdev == NULL) {
+	/*ERRMSG*/rtdm_printk("RTnet: host %u.%u.%u.%u unreachable\n",
+			      NIPQUAD(hop));
+	return -EHOSTUNREACH;
+    }
 
-		/* start over, now using the gateway ip as destination */
-		goto restart;
-	    }
+    rt_buf->ip    = daddr;
+    rt_buf->rtdev = rtdev;
 
-	    net_rt = net_rt->next;
+    return 0;
+}
+
+
+
+/***
+ *  rt_ip_route_output - looks up output route
+ *
+ *  Note: increments refcount on returned rtdev in rt_buf
+ */
+int rt_ip_route_output(struct dest_route *rt_buf, u32 daddr, u32 saddr)
+{
+    unsigned int gen;
+
+
+    return __rt_ip_route_output(rt_buf, daddr, saddr, &gen);
+}
+
+
+
+/***
+ *  rt_ip_route_output_cached - looks up output route, trying cache first
+ *
+ *  The cache does not pin its device: it is only trusted as long as
+ *  the routing tables did not change since it was filled.
+ *
+ *  Note: increments refcount on returned rtdev in rt_buf
+ */
+int rt_ip_route_output_cached(struct dest_route_cache *cache,
+			      struct dest_route *rt_buf, u32 daddr, u32 saddr)
+{
+    rtdm_lockctx_t      context;
+    unsigned int        gen;
+    int                 ret;
+
+
+    rtdm_lock_get_irqsave(&cache->lock, context);
+
+    if ((cache->rt.rtdev != NULL) &&
+	(cache->daddr == daddr) && (cache->saddr == saddr)) {
+	rt_route_reader_enter();
+
+	if ((cache->gen == rt_route_gen()) &&
+	    rtdev_reference(cache->rt.rtdev)) {
+	    *rt_buf = cache->rt;
+
+	    rt_route_reader_exit();
+	    rtdm_lock_put_irqrestore(&cache->lock, context);
+
+	    return 0;
 	}
 
-	rtdm_lock_put_irqrestore(&net_table_lock, context);
+	rt_route_reader_exit();
     }
-#endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
-    /*ERRMSG*/rtdm_printk("RTnet: host %u.%u.%u.%u unreachable\n", NIPQUAD(daddr));
-    return -EHOSTUNREACH;
+    rtdm_lock_put_irqrestore(&cache->lock, context);
+
+    ret = __rt_ip_route_output(rt_buf, daddr, saddr, &gen);
+    if (ret < 0)
+	return ret;
+
+    rtdm_lock_get_irqsave(&cache->lock, context);
+
+    cache->daddr = daddr;
+    cache->saddr = saddr;
+    cache->gen   = gen;
+    cache->rt    = *rt_buf;
+
+    rtdm_lock_put_irqrestore(&cache->lock, context);
+
+    return 0;
 }
 
 
@@ -1071,3 +1269,4 @@ EXPORT_SYMBOL_GPL(rt_ip_route_add_host);
 EXPORT_SYMBOL_GPL(rt_ip_route_del_host);
 EXPORT_SYMBOL_GPL(rt_ip_route_del_all);
 EXPORT_SYMBOL_GPL(rt_ip_route_output);
+EXPORT_SYMBOL_GPL(rt_ip_route_output_cached);
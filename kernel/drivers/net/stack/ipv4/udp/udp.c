@@ -294,6 +294,7 @@ int rt_udp_socket(struct rtdm_fd *fd)
     sock->prot.inet.saddr = INADDR_ANY;
     sock->prot.inet.state = TCP_CLOSE;
     sock->prot.inet.tos   = 0;
+    rt_ip_route_cache_init(&sock->prot.inet.rt_cache);
 
     rtdm_lock_get_irqsave(&udp_socket_base_lock, context);
 
@@ -394,12 +395,13 @@ int rt_udp_ioctl(struct rtdm_fd *fd, unsigned int request, void __user *arg)
 
 
 /***
- *  rt_udp_recvmsg
- */
-/***
- *  rt_udp_recvmsg
+ *  __rt_udp_recvmsg
+ *
+ *  @msg lives in kernel memory, its msg_namelen and msg_flags fields
+ *  are updated in place.
  */
-ssize_t rt_udp_recvmsg(struct rtdm_fd *fd, struct user_msghdr *u_msg, int msg_flags)
+static ssize_t __rt_udp_recvmsg(struct rtdm_fd *fd, struct user_msghdr *msg,
+				int msg_flags)
 {
     struct rtsocket     *sock = rtdm_fd_to_private(fd);
     size_t              len;
@@ -412,14 +414,8 @@ ssize_t rt_udp_recvmsg(struct rtdm_fd *fd, struct user_msghdr *u_msg, int msg_fl
     struct sockaddr_in  sin;
     nanosecs_rel_t      timeout = sock->timeout;
     int                 ret, flags;
-    struct user_msghdr _msg, *msg;
-    socklen_t namelen;
     struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
 
-    msg = rtnet_get_arg(fd, &_msg, u_msg, sizeof(_msg));
-    if (IS_ERR(msg))
-	    return PTR_ERR(msg);
-
     if (msg->msg_iovlen < 0)
 	    return -EINVAL;
 
@@ -461,10 +457,7 @@ ssize_t rt_udp_recvmsg(struct rtdm_fd *fd, struct user_msghdr *u_msg, int msg_fl
 	    if (ret)
 		    goto fail;
 
-	    namelen = sizeof(sin);
-	    ret = rtnet_put_arg(fd, &u_msg->msg_namelen, &namelen, sizeof(namelen));
-	    if (ret)
-		    goto fail;
+	    msg->msg_namelen = sizeof(sin);
        }
 
     data_len = ntohs(uh->len) - sizeof(struct udphdr);
@@ -503,11 +496,7 @@ ssize_t rt_udp_recvmsg(struct rtdm_fd *fd, struct user_msghdr *u_msg, int msg_fl
     if (data_len > 0)
 	    flags |= MSG_TRUNC;
 
-    if (flags != msg->msg_flags) {
-	    ret = rtnet_put_arg(fd, &u_msg->msg_flags, &flags, sizeof(flags));
-	    if (ret)
-		    goto fail;
-    }
+    msg->msg_flags = flags;
 out:
     if ((msg_flags & MSG_PEEK) == 0)
         kfree_rtskb(first_skb);
@@ -526,6 +515,74 @@ fail:
 
 
 
+/***
+ *  rt_udp_recvmsg
+ */
+ssize_t rt_udp_recvmsg(struct rtdm_fd *fd, struct user_msghdr *u_msg, int msg_flags)
+{
+    struct user_msghdr _msg, *msg;
+    socklen_t namelen;
+    ssize_t ret;
+    int flags;
+    int err;
+
+    msg = rtnet_get_arg(fd, &_msg, u_msg, sizeof(_msg));
+    if (IS_ERR(msg))
+	    return PTR_ERR(msg);
+
+    namelen = msg->msg_namelen;
+    flags = msg->msg_flags;
+
+    ret = __rt_udp_recvmsg(fd, msg, msg_flags);
+    if (ret < 0)
+	    return ret;
+
+    if (msg->msg_namelen != namelen) {
+	    err = rtnet_put_arg(fd, &u_msg->msg_namelen, &msg->msg_namelen,
+				sizeof(msg->msg_namelen));
+	    if (err)
+		    return err;
+    }
+
+    if (msg->msg_flags != flags) {
+	    err = rtnet_put_arg(fd, &u_msg->msg_flags, &msg->msg_flags,
+				sizeof(msg->msg_flags));
+	    if (err)
+		    return err;
+    }
+
+    return ret;
+}
+
+
+
+/***
+ *  rt_udp_recvmmsg
+ *
+ *  Message headers already live in kernel memory, so datagrams are
+ *  received into them directly. Only the first receive may block
+ *  when MSG_WAITFORONE is set.
+ */
+static int rt_udp_recvmmsg(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			   unsigned int vlen, int msg_flags)
+{
+    unsigned int n;
+    ssize_t ret = 0;
+
+    for (n = 0; n < vlen; n++) {
+	ret = __rt_udp_recvmsg(fd, &mmsg[n].msg_hdr, msg_flags);
+	if (ret < 0)
+	    break;
+	mmsg[n].msg_len = ret;
+	if (msg_flags & MSG_WAITFORONE)
+	    msg_flags |= MSG_DONTWAIT;
+    }
+
+    return n ?: ret;
+}
+
+
+
 /***
  *  struct udpfakehdr
  */
@@ -585,35 +642,35 @@ static int rt_udp_getfrag(const void *p, unsigned char *to,
 
 
 
+/*
+ * Output route kept across the messages of a sendmmsg() batch, along
+ * with the reference on its device.
+ */
+struct rt_udp_route_cache {
+    u32                 daddr;
+    u32                 saddr;
+    struct dest_route   rt;
+};
+
 /***
- *  rt_udp_sendmsg
+ *  __rt_udp_sendmsg
  */
-ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_flags)
+static ssize_t __rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg,
+				int msg_flags, struct rt_udp_route_cache *rc)
 {
     struct rtsocket     *sock = rtdm_fd_to_private(fd);
     size_t              len;
     int                 ulen;
     struct sockaddr_in  _sin, *sin;
     struct udpfakehdr   ufh;
-    struct dest_route   rt;
+    struct dest_route   _rt, *rt;
     u32                 saddr;
     u32                 daddr;
     u16                 dport;
     int                 err;
     rtdm_lockctx_t      context;
-    struct user_msghdr _msg;
     struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
 
-    if (msg_flags & MSG_OOB)   /* Mirror BSD error message compatibility */
-        return -EOPNOTSUPP;
-
-    if (msg_flags & ~(MSG_DONTROUTE|MSG_DONTWAIT) )
-        return -EINVAL;
-
-    msg = rtnet_get_arg(fd, &_msg, msg, sizeof(*msg));
-    if (IS_ERR(msg))
-	    return PTR_ERR(msg);
-
     if (msg->msg_iovlen < 0)
 	    return -EINVAL;
 
@@ -670,13 +727,29 @@ ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int ms
 	    goto out;
     }
 
-    /* get output route */
-    err = rt_ip_route_output(&rt, daddr, saddr);
-    if (err)
-	    goto out;
+    /* get output route, unless the previous message used the same */
+    if (rc && rc->rt.rtdev && rc->daddr == daddr && rc->saddr == saddr)
+	    rt = &rc->rt;
+    else {
+	    rt = rc ? &rc->rt : &_rt;
+	    if (rc && rc->rt.rtdev) {
+		    rtdev_dereference(rc->rt.rtdev);
+		    rc->rt.rtdev = NULL;
+	    }
+	    err = rt_ip_route_output_cached(&sock->prot.inet.rt_cache, rt,
+					    daddr, saddr);
+	    if (err) {
+		    rt->rtdev = NULL;
+		    goto out;
+	    }
+	    if (rc) {
+		    rc->daddr = daddr;
+		    rc->saddr = saddr;
+	    }
+    }
 
     /* we found a route, remember the routing dest-addr could be the netmask */
-    ufh.saddr     = saddr != INADDR_ANY ? saddr : rt.rtdev->local_ip;
+    ufh.saddr     = saddr != INADDR_ANY ? saddr : rt->rtdev->local_ip;
     ufh.daddr     = daddr;
     ufh.uh.dest   = dport;
     ufh.uh.len    = htons(ulen);
@@ -686,10 +759,11 @@ ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int ms
     ufh.iovlen    = msg->msg_iovlen;
     ufh.wcheck    = 0;
 
-    err = rt_ip_build_xmit(sock, rt_udp_getfrag, &ufh, ulen, &rt, msg_flags);
+    err = rt_ip_build_xmit(sock, rt_udp_getfrag, &ufh, ulen, rt, msg_flags);
 
-    /* Drop the reference obtained in rt_ip_route_output() */
-    rtdev_dereference(rt.rtdev);
+    /* Drop the reference obtained in rt_ip_route_output_cached() */
+    if (rc == NULL)
+	    rtdev_dereference(rt->rtdev);
 out:
     rtdm_drop_iovec(iov, iov_fast);
 
@@ -698,6 +772,62 @@ out:
 
 
 
+/***
+ *  rt_udp_sendmsg
+ */
+ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_flags)
+{
+    struct user_msghdr _msg;
+
+    if (msg_flags & MSG_OOB)   /* Mirror BSD error message compatibility */
+        return -EOPNOTSUPP;
+
+    if (msg_flags & ~(MSG_DONTROUTE|MSG_DONTWAIT) )
+        return -EINVAL;
+
+    msg = rtnet_get_arg(fd, &_msg, msg, sizeof(*msg));
+    if (IS_ERR(msg))
+	    return PTR_ERR(msg);
+
+    return __rt_udp_sendmsg(fd, msg, msg_flags, NULL);
+}
+
+
+
+/***
+ *  rt_udp_sendmmsg
+ *
+ *  Consecutive datagrams heading to the same destination share a
+ *  single route lookup.
+ */
+static int rt_udp_sendmmsg(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+			   unsigned int vlen, int msg_flags)
+{
+    struct rt_udp_route_cache rc = { .rt.rtdev = NULL };
+    unsigned int n;
+    ssize_t ret = 0;
+
+    if (msg_flags & MSG_OOB)   /* Mirror BSD error message compatibility */
+        return -EOPNOTSUPP;
+
+    if (msg_flags & ~(MSG_DONTROUTE|MSG_DONTWAIT) )
+        return -EINVAL;
+
+    for (n = 0; n < vlen; n++) {
+	ret = __rt_udp_sendmsg(fd, &mmsg[n].msg_hdr, msg_flags, &rc);
+	if (ret < 0)
+	    break;
+	mmsg[n].msg_len = ret;
+    }
+
+    if (rc.rt.rtdev)
+	rtdev_dereference(rc.rt.rtdev);
+
+    return n ?: ret;
+}
+
+
+
 /***
  *  rt_udp_check
  */
@@ -811,6 +941,8 @@ static struct rtdm_driver udp_driver = {
         .ioctl_nrt =    rt_udp_ioctl,
         .recvmsg_rt =   rt_udp_recvmsg,
         .sendmsg_rt =   rt_udp_sendmsg,
+        .recvmmsg_rt =  rt_udp_recvmmsg,
+        .sendmmsg_rt =  rt_udp_sendmmsg,
         .select =       rt_socket_select_bind,
     },
 };
@@ -25,6 +25,8 @@
 #include <linux/module.h>
 #include <linux/sched.h>
 #include <linux/err.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 
 #include <rtnet_iovec.h>
 #include <rtnet_socket.h>
@@ -32,6 +34,163 @@
 
 MODULE_LICENSE("GPL");
 
+#define RT_PACKET_RING_MAXFRAME     65536
+#define RT_PACKET_RING_MAXSIZE      (64 << 20)
+#define RT_PACKET_FRAME_OFFSET      \
+    RTNET_PACKET_ALIGN(sizeof(struct rtnet_packet_frame))
+
+/*
+ * Frame ring shared with user-space. Ownership of each frame is
+ * passed back and forth through its status word, the kernel side
+ * only keeps track of the next frame to fill (RX) or to send (TX).
+ */
+struct rt_packet_ring {
+    void                *base;
+    size_t              size;       /* page aligned */
+    unsigned int        frame_size;
+    unsigned int        frame_nr;
+    unsigned int        head;
+    int                 losing;
+    u32                 packets;
+    u32                 drops;
+    rtdm_lock_t         lock;       /* RX side */
+    rtdm_mutex_t        mutex;      /* TX side */
+};
+
+static inline struct rtnet_packet_frame *
+rt_packet_frame(struct rt_packet_ring *ring, unsigned int n)
+{
+    return ring->base + n * ring->frame_size;
+}
+
+static inline unsigned int
+rt_packet_next(struct rt_packet_ring *ring, unsigned int n)
+{
+    return ++n == ring->frame_nr ? 0 : n;
+}
+
+static inline int rt_packet_socket_type(struct rtdm_fd *fd)
+{
+    return rtdm_fd_to_context(fd)->device->driver->socket_type;
+}
+
+static struct rt_packet_ring *
+rt_packet_ring_alloc(const struct rtnet_packet_req *req)
+{
+    struct rt_packet_ring *ring;
+    unsigned int n;
+    size_t size;
+
+    if (req->frame_size <= RT_PACKET_FRAME_OFFSET ||
+	req->frame_size > RT_PACKET_RING_MAXFRAME ||
+	(req->frame_size & (RTNET_PACKET_ALIGNMENT - 1)) ||
+	req->frame_nr == 0 ||
+	(u64)req->frame_size * req->frame_nr > RT_PACKET_RING_MAXSIZE)
+	return ERR_PTR(-EINVAL);
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (ring == NULL)
+	return ERR_PTR(-ENOMEM);
+
+    size = PAGE_ALIGN(req->frame_size * req->frame_nr);
+    ring->base = vmalloc_user(size);
+    if (ring->base == NULL) {
+	kfree(ring);
+	return ERR_PTR(-ENOMEM);
+    }
+
+    ring->size       = size;
+    ring->frame_size = req->frame_size;
+    ring->frame_nr   = req->frame_nr;
+    rtdm_lock_init(&ring->lock);
+    rtdm_mutex_init(&ring->mutex);
+
+    for (n = 0; n < ring->frame_nr; n++) {
+	rt_packet_frame(ring, n)->mac = RT_PACKET_FRAME_OFFSET;
+	rt_packet_frame(ring, n)->net = RT_PACKET_FRAME_OFFSET;
+    }
+
+    return ring;
+}
+
+static void rt_packet_ring_free(struct rt_packet_ring *ring)
+{
+    if (ring == NULL)
+	return;
+
+    rtdm_mutex_destroy(&ring->mutex);
+    /* Pages still mapped by user-space are pinned by their mappings. */
+    vfree(ring->base);
+    kfree(ring);
+}
+
+/***
+ *  rt_packet_ring_store - copy a received packet to the next RX frame
+ *
+ *  Returns true if the application may be waiting for it, i.e. if
+ *  it had consumed all frames already.
+ */
+static bool rt_packet_ring_store(struct rt_packet_ring *ring,
+				 struct rtskb *skb, bool raw)
+{
+    struct rtnet_packet_frame *f, *prev;
+    unsigned char   *src;
+    unsigned int    len, snaplen;
+    rtdm_lockctx_t  context;
+    bool            empty;
+
+    src     = raw ? skb->mac.raw : skb->data;
+    len     = skb->len + (skb->data - src);
+    snaplen = min(len, ring->frame_size - RT_PACKET_FRAME_OFFSET);
+
+    rtdm_lock_get_irqsave(&ring->lock, context);
+
+    f = rt_packet_frame(ring, ring->head);
+    if (ACCESS_ONCE(f->status) != RTNET_PACKET_STATUS_KERNEL) {
+	ring->drops++;
+	ring->losing = 1;
+	rtdm_lock_put_irqrestore(&ring->lock, context);
+	return false;
+    }
+
+    smp_mb();   /* Status before contents. */
+
+    memcpy((void *)f + RT_PACKET_FRAME_OFFSET, src, snaplen);
+    f->len      = len;
+    f->snaplen  = snaplen;
+    f->mac      = RT_PACKET_FRAME_OFFSET;
+    f->net      = RT_PACKET_FRAME_OFFSET + (skb->data - src);
+    f->tstamp   = skb->time_stamp;
+    f->ifindex  = skb->rtdev->ifindex;
+    f->protocol = skb->protocol;
+    f->pkttype  = skb->pkt_type;
+    /* Ethernet specific - we rather need some parse handler here */
+    f->halen    = ETH_ALEN;
+    memcpy(f->addr, skb->mac.ethernet->h_source, ETH_ALEN);
+
+    smp_wmb();  /* Contents before status. */
+    ACCESS_ONCE(f->status) = RTNET_PACKET_STATUS_USER |
+	(ring->losing ? RTNET_PACKET_STATUS_LOSING : 0);
+    ring->losing = 0;
+    ring->packets++;
+
+    /*
+     * The application releases frames in order, so it waits for
+     * input only if it gave the previous frame back already. Pairs
+     * with the barrier it issues between releasing a frame and
+     * checking the next one.
+     */
+    smp_mb();
+    prev = rt_packet_frame(ring, (ring->head ?: ring->frame_nr) - 1);
+    empty = ring->frame_nr == 1 ||
+	ACCESS_ONCE(prev->status) == RTNET_PACKET_STATUS_KERNEL;
+
+    ring->head = rt_packet_next(ring, ring->head);
+
+    rtdm_lock_put_irqrestore(&ring->lock, context);
+
+    return empty;
+}
 
 /***
  *  rt_packet_rcv
@@ -43,12 +202,29 @@ static int rt_packet_rcv(struct rtskb *skb, struct rtpacket_type *pt)
     int             ifindex = sock->prot.packet.ifindex;
     void            (*callback_func)(struct rtdm_fd *, void *);
     void            *callback_arg;
+    struct rt_packet_ring *ring;
     rtdm_lockctx_t  context;
+    bool            wake;
 
 
     if (unlikely((ifindex != 0) && (ifindex != skb->rtdev->ifindex)))
 	return -EUNATCH;
 
+    ring = ACCESS_ONCE(sock->prot.packet.rx_ring);
+    if (ring) {
+	wake = rt_packet_ring_store(ring, skb,
+		rt_packet_socket_type(rt_socket_fd(sock)) != SOCK_DGRAM);
+#ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
+	/* ETH_P_ALL listeners only get to see the buffer. */
+	if (pt->type != htons(ETH_P_ALL))
+#endif
+	    kfree_rtskb(skb);
+	if (!wake)
+	    goto out;
+	rtdm_sem_up(&sock->pending_sem);
+	goto notify;
+    }
+
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
     if (pt->type == htons(ETH_P_ALL)) {
 	struct rtskb *clone_skb = rtskb_clone(skb, &sock->skb_pool);
@@ -65,6 +241,7 @@ static int rt_packet_rcv(struct rtskb *skb, struct rtpacket_type *pt)
     rtskb_queue_tail(&sock->incoming, skb);
     rtdm_sem_up(&sock->pending_sem);
 
+  notify:
     rtdm_lock_get_irqsave(&sock->param_lock, context);
     callback_func = sock->callback_func;
     callback_arg  = sock->callback_arg;
@@ -124,9 +301,9 @@ static int rt_packet_bind(struct rtdm_fd *fd, struct rtsocket *sock,
 
 	rtdm_lock_get_irqsave(&sock->param_lock, context);
 
-	/* release existing binding */
+	/* release existing binding, pt itself stays valid */
 	if (pt->type != 0)
-		rtdev_remove_pack(pt);
+		__rtdev_remove_pack(pt);
 
 	pt->type = new_type;
 	sock->prot.packet.ifindex = sll->sll_ifindex;
@@ -216,6 +393,8 @@ static int rt_packet_socket(struct rtdm_fd *fd, int protocol)
 
     sock->prot.packet.packet_type.type		= protocol;
     sock->prot.packet.ifindex			= 0;
+    sock->prot.packet.rx_ring			= NULL;
+    sock->prot.packet.tx_ring			= NULL;
     sock->prot.packet.packet_type.trylock	= rt_packet_trylock;
     sock->prot.packet.packet_type.unlock        = rt_packet_unlock;
 
@@ -249,22 +428,181 @@ static void rt_packet_close(struct rtdm_fd *fd)
     rtdm_lock_get_irqsave(&sock->param_lock, context);
 
     if (pt->type != 0) {
-	rtdev_remove_pack(pt);
+	__rtdev_remove_pack(pt);
 	pt->type = 0;
     }
 
     rtdm_lock_put_irqrestore(&sock->param_lock, context);
 
+    /* wait for deliveries still referring to pt */
+    rtdev_sync_packs();
+
     /* free packets in incoming queue */
     while ((del = rtskb_dequeue(&sock->incoming)) != NULL) {
 	kfree_rtskb(del);
     }
 
+    rt_packet_ring_free(sock->prot.packet.rx_ring);
+    rt_packet_ring_free(sock->prot.packet.tx_ring);
+
     rt_socket_cleanup(fd);
 }
 
 
 
+/***
+ *  rt_packet_setsockopt
+ */
+static int rt_packet_setsockopt(struct rtdm_fd *fd, struct rtsocket *sock,
+				const struct _rtdm_setsockopt_args *setopt)
+{
+	struct rtnet_packet_req _req;
+	const struct rtnet_packet_req *req;
+	struct rt_packet_ring *ring, **ringp;
+	rtdm_lockctx_t context;
+	int ret = 0;
+
+	if (setopt->level != SOL_PACKET)
+		return -ENOPROTOOPT;
+
+	switch (setopt->optname) {
+	case RTNET_PACKET_RX_RING:
+		ringp = &sock->prot.packet.rx_ring;
+		break;
+	case RTNET_PACKET_TX_RING:
+		ringp = &sock->prot.packet.tx_ring;
+		break;
+	default:
+		return -ENOPROTOOPT;
+	}
+
+	if (setopt->optlen != sizeof(*req))
+		return -EINVAL;
+
+	req = rtnet_get_arg(fd, &_req, setopt->optval, sizeof(_req));
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	ring = rt_packet_ring_alloc(req);
+	if (IS_ERR(ring))
+		return PTR_ERR(ring);
+
+	mutex_lock(&sock->pool_nrt_lock);
+
+	rtdm_lock_get_irqsave(&sock->param_lock, context);
+	if (*ringp)
+		ret = -EBUSY;
+	else
+		*ringp = ring;
+	rtdm_lock_put_irqrestore(&sock->param_lock, context);
+
+	mutex_unlock(&sock->pool_nrt_lock);
+
+	if (ret)
+		rt_packet_ring_free(ring);
+
+	return ret;
+}
+
+/***
+ *  rt_packet_getsockopt
+ */
+static int rt_packet_getsockopt(struct rtdm_fd *fd, struct rtsocket *sock,
+				const struct _rtdm_getsockopt_args *getopt)
+{
+	struct rt_packet_ring *ring = sock->prot.packet.rx_ring;
+	struct rtnet_packet_stats stats;
+	socklen_t _len, *len;
+	rtdm_lockctx_t context;
+	int ret;
+
+	if (getopt->level != SOL_PACKET ||
+	    getopt->optname != RTNET_PACKET_STATISTICS)
+		return -ENOPROTOOPT;
+
+	len = rtnet_get_arg(fd, &_len, getopt->optlen, sizeof(_len));
+	if (IS_ERR(len))
+		return PTR_ERR(len);
+
+	if (*len < sizeof(stats))
+		return -EINVAL;
+
+	/* Counters restart from zero after each read. */
+	memset(&stats, 0, sizeof(stats));
+	if (ring) {
+		rtdm_lock_get_irqsave(&ring->lock, context);
+		stats.packets = ring->packets + ring->drops;
+		stats.drops = ring->drops;
+		ring->packets = ring->drops = 0;
+		rtdm_lock_put_irqrestore(&ring->lock, context);
+	}
+
+	ret = rtnet_put_arg(fd, getopt->optval, &stats, sizeof(stats));
+	if (ret)
+		return ret;
+
+	*len = sizeof(stats);
+
+	return rtnet_put_arg(fd, getopt->optlen, len, sizeof(*len));
+}
+
+static int rt_packet_map_ring(struct vm_area_struct *vma,
+			      unsigned long *addr, struct rt_packet_ring *ring)
+{
+	size_t off;
+	int ret;
+
+	if (ring == NULL)
+		return 0;
+
+	for (off = 0; off < ring->size; off += PAGE_SIZE) {
+		ret = vm_insert_page(vma, *addr,
+				     vmalloc_to_page(ring->base + off));
+		if (ret)
+			return ret;
+		*addr += PAGE_SIZE;
+	}
+
+	return 0;
+}
+
+/***
+ *  rt_packet_mmap - map the RX ring, followed by the TX ring
+ */
+static int rt_packet_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtsocket *sock = rtdm_fd_to_private(fd);
+	struct rt_packet_ring *rx, *tx;
+	unsigned long addr;
+	size_t size;
+	int ret;
+
+	mutex_lock(&sock->pool_nrt_lock);
+
+	rx = sock->prot.packet.rx_ring;
+	tx = sock->prot.packet.tx_ring;
+	size = (rx ? rx->size : 0) + (tx ? tx->size : 0);
+
+	ret = -EINVAL;
+	if (size == 0 || vma->vm_pgoff != 0 ||
+	    vma->vm_end - vma->vm_start != size)
+		goto out;
+
+	addr = vma->vm_start;
+	ret = rt_packet_map_ring(vma, &addr, rx);
+	if (ret == 0)
+		ret = rt_packet_map_ring(vma, &addr, tx);
+out:
+	mutex_unlock(&sock->pool_nrt_lock);
+
+	return ret;
+}
+
+
+
 /***
  *  rt_packet_ioctl
  */
@@ -275,6 +613,10 @@ static int rt_packet_ioctl(struct rtdm_fd *fd, unsigned int request, void __user
 	struct _rtdm_setsockaddr_args _setaddr;
 	const struct _rtdm_getsockaddr_args *getaddr;
 	struct _rtdm_getsockaddr_args _getaddr;
+	const struct _rtdm_setsockopt_args *setopt;
+	struct _rtdm_setsockopt_args _setopt;
+	const struct _rtdm_getsockopt_args *getopt;
+	struct _rtdm_getsockopt_args _getopt;
 
 	/* fast path for common socket IOCTLs */
 	if (_IOC_TYPE(request) == RTIOC_TYPE_NETWORK)
@@ -294,6 +636,18 @@ static int rt_packet_ioctl(struct rtdm_fd *fd, unsigned int request, void __user
 		return rt_packet_getsockname(fd, sock, getaddr->addr,
 					     getaddr->addrlen);
 
+	case _RTIOC_SETSOCKOPT:
+		setopt = rtnet_get_arg(fd, &_setopt, arg, sizeof(_setopt));
+		if (IS_ERR(setopt))
+			return PTR_ERR(setopt);
+		return rt_packet_setsockopt(fd, sock, setopt);
+
+	case _RTIOC_GETSOCKOPT:
+		getopt = rtnet_get_arg(fd, &_getopt, arg, sizeof(_getopt));
+		if (IS_ERR(getopt))
+			return PTR_ERR(getopt);
+		return rt_packet_getsockopt(fd, sock, getopt);
+
 	default:
 		return rt_socket_if_ioctl(fd, request, arg);
 	}
@@ -301,6 +655,31 @@ static int rt_packet_ioctl(struct rtdm_fd *fd, unsigned int request, void __user
 
 
 
+/***
+ *  rt_packet_ring_wait - wait for the RX ring to become non-empty
+ */
+static ssize_t rt_packet_ring_wait(struct rtsocket *sock, int msg_flags)
+{
+    nanosecs_rel_t      timeout = sock->timeout;
+    int                 ret;
+
+    if (msg_flags & MSG_DONTWAIT)
+	timeout = -1;
+
+    ret = rtdm_sem_timeddown(&sock->pending_sem, timeout, NULL);
+    switch (ret) {
+	case 0:
+	case -EWOULDBLOCK:
+	case -ETIMEDOUT:
+	case -EINTR:
+	    return ret;
+	default:
+	    return -EBADF;  /* socket has been closed */
+    }
+}
+
+
+
 /***
  *  rt_packet_recvmsg
  */
@@ -318,6 +697,10 @@ rt_packet_recvmsg(struct rtdm_fd *fd, struct user_msghdr *u_msg, int msg_flags)
     socklen_t namelen;
     struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
 
+    /* input is delivered through the mapped RX ring */
+    if (sock->prot.packet.rx_ring)
+	return rt_packet_ring_wait(sock, msg_flags);
+
     msg = rtnet_get_arg(fd, &_msg, u_msg, sizeof(_msg));
     if (IS_ERR(msg))
 	    return PTR_ERR(msg);
@@ -413,11 +796,90 @@ fail:
 
 
 
+/*
+ * Output device kept across the messages of a sendmmsg() batch, along
+ * with the reference on it.
+ */
+struct rt_packet_dev_cache {
+    int                 ifindex;
+    struct rtnet_device *rtdev;
+};
+
+static struct rtnet_device *
+rt_packet_get_dev(struct rt_packet_dev_cache *dc, int ifindex)
+{
+    struct rtnet_device *rtdev;
+
+    if (dc && dc->rtdev && dc->ifindex == ifindex)
+	return dc->rtdev;
+
+    if (dc && dc->rtdev) {
+	rtdev_dereference(dc->rtdev);
+	dc->rtdev = NULL;
+    }
+
+    rtdev = rtdev_get_by_index(ifindex);
+    if (rtdev && dc) {
+	dc->rtdev = rtdev;
+	dc->ifindex = ifindex;
+    }
+
+    return rtdev;
+}
+
 /***
- *  rt_packet_sendmsg
+ *  rt_packet_alloc_xmit - allocate an outgoing rtskb for len bytes
+ *
+ *  The link layer header is already built for datagram sockets, the
+ *  payload still has to be appended.
+ */
+static struct rtskb *
+rt_packet_alloc_xmit(struct rtdm_fd *fd, struct rtsocket *sock,
+		     struct rtnet_device *rtdev, unsigned short proto,
+		     unsigned char *addr, size_t len)
+{
+    int                 socket_type = rt_packet_socket_type(fd);
+    struct rtskb        *rtskb;
+
+    /* If an RTmac discipline is active, this becomes a pure sanity check to
+       avoid writing beyond rtskb boundaries. The hard check is then performed
+       upon rtdev_xmit() by the discipline's xmit handler. */
+    if (len > rtdev->mtu +
+	((socket_type == SOCK_RAW) ? rtdev->hard_header_len : 0))
+	return ERR_PTR(-EMSGSIZE);
+
+    rtskb = alloc_rtskb(rtdev->hard_header_len + len, &sock->skb_pool);
+    if (rtskb == NULL)
+	return ERR_PTR(-ENOBUFS);
+
+    rtskb_reserve(rtskb, rtdev->hard_header_len);
+
+    rtskb->rtdev    = rtdev;
+    rtskb->priority = sock->priority;
+
+    if (rtdev->hard_header) {
+	int hdr_len;
+
+	hdr_len = rtdev->hard_header(rtskb, rtdev, ntohs(proto),
+				     addr, NULL, len);
+	if (socket_type != SOCK_DGRAM) {
+	    rtskb->tail = rtskb->data;
+	    rtskb->len = 0;
+	} else if (hdr_len < 0) {
+	    kfree_rtskb(rtskb);
+	    return ERR_PTR(-EINVAL);
+	}
+    }
+
+    return rtskb;
+}
+
+/***
+ *  __rt_packet_sendmsg
  */
 static ssize_t
-rt_packet_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_flags)
+__rt_packet_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg,
+		    int msg_flags, struct rt_packet_dev_cache *dc)
 {
     struct rtsocket     *sock = rtdm_fd_to_private(fd);
     size_t              len;
@@ -428,18 +890,8 @@ rt_packet_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_fla
     unsigned char       *addr;
     int                 ifindex;
     ssize_t             ret;
-    struct user_msghdr _msg;
     struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
 
-    if (msg_flags & MSG_OOB)    /* Mirror BSD error message compatibility */
-	return -EOPNOTSUPP;
-    if (msg_flags & ~MSG_DONTWAIT)
-	return -EINVAL;
-
-    msg = rtnet_get_arg(fd, &_msg, msg, sizeof(*msg));
-    if (IS_ERR(msg))
-	    return PTR_ERR(msg);
-
     if (msg->msg_iovlen < 0)
 	    return -EINVAL;
 
@@ -478,49 +930,22 @@ rt_packet_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_fla
 	    addr    = sll->sll_addr;
     }
 
-    if ((rtdev = rtdev_get_by_index(ifindex)) == NULL) {
-	    ret = -ENODEV;
-	    goto abort;
-    }
-
-    len = rtdm_get_iov_flatlen(iov, msg->msg_iovlen);
-    rtskb = alloc_rtskb(rtdev->hard_header_len + len, &sock->skb_pool);
-    if (rtskb == NULL) {
-	ret = -ENOBUFS;
-	goto out;
-    }
-
-    /* If an RTmac discipline is active, this becomes a pure sanity check to
-       avoid writing beyond rtskb boundaries. The hard check is then performed
-       upon rtdev_xmit() by the discipline's xmit handler. */
-    if (len > rtdev->mtu +
-	((rtdm_fd_to_context(fd)->device->driver->socket_type == SOCK_RAW) ?
-	    rtdev->hard_header_len : 0)) {
-	ret = -EMSGSIZE;
-	goto err;
+    rtdev = rt_packet_get_dev(dc, ifindex);
+    if (rtdev == NULL) {
+	ret = -ENODEV;
+	goto abort;
     }
 
     if ((sll != NULL) && (sll->sll_halen != rtdev->addr_len)) {
 	ret = -EINVAL;
-	goto err;
+	goto out;
     }
 
-    rtskb_reserve(rtskb, rtdev->hard_header_len);
-
-    rtskb->rtdev    = rtdev;
-    rtskb->priority = sock->priority;
-
-    if (rtdev->hard_header) {
-	int hdr_len;
-
-	ret = -EINVAL;
-	hdr_len = rtdev->hard_header(rtskb, rtdev, ntohs(proto),
-				     addr, NULL, len);
-	if (rtdm_fd_to_context(fd)->device->driver->socket_type != SOCK_DGRAM) {
-	    rtskb->tail = rtskb->data;
-	    rtskb->len = 0;
-	} else if (hdr_len < 0)
-	    goto err;
+    len = rtdm_get_iov_flatlen(iov, msg->msg_iovlen);
+    rtskb = rt_packet_alloc_xmit(fd, sock, rtdev, proto, addr, len);
+    if (IS_ERR(rtskb)) {
+	ret = PTR_ERR(rtskb);
+	goto out;
     }
 
     ret = rtnet_read_from_iov(fd, iov, msg->msg_iovlen, rtskb_put(rtskb, len), len);
@@ -534,7 +959,8 @@ rt_packet_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_fla
     }
 
  out:
-    rtdev_dereference(rtdev);
+    if (dc == NULL)
+	rtdev_dereference(rtdev);
  abort:
     rtdm_drop_iovec(iov, iov_fast);
 
@@ -546,6 +972,162 @@ rt_packet_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_fla
 
 
 
+/***
+ *  rt_packet_ring_xmit - send a TX ring frame
+ */
+static int rt_packet_ring_xmit(struct rtdm_fd *fd, struct rtsocket *sock,
+			       struct rt_packet_ring *ring,
+			       struct rtnet_packet_frame *f,
+			       struct rt_packet_dev_cache *dc)
+{
+    struct rtnet_device *rtdev;
+    struct rtskb        *rtskb;
+    unsigned short      proto;
+    unsigned char       *addr = NULL;
+    size_t              len = f->len;
+    int                 ifindex;
+
+    if (len > ring->frame_size - RT_PACKET_FRAME_OFFSET)
+	return -EINVAL;
+
+    ifindex = f->ifindex ?: sock->prot.packet.ifindex;
+    proto   = f->protocol ?: sock->prot.packet.packet_type.type;
+
+    rtdev = rt_packet_get_dev(dc, ifindex);
+    if (rtdev == NULL)
+	return -ENODEV;
+
+    if (f->halen) {
+	if (f->halen != rtdev->addr_len)
+	    return -EINVAL;
+	addr = f->addr;
+    }
+
+    rtskb = rt_packet_alloc_xmit(fd, sock, rtdev, proto, addr, len);
+    if (IS_ERR(rtskb))
+	return PTR_ERR(rtskb);
+
+    memcpy(rtskb_put(rtskb, len), (void *)f + RT_PACKET_FRAME_OFFSET, len);
+
+    if ((rtdev->flags & IFF_UP) == 0) {
+	kfree_rtskb(rtskb);
+	return -ENETDOWN;
+    }
+
+    return rtdev_xmit(rtskb);
+}
+
+/***
+ *  rt_packet_ring_flush - send all frames requested in the TX ring
+ *
+ *  Stops at the first frame not marked for sending. A frame is left
+ *  pending when running out of buffers, so that the next flush
+ *  retries it. Returns the number of frames sent.
+ */
+static ssize_t rt_packet_ring_flush(struct rtdm_fd *fd, struct rtsocket *sock,
+				    struct rt_packet_ring *ring)
+{
+    struct rt_packet_dev_cache dc = { .rtdev = NULL };
+    struct rtnet_packet_frame *f;
+    ssize_t             count = 0;
+    int                 ret;
+
+    ret = rtdm_mutex_lock(&ring->mutex);
+    if (ret)
+	return ret;
+
+    for (;;) {
+	f = rt_packet_frame(ring, ring->head);
+	if (ACCESS_ONCE(f->status) != RTNET_PACKET_STATUS_SEND_REQUEST)
+	    break;
+
+	smp_rmb();  /* Status before contents. */
+
+	ret = rt_packet_ring_xmit(fd, sock, ring, f, &dc);
+	if (ret == -ENOBUFS)
+	    break;
+
+	smp_mb();   /* Contents read before handing the frame back. */
+	ACCESS_ONCE(f->status) = ret ? RTNET_PACKET_STATUS_WRONG_FORMAT :
+	    RTNET_PACKET_STATUS_AVAILABLE;
+	ring->head = rt_packet_next(ring, ring->head);
+	if (ret)
+	    break;
+
+	count++;
+    }
+
+    rtdm_mutex_unlock(&ring->mutex);
+
+    if (dc.rtdev)
+	rtdev_dereference(dc.rtdev);
+
+    return count ?: ret;
+}
+
+
+
+/***
+ *  rt_packet_sendmsg
+ */
+static ssize_t
+rt_packet_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg, int msg_flags)
+{
+    struct rtsocket *sock = rtdm_fd_to_private(fd);
+    struct user_msghdr _msg;
+
+    if (msg_flags & MSG_OOB)    /* Mirror BSD error message compatibility */
+	return -EOPNOTSUPP;
+    if (msg_flags & ~MSG_DONTWAIT)
+	return -EINVAL;
+
+    msg = rtnet_get_arg(fd, &_msg, msg, sizeof(*msg));
+    if (IS_ERR(msg))
+	    return PTR_ERR(msg);
+
+    /* an empty message kicks the mapped TX ring */
+    if (msg->msg_iovlen == 0 && sock->prot.packet.tx_ring)
+	return rt_packet_ring_flush(fd, sock, sock->prot.packet.tx_ring);
+
+    return __rt_packet_sendmsg(fd, msg, msg_flags, NULL);
+}
+
+
+
+/***
+ *  rt_packet_sendmmsg
+ *
+ *  Consecutive frames heading to the same interface share a single
+ *  device lookup.
+ */
+static int
+rt_packet_sendmmsg(struct rtdm_fd *fd, struct mmsghdr *mmsg,
+		   unsigned int vlen, int msg_flags)
+{
+    struct rt_packet_dev_cache dc = { .rtdev = NULL };
+    unsigned int n;
+    ssize_t ret = 0;
+
+    if (msg_flags & MSG_OOB)    /* Mirror BSD error message compatibility */
+	return -EOPNOTSUPP;
+    if (msg_flags & ~MSG_DONTWAIT)
+	return -EINVAL;
+
+    for (n = 0; n < vlen; n++) {
+	ret = __rt_packet_sendmsg(fd, &mmsg[n].msg_hdr, msg_flags, &dc);
+	if (ret < 0)
+	    break;
+	mmsg[n].msg_len = ret;
+    }
+
+    if (dc.rtdev)
+	rtdev_dereference(dc.rtdev);
+
+    return n ?: ret;
+}
+
+
+
 static struct rtdm_driver packet_proto_drv = {
     .profile_info =     RTDM_PROFILE_INFO(packet,
 					RTDM_CLASS_NETWORK,
@@ -566,7 +1148,9 @@ static struct rtdm_driver packet_proto_drv = {
 	.ioctl_nrt =    rt_packet_ioctl,
 	.recvmsg_rt =   rt_packet_recvmsg,
 	.sendmsg_rt =   rt_packet_sendmsg,
+	.sendmmsg_rt =  rt_packet_sendmmsg,
 	.select =       rt_socket_select_bind,
+	.mmap =         rt_packet_mmap,
     },
 };
 
@@ -595,7 +1179,9 @@ static struct rtdm_driver raw_packet_proto_drv = {
 	.ioctl_nrt =    rt_packet_ioctl,
 	.recvmsg_rt =   rt_packet_recvmsg,
 	.sendmsg_rt =   rt_packet_sendmsg,
+	.sendmmsg_rt =  rt_packet_sendmmsg,
 	.select =       rt_socket_select_bind,
+	.mmap =         rt_packet_mmap,
     },
 };
 
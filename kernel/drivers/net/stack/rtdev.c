@@ -28,6 +28,9 @@
 #include <linux/if_arp.h> /* ARPHRD_ETHER */
 #include <linux/netdevice.h>
 #include <linux/moduleparam.h>
+#include <linux/delay.h>
+#include <linux/jhash.h>
+#include <asm/unaligned.h>
 
 #include <rtnet_internal.h>
 #include <rtskb.h>
@@ -41,6 +44,15 @@ module_param(device_rtskbs, uint, 0444);
 MODULE_PARM_DESC(device_rtskbs, "Number of additional global realtime socket "
 		 "buffers per network adapter");
 
+static unsigned int poll_prio = RTNET_DEF_STACK_PRIORITY;
+module_param(poll_prio, uint, 0444);
+MODULE_PARM_DESC(poll_prio, "Priority of the device poll tasks");
+
+static unsigned int tx_queue_policy = RTDEV_TXQ_PRIO;
+module_param(tx_queue_policy, uint, 0444);
+MODULE_PARM_DESC(tx_queue_policy, "TX queue selection on multi-queue adapters "
+		 "(0: socket priority, 1: flow hash)");
+
 struct rtnet_device         *rtnet_devices[MAX_RT_DEVICES];
 static struct rtnet_device  *loopback_device;
 static DEFINE_RTDM_LOCK(rtnet_devices_rt_lock);
@@ -73,6 +85,22 @@ struct rtskb *rtnetdev_alloc_rtskb(struct rtnet_device *rtdev, unsigned int size
 }
 EXPORT_SYMBOL_GPL(rtnetdev_alloc_rtskb);
 
+/***
+ *  rtdev_queue_alloc_rtskb - allocate a receive buffer for a device queue
+ *  @rtdev:         the device
+ *  @queue:         queue index
+ *  @size:          buffer size
+ */
+struct rtskb *rtdev_queue_alloc_rtskb(struct rtnet_device *rtdev,
+				      unsigned int queue, unsigned int size)
+{
+    struct rtskb *rtskb = alloc_rtskb(size, rtdev->queues[queue].pool);
+    if (rtskb)
+	rtskb->rtdev = rtdev;
+    return rtskb;
+}
+EXPORT_SYMBOL_GPL(rtdev_queue_alloc_rtskb);
+
 /***
  *  __rtdev_get_by_name - find a rtnet_device by its name
  *  @name: name to find
@@ -261,7 +289,7 @@ struct rtnet_device *rtdev_alloc(unsigned sizeof_priv, unsigned dev_pool_size)
 {
     struct rtnet_device *rtdev;
     unsigned            alloc_size;
-    int                 ret;
+    int                 ret, i;
 
 
     /* ensure 32-byte alignment of the private area */
@@ -287,6 +315,18 @@ struct rtnet_device *rtdev_alloc(unsigned sizeof_priv, unsigned dev_pool_size)
     rtdm_lock_init(&rtdev->rtdev_lock);
     mutex_init(&rtdev->nrt_lock);
 
+    rtdev->rx_mode     = RTDEV_RX_IRQ;
+    rtdev->poll_budget = RTDEV_DEF_POLL_BUDGET;
+
+    for (i = 0; i < MAX_RT_DEV_QUEUES; i++) {
+	rtdm_mutex_init(&rtdev->queues[i].xmit_mutex);
+	rtdev->queues[i].irq_cpu = -1;
+    }
+    rtdev->num_queues          = 1;
+    rtdev->tx_policy           = tx_queue_policy;
+    rtdev->queues[0].pool      = &rtdev->dev_pool;
+    rtdev->queues[0].pool_size = dev_pool_size;
+
     atomic_set(&rtdev->refcount, 0);
 
     /* scale global rtskb pool */
@@ -305,10 +345,20 @@ struct rtnet_device *rtdev_alloc(unsigned sizeof_priv, unsigned dev_pool_size)
  */
 void rtdev_free (struct rtnet_device *rtdev)
 {
+    int i;
+
+
     if (rtdev != NULL) {
+	for (i = 1; i < MAX_RT_DEV_QUEUES; i++)
+	    if (rtdev->queues[i].pool) {
+		rtskb_pool_release(rtdev->queues[i].pool);
+		kfree(rtdev->queues[i].pool);
+	    }
 	rtskb_pool_release(&rtdev->dev_pool);
 	rtskb_pool_shrink(&global_pool, rtdev->add_rtskbs);
 	rtdev->stack_event = NULL;
+	for (i = 0; i < MAX_RT_DEV_QUEUES; i++)
+	    rtdm_mutex_destroy(&rtdev->queues[i].xmit_mutex);
 	rtdm_mutex_destroy(&rtdev->xmit_mutex);
 	kfree(rtdev);
     }
@@ -316,6 +366,57 @@ void rtdev_free (struct rtnet_device *rtdev)
 
 
 
+/***
+ *  rtdev_set_queues - set the number of hardware queue pairs of a device
+ *  @rtdev:         the device
+ *  @num_queues:    number of RX/TX queue pairs the driver serves
+ *  @pool_size:     rtskbs to allocate for each additional queue
+ *
+ *  Queues beyond the first one get a private rtskb pool. Called from
+ *  the driver probe function, or from its open handler when falling
+ *  back to fewer queues. Since their buffers may still be in flight,
+ *  pools of dropped queues are only released by rtdev_free().
+ */
+int rtdev_set_queues(struct rtnet_device *rtdev, unsigned int num_queues,
+		     unsigned int pool_size)
+{
+    struct rtdev_queue  *queue;
+    unsigned int        i;
+
+
+    if (num_queues == 0 || num_queues > MAX_RT_DEV_QUEUES)
+	return -EINVAL;
+
+    for (i = 1; i < num_queues; i++) {
+	queue = &rtdev->queues[i];
+	if (queue->pool)
+	    continue;
+
+	queue->pool = kmalloc(sizeof(*queue->pool), GFP_KERNEL);
+	if (queue->pool == NULL)
+	    goto fail;
+
+	if (rtskb_pool_init(queue->pool, pool_size,
+			    &rtdev_ops, rtdev) < pool_size) {
+	    rtskb_pool_release(queue->pool);
+	    kfree(queue->pool);
+	    queue->pool = NULL;
+	    goto fail;
+	}
+	queue->pool_size = pool_size;
+    }
+
+    rtdev->num_queues = num_queues;
+
+    return 0;
+
+  fail:
+    printk(KERN_ERR "RTnet: cannot allocate pool of queue %u\n", i);
+    return -ENOMEM;
+}
+
+
+
 /**
  * rtalloc_etherdev - Allocates and sets up an ethernet device
  * @sizeof_priv: size of additional driver-private structure to
@@ -538,6 +639,10 @@ int rt_register_rtnetdev(struct rtnet_device *rtdev)
     if (err)
 	    goto fail_map;
 
+    err = rt_stack_rx_queue_create(rtdev);
+    if (err)
+	    goto fail_rxq;
+
     rtdm_lock_get_irqsave(&rtnet_devices_rt_lock, context);
 
     if (rtdev->flags & IFF_LOOPBACK) {
@@ -569,6 +674,8 @@ int rt_register_rtnetdev(struct rtnet_device *rtdev)
     return 0;
 
 fail_loopback:
+    rt_stack_rx_queue_destroy(rtdev);
+fail_rxq:
     rtdev_unmap_all_rtskbs(rtdev);
 fail_map:
     if (rtdev->sysbind)
@@ -618,6 +725,7 @@ int rt_unregister_rtnetdev(struct rtnet_device *rtdev)
 	    hook->unregister_device(rtdev);
     }
 
+    rt_stack_rx_queue_destroy(rtdev);
     rtdev_unmap_all_rtskbs(rtdev);
 
     mutex_unlock(&rtnet_devices_nrt_lock);
@@ -709,24 +817,63 @@ int rtdev_close(struct rtnet_device *rtdev)
 
 static int rtdev_locked_xmit(struct rtskb *skb, struct rtnet_device *rtdev)
 {
-    int ret;
+    struct rtdev_queue  *queue = &rtdev->queues[skb->queue_mapping];
+    int                 ret;
 
 
-    rtdm_mutex_lock(&rtdev->xmit_mutex);
+    rtdm_mutex_lock(&queue->xmit_mutex);
     ret = rtdev->hard_start_xmit(skb, rtdev);
-    rtdm_mutex_unlock(&rtdev->xmit_mutex);
+    if (ret == 0)
+	queue->tx_packets++;
+    rtdm_mutex_unlock(&queue->xmit_mutex);
 
     return ret;
 }
 
 
 
+/***
+ *  rtdev_select_queue - map an outgoing packet on a TX queue
+ *
+ *  Must be called before the rtskb is acquired by the device: its
+ *  owning pool then still identifies the sending socket.
+ */
+static unsigned int rtdev_select_queue(struct rtnet_device *rtdev,
+				       struct rtskb *skb)
+{
+    unsigned int    prio;
+    u32             hash;
+
+
+    if (rtdev->num_queues == 1)
+	return 0;
+
+    if (rtdev->tx_policy == RTDEV_TXQ_HASH) {
+	/* Flow = sending socket and destination station, so that the
+	   packets (and fragments) of a flow are never reordered. */
+	hash = jhash_1word((u32)(unsigned long)skb->pool, rtdev->ifindex);
+	if (skb->len >= rtdev->hard_header_len && rtdev->addr_len >= 4)
+	    hash = jhash_2words(hash, get_unaligned((u32 *)skb->data), 0);
+	return hash % rtdev->num_queues;
+    }
+
+    /* Most urgent priorities first, spread linearly over the queues */
+    prio = skb->priority & RTSKB_PRIO_MASK;
+    if (prio > QUEUE_MIN_PRIO)
+	prio = QUEUE_MIN_PRIO;
+
+    return prio * rtdev->num_queues / (QUEUE_MIN_PRIO + 1);
+}
+
+
+
 /***
  *  rtdev_xmit - send real-time packet
  */
 int rtdev_xmit(struct rtskb *rtskb)
 {
     struct rtnet_device *rtdev;
+    unsigned int        queue;
     int                 err;
 
 
@@ -740,7 +887,10 @@ int rtdev_xmit(struct rtskb *rtskb)
 	return err;
     }
 
-    if (rtskb_acquire(rtskb, &rtdev->dev_pool) != 0) {
+    queue = rtdev_select_queue(rtdev, rtskb);
+    rtskb->queue_mapping = queue;
+
+    if (rtskb_acquire(rtskb, rtdev->queues[queue].pool) != 0) {
 	err = -ENOBUFS;
 	kfree_rtskb(rtskb);
 	return err;
@@ -804,6 +954,362 @@ unsigned int rt_hard_mtu(struct rtnet_device *rtdev, unsigned int priority)
 }
 
 
+
+static void rtdev_poll_task(void *arg)
+{
+    struct rtdev_poll   *poll = arg;
+    struct rtnet_device *rtdev = poll->rtdev;
+    nanosecs_rel_t      backoff;
+    int                 budget;
+
+
+    while (!rtdm_task_should_stop()) {
+	if (rtdm_event_wait(&poll->event) < 0)
+	    break;
+
+	for (;;) {
+	    budget = ACCESS_ONCE(rtdev->poll_budget);
+	    if (rtdev_poll_run(poll, budget) < budget)
+		break;
+
+	    /* Hand the queue back early if someone waits for it. */
+	    if (test_bit(RTDEV_POLL_STOP, &poll->state) ||
+		test_bit(RTDEV_POLL_DISABLE, &poll->state))
+		break;
+
+	    /* Budget exhausted: leave the CPU to lower priority real-time
+	       work for one ITR period, the hardware queues up meanwhile. */
+	    backoff = (rtdev->itr ? : RTDEV_DEF_POLL_BACKOFF) * 1000ULL;
+	    if (rtdm_task_sleep(backoff) < 0)
+		break;
+	}
+
+	clear_bit(RTDEV_POLL_SCHED, &poll->state);
+	smp_mb__after_atomic();
+	poll->irq_enable(poll);
+    }
+}
+
+
+
+/***
+ *  rtdev_queue_cpu - real-time CPU serving a device queue
+ *
+ *  Spreads the queues of all devices over the real-time CPUs.
+ */
+int rtdev_queue_cpu(struct rtnet_device *rtdev, unsigned int queue)
+{
+    cpumask_t   rt_cpus;
+    int         cpu, n;
+
+
+    cpumask_and(&rt_cpus, &cobalt_cpu_affinity, cpu_online_mask);
+    n = cpumask_weight(&rt_cpus);
+    n = n > 0 ? (rtdev->ifindex - 1 + queue) % n : 0;
+    for_each_cpu(cpu, &rt_cpus)
+	if (n-- == 0)
+	    break;
+
+    return cpu < nr_cpu_ids ? cpu : 0;
+}
+
+
+
+/***
+ *  rtdev_set_queue_irq_affinity - route a queue interrupt to its CPU
+ *  @rtdev:         the device, registered
+ *  @queue:         queue index
+ *  @irq_handle:    interrupt of the queue
+ *
+ *  Called from non-real-time context after requesting the interrupt.
+ */
+void rtdev_set_queue_irq_affinity(struct rtnet_device *rtdev,
+				  unsigned int queue, rtdm_irq_t *irq_handle)
+{
+    int cpu = rtdev_queue_cpu(rtdev, queue);
+
+    xnintr_affinity(irq_handle, *cpumask_of(cpu));
+    if (queue < rtdev->num_queues)
+	rtdev->queues[queue].irq_cpu = cpu;
+}
+
+
+
+/* Poll tasks run on the CPU receiving the queue interrupt. */
+static int rtdev_poll_start(struct rtdev_poll *poll)
+{
+    struct rtnet_device *rtdev = poll->rtdev;
+    char                name[32];
+    cpumask_t           affinity;
+    int                 err;
+
+
+    cpumask_clear(&affinity);
+    cpumask_set_cpu(rtdev_queue_cpu(rtdev, poll->index), &affinity);
+
+    snprintf(name, sizeof(name), "rtnet-poll-%s/%u", rtdev->name, poll->index);
+    err = __rtdm_task_init(&poll->task, name, rtdev_poll_task, poll,
+			   poll_prio, 0, &affinity);
+    if (err == 0)
+	set_bit(RTDEV_POLL_TASK, &poll->state);
+
+    return err;
+}
+
+
+
+/* The caller makes sure that no queue is handed over to the task
+   anymore: the queue is held by the driver or by the caller, or the
+   device never reached polling mode. */
+static void rtdev_poll_stop(struct rtdev_poll *poll)
+{
+    if (!test_and_clear_bit(RTDEV_POLL_TASK, &poll->state))
+	return;
+
+    rtdm_task_destroy(&poll->task);
+}
+
+
+
+/* Wait for the poll task to release a queue, then take it. Returns
+   false if the driver holds the queue instead. */
+static bool rtdev_poll_claim(struct rtdev_poll *poll)
+{
+    set_bit(RTDEV_POLL_STOP, &poll->state);
+
+    while (test_and_set_bit(RTDEV_POLL_SCHED, &poll->state)) {
+	if (test_bit(RTDEV_POLL_DISABLE, &poll->state)) {
+	    clear_bit(RTDEV_POLL_STOP, &poll->state);
+	    return false;
+	}
+	msleep(1);
+    }
+
+    return true;
+}
+
+
+
+static void rtdev_poll_release(struct rtdev_poll *poll)
+{
+    clear_bit(RTDEV_POLL_STOP, &poll->state);
+    smp_mb__before_atomic();
+    clear_bit(RTDEV_POLL_SCHED, &poll->state);
+    smp_mb__after_atomic();
+    poll->irq_enable(poll);
+}
+
+
+
+/***
+ *  rtdev_add_poll - register a queue of a device for polling
+ *  @rtdev:         the device
+ *  @poll:          poll context, usually embedded in the queue
+ *  @fn:            poll handler
+ *  @irq_enable:    unmask the queue interrupt
+ *  @irq_disable:   mask the queue interrupt (optional)
+ *
+ *  The queue starts disabled, see rtdev_poll_enable(). Called from
+ *  non-real-time context.
+ */
+int rtdev_add_poll(struct rtnet_device *rtdev, struct rtdev_poll *poll,
+		   int (*fn)(struct rtdev_poll *poll, int budget),
+		   void (*irq_enable)(struct rtdev_poll *poll),
+		   void (*irq_disable)(struct rtdev_poll *poll))
+{
+    int ret = 0;
+
+
+    memset(poll, 0, sizeof(*poll));
+    poll->rtdev       = rtdev;
+    poll->poll        = fn;
+    poll->irq_enable  = irq_enable;
+    poll->irq_disable = irq_disable;
+    poll->state       = (1 << RTDEV_POLL_SCHED) | (1 << RTDEV_POLL_DISABLE);
+    rtdm_event_init(&poll->event, 0);
+
+    mutex_lock(&rtdev->nrt_lock);
+
+    if (rtdev->nr_polls >= MAX_RT_DEV_QUEUES) {
+	ret = -ENOSPC;
+	goto out;
+    }
+
+    poll->index = rtdev->nr_polls;
+    if (rtdev->rx_mode == RTDEV_RX_POLL) {
+	ret = rtdev_poll_start(poll);
+	if (ret)
+	    goto out;
+    }
+
+    rtdev->polls[rtdev->nr_polls++] = poll;
+
+  out:
+    mutex_unlock(&rtdev->nrt_lock);
+
+    if (ret) {
+	rtdm_event_destroy(&poll->event);
+	poll->rtdev = NULL;
+    }
+
+    return ret;
+}
+
+
+
+/***
+ *  rtdev_del_poll - unregister a queue
+ *  @poll:          poll context, may not have been registered
+ *
+ *  The queue must be disabled. Called from non-real-time context.
+ */
+void rtdev_del_poll(struct rtdev_poll *poll)
+{
+    struct rtnet_device *rtdev = poll->rtdev;
+    unsigned int        i;
+
+
+    if (rtdev == NULL)
+	return;
+
+    mutex_lock(&rtdev->nrt_lock);
+
+    rtdev_poll_stop(poll);
+
+    for (i = 0; i < rtdev->nr_polls; i++)
+	if (rtdev->polls[i] == poll)
+	    break;
+    if (i < rtdev->nr_polls) {
+	rtdev->nr_polls--;
+	for (; i < rtdev->nr_polls; i++) {
+	    rtdev->polls[i] = rtdev->polls[i + 1];
+	    rtdev->polls[i]->index = i;
+	}
+	rtdev->polls[rtdev->nr_polls] = NULL;
+    }
+
+    mutex_unlock(&rtdev->nrt_lock);
+
+    rtdm_event_destroy(&poll->event);
+    poll->rtdev = NULL;
+}
+
+
+
+/***
+ *  rtdev_poll_enable - let a queue be scheduled for polling
+ *
+ *  Called by the driver when bringing the queue up.
+ */
+void rtdev_poll_enable(struct rtdev_poll *poll)
+{
+    smp_mb__before_atomic();
+    clear_bit(RTDEV_POLL_SCHED, &poll->state);
+    clear_bit(RTDEV_POLL_DISABLE, &poll->state);
+}
+
+
+
+/***
+ *  rtdev_poll_disable - wait for the poll task to release a queue
+ *
+ *  Called by the driver when bringing the queue down, after masking
+ *  its interrupt. The queue is not polled again until re-enabled.
+ */
+void rtdev_poll_disable(struct rtdev_poll *poll)
+{
+    set_bit(RTDEV_POLL_DISABLE, &poll->state);
+
+    while (test_and_set_bit(RTDEV_POLL_SCHED, &poll->state))
+	msleep(1);
+}
+
+
+
+/***
+ *  rtdev_set_rx_mode - select how the RX queues of a device are served
+ *  @rtdev:         the device, nrt_lock held
+ *  @mode:          RTDEV_RX_IRQ or RTDEV_RX_POLL
+ */
+int rtdev_set_rx_mode(struct rtnet_device *rtdev, unsigned int mode)
+{
+    bool            claimed[MAX_RT_DEV_QUEUES];
+    unsigned int    i;
+    int             err;
+
+
+    if (mode == rtdev->rx_mode)
+	return 0;
+
+    switch (mode) {
+	case RTDEV_RX_POLL:
+	    if (rtdev->nr_polls == 0)
+		return -EOPNOTSUPP;
+
+	    for (i = 0; i < rtdev->nr_polls; i++) {
+		err = rtdev_poll_start(rtdev->polls[i]);
+		if (err) {
+		    while (i-- > 0)
+			rtdev_poll_stop(rtdev->polls[i]);
+		    return err;
+		}
+	    }
+
+	    /* Tasks must be ready before interrupt handlers see the mode. */
+	    smp_wmb();
+	    rtdev->rx_mode = mode;
+	    break;
+
+	case RTDEV_RX_IRQ:
+	    /* Hold every queue while switching, so that the interrupt
+	       handler and a poll task never clean the same ring. */
+	    for (i = 0; i < rtdev->nr_polls; i++) {
+		claimed[i] = rtdev_poll_claim(rtdev->polls[i]);
+		rtdev_poll_stop(rtdev->polls[i]);
+	    }
+
+	    rtdev->rx_mode = mode;
+	    smp_mb();
+
+	    for (i = 0; i < rtdev->nr_polls; i++)
+		if (claimed[i])
+		    rtdev_poll_release(rtdev->polls[i]);
+	    break;
+
+	default:
+	    return -EINVAL;
+    }
+
+    return 0;
+}
+
+
+
+/***
+ *  rtdev_set_itr - set the interrupt throttling interval of a device
+ *  @rtdev:         the device, nrt_lock held
+ *  @usecs:         minimum interval between RX interrupts, 0 restores
+ *                  the adaptive moderation of the driver
+ *
+ *  In polling mode, this is also the back-off period of a poll task
+ *  after exhausting its budget.
+ */
+int rtdev_set_itr(struct rtnet_device *rtdev, unsigned int usecs)
+{
+    int ret;
+
+
+    if (rtdev->set_itr == NULL)
+	return -EOPNOTSUPP;
+
+    ret = rtdev->set_itr(rtdev, usecs);
+    if (ret == 0)
+	rtdev->itr = usecs;
+
+    return ret;
+}
+
+
 EXPORT_SYMBOL_GPL(__rt_alloc_etherdev);
 EXPORT_SYMBOL_GPL(rtdev_free);
 
@@ -827,3 +1333,12 @@ EXPORT_SYMBOL_GPL(rtdev_xmit_proxy);
 #endif
 
 EXPORT_SYMBOL_GPL(rt_hard_mtu);
+
+EXPORT_SYMBOL_GPL(rtdev_add_poll);
+EXPORT_SYMBOL_GPL(rtdev_del_poll);
+EXPORT_SYMBOL_GPL(rtdev_poll_enable);
+EXPORT_SYMBOL_GPL(rtdev_poll_disable);
+
+EXPORT_SYMBOL_GPL(rtdev_set_queues);
+EXPORT_SYMBOL_GPL(rtdev_queue_cpu);
+EXPORT_SYMBOL_GPL(rtdev_set_queue_irq_affinity);
@@ -90,6 +90,62 @@ static long rtnet_ioctl(struct file *file,
 
 
 
+static int rtnet_poll_ioctl(struct rtnet_device *rtdev, unsigned long arg)
+{
+    struct rtnet_poll_cmd   cmd;
+    struct rtdev_poll       *poll;
+    unsigned int            i;
+    int                     ret = 0;
+
+
+    if (copy_from_user(&cmd, (void *)arg, sizeof(cmd)) != 0)
+	return -EFAULT;
+
+    if ((cmd.set_mask & RTNET_POLL_SET_BUDGET) &&
+	(cmd.budget == 0 || cmd.budget > RTDEV_MAX_POLL_BUDGET))
+	return -EINVAL;
+
+    if (mutex_lock_interruptible(&rtdev->nrt_lock))
+	return -ERESTARTSYS;
+
+    if (cmd.set_mask & RTNET_POLL_SET_BUDGET)
+	rtdev->poll_budget = cmd.budget;
+
+    if (cmd.set_mask & RTNET_POLL_SET_ITR) {
+	ret = rtdev_set_itr(rtdev, cmd.itr);
+	if (ret)
+	    goto out;
+    }
+
+    if (cmd.set_mask & RTNET_POLL_SET_MODE) {
+	ret = rtdev_set_rx_mode(rtdev, cmd.rx_mode);
+	if (ret)
+	    goto out;
+    }
+
+    cmd.rx_mode   = rtdev->rx_mode;
+    cmd.budget    = rtdev->poll_budget;
+    cmd.itr       = rtdev->itr;
+    cmd.nr_queues = rtdev->nr_polls;
+    for (i = 0; i < rtdev->nr_polls; i++) {
+	poll = rtdev->polls[i];
+	cmd.queue[i].irqs    = poll->stats.irqs;
+	cmd.queue[i].polls   = poll->stats.polls;
+	cmd.queue[i].packets = poll->stats.packets;
+	cmd.queue[i].drops   = poll->stats.drops;
+    }
+
+  out:
+    mutex_unlock(&rtdev->nrt_lock);
+
+    if (ret == 0 && copy_to_user((void *)arg, &cmd, sizeof(cmd)) != 0)
+	return -EFAULT;
+
+    return ret;
+}
+
+
+
 static int rtnet_core_ioctl(struct rtnet_device *rtdev, unsigned int request,
 			    unsigned long arg)
 {
@@ -100,6 +156,9 @@ static int rtnet_core_ioctl(struct rtnet_device *rtdev, unsigned int request,
     rtdm_lockctx_t          context;
 
 
+    if (request == IOC_RT_IFPOLL)
+	return rtnet_poll_ioctl(rtdev, arg);
+
     ret = copy_from_user(&cmd, (void *)arg, sizeof(cmd));
     if (ret != 0)
 	return -EFAULT;
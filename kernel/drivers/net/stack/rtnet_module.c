@@ -130,8 +130,10 @@ static struct xnvfile_regular rtnet_devices_vfile = {
 static int rtnet_rtskb_show(struct xnvfile_regular_iterator *it, void *data)
 {
     unsigned int rtskb_len;
+    unsigned long hits, misses;
 
     rtskb_len = ALIGN_RTSKB_STRUCT_LEN + SKB_DATA_ALIGN(RTSKB_SIZE);
+    rtskb_pool_cache_stats(&hits, &misses);
 
     xnvfile_printf(it, "Statistics\t\tCurrent\tMaximum\n"
 		     "rtskb pools\t\t%d\t%d\n"
@@ -140,6 +142,12 @@ static int rtnet_rtskb_show(struct xnvfile_regular_iterator *it, void *data)
 		     rtskb_pools, rtskb_pools_max,
 		     rtskb_amount, rtskb_amount_max,
 		     rtskb_amount * rtskb_len, rtskb_amount_max * rtskb_len);
+    xnvfile_printf(it, "\nPool caches\t\tHits\tMisses\tHit rate\n"
+		     "all CPUs\t\t%lu\t%lu\t%lu%%\n",
+		     hits, misses,
+		     hits + misses ?
+		     (unsigned long)div64_u64((u64)hits * 100, hits + misses) :
+		     0);
 	return 0;
 }
 
@@ -257,6 +265,59 @@ static struct xnvfile_regular rtnet_stats_vfile = {
 	.ops = &rtnet_stats_vfile_ops,
 };
 
+static int rtnet_queues_show(struct xnvfile_regular_iterator *it, void *data)
+{
+	struct rtnet_device *rtdev;
+	struct rtdev_queue_stats *rx;
+	struct rtdev_queue *queue;
+	unsigned int i;
+
+	if (it->pos == 0) {
+		xnvfile_printf(it, "Name\tQueue\tPolicy\tCPU\tPool\t"
+			       "TX packets\tRX irqs\tRX polls\tRX packets\t"
+			       "RX drops\n");
+		return 0;
+	}
+
+	rtdev = __rtdev_get_by_index(it->pos);
+	if (rtdev == NULL)
+		return VFILE_SEQ_SKIP;
+
+	for (i = 0; i < rtdev->num_queues; i++) {
+		queue = &rtdev->queues[i];
+		rx = i < rtdev->nr_polls ? &rtdev->polls[i]->stats : NULL;
+
+		xnvfile_printf(it, "%-7s %u\t%s\t", rtdev->name, i,
+			       rtdev->tx_policy == RTDEV_TXQ_HASH ?
+			       "hash" : "prio");
+		if (queue->irq_cpu < 0)
+			xnvfile_printf(it, "-\t");
+		else
+			xnvfile_printf(it, "%d\t", queue->irq_cpu);
+		xnvfile_printf(it, "%u\t%-10lu\t", queue->pool_size,
+			       queue->tx_packets);
+		if (rx)
+			xnvfile_printf(it, "%-7lu\t\t%-8lu\t%-10lu\t%lu\n",
+				       rx->irqs, rx->polls, rx->packets,
+				       rx->drops);
+		else
+			xnvfile_printf(it, "-\t\t-\t\t-\t\t-\n");
+	}
+
+	return 0;
+}
+
+static struct xnvfile_regular_ops rtnet_queues_vfile_ops = {
+	.begin = rtnet_stats_begin,
+	.next = rtnet_stats_next,
+	.show = rtnet_queues_show,
+};
+
+static struct xnvfile_regular rtnet_queues_vfile = {
+	.entry = { .lockops = &rtnet_devices_nrt_lock_ops, },
+	.ops = &rtnet_queues_vfile_ops,
+};
+
 static int rtnet_proc_register(void)
 {
 	int err;
@@ -281,8 +342,15 @@ static int rtnet_proc_register(void)
 	if (err < 0)
 		goto error5;
 
+	err = xnvfile_init_regular("queues", &rtnet_queues_vfile, &rtnet_proc_root);
+	if (err < 0)
+		goto error6;
+
     return 0;
 
+  error6:
+	xnvfile_destroy_regular(&rtnet_stats_vfile);
+
   error5:
 	xnvfile_destroy_regular(&rtnet_version_vfile);
 
@@ -304,6 +372,7 @@ static int rtnet_proc_register(void)
 
 static void rtnet_proc_unregister(void)
 {
+	xnvfile_destroy_regular(&rtnet_queues_vfile);
 	xnvfile_destroy_regular(&rtnet_stats_vfile);
 	xnvfile_destroy_regular(&rtnet_version_vfile);
 	xnvfile_destroy_regular(&rtnet_rtskb_vfile);
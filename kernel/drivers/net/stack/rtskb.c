@@ -23,6 +23,7 @@
 
 #include <linux/moduleparam.h>
 #include <linux/slab.h>
+#include <linux/percpu.h>
 #include <net/checksum.h>
 
 #include <rtdev.h>
@@ -48,6 +49,13 @@ unsigned int rtskb_pools_max=0;
 unsigned int rtskb_amount=0;
 unsigned int rtskb_amount_max=0;
 
+struct rtskb_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+};
+
+static DEFINE_PER_CPU(struct rtskb_cache_stats, rtskb_cache_stats);
+
 #if IS_ENABLED(CONFIG_XENO_DRIVERS_NET_ADDON_RTCAP)
 /* RTcap interface */
 rtdm_lock_t rtcap_lock;
@@ -151,53 +159,227 @@ void rtskb_under_panic(struct rtskb *skb, int sz, void *here)
 EXPORT_SYMBOL_GPL(rtskb_under_panic);
 #endif /* CONFIG_XENO_DRIVERS_NET_CHECKED */
 
-static struct rtskb *__rtskb_pool_dequeue(struct rtskb_pool *pool)
+/***
+ *  rtskb_pool_cache_steal - take a rtskb from the cache of another CPU
+ *
+ *  Slow path once the pool queue ran dry, the free rtskbs may all sleep
+ *  in remote caches. Must not hold the local cache lock. IRQs off.
+ */
+static struct rtskb *rtskb_pool_cache_steal(struct rtskb_pool *pool)
 {
-    struct rtskb_queue *queue = &pool->queue;
-    struct rtskb *skb;
+    struct rtskb_pool_cache *cache;
+    struct rtskb *skb = NULL;
+    int cpu;
 
-    if (!pool->lock_ops->trylock(pool->lock_cookie))
-	    return NULL;
-    skb = __rtskb_dequeue(queue);
-    if (skb == NULL)
-	    pool->lock_ops->unlock(pool->lock_cookie);
+    for_each_possible_cpu(cpu) {
+	cache = per_cpu_ptr(pool->cache, cpu);
+	if (ACCESS_ONCE(cache->count) == 0)
+	    continue;
+
+	rtdm_lock_get(&cache->lock);
+	if (cache->count > 0)
+	    skb = cache->skbs[--cache->count];
+	rtdm_lock_put(&cache->lock);
+
+	if (skb)
+	    break;
+    }
 
     return skb;
 }
 
+/***
+ *  rtskb_pool_cache_dequeue - take a rtskb from the cache of this CPU
+ *
+ *  Refills half of the cache from the pool queue if empty, falls back to
+ *  the caches of other CPUs if the queue is empty as well. IRQs off.
+ */
+static struct rtskb *rtskb_pool_cache_dequeue(struct rtskb_pool *pool)
+{
+    struct rtskb_pool_cache *cache = raw_cpu_ptr(pool->cache);
+    struct rtskb_queue *queue = &pool->queue;
+    unsigned int batch;
+    struct rtskb *skb = NULL;
+
+    rtdm_lock_get(&cache->lock);
+
+    if (likely(cache->count > 0)) {
+	raw_cpu_ptr(&rtskb_cache_stats)->hits++;
+	goto out;
+    }
+
+    raw_cpu_ptr(&rtskb_cache_stats)->misses++;
+
+    batch = (ACCESS_ONCE(pool->cache_limit) + 1) / 2 ?: 1;
+
+    rtdm_lock_get(&queue->lock);
+    while (cache->count < batch && (skb = __rtskb_dequeue(queue)) != NULL)
+	cache->skbs[cache->count++] = skb;
+    rtdm_lock_put(&queue->lock);
+
+    skb = NULL;
+  out:
+    if (cache->count > 0)
+	skb = cache->skbs[--cache->count];
+
+    rtdm_lock_put(&cache->lock);
+
+    return skb ?: rtskb_pool_cache_steal(pool);
+}
+
+/***
+ *  rtskb_pool_cache_queue_tail - put a rtskb into the cache of this CPU
+ *
+ *  Flushes half of the cache to the pool queue if full. Single rtskbs
+ *  only, IRQs off.
+ */
+static void rtskb_pool_cache_queue_tail(struct rtskb_pool *pool,
+					struct rtskb *skb)
+{
+    struct rtskb_pool_cache *cache = raw_cpu_ptr(pool->cache);
+    struct rtskb_queue *queue = &pool->queue;
+    unsigned int limit;
+
+    rtdm_lock_get(&cache->lock);
+
+    limit = ACCESS_ONCE(pool->cache_limit);
+    if (likely(cache->count < limit)) {
+	raw_cpu_ptr(&rtskb_cache_stats)->hits++;
+	skb->next = NULL;
+	cache->skbs[cache->count++] = skb;
+	goto out;
+    }
+
+    raw_cpu_ptr(&rtskb_cache_stats)->misses++;
+
+    rtdm_lock_get(&queue->lock);
+    __rtskb_queue_tail(queue, skb);
+    while (cache->count > limit / 2)
+	__rtskb_queue_tail(queue, cache->skbs[--cache->count]);
+    rtdm_lock_put(&queue->lock);
+
+  out:
+    rtdm_lock_put(&cache->lock);
+}
+
+/***
+ *  rtskb_pool_drain_caches - return all cached rtskbs to the pool queue
+ */
+static void rtskb_pool_drain_caches(struct rtskb_pool *pool)
+{
+    struct rtskb_pool_cache *cache;
+    rtdm_lockctx_t context;
+    int cpu;
+
+    if (pool->cache == NULL)
+	return;
+
+    for_each_possible_cpu(cpu) {
+	cache = per_cpu_ptr(pool->cache, cpu);
+	rtdm_lock_get_irqsave(&cache->lock, context);
+	rtdm_lock_get(&pool->queue.lock);
+	while (cache->count > 0)
+	    __rtskb_queue_tail(&pool->queue, cache->skbs[--cache->count]);
+	rtdm_lock_put(&pool->queue.lock);
+	rtdm_lock_put_irqrestore(&cache->lock, context);
+    }
+}
+
+/***
+ *  rtskb_pool_cache_limit - adjust the cache depth to the pool size
+ *
+ *  At most half of the pool may sleep in the caches of all CPUs, a cache
+ *  of less than two rtskbs is not worth it.
+ */
+static void rtskb_pool_cache_limit(struct rtskb_pool *pool)
+{
+    unsigned int limit = 0;
+
+    if (pool->cache) {
+	limit = min_t(unsigned int, RTSKB_POOL_CACHE_SIZE,
+		      pool->size / (2 * num_online_cpus()));
+	if (limit < 2)
+	    limit = 0;
+    }
+
+    ACCESS_ONCE(pool->cache_limit) = limit;
+}
+
 struct rtskb *rtskb_pool_dequeue(struct rtskb_pool *pool)
 {
     struct rtskb_queue *queue = &pool->queue;
     rtdm_lockctx_t context;
     struct rtskb *skb;
 
+    if (ACCESS_ONCE(pool->cache_limit)) {
+	rtdm_lock_irqsave(context);
+	if (!pool->lock_ops->trylock(pool->lock_cookie))
+	    skb = NULL;
+	else {
+	    skb = rtskb_pool_cache_dequeue(pool);
+	    if (skb == NULL)
+		pool->lock_ops->unlock(pool->lock_cookie);
+	}
+	rtdm_lock_irqrestore(context);
+
+	return skb;
+    }
+
     rtdm_lock_get_irqsave(&queue->lock, context);
-    skb = __rtskb_pool_dequeue(pool);
+    if (!pool->lock_ops->trylock(pool->lock_cookie))
+	skb = NULL;
+    else {
+	skb = __rtskb_dequeue(queue);
+	if (skb == NULL)
+	    pool->lock_ops->unlock(pool->lock_cookie);
+    }
     rtdm_lock_put_irqrestore(&queue->lock, context);
 
     return skb;
 }
 EXPORT_SYMBOL_GPL(rtskb_pool_dequeue);
 
-static void __rtskb_pool_queue_tail(struct rtskb_pool *pool, struct rtskb *skb)
-{
-    struct rtskb_queue *queue = &pool->queue;
-
-    __rtskb_queue_tail(queue,skb);
-    pool->lock_ops->unlock(pool->lock_cookie);
-}
-
 void rtskb_pool_queue_tail(struct rtskb_pool *pool, struct rtskb *skb)
 {
     struct rtskb_queue *queue = &pool->queue;
     rtdm_lockctx_t context;
 
+    /* Chains are not cached, they go back to the queue en bloc. */
+    if (ACCESS_ONCE(pool->cache_limit) && skb->chain_end == skb) {
+	rtdm_lock_irqsave(context);
+	rtskb_pool_cache_queue_tail(pool, skb);
+	pool->lock_ops->unlock(pool->lock_cookie);
+	rtdm_lock_irqrestore(context);
+	return;
+    }
+
     rtdm_lock_get_irqsave(&queue->lock, context);
-    __rtskb_pool_queue_tail(pool, skb);
+    __rtskb_queue_tail(queue, skb);
+    pool->lock_ops->unlock(pool->lock_cookie);
     rtdm_lock_put_irqrestore(&queue->lock, context);
 }
 EXPORT_SYMBOL_GPL(rtskb_pool_queue_tail);
 
+/***
+ *  rtskb_pool_cache_stats - sum up the cache statistics of all CPUs
+ *  @hits: allocations and releases served by a per-CPU cache
+ *  @misses: refills and flushes of a cache from/to the pool queue
+ */
+void rtskb_pool_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+    struct rtskb_cache_stats *stats;
+    int cpu;
+
+    *hits = *misses = 0;
+
+    for_each_possible_cpu(cpu) {
+	stats = per_cpu_ptr(&rtskb_cache_stats, cpu);
+	*hits   += stats->hits;
+	*misses += stats->misses;
+    }
+}
+EXPORT_SYMBOL_GPL(rtskb_pool_cache_stats);
+
 /***
  *  alloc_rtskb - allocate an rtskb from a pool
  *  @size: required buffer size (to check against maximum boundary)
@@ -223,6 +405,7 @@ struct rtskb *alloc_rtskb(unsigned int size, struct rtskb_pool *pool)
     skb->len = 0;
     skb->pkt_type = PACKET_HOST;
     skb->xmit_stamp = NULL;
+    skb->queue_mapping = 0;
 
 #if IS_ENABLED(CONFIG_XENO_DRIVERS_NET_ADDON_RTCAP)
     skb->cap_flags = 0;
@@ -317,9 +500,21 @@ unsigned int rtskb_pool_init(struct rtskb_pool *pool,
 			    const struct rtskb_pool_lock_ops *lock_ops,
 			    void *lock_cookie)
 {
+    struct rtskb_pool_cache *cache;
     unsigned int i;
+    int cpu;
 
     rtskb_queue_init(&pool->queue);
+    pool->size = 0;
+
+    /* Without its per-CPU cache, the pool just works on its queue. */
+    pool->cache = alloc_percpu(struct rtskb_pool_cache);
+    if (pool->cache)
+	for_each_possible_cpu(cpu) {
+	    cache = per_cpu_ptr(pool->cache, cpu);
+	    rtdm_lock_init(&cache->lock);
+	    cache->count = 0;
+	}
 
     i = rtskb_pool_extend(pool, initial_size);
 
@@ -371,12 +566,21 @@ void rtskb_pool_release(struct rtskb_pool *pool)
 {
     struct rtskb *skb;
 
+    rtskb_pool_drain_caches(pool);
+
     while ((skb = rtskb_dequeue(&pool->queue)) != NULL) {
 	rtdev_unmap_rtskb(skb);
 	kmem_cache_free(rtskb_slab_pool, skb);
 	rtskb_amount--;
     }
 
+    if (pool->cache) {
+	free_percpu(pool->cache);
+	pool->cache = NULL;
+    }
+    pool->cache_limit = 0;
+    pool->size = 0;
+
     rtskb_pools--;
 }
 
@@ -419,6 +623,9 @@ unsigned int rtskb_pool_extend(struct rtskb_pool *pool,
 	    rtskb_amount_max = rtskb_amount;
     }
 
+    pool->size += i;
+    rtskb_pool_cache_limit(pool);
+
     return i;
 }
 
@@ -430,6 +637,9 @@ unsigned int rtskb_pool_shrink(struct rtskb_pool *pool,
     struct rtskb    *skb;
 
 
+    if (rem_rtskbs > 0)
+	rtskb_pool_drain_caches(pool);
+
     for (i = 0; i < rem_rtskbs; i++) {
 	if ((skb = rtskb_dequeue(&pool->queue)) == NULL)
 	    break;
@@ -439,6 +649,13 @@ unsigned int rtskb_pool_shrink(struct rtskb_pool *pool,
 	rtskb_amount--;
     }
 
+    pool->size -= i;
+    rtskb_pool_cache_limit(pool);
+
+    /* Nothing may be left behind in caches which are not used anymore. */
+    if (pool->cache && pool->cache_limit == 0)
+	rtskb_pool_drain_caches(pool);
+
     return i;
 }
 
@@ -448,27 +665,16 @@ int rtskb_acquire(struct rtskb *rtskb, struct rtskb_pool *comp_pool)
 {
     struct rtskb *comp_rtskb;
     struct rtskb_pool *release_pool;
-    rtdm_lockctx_t context;
-
 
-    rtdm_lock_get_irqsave(&comp_pool->queue.lock, context);
 
-    comp_rtskb = __rtskb_pool_dequeue(comp_pool);
-    if (!comp_rtskb) {
-	rtdm_lock_put_irqrestore(&comp_pool->queue.lock, context);
+    comp_rtskb = rtskb_pool_dequeue(comp_pool);
+    if (!comp_rtskb)
 	return -ENOMEM;
-    }
-
-    rtdm_lock_put(&comp_pool->queue.lock);
 
     comp_rtskb->chain_end = comp_rtskb;
     comp_rtskb->pool = release_pool = rtskb->pool;
 
-    rtdm_lock_get(&release_pool->queue.lock);
-
-    __rtskb_pool_queue_tail(release_pool, comp_rtskb);
-
-    rtdm_lock_put_irqrestore(&release_pool->queue.lock, context);
+    rtskb_pool_queue_tail(release_pool, comp_rtskb);
 
     rtskb->pool = comp_pool;
 
@@ -23,6 +23,8 @@
  */
 
 #include <linux/moduleparam.h>
+#include <linux/delay.h>
+#include <linux/rculist.h>
 
 #include <rtdev.h>
 #include <rtnet_internal.h>
@@ -40,12 +42,80 @@ MODULE_PARM_DESC(stack_mgr_prio, "Priority of the stack manager task");
 #endif
 static DECLARE_RTSKB_FIFO(rx, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
 
+#ifdef CONFIG_XENO_DRIVERS_NET_RX_PERDEV
+struct rtnet_rx_queue {
+    rtdm_task_t         task;
+    rtdm_event_t        event;
+    DECLARE_RTSKB_FIFO(rx, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+};
+#endif /* CONFIG_XENO_DRIVERS_NET_RX_PERDEV */
+
 struct list_head    rt_packets[RTPACKET_HASH_TBL_SIZE];
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
 struct list_head    rt_packets_all;
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 DEFINE_RTDM_LOCK(rt_packets_lock);
 
+/*
+ * The protocol lists are walked without holding rt_packets_lock.
+ * Writers still serialise on that lock and bump rt_packets_seq around
+ * each update, so that a reader which raced with an entry moving
+ * between lists (rebinding of a packet socket) restarts its walk
+ * instead of following the entry into a foreign list. Entries are
+ * only released after rtdev_sync_packs() observed that all readers
+ * which may still see them left rt_stack_deliver().
+ */
+static unsigned int rt_packets_seq;
+static unsigned int rt_packets_epoch;
+static atomic_t     rt_packets_readers[2];
+static DEFINE_MUTEX(rt_packets_sync_lock);
+
+
+static inline int rt_packets_read_begin(void)
+{
+    int idx = ACCESS_ONCE(rt_packets_epoch) & 1;
+
+    atomic_inc(&rt_packets_readers[idx]);
+    smp_mb();
+
+    return idx;
+}
+
+static inline void rt_packets_read_end(int idx)
+{
+    smp_mb();
+    atomic_dec(&rt_packets_readers[idx]);
+}
+
+static inline unsigned int rt_packets_seq_begin(void)
+{
+    unsigned int seq;
+
+    while ((seq = ACCESS_ONCE(rt_packets_seq)) & 1)
+	cpu_relax();
+    smp_rmb();
+
+    return seq;
+}
+
+static inline bool rt_packets_seq_retry(unsigned int seq)
+{
+    smp_rmb();
+    return ACCESS_ONCE(rt_packets_seq) != seq;
+}
+
+static inline void rt_packets_write_begin(void)
+{
+    rt_packets_seq++;
+    smp_wmb();
+}
+
+static inline void rt_packets_write_end(void)
+{
+    smp_wmb();
+    rt_packets_seq++;
+}
+
 
 /***
  *  rtdev_add_pack:         add protocol (Layer 3)
@@ -65,17 +135,19 @@ int __rtdev_add_pack(struct rtpacket_type *pt, struct module *module)
     pt->owner = module;
 
     rtdm_lock_get_irqsave(&rt_packets_lock, context);
+    rt_packets_write_begin();
 
     if (pt->type == htons(ETH_P_ALL))
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
-	list_add_tail(&pt->list_entry, &rt_packets_all);
+	list_add_tail_rcu(&pt->list_entry, &rt_packets_all);
 #else /* !CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 	ret = -EINVAL;
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
     else
-	list_add_tail(&pt->list_entry,
-		      &rt_packets[ntohs(pt->type) & RTPACKET_HASH_KEY_MASK]);
+	list_add_tail_rcu(&pt->list_entry,
+			  &rt_packets[ntohs(pt->type) & RTPACKET_HASH_KEY_MASK]);
 
+    rt_packets_write_end();
     rtdm_lock_put_irqrestore(&rt_packets_lock, context);
 
     return ret;
@@ -85,10 +157,13 @@ EXPORT_SYMBOL_GPL(__rtdev_add_pack);
 
 
 /***
- *  rtdev_remove_pack:  remove protocol (Layer 3)
- *  @pt:                protocol
+ *  __rtdev_remove_pack:    unlink protocol (Layer 3)
+ *  @pt:                    protocol
+ *
+ *  Does not wait for concurrent deliveries, may be called from any
+ *  context. @pt must not be released before rtdev_sync_packs() returned.
  */
-void rtdev_remove_pack(struct rtpacket_type *pt)
+void __rtdev_remove_pack(struct rtpacket_type *pt)
 {
     rtdm_lockctx_t  context;
 
@@ -96,25 +171,85 @@ void rtdev_remove_pack(struct rtpacket_type *pt)
     RTNET_ASSERT(pt != NULL, return;);
 
     rtdm_lock_get_irqsave(&rt_packets_lock, context);
-    list_del(&pt->list_entry);
+    rt_packets_write_begin();
+    list_del_rcu(&pt->list_entry);
+    rt_packets_write_end();
     rtdm_lock_put_irqrestore(&rt_packets_lock, context);
 }
 
+EXPORT_SYMBOL_GPL(__rtdev_remove_pack);
+
+
+/***
+ *  rtdev_sync_packs:   wait for deliveries to unlinked protocols
+ *
+ *  Must be called from non-RT context.
+ */
+void rtdev_sync_packs(void)
+{
+    int idx, n;
+
+
+    mutex_lock(&rt_packets_sync_lock);
+
+    /* Flip twice so that readers which sampled the epoch just before
+       the first flip are caught as well. */
+    for (n = 0; n < 2; n++) {
+	smp_mb();
+	idx = rt_packets_epoch & 1;
+	rt_packets_epoch++;
+	smp_mb();
+
+	while (atomic_read(&rt_packets_readers[idx]) > 0)
+	    msleep(1);
+    }
+
+    smp_mb();
+
+    mutex_unlock(&rt_packets_sync_lock);
+}
+
+EXPORT_SYMBOL_GPL(rtdev_sync_packs);
+
+
+/***
+ *  rtdev_remove_pack:  remove protocol (Layer 3)
+ *  @pt:                protocol
+ */
+void rtdev_remove_pack(struct rtpacket_type *pt)
+{
+    __rtdev_remove_pack(pt);
+    rtdev_sync_packs();
+}
+
 EXPORT_SYMBOL_GPL(rtdev_remove_pack);
 
 
 /***
- *  rtnetif_rx: will be called from the driver interrupt handler
- *  (IRQs disabled!) and send a message to rtdev-owned stack-manager
+ *  rtnetif_rx: will be called from the driver interrupt handler or
+ *  from a device poll task, and send a message to rtdev-owned
+ *  stack-manager
  *
  *  @skb - the packet
+ *
+ *  Note: poll tasks run with IRQs enabled, and the RX fifo is shared
+ *  with the interrupt handlers of other devices, hence the irqsave
+ *  insertion.
  */
 void rtnetif_rx(struct rtskb *skb)
 {
+    struct rtskb_fifo *fifo = &rx.fifo;
+
+
     RTNET_ASSERT(skb != NULL, return;);
     RTNET_ASSERT(skb->rtdev != NULL, return;);
 
-    if (unlikely(rtskb_fifo_insert_inirq(&rx.fifo, skb) < 0)) {
+#ifdef CONFIG_XENO_DRIVERS_NET_RX_PERDEV
+    if (skb->rtdev->rx_queue)
+	fifo = &skb->rtdev->rx_queue->rx.fifo;
+#endif /* CONFIG_XENO_DRIVERS_NET_RX_PERDEV */
+
+    if (unlikely(rtskb_fifo_insert(fifo, skb) < 0)) {
 	rtdm_printk("RTnet: dropping packet in %s()\n", __FUNCTION__);
 	kfree_rtskb(skb);
     }
@@ -133,28 +268,32 @@ __DELIVER_PREFIX void rt_stack_deliver(struct rtskb *rtskb)
 {
     unsigned short          hash;
     struct rtpacket_type    *pt_entry;
-    rtdm_lockctx_t          context;
     struct rtnet_device     *rtdev = rtskb->rtdev;
+    unsigned int            seq;
     int                     err;
     int                     eth_p_all_hit = 0;
+    int                     idx;
 
 
     rtcap_report_incoming(rtskb);
 
     rtskb->nh.raw = rtskb->data;
 
-    rtdm_lock_get_irqsave(&rt_packets_lock, context);
+    idx = rt_packets_read_begin();
 
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
     eth_p_all_hit = 0;
-    list_for_each_entry(pt_entry, &rt_packets_all, list_entry) {
+    seq = rt_packets_seq_begin();
+    list_for_each_entry_rcu(pt_entry, &rt_packets_all, list_entry) {
+	/* Listeners were already served, so don't restart but rather
+	   skip the rest on concurrent updates. */
+	if (rt_packets_seq_retry(seq))
+	    break;
 	if (!pt_entry->trylock(pt_entry))
 	    continue;
-	rtdm_lock_put_irqrestore(&rt_packets_lock, context);
 
 	pt_entry->handler(rtskb, pt_entry);
 
-	rtdm_lock_get_irqsave(&rt_packets_lock, context);
 	pt_entry->unlock(pt_entry);
 	eth_p_all_hit = 1;
     }
@@ -162,24 +301,29 @@ __DELIVER_PREFIX void rt_stack_deliver(struct rtskb *rtskb)
 
     hash = ntohs(rtskb->protocol) & RTPACKET_HASH_KEY_MASK;
 
-    list_for_each_entry(pt_entry, &rt_packets[hash], list_entry)
+    /* Restarting is harmless here: handlers which returned an error
+       did not consume the packet. */
+  restart:
+    seq = rt_packets_seq_begin();
+    list_for_each_entry_rcu(pt_entry, &rt_packets[hash], list_entry) {
+	if (rt_packets_seq_retry(seq))
+	    goto restart;
 	if (pt_entry->type == rtskb->protocol) {
 	    if (!pt_entry->trylock(pt_entry))
 		continue;
-	    rtdm_lock_put_irqrestore(&rt_packets_lock, context);
 
 	    err = pt_entry->handler(rtskb, pt_entry);
 
-	    rtdm_lock_get_irqsave(&rt_packets_lock, context);
 	    pt_entry->unlock(pt_entry);
 
 	    if (likely(!err)) {
-		rtdm_lock_put_irqrestore(&rt_packets_lock, context);
+		rt_packets_read_end(idx);
 		return;
 	    }
 	}
+    }
 
-    rtdm_lock_put_irqrestore(&rt_packets_lock, context);
+    rt_packets_read_end(idx);
 
     /* Don't warn if ETH_P_ALL listener were present or when running in
        promiscuous mode (RTcap). */
@@ -211,11 +355,112 @@ static void rt_stack_mgr_task(void *arg)
 }
 
 
+#ifdef CONFIG_XENO_DRIVERS_NET_RX_PERDEV
+static void rt_stack_rx_task(void *arg)
+{
+    struct rtnet_rx_queue   *rxq = arg;
+    struct rtskb            *rtskb;
+
+    while (!rtdm_task_should_stop()) {
+	if (rtdm_event_wait(&rxq->event) < 0)
+	    break;
+
+	/* we are the only reader => no locking required */
+	while ((rtskb = __rtskb_fifo_remove(&rxq->rx.fifo)))
+	    rt_stack_deliver(rtskb);
+    }
+}
+
+
+/***
+ *  rt_stack_rx_queue_create:   set up RX queue and manager of a device
+ *  @rtdev:                     the device being registered
+ *
+ *  The manager task is pinned to one of the real-time CPUs, devices are
+ *  spread round-robin according to their interface index.
+ */
+int rt_stack_rx_queue_create(struct rtnet_device *rtdev)
+{
+    struct rtnet_rx_queue   *rxq;
+    char                    name[32];
+    cpumask_t               affinity;
+    int                     cpu, n, err;
+
+
+    rxq = kzalloc(sizeof(*rxq), GFP_KERNEL);
+    if (rxq == NULL)
+	return -ENOMEM;
+
+    rtskb_fifo_init(&rxq->rx.fifo, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+    rtdm_event_init(&rxq->event, 0);
+
+    cpumask_and(&affinity, &cobalt_cpu_affinity, cpu_online_mask);
+    n = cpumask_weight(&affinity);
+    n = n > 0 ? (rtdev->ifindex - 1) % n : 0;
+    for_each_cpu(cpu, &affinity)
+	if (n-- == 0)
+	    break;
+    cpumask_clear(&affinity);
+    cpumask_set_cpu(cpu < nr_cpu_ids ? cpu : 0, &affinity);
+
+    snprintf(name, sizeof(name), "rtnet-rx-%s", rtdev->name);
+    err = __rtdm_task_init(&rxq->task, name, rt_stack_rx_task, rxq,
+			   stack_mgr_prio, 0, &affinity);
+    if (err) {
+	rtdm_event_destroy(&rxq->event);
+	kfree(rxq);
+	return err;
+    }
+
+    rtdev->rx_queue = rxq;
+    /* Drivers may connect before registering the device. */
+    if (rtdev->stack_event != NULL)
+	rtdev->stack_event = &rxq->event;
+
+    return 0;
+}
+
+
+/***
+ *  rt_stack_rx_queue_destroy
+ *  @rtdev:                     the device being unregistered
+ */
+void rt_stack_rx_queue_destroy(struct rtnet_device *rtdev)
+{
+    struct rtnet_rx_queue   *rxq = rtdev->rx_queue;
+    struct rtskb            *rtskb;
+
+
+    if (rxq == NULL)
+	return;
+
+    if (rtdev->stack_event == &rxq->event)
+	rtdev->stack_event = &STACK_manager.event;
+    rtdev->rx_queue = NULL;
+
+    rtdm_event_destroy(&rxq->event);
+    rtdm_task_destroy(&rxq->task);
+
+    while ((rtskb = __rtskb_fifo_remove(&rxq->rx.fifo)))
+	kfree_rtskb(rtskb);
+
+    kfree(rxq);
+}
+#endif /* CONFIG_XENO_DRIVERS_NET_RX_PERDEV */
+
+
 /***
  *  rt_stack_connect
  */
 void rt_stack_connect (struct rtnet_device *rtdev, struct rtnet_mgr *mgr)
 {
+#ifdef CONFIG_XENO_DRIVERS_NET_RX_PERDEV
+    if (rtdev->rx_queue) {
+	rtdev->stack_event = &rtdev->rx_queue->event;
+	return;
+    }
+#endif /* CONFIG_XENO_DRIVERS_NET_RX_PERDEV */
+
     rtdev->stack_event = &mgr->event;
 }
 
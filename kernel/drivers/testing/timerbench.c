@@ -18,6 +18,7 @@
 
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/semaphore.h>
 #include <linux/ipipe_trace.h>
 #include <cobalt/kernel/arith.h>
@@ -436,6 +437,147 @@ static int rt_tmbench_stop(struct rt_tmbench_context *ctx, void *u_res)
 	return ret;
 }
 
+/*
+ * Timer queue benchmark: measure the per-operation cost of the core
+ * timer queue implementation selected in the kernel configuration
+ * (CONFIG_XENO_OPT_TIMER_*), on a private queue populated with
+ * @nrtimers armed holders. Each round inserts all holders with
+ * pseudo-random dates spread over 100 ms, expires them one by one in
+ * date order, re-arming each expired holder one period later like a
+ * periodic timer would, then cancels all of them in insertion order.
+ */
+
+#define TMQUEUE_MAX_TIMERS	(1024 * 1024)
+#define TMQUEUE_HORIZON_NS	100000000U
+#define TMQUEUE_PERIOD_NS	1000000ULL
+
+struct tmqueue_stat {
+	xnticks_t sum;
+	xnticks_t max;
+	unsigned long count;
+};
+
+static inline void tmqueue_account(struct tmqueue_stat *st, xnticks_t d)
+{
+	st->sum += d;
+	st->count++;
+	if (d > st->max)
+		st->max = d;
+}
+
+static inline __s64 tmqueue_avg_ns(struct tmqueue_stat *st)
+{
+	if (st->count == 0)
+		return 0;
+
+	return xnclock_ticks_to_ns(&nkclock,
+				   xnarch_ulldiv(st->sum, st->count, NULL));
+}
+
+static inline void tmqueue_breathe(unsigned long n)
+{
+	if ((n % 1024) == 0)
+		cond_resched();
+}
+
+static int rt_tmbench_queue(struct rtdm_fd *fd,
+			    struct rttst_tmqueue_bench __user *u_bench)
+{
+	struct tmqueue_stat ins = { 0 }, rem = { 0 }, exp = { 0 };
+	xnticks_t period, now, t0, t1;
+	struct rttst_tmqueue_bench bench;
+	xntimerh_t *holders, *h;
+	unsigned int n, round;
+	u32 seed = 1;
+	xntimerq_t *q;
+	int ret = 0;
+	spl_t s;
+
+	ret = rtdm_safe_copy_from_user(fd, &bench, u_bench, sizeof(bench));
+	if (ret)
+		return ret;
+
+	if (bench.nrtimers == 0 || bench.nrtimers > TMQUEUE_MAX_TIMERS ||
+	    bench.rounds == 0)
+		return -EINVAL;
+
+	q = kmalloc(sizeof(*q), GFP_KERNEL);
+	if (q == NULL)
+		return -ENOMEM;
+
+	holders = vmalloc(bench.nrtimers * sizeof(*holders));
+	if (holders == NULL) {
+		kfree(q);
+		return -ENOMEM;
+	}
+
+	xntimerq_init(q);
+	period = xnclock_ns_to_ticks(&nkclock, TMQUEUE_PERIOD_NS);
+
+	for (round = 0; round < bench.rounds; round++) {
+		now = xnclock_read_raw(&nkclock);
+		for (n = 0; n < bench.nrtimers; n++) {
+			h = holders + n;
+			xntimerh_init(h);
+			seed = seed * 1103515245 + 12345;
+			xntimerh_date(h) = now + xnclock_ns_to_ticks(&nkclock,
+						seed % TMQUEUE_HORIZON_NS);
+			xntimerh_prio(h) = XNTIMER_STDPRIO;
+			splhigh(s);
+			t0 = xnclock_read_raw(&nkclock);
+			xntimerq_insert(q, h);
+			t1 = xnclock_read_raw(&nkclock);
+			splexit(s);
+			tmqueue_account(&ins, t1 - t0);
+			tmqueue_breathe(n);
+		}
+
+		for (n = 0; n < bench.nrtimers; n++) {
+			splhigh(s);
+			t0 = xnclock_read_raw(&nkclock);
+			h = xntimerq_head(q);
+			xntimerq_remove(q, h);
+			t1 = xnclock_read_raw(&nkclock);
+			xntimerh_date(h) += period;
+			xntimerq_insert(q, h);
+			splexit(s);
+			tmqueue_account(&exp, t1 - t0);
+			tmqueue_breathe(n);
+		}
+
+		for (n = 0; n < bench.nrtimers; n++) {
+			h = holders + n;
+			splhigh(s);
+			t0 = xnclock_read_raw(&nkclock);
+			xntimerq_remove(q, h);
+			t1 = xnclock_read_raw(&nkclock);
+			splexit(s);
+			tmqueue_account(&rem, t1 - t0);
+			tmqueue_breathe(n);
+		}
+
+		if (!xntimerq_empty(q)) {
+			ret = -EPROTO;
+			goto out;
+		}
+	}
+
+	bench.insert_avg_ns = tmqueue_avg_ns(&ins);
+	bench.insert_max_ns = xnclock_ticks_to_ns(&nkclock, ins.max);
+	bench.remove_avg_ns = tmqueue_avg_ns(&rem);
+	bench.remove_max_ns = xnclock_ticks_to_ns(&nkclock, rem.max);
+	bench.expire_avg_ns = tmqueue_avg_ns(&exp);
+	bench.expire_max_ns = xnclock_ticks_to_ns(&nkclock, exp.max);
+
+	ret = rtdm_safe_copy_to_user(fd, u_bench, &bench, sizeof(bench));
+out:
+	xntimerq_destroy(q);
+	vfree(holders);
+	kfree(q);
+
+	return ret;
+}
+
 static int rt_tmbench_ioctl_nrt(struct rtdm_fd *fd,
 				unsigned int request, void __user *arg)
 {
@@ -452,6 +594,10 @@ static int rt_tmbench_ioctl_nrt(struct rtdm_fd *fd,
 	COMPAT_CASE(RTTST_RTIOC_TMBENCH_STOP):
 		err = rt_tmbench_stop(ctx, arg);
 		break;
+
+	case RTTST_RTIOC_TMBENCH_QUEUE:
+		err = rt_tmbench_queue(fd, arg);
+		break;
 	default:
 		err = -EINVAL;
 	}
@@ -0,0 +1,321 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <asm/xenomai/syscall.h>
+#include "internal.h"
+
+/**
+ * @ingroup cobalt_api
+ * @defgroup cobalt_api_batch Batched service calls
+ *
+ * Cobalt services issued in a row, with a single syscall
+ *
+ * A batch collects requests for a few non-blocking Cobalt and RTDM
+ * services into a ring, then submits them all at once to the core,
+ * paying for a single trap instead of one per request. Requests run
+ * in order, exactly as if they had been issued one after the other
+ * by the submitting thread. A batch must not be shared between
+ * threads without external serialization.
+ *
+ * @{
+ */
+
+/**
+ * Initialize a batch.
+ *
+ * @param batch the batch descriptor to initialize.
+ *
+ * @param size the number of requests the batch may hold between two
+ * submissions, which must be a power of two not greater than
+ * COBALT_BATCH_MAXSZ.
+ *
+ * @return 0 on success, otherwise:
+ * - -EINVAL, @a size is invalid;
+ * - -ENOMEM, not enough memory to allocate the ring.
+ *
+ * @apitags{thread-unrestricted, switch-secondary}
+ */
+int cobalt_batch_init(cobalt_batch_t *batch, unsigned int size)
+{
+	struct cobalt_batch_ring *ring;
+
+	if (size == 0 || size > COBALT_BATCH_MAXSZ || (size & (size - 1)))
+		return -EINVAL;
+
+	ring = malloc(sizeof(*ring) + size * sizeof(ring->entries[0]));
+	if (ring == NULL)
+		return -ENOMEM;
+
+	memset(ring, 0, sizeof(*ring) + size * sizeof(ring->entries[0]));
+	ring->mask = size - 1;
+	batch->ring = ring;
+	cobalt_commit_memory(ring);
+
+	return 0;
+}
+
+/**
+ * Release a batch.
+ *
+ * Requests which have not been submitted yet are dropped.
+ *
+ * @param batch the batch descriptor.
+ *
+ * @apitags{thread-unrestricted, switch-secondary}
+ */
+void cobalt_batch_destroy(cobalt_batch_t *batch)
+{
+	free(batch->ring);
+	batch->ring = NULL;
+}
+
+static int batch_queue(cobalt_batch_t *batch, unsigned int nr,
+		       unsigned long a1, unsigned long a2,
+		       unsigned long a3, unsigned long a4)
+{
+	struct cobalt_batch_ring *ring = batch->ring;
+	struct cobalt_batch_entry *e;
+	unsigned int slot;
+
+	slot = ring->tail;
+	if (slot - ring->head > ring->mask)
+		return -ENOSPC;
+
+	e = &ring->entries[slot & ring->mask];
+	e->nr = nr;
+	e->args[0] = a1;
+	e->args[1] = a2;
+	e->args[2] = a3;
+	e->args[3] = a4;
+	e->args[4] = 0;
+	e->result = -EINPROGRESS;
+	ring->tail = slot + 1;
+
+	return (int)(slot & INT_MAX);
+}
+
+/**
+ * Queue a sem_post() request.
+ *
+ * @param batch the batch descriptor.
+ *
+ * @param sem the semaphore to post.
+ *
+ * @return a positive or null slot number identifying the request
+ * for cobalt_batch_result(), or -ENOSPC if the batch is full.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int cobalt_batch_sem_post(cobalt_batch_t *batch, sem_t *sem)
+{
+	struct cobalt_sem_shadow *_sem =
+		&((union cobalt_sem_union *)sem)->shadow_sem;
+
+	return batch_queue(batch, sc_cobalt_sem_post,
+			   (unsigned long)_sem, 0, 0, 0);
+}
+
+/**
+ * Queue an event post request.
+ *
+ * The event bits are raised immediately, waking up waiters (if any)
+ * is deferred until the batch is submitted.
+ *
+ * @param batch the batch descriptor.
+ *
+ * @param event the event to post.
+ *
+ * @param bits the bits to raise.
+ *
+ * @return a positive or null slot number identifying the request
+ * for cobalt_batch_result(), or -ENOSPC if the batch is full.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int cobalt_batch_event_post(cobalt_batch_t *batch,
+			    cobalt_event_t *event, unsigned int bits)
+{
+	struct cobalt_event_state *state = get_event_state(event);
+	struct cobalt_batch_ring *ring = batch->ring;
+
+	if (ring->tail - ring->head > ring->mask)
+		return -ENOSPC;
+
+	__sync_or_and_fetch(&state->value, bits); /* full barrier. */
+
+	return batch_queue(batch, sc_cobalt_event_sync,
+			   (unsigned long)event, 0, 0, 0);
+}
+
+/**
+ * Queue a mq_send() request.
+ *
+ * The request blocks the batch if the queue is full, unless @a mqd
+ * was opened with O_NONBLOCK.
+ *
+ * @return a positive or null slot number identifying the request
+ * for cobalt_batch_result(), or -ENOSPC if the batch is full.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int cobalt_batch_mq_send(cobalt_batch_t *batch, mqd_t mqd,
+			 const char *buf, size_t len, unsigned int prio)
+{
+	return batch_queue(batch, sc_cobalt_mq_timedsend,
+			   mqd, (unsigned long)buf, len, prio);
+}
+
+/**
+ * Queue a read() request on a real-time file descriptor.
+ *
+ * @return a positive or null slot number identifying the request
+ * for cobalt_batch_result(), or -ENOSPC if the batch is full.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int cobalt_batch_read(cobalt_batch_t *batch,
+		      int fd, void *buf, size_t len)
+{
+	return batch_queue(batch, sc_cobalt_read,
+			   fd, (unsigned long)buf, len, 0);
+}
+
+/**
+ * Queue a write() request on a real-time file descriptor.
+ *
+ * @return a positive or null slot number identifying the request
+ * for cobalt_batch_result(), or -ENOSPC if the batch is full.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int cobalt_batch_write(cobalt_batch_t *batch,
+		       int fd, const void *buf, size_t len)
+{
+	return batch_queue(batch, sc_cobalt_write,
+			   fd, (unsigned long)buf, len, 0);
+}
+
+/**
+ * Queue an ioctl() request on a real-time file descriptor.
+ *
+ * Requests only the non-real-time handler of the driver knows about
+ * are issued as regular syscalls by cobalt_batch_submit(), at the
+ * expense of a mode switch.
+ *
+ * @return a positive or null slot number identifying the request
+ * for cobalt_batch_result(), or -ENOSPC if the batch is full.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int cobalt_batch_ioctl(cobalt_batch_t *batch,
+		       int fd, unsigned int request, void *arg)
+{
+	return batch_queue(batch, sc_cobalt_ioctl,
+			   fd, request, (unsigned long)arg, 0);
+}
+
+/**
+ * Submit a batch.
+ *
+ * Runs all requests queued since the last submission with a single
+ * syscall. Upon return, the completion status of each request can
+ * be obtained from cobalt_batch_result().
+ *
+ * RTDM requests the real-time handler of the driver declines are
+ * handed back by the core, then issued as regular syscalls so that
+ * the non-real-time handler may process them, before the remaining
+ * requests are submitted anew.
+ *
+ * @param batch the batch descriptor.
+ *
+ * @param flags COBALT_BATCH_STOP stops processing at the first
+ * request which fails, leaving the remaining ones queued for the
+ * next submission. Otherwise, zero.
+ *
+ * @return the number of requests processed, which may be lower than
+ * the number of queued requests if COBALT_BATCH_STOP was given, or a
+ * signal was received. Otherwise, a negative error code:
+ * - -EINVAL, invalid @a flags or corrupted ring;
+ * - -EFAULT, the ring is not accessible;
+ * - -EPERM, the caller is not a Xenomai thread.
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+int cobalt_batch_submit(cobalt_batch_t *batch, int flags)
+{
+	struct cobalt_batch_ring *ring = batch->ring;
+	struct cobalt_batch_entry *e;
+	int ret, count = 0;
+
+	while (ring->head != ring->tail) {
+		ret = XENOMAI_SYSCALL2(sc_cobalt_batch, ring, flags);
+		if (ret < 0)
+			return count ?: ret;
+
+		count += ret;
+		if (ring->head == ring->tail)
+			break;
+
+		/*
+		 * Processing stopped early: only a request the core
+		 * handed back is left at head with -ENOSYS.
+		 */
+		e = &ring->entries[ring->head & ring->mask];
+		if (e->result != -ENOSYS)
+			break;
+
+		e->result = XENOMAI_SYSCALL5(e->nr,
+					     (unsigned long)e->args[0],
+					     (unsigned long)e->args[1],
+					     (unsigned long)e->args[2],
+					     (unsigned long)e->args[3],
+					     (unsigned long)e->args[4]);
+		ring->head++;
+		count++;
+
+		if (e->result < 0 && (flags & COBALT_BATCH_STOP))
+			break;
+	}
+
+	return count;
+}
+
+/**
+ * Get the completion status of a request.
+ *
+ * @param batch the batch descriptor.
+ *
+ * @param slot the slot number returned when the request was queued.
+ * The result remains available until as many requests as the batch
+ * size have been queued since then.
+ *
+ * @return the value the service would have returned if called
+ * directly (i.e. zero or a positive count on success, a negative
+ * error code on failure), or -EINPROGRESS if the request was not
+ * processed yet.
+ *
+ * @apitags{thread-unrestricted}
+ */
+long cobalt_batch_result(cobalt_batch_t *batch, int slot)
+{
+	struct cobalt_batch_ring *ring = batch->ring;
+
+	return (long)ring->entries[slot & ring->mask].result;
+}
+
+/** @} */
@@ -191,6 +191,7 @@ static void __pthread_cond_cleanup(void *data)
 	} while (err == -EINTR);
 
 	c->mutex->lockcnt = c->count;
+	mutex_set_owner(c->mutex);
 }
 
 static int __attribute__((cold)) cobalt_cond_autoinit(pthread_cond_t *cond)
@@ -293,6 +294,7 @@ COBALT_IMPL(int, pthread_cond_wait, (pthread_cond_t *cond, pthread_mutex_t *mute
 		err = XENOMAI_SYSCALL2(sc_cobalt_cond_wait_epilogue, _cnd, _mx);
 
 	_mx->lockcnt = count;
+	mutex_set_owner(_mx);
 
 	pthread_testcancel();
 
@@ -387,6 +389,7 @@ COBALT_IMPL(int, pthread_cond_timedwait, (pthread_cond_t *cond,
 		err = XENOMAI_SYSCALL2(sc_cobalt_cond_wait_epilogue, _cnd, _mx);
 
 	_mx->lockcnt = count;
+	mutex_set_owner(_mx);
 
 	pthread_testcancel();
 
@@ -189,6 +189,7 @@ static void cobalt_fork_handler(void)
 	cobalt_unmap_umm();
 	cobalt_clear_tsd();
 	cobalt_print_init_atfork();
+	cobalt_mq_init_atfork();
 	if (cobalt_init())
 		exit(EXIT_FAILURE);
 }
@@ -425,14 +425,6 @@ forward:
 	pthread_kill(pthread_self(), SIGDEBUG);
 }
 
-static inline
-struct cobalt_event_state *get_event_state(cobalt_event_t *event)
-{
-	return event->flags & COBALT_EVENT_SHARED ?
-		cobalt_umm_shared + event->state_offset :
-		cobalt_umm_private + event->state_offset;
-}
-
 int cobalt_event_init(cobalt_event_t *event, unsigned int value,
 		      int flags)
 {
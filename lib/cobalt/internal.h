@@ -63,6 +63,48 @@ static inline atomic_t *mutex_get_ownerp(struct cobalt_mutex_shadow *shadow)
 	return &mutex_get_state(shadow)->owner;
 }
 
+#if HAVE_DECL_PTHREAD_MUTEX_ADAPTIVE_NP && defined(CONFIG_SMP)
+static inline int mutex_adaptive_p(struct cobalt_mutex_shadow *shadow)
+{
+	return shadow->attr.type == PTHREAD_MUTEX_ADAPTIVE_NP;
+}
+#else
+static inline int mutex_adaptive_p(struct cobalt_mutex_shadow *shadow)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Adaptive mutexes advertise the user window of their owner, so
+ * that waiters may figure out whether it is running.
+ */
+static inline void mutex_set_owner(struct cobalt_mutex_shadow *shadow)
+{
+	struct xnthread_user_window *u_window;
+
+	if (!mutex_adaptive_p(shadow))
+		return;
+
+	u_window = cobalt_get_current_window();
+	mutex_get_state(shadow)->owner_window =
+		(void *)u_window - cobalt_umm_shared;
+}
+
+static inline void mutex_clear_owner(struct cobalt_mutex_shadow *shadow)
+{
+	if (mutex_adaptive_p(shadow))
+		mutex_get_state(shadow)->owner_window = COBALT_MUTEX_NOWINDOW;
+}
+
+static inline
+struct cobalt_event_state *get_event_state(cobalt_event_t *event)
+{
+	return event->flags & COBALT_EVENT_SHARED ?
+		cobalt_umm_shared + event->state_offset :
+		cobalt_umm_private + event->state_offset;
+}
+
 void cobalt_sigshadow_install_once(void);
 
 void cobalt_thread_init(void);
@@ -75,6 +117,8 @@ void cobalt_print_init(void);
 
 void cobalt_print_init_atfork(void);
 
+void cobalt_mq_init_atfork(void);
+
 void cobalt_ticks_init(unsigned long long freq);
 
 void cobalt_mutex_init(void);
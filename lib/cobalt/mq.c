@@ -18,10 +18,12 @@
 
 #include <errno.h>
 #include <stdarg.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <mqueue.h>
+#include <sys/mman.h>
 #include <asm/xenomai/syscall.h>
 #include "internal.h"
 
@@ -39,6 +41,183 @@
  *@{
  */
 
+/*
+ * Mapped queues opened by this process, indexed by descriptor. The
+ * user-space fast path is only available to descriptors below
+ * MQ_MAP_MAX.
+ */
+#define MQ_MAP_MAX  1024
+
+static struct {
+	struct cobalt_mq_state *state;
+	size_t size;
+	int perms;
+} mq_maps[MQ_MAP_MAX];
+
+static void mq_map_release(mqd_t q)
+{
+	if ((unsigned int)q >= MQ_MAP_MAX || mq_maps[q].state == NULL)
+		return;
+
+	munmap(mq_maps[q].state, mq_maps[q].size);
+	mq_maps[q].state = NULL;
+}
+
+static void mq_map_setup(mqd_t q, int oflags)
+{
+	__u32 size;
+	void *p;
+	int ret;
+
+	if ((unsigned int)q >= MQ_MAP_MAX)
+		return;
+
+	mq_map_release(q);
+	ret = XENOMAI_SYSCALL2(sc_cobalt_mq_getmap, q, &size);
+	if (ret)
+		return;
+
+	/* Each mapped queue lives in its own area, mapped from its descriptor. */
+	p = __COBALT(mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, q, 0));
+	if (p == MAP_FAILED)
+		return;
+
+	mq_maps[q].perms = oflags & O_ACCMODE;
+	mq_maps[q].size = size;
+	mq_maps[q].state = p;
+}
+
+void cobalt_mq_init_atfork(void)
+{
+	mqd_t q;
+
+	/* Descriptors are not inherited by the child. */
+	for (q = 0; q < MQ_MAP_MAX; q++)
+		mq_map_release(q);
+}
+
+static struct cobalt_mq_state *mq_map_get(mqd_t q, int perm)
+{
+	if ((unsigned int)q >= MQ_MAP_MAX)
+		return NULL;
+
+	if (mq_maps[q].perms != perm && mq_maps[q].perms != O_RDWR)
+		return NULL;
+
+	return mq_maps[q].state;
+}
+
+static void mq_map_unlock(mqd_t q, struct cobalt_mq_state *state,
+			  xnhandle_t cur)
+{
+	/* The kernel may have claimed the lock meanwhile. */
+	if (!xnsynch_fast_release(&state->lock, cur))
+		XENOMAI_SYSCALL1(sc_cobalt_mq_unlock, q);
+}
+
+/*
+ * Grab the queue lock for a user-space transfer. This fails if the
+ * lock is contended, or if the kernel has to handle the transfer
+ * (pending waiters, selector binding, armed notification).
+ */
+static int mq_map_lock(mqd_t q, struct cobalt_mq_state *state,
+		       xnhandle_t *curp)
+{
+	xnhandle_t cur;
+
+	cur = cobalt_get_current();
+	if (cur == XN_NO_HANDLE)
+		return -EPERM;
+
+	/* Weak and debug threads have their resources tracked. */
+	if (cobalt_get_current_mode() & (XNWEAK|XNDEBUG))
+		return -EPERM;
+
+	if (xnsynch_fast_acquire(&state->lock, cur))
+		return -EBUSY;
+
+	*curp = cur;
+
+	if (state->kflags) {
+		mq_map_unlock(q, state, cur);
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+/* Returns 0 if sent, a negative value if the kernel has to. */
+static int mq_try_send(mqd_t q, const char *buffer,
+		       size_t len, unsigned prio)
+{
+	struct cobalt_mq_state *state;
+	struct cobalt_mq_slot *slot;
+	xnhandle_t cur;
+	int n;
+
+	state = mq_map_get(q, O_WRONLY);
+	if (state == NULL)
+		return -ENOSYS;
+
+	if (len > state->msgsize || prio >= COBALT_MSGPRIOMAX)
+		return -EINVAL;
+
+	if (mq_map_lock(q, state, &cur))
+		return -EBUSY;
+
+	n = cobalt_mq_get_free(state, state->maxmsg, state->stride);
+	if (n < 0)
+		goto out;
+
+	slot = cobalt_mq_slot(state, state->stride, n);
+	memcpy(slot->data, buffer, len);
+	slot->len = len;
+	slot->prio = prio;
+	n = cobalt_mq_enqueue(state, state->maxmsg, state->stride, n);
+out:
+	mq_map_unlock(q, state, cur);
+
+	return n < 0 ? n : 0;
+}
+
+/* Returns the message size if received, a negative value otherwise. */
+static ssize_t mq_try_receive(mqd_t q, char *buffer,
+			      size_t len, unsigned *prio)
+{
+	struct cobalt_mq_state *state;
+	struct cobalt_mq_slot *slot;
+	xnhandle_t cur;
+	ssize_t ret;
+	int n;
+
+	state = mq_map_get(q, O_RDONLY);
+	if (state == NULL)
+		return -ENOSYS;
+
+	if (len < state->msgsize)
+		return -EMSGSIZE;
+
+	if (mq_map_lock(q, state, &cur))
+		return -EBUSY;
+
+	n = cobalt_mq_dequeue(state, state->maxmsg, state->stride);
+	if (n < 0) {
+		ret = n;
+		goto out;
+	}
+
+	slot = cobalt_mq_slot(state, state->stride, n);
+	ret = slot->len;
+	memcpy(buffer, slot->data, ret);
+	if (prio)
+		*prio = slot->prio;
+	cobalt_mq_put_free(state, state->stride, n);
+out:
+	mq_map_unlock(q, state, cur);
+
+	return ret;
+}
+
 /**
  * @brief Open a message queue
  *
@@ -70,7 +249,13 @@
  * are used when creating a message queue:
  * - @a mq_maxmsg is the maximum number of messages in the queue (128 by
  *   default);
- * - @a mq_msgsize is the maximum size of each message (128 by default).
+ * - @a mq_msgsize is the maximum size of each message (128 by default);
+ * - @a mq_flags may contain MQ_MAPPED, in which case the message pool
+ *   is laid out in an area each process opening the queue maps into
+ *   its address space, instead of the system heap.
+ *   Sending to and receiving from such queue then completes in
+ *   user-space without any system call, unless the caller has to
+ *   wait, or wake up a waiter.
  *
  * @a name may be any arbitrary string, in which slashes have no particular
  * meaning. However, for portability, using a name which starts with a slash and
@@ -121,6 +306,8 @@ COBALT_IMPL(mqd_t, mq_open, (const char *name, int oflags, ...))
 		return (mqd_t)-1;
 	}
 
+	mq_map_setup(fd, oflags);
+
 	return (mqd_t)fd;
 }
 
@@ -148,6 +335,8 @@ COBALT_IMPL(int, mq_close, (mqd_t mqd))
 {
 	int err;
 
+	mq_map_release(mqd);
+
 	err = XENOMAI_SYSCALL1(sc_cobalt_mq_close, mqd);
 	if (err) {
 		errno = -err;
@@ -330,6 +519,9 @@ COBALT_IMPL(int, mq_send, (mqd_t q, const char *buffer, size_t len, unsigned pri
 {
 	int err, oldtype;
 
+	if (mq_try_send(q, buffer, len, prio) == 0)
+		return 0;
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedsend,
@@ -390,6 +582,9 @@ COBALT_IMPL(int, mq_timedsend, (mqd_t q,
 	if (timeout == NULL)
 		return -EFAULT;
 
+	if (mq_try_send(q, buffer, len, prio) == 0)
+		return 0;
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedsend,
@@ -449,6 +644,12 @@ COBALT_IMPL(ssize_t, mq_receive, (mqd_t q, char *buffer, size_t len, unsigned *p
 	ssize_t rlen = (ssize_t) len;
 	int err, oldtype;
 
+	rlen = mq_try_receive(q, buffer, len, prio);
+	if (rlen >= 0)
+		return rlen;
+
+	rlen = (ssize_t) len;
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedreceive,
@@ -514,6 +715,12 @@ COBALT_IMPL(ssize_t, mq_timedreceive, (mqd_t q,
 	if (timeout == NULL)
 		return -EFAULT;
 
+	rlen = mq_try_receive(q, buffer, len, prio);
+	if (rlen >= 0)
+		return rlen;
+
+	rlen = (ssize_t) len;
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedreceive,
@@ -19,7 +19,10 @@
 #include <string.h>
 #include <limits.h>
 #include <pthread.h>
+#include <boilerplate/atomic.h>
+#include <cobalt/ticks.h>
 #include <asm/xenomai/syscall.h>
+#include <asm/xenomai/tsc.h>
 #include "current.h"
 #include "internal.h"
 
@@ -49,6 +52,15 @@
  * By default, Cobalt mutexes are of the normal type, use no
  * priority protocol and may not be shared between several processes.
  *
+ * On SMP systems, mutexes of the @a PTHREAD_MUTEX_ADAPTIVE_NP type
+ * behave like normal ones, except that a contending thread briefly
+ * spins on the lock while its owner is running on another CPU,
+ * instead of sleeping in the kernel right away. Spinning stops as
+ * soon as the owner is preempted or blocks, another thread waits for
+ * the mutex, or a few microseconds have elapsed; the contending
+ * thread then sleeps as usual, under the priority protocol of the
+ * mutex. Lazy priority ceiling mutexes never spin.
+ *
  * Note that only pthread_mutex_init() may be used to initialize a mutex, using
  * the static initializer @a PTHREAD_MUTEX_INITIALIZER is not supported.
  *
@@ -60,6 +72,75 @@ static union cobalt_mutex_union cobalt_autoinit_mutex_union;
 static pthread_mutex_t *const cobalt_autoinit_mutex =
 	&cobalt_autoinit_mutex_union.native_mutex;
 
+#if HAVE_DECL_PTHREAD_MUTEX_ADAPTIVE_NP && defined(CONFIG_SMP)
+
+/*
+ * Longest time a waiter may busy-wait on an adaptive mutex held by a
+ * thread running on another CPU, before sleeping in the kernel.
+ */
+#define COBALT_MUTEX_SPIN_NS  10000
+
+static unsigned long long mutex_spin_ticks;
+
+static inline int owner_running_p(struct cobalt_mutex_state *state)
+{
+	struct xnthread_user_window *u_window;
+	__u32 offset = state->owner_window;
+
+	if (offset == COBALT_MUTEX_NOWINDOW)
+		return 0;
+
+	u_window = cobalt_umm_shared + offset;
+
+	return u_window->oncpu != 0;
+}
+
+/*
+ * Spin on the fast lock for a bounded time, as long as its owner is
+ * observed running in primary mode on a remote CPU and nobody sleeps
+ * on it. Returns zero once the lock is grabbed, non-zero if the
+ * caller should block in the kernel instead, which then applies the
+ * priority protocol of the mutex as usual.
+ */
+static int mutex_spin(struct cobalt_mutex_shadow *shadow, xnhandle_t cur)
+{
+	struct cobalt_mutex_state *state = mutex_get_state(shadow);
+	unsigned long long deadline;
+	xnhandle_t h;
+
+	deadline = cobalt_read_tsc() + mutex_spin_ticks;
+
+	for (;;) {
+		h = atomic_read(&state->owner);
+		if (h == XN_NO_HANDLE) {
+			if (xnsynch_fast_acquire(&state->owner, cur) == 0)
+				return 0;
+		} else if (xnsynch_fast_is_claimed(h) ||
+			   !owner_running_p(state))
+			return -EAGAIN;
+		if ((long long)(cobalt_read_tsc() - deadline) >= 0)
+			return -ETIMEDOUT;
+		cpu_relax();
+	}
+}
+
+static void mutex_spin_init(void)
+{
+	mutex_spin_ticks = cobalt_ns_to_ticks(COBALT_MUTEX_SPIN_NS);
+}
+
+#else  /* !(HAVE_DECL_PTHREAD_MUTEX_ADAPTIVE_NP && CONFIG_SMP) */
+
+static inline int mutex_spin(struct cobalt_mutex_shadow *shadow,
+			     xnhandle_t cur)
+{
+	return -EAGAIN;
+}
+
+static inline void mutex_spin_init(void) { }
+
+#endif /* !(HAVE_DECL_PTHREAD_MUTEX_ADAPTIVE_NP && CONFIG_SMP) */
+
 void cobalt_mutex_init(void)
 {
 	struct cobalt_mutex_shadow *_mutex =
@@ -67,6 +148,7 @@ void cobalt_mutex_init(void)
 	pthread_mutexattr_t rt_init_mattr;
 	int err __attribute__((unused));
 
+	mutex_spin_init();
 	pthread_mutexattr_init(&cobalt_default_mutexattr);
 
 	pthread_mutexattr_init(&rt_init_mattr);
@@ -210,6 +292,10 @@ static int __attribute__((cold)) cobalt_mutex_autoinit(pthread_mutex_t *mutex)
 #if HAVE_DECL_PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP
 	static pthread_mutex_t uninit_errorcheck_mutex =
 		PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP;
+#endif
+#if HAVE_DECL_PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+	static pthread_mutex_t uninit_adaptive_mutex =
+		PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP;
 #endif
 	struct cobalt_mutex_shadow *_mutex =
 		&((union cobalt_mutex_union *)mutex)->shadow_mutex;
@@ -226,6 +312,10 @@ static int __attribute__((cold)) cobalt_mutex_autoinit(pthread_mutex_t *mutex)
 #if HAVE_DECL_PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP
 	else if (memcmp(mutex, &uninit_errorcheck_mutex, sizeof(*mutex)) == 0)
 		type = PTHREAD_MUTEX_ERRORCHECK_NP;
+#endif
+#if HAVE_DECL_PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+	else if (memcmp(mutex, &uninit_adaptive_mutex, sizeof(*mutex)) == 0)
+		type = PTHREAD_MUTEX_ADAPTIVE_NP;
 #endif
 	else
 		return EINVAL;
@@ -311,8 +401,11 @@ start:
 			goto protect;
 fast_path:
 		ret = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
+		if (ret == -EAGAIN && !lazy_protect && mutex_adaptive_p(_mutex))
+			ret = mutex_spin(_mutex, cur);
 		if (ret == 0) {
 			_mutex->lockcnt = 1;
+			mutex_set_owner(_mutex);
 			return 0;
 		}
 	} else {
@@ -328,6 +421,9 @@ slow_path:
 
 		switch(_mutex->attr.type) {
 		case PTHREAD_MUTEX_NORMAL:
+#if HAVE_DECL_PTHREAD_MUTEX_ADAPTIVE_NP
+		case PTHREAD_MUTEX_ADAPTIVE_NP:
+#endif
 			break;
 
 		case PTHREAD_MUTEX_ERRORCHECK:
@@ -345,8 +441,10 @@ slow_path:
 		ret = XENOMAI_SYSCALL1(sc_cobalt_mutex_lock, _mutex);
 	while (ret == -EINTR);
 
-	if (ret == 0)
+	if (ret == 0) {
 		_mutex->lockcnt = 1;
+		mutex_set_owner(_mutex);
+	}
 
 	return -ret;
 protect:	
@@ -422,8 +520,11 @@ start:
 			goto protect;
 fast_path:
 		ret = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
+		if (ret == -EAGAIN && !lazy_protect && mutex_adaptive_p(_mutex))
+			ret = mutex_spin(_mutex, cur);
 		if (ret == 0) {
 			_mutex->lockcnt = 1;
+			mutex_set_owner(_mutex);
 			return 0;
 		}
 	} else {
@@ -439,6 +540,9 @@ slow_path:
 			
 		switch(_mutex->attr.type) {
 		case PTHREAD_MUTEX_NORMAL:
+#if HAVE_DECL_PTHREAD_MUTEX_ADAPTIVE_NP
+		case PTHREAD_MUTEX_ADAPTIVE_NP:
+#endif
 			break;
 
 		case PTHREAD_MUTEX_ERRORCHECK:
@@ -457,8 +561,10 @@ slow_path:
 		ret = XENOMAI_SYSCALL2(sc_cobalt_mutex_timedlock, _mutex, to);
 	} while (ret == -EINTR);
 
-	if (ret == 0)
+	if (ret == 0) {
 		_mutex->lockcnt = 1;
+		mutex_set_owner(_mutex);
+	}
 	return -ret;
 protect:	
 	u_window = cobalt_get_current_window();
@@ -526,6 +632,7 @@ fast_path:
 		ret = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
 		if (ret == 0) {
 			_mutex->lockcnt = 1;
+			mutex_set_owner(_mutex);
 			return 0;
 		}
 	} else {
@@ -554,8 +661,10 @@ slow_path:
 		ret = XENOMAI_SYSCALL1(sc_cobalt_mutex_trylock, _mutex);
 	} while (ret == -EINTR);
 
-	if (ret == 0)
+	if (ret == 0) {
 		_mutex->lockcnt = 1;
+		mutex_set_owner(_mutex);
+	}
 
 	return -ret;
 autoinit:
@@ -627,6 +736,8 @@ start:
 		return 0;
 	}
 
+	mutex_clear_owner(_mutex);
+
 	if ((state->flags & COBALT_MUTEX_COND_SIGNAL))
 		goto do_syscall;
 
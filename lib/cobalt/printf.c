@@ -26,6 +26,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <semaphore.h>
+#include <time.h>
 #include <boilerplate/atomic.h>
 #include <boilerplate/compiler.h>
 #include <cobalt/tunables.h>
@@ -42,11 +44,19 @@
 
 #define RT_PRINT_MODE_FORMAT		0
 #define RT_PRINT_MODE_FWRITE		1
+#define RT_PRINT_MODE_BINARY		2
+
+/* Longest line a binary entry may expand to. */
+#define RT_PRINT_BINARY_LINE		1024
+
+/* Kick the printer when a buffer gets half full. */
+#define RT_PRINT_HIGH_WATER(size)	((size) / 2)
 
 struct entry_head {
 	FILE *dest;
 	uint32_t seq_no;
 	int priority;
+	int mode;
 	size_t len;
 	char data[0];
 } __attribute__((packed));
@@ -61,6 +71,9 @@ struct print_buffer {
 
 	char name[32];
 
+	/* Set by the writer when it kicked the printer. */
+	int kicked;
+
 	/*
 	 * Keep read_pos separated from write_pos to optimise write
 	 * caching on SMP.
@@ -76,8 +89,11 @@ int __cobalt_print_syncdelay = RT_PRINT_DEFAULT_SYNCDELAY;
 
 static struct print_buffer *first_buffer;
 static int buffers;
-static uint32_t seq_no;
+static atomic_t seq_no;
 static struct timespec syncdelay;
+static sem_t printer_sem;
+static int printer_sem_valid;
+static int printer_kick;
 static pthread_mutex_t buffer_lock;
 static pthread_cond_t printer_wakeup;
 static pthread_key_t buffer_key;
@@ -91,6 +107,344 @@ static unsigned long pool_start, pool_len;
 static void release_buffer(struct print_buffer *buffer);
 static void print_buffers(void);
 
+/*
+ * Binary entries store the format pointer followed by the raw
+ * arguments, formatting is deferred to the printer thread. The
+ * conversion scanner below is shared by both ends.
+ */
+enum {
+	BIN_ARG_NONE,
+	BIN_ARG_INT,
+	BIN_ARG_LONG,
+	BIN_ARG_LLONG,
+	BIN_ARG_DOUBLE,
+	BIN_ARG_LDOUBLE,
+	BIN_ARG_PTR,
+	BIN_ARG_STRING,
+	BIN_ARG_ERRNO,
+	BIN_ARG_UNSUPPORTED,
+};
+
+/*
+ * Scan the conversion starting right after a '%' sign. Return a
+ * pointer past the conversion specifier, the argument type, the
+ * number of '*' fields and the literal precision (-1 if none).
+ */
+static const char *scan_conversion(const char *p, int *type,
+				   int *stars, int *prec)
+{
+	int lmod = 0;
+
+	*stars = 0;
+	*prec = -1;
+
+	while (*p && strchr("-+ #0'I", *p))
+		p++;
+
+	if (*p == '*') {
+		(*stars)++;
+		p++;
+	} else
+		while (*p >= '0' && *p <= '9')
+			p++;
+
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			(*stars)++;
+			p++;
+		} else {
+			*prec = 0;
+			while (*p >= '0' && *p <= '9')
+				*prec = *prec * 10 + *p++ - '0';
+		}
+	}
+
+	for (;; p++) {
+		switch (*p) {
+		case 'h':
+			continue;
+		case 'l':
+			lmod = lmod ? 'q' : 'l';
+			continue;
+		case 'q':
+		case 'L':
+			lmod = 'q';
+			continue;
+		case 'j':
+			lmod = sizeof(intmax_t) == sizeof(long) ? 'l' : 'q';
+			continue;
+		case 'z':
+		case 't':
+			lmod = 'l';
+			continue;
+		}
+		break;
+	}
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		*type = lmod == 'q' ? BIN_ARG_LLONG :
+			lmod == 'l' ? BIN_ARG_LONG : BIN_ARG_INT;
+		break;
+	case 'c':
+		*type = BIN_ARG_INT;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		*type = lmod == 'q' ? BIN_ARG_LDOUBLE : BIN_ARG_DOUBLE;
+		break;
+	case 's':
+		*type = lmod ? BIN_ARG_UNSUPPORTED : BIN_ARG_STRING;
+		break;
+	case 'p':
+		*type = BIN_ARG_PTR;
+		break;
+	case 'm':
+		*type = BIN_ARG_ERRNO;
+		break;
+	case '%':
+		*type = BIN_ARG_NONE;
+		break;
+	default:
+		/* %n, positional arguments, wide chars, garbage. */
+		*type = BIN_ARG_UNSUPPORTED;
+		return p;
+	}
+
+	return p + 1;
+}
+
+#define bin_store(__pos, __end, __value)			\
+	({							\
+		typeof(__value) __v = (__value);		\
+		int __ok = (__end) - (__pos) >= sizeof(__v);	\
+		if (__ok) {					\
+			memcpy(__pos, &__v, sizeof(__v));	\
+			(__pos) += sizeof(__v);			\
+		}						\
+		__ok;						\
+	})
+
+/*
+ * Returns the number of bytes stored, zero if the entry does not fit,
+ * or -EINVAL if the format cannot be deferred.
+ */
+static int encode_binary(char *data, int room, const char *format,
+			 va_list args)
+{
+	char *pos = data, *end = data + room;
+	int type, stars, prec, n, star[2];
+	const char *p = format, *s;
+	size_t len;
+
+	if (room <= 0 || !bin_store(pos, end, format))
+		return 0;
+
+	while ((p = strchr(p, '%')) != NULL) {
+		p = scan_conversion(p + 1, &type, &stars, &prec);
+		if (type == BIN_ARG_UNSUPPORTED)
+			return -EINVAL;
+
+		for (n = 0; n < stars; n++) {
+			star[n] = va_arg(args, int);
+			if (!bin_store(pos, end, star[n]))
+				return 0;
+		}
+
+		switch (type) {
+		case BIN_ARG_INT:
+			if (!bin_store(pos, end, va_arg(args, int)))
+				return 0;
+			break;
+		case BIN_ARG_LONG:
+			if (!bin_store(pos, end, va_arg(args, long)))
+				return 0;
+			break;
+		case BIN_ARG_LLONG:
+			if (!bin_store(pos, end, va_arg(args, long long)))
+				return 0;
+			break;
+		case BIN_ARG_DOUBLE:
+			if (!bin_store(pos, end, va_arg(args, double)))
+				return 0;
+			break;
+		case BIN_ARG_LDOUBLE:
+			if (!bin_store(pos, end, va_arg(args, long double)))
+				return 0;
+			break;
+		case BIN_ARG_PTR:
+			if (!bin_store(pos, end, va_arg(args, void *)))
+				return 0;
+			break;
+		case BIN_ARG_ERRNO:
+			if (!bin_store(pos, end, errno))
+				return 0;
+			break;
+		case BIN_ARG_STRING:
+			/* The string may be gone by the time we print it. */
+			s = va_arg(args, const char *) ?: "(null)";
+			if (stars == 2 || (stars == 1 && prec < 0))
+				prec = star[stars - 1];
+			len = prec >= 0 ? strnlen(s, prec) : strlen(s);
+			if ((size_t)(end - pos) < len + 1)
+				return 0;
+			memcpy(pos, s, len);
+			pos[len] = '\0';
+			pos += len + 1;
+			break;
+		}
+	}
+
+	return pos - data;
+}
+
+#define bin_fetch(__pos, __end, __var)				\
+	({							\
+		int __ok = (__end) - (__pos) >= sizeof(__var);	\
+		if (__ok) {					\
+			memcpy(&(__var), __pos, sizeof(__var));	\
+			(__pos) += sizeof(__var);		\
+		}						\
+		__ok;						\
+	})
+
+#define bin_format(__buf, __size, __spec, __stars, __star, __value...)	\
+	((__stars) == 0 ?						\
+	 snprintf(__buf, __size, __spec, ##__value) :			\
+	 (__stars) == 1 ?						\
+	 snprintf(__buf, __size, __spec, (__star)[0], ##__value) :	\
+	 snprintf(__buf, __size, __spec, (__star)[0], (__star)[1], ##__value))
+
+/* Expand a binary entry into @line, return the text length. */
+static size_t format_binary(char *line, size_t size,
+			    const char *data, size_t len)
+{
+	int type, stars, prec, star[2], iv, i, n, e;
+	const char *pos = data, *end = data + len;
+	const char *format, *p, *q;
+	size_t out = 0, speclen;
+	char spec[64];
+	long long ll;
+	long double ld;
+	double d;
+	void *ptr;
+	long l;
+
+	if (!bin_fetch(pos, end, format))
+		return 0;
+
+	for (p = format; *p && out < size - 1; p = q) {
+		if (*p != '%') {
+			q = strchrnul(p, '%');
+			n = q - p;
+			if (n > size - 1 - out)
+				n = size - 1 - out;
+			memcpy(line + out, p, n);
+			out += n;
+			continue;
+		}
+
+		q = scan_conversion(p + 1, &type, &stars, &prec);
+		speclen = q - p;
+		if (speclen >= sizeof(spec))
+			break;
+		memcpy(spec, p, speclen);
+		spec[speclen] = '\0';
+
+		for (i = 0; i < stars; i++)
+			if (!bin_fetch(pos, end, star[i]))
+				goto done;
+
+		switch (type) {
+		case BIN_ARG_NONE:
+			line[out] = '%';
+			n = 1;
+			break;
+		case BIN_ARG_INT:
+			if (!bin_fetch(pos, end, iv))
+				goto done;
+			n = bin_format(line + out, size - out, spec, stars, star, iv);
+			break;
+		case BIN_ARG_LONG:
+			if (!bin_fetch(pos, end, l))
+				goto done;
+			n = bin_format(line + out, size - out, spec, stars, star, l);
+			break;
+		case BIN_ARG_LLONG:
+			if (!bin_fetch(pos, end, ll))
+				goto done;
+			n = bin_format(line + out, size - out, spec, stars, star, ll);
+			break;
+		case BIN_ARG_DOUBLE:
+			if (!bin_fetch(pos, end, d))
+				goto done;
+			n = bin_format(line + out, size - out, spec, stars, star, d);
+			break;
+		case BIN_ARG_LDOUBLE:
+			if (!bin_fetch(pos, end, ld))
+				goto done;
+			n = bin_format(line + out, size - out, spec, stars, star, ld);
+			break;
+		case BIN_ARG_PTR:
+			if (!bin_fetch(pos, end, ptr))
+				goto done;
+			n = bin_format(line + out, size - out, spec, stars, star, ptr);
+			break;
+		case BIN_ARG_ERRNO:
+			if (!bin_fetch(pos, end, e))
+				goto done;
+			errno = e;
+			n = bin_format(line + out, size - out, spec, stars, star, 0);
+			break;
+		case BIN_ARG_STRING:
+			if (pos >= end || memchr(pos, '\0', end - pos) == NULL)
+				goto done;
+			n = bin_format(line + out, size - out, spec, stars, star, pos);
+			pos += strlen(pos) + 1;
+			break;
+		default:
+			goto done;
+		}
+
+		if (n < 0)
+			break;
+		out += n < size - out ? n : size - 1 - out;
+	}
+done:
+	return out;
+}
+
+static void kick_printer(struct print_buffer *buffer,
+			 off_t write_pos, off_t read_pos)
+{
+	size_t fill;
+
+	if (buffer->kicked)
+		return;
+
+	if (write_pos >= read_pos)
+		fill = write_pos - read_pos;
+	else
+		fill = buffer->size - read_pos + write_pos;
+
+	if (fill >= RT_PRINT_HIGH_WATER(buffer->size)) {
+		buffer->kicked = 1;
+		__RT(sem_post(&printer_sem));
+	}
+}
+
 /* *** rt_print API *** */
 
 static int 
@@ -101,6 +455,7 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 	off_t write_pos, read_pos;
 	struct entry_head *head;
 	int len, str_len;
+	va_list bargs;
 	int res = 0;
 
 	if (!buffer) {
@@ -128,7 +483,7 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 		if (len == 0 && read_pos > sizeof(struct entry_head)) {
 			/* Write out empty entry */
 			head = buffer->ring + write_pos;
-			head->seq_no = seq_no;
+			head->seq_no = atomic_read(&seq_no);
 			head->priority = 0;
 			head->len = 0;
 
@@ -149,7 +504,18 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 
 	head = buffer->ring + write_pos;
 
-	if (mode == RT_PRINT_MODE_FORMAT) {
+	if (mode == RT_PRINT_MODE_BINARY) {
+		va_copy(bargs, args);
+		res = encode_binary(head->data, len, format, bargs);
+		va_end(bargs);
+		if (res < 0)
+			/* Cannot defer this one, format it now. */
+			mode = RT_PRINT_MODE_FORMAT;
+	}
+
+	if (mode == RT_PRINT_MODE_BINARY)
+		len = res;
+	else if (mode == RT_PRINT_MODE_FORMAT) {
 		if (stream != RT_PRINT_SYSLOG_STREAM) {
 			/* We do not need the terminating \0 */
 #ifdef CONFIG_XENO_FORTIFY
@@ -202,8 +568,9 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 
 	/* If we were able to write some text, finalise the entry */
 	if (len > 0) {
-		head->seq_no = ++seq_no;
+		head->seq_no = atomic_add_fetch(&seq_no, 1);
 		head->priority = priority;
+		head->mode = mode;
 		head->dest = stream;
 		head->len = len;
 
@@ -216,7 +583,7 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 	    read_pos <= write_pos && read_pos > buffer->size - write_pos) {
 		/* An empty entry marks the wrap-around */
 		head = buffer->ring + write_pos;
-		head->seq_no = seq_no;
+		head->seq_no = atomic_read(&seq_no);
 		head->priority = priority;
 		head->len = 0;
 
@@ -228,6 +595,9 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 
 	buffer->write_pos = write_pos;
 
+	if (printer_kick)
+		kick_printer(buffer, write_pos, read_pos);
+
 	return res;
 }
 
@@ -260,6 +630,43 @@ int __rt_vfprintf_chk(FILE *stream, int level, const char *fmt, va_list args)
 
 #endif
 
+/*
+ * The binary variants only store the format pointer and the raw
+ * arguments, which must therefore refer to a persistent format
+ * string such as a literal. Strings passed for %s are copied. Formats
+ * which cannot be deferred (e.g. %n, positional or wide arguments)
+ * are formatted immediately as rt_vfprintf() would do.
+ */
+int rt_vfprintf_bin(FILE *stream, const char *format, va_list args)
+{
+	return vprint_to_buffer(stream, 0, 0,
+				RT_PRINT_MODE_BINARY, 0, format, args);
+}
+
+int rt_fprintf_bin(FILE *stream, const char *format, ...)
+{
+	va_list args;
+	int n;
+
+	va_start(args, format);
+	n = rt_vfprintf_bin(stream, format, args);
+	va_end(args);
+
+	return n;
+}
+
+int rt_printf_bin(const char *format, ...)
+{
+	va_list args;
+	int n;
+
+	va_start(args, format);
+	n = rt_vfprintf_bin(stdout, format, args);
+	va_end(args);
+
+	return n;
+}
+
 int rt_vprintf(const char *format, va_list args)
 {
 	return rt_vfprintf(stdout, format, args);
@@ -375,6 +782,7 @@ static void rt_print_init_inner(struct print_buffer *buffer, size_t size)
 
 	buffer->read_pos  = 0;
 	buffer->write_pos = 0;
+	buffer->kicked = 0;
 
 	buffer->prev = NULL;
 
@@ -565,7 +973,8 @@ static struct print_buffer *get_next_buffer(void)
 
 	while (pos) {
 		if (pos->read_pos != pos->write_pos &&
-		    (!buffer || get_next_seq_no(pos) < next_seq_no)) {
+		    (!buffer ||
+		     (int32_t)(get_next_seq_no(pos) - next_seq_no) < 0)) {
 			buffer = pos;
 			next_seq_no = get_next_seq_no(pos);
 		}
@@ -577,6 +986,7 @@ static struct print_buffer *get_next_buffer(void)
 
 static void print_buffers(void)
 {
+	static char line[RT_PRINT_BINARY_LINE];
 	struct print_buffer *buffer;
 	struct entry_head *head;
 	off_t read_pos;
@@ -587,6 +997,9 @@ static void print_buffers(void)
 		if (!buffer)
 			break;
 
+		/* Rearm the high-water kick once we got there. */
+		buffer->kicked = 0;
+
 		read_pos = buffer->read_pos;
 		head = buffer->ring + read_pos;
 		len = head->len;
@@ -594,7 +1007,12 @@ static void print_buffers(void)
 		if (len) {
 			/* Print out non-empty entry and proceed */
 			/* Check if output goes to syslog */
-			if (head->dest == RT_PRINT_SYSLOG_STREAM) {
+			if (head->mode == RT_PRINT_MODE_BINARY) {
+				ret = format_binary(line, sizeof(line),
+						    head->data, len);
+				ret = fwrite(line, ret, 1, head->dest);
+				(void)ret;
+			} else if (head->dest == RT_PRINT_SYSLOG_STREAM) {
 				syslog(head->priority,
 				       "%s", head->data);
 			} else {
@@ -621,6 +1039,19 @@ static void print_buffers(void)
 
 static void *printer_loop(void *arg)
 {
+	struct sched_param param = { .sched_priority = 0 };
+	struct timespec ts;
+
+	/*
+	 * Attach to the Cobalt core, so that writers may kick us from
+	 * primary mode when crossing the high-water mark of their
+	 * buffer. The sync delay then only bounds the latency of
+	 * sparse output. Otherwise, fall back to periodic draining.
+	 */
+	if (printer_sem_valid &&
+	    __RT(pthread_setschedparam(pthread_self(), SCHED_OTHER, &param)) == 0)
+		printer_kick = 1;
+
 	while (1) {
 		pthread_mutex_lock(&buffer_lock);
 
@@ -631,7 +1062,19 @@ static void *printer_loop(void *arg)
 
 		pthread_mutex_unlock(&buffer_lock);
 
-		nanosleep(&syncdelay, NULL);
+		if (!printer_kick) {
+			nanosleep(&syncdelay, NULL);
+			continue;
+		}
+
+		__RT(clock_gettime(CLOCK_REALTIME, &ts));
+		ts.tv_sec += syncdelay.tv_sec;
+		ts.tv_nsec += syncdelay.tv_nsec;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_nsec -= 1000000000;
+			ts.tv_sec++;
+		}
+		__RT(sem_timedwait(&printer_sem, &ts));
 	}
 
 	return NULL;
@@ -662,6 +1105,10 @@ void cobalt_print_init_atfork(void)
 	/* re-init to avoid finding it locked by some parent thread */
 	pthread_mutex_init(&buffer_lock, NULL);
 
+	/* Our parent's semaphore is not ours. */
+	printer_kick = 0;
+	printer_sem_valid = 0;
+
 	while (*pbuffer) {
 		if (*pbuffer == my_buffer)
 			pbuffer = &(*pbuffer)->next;
@@ -681,7 +1128,9 @@ void cobalt_print_init(void)
 	unsigned int i;
 
 	first_buffer = NULL;
-	seq_no = 0;
+	atomic_set(&seq_no, 0);
+	printer_kick = 0;
+	printer_sem_valid = __RT(sem_init(&printer_sem, 0, 0)) == 0;
 
 	syncdelay.tv_sec  = __cobalt_print_syncdelay / 1000;
 	syncdelay.tv_nsec = (__cobalt_print_syncdelay % 1000) * 1000000;
@@ -46,3 +46,105 @@ COBALT_IMPL(int, select, (int __nfds, fd_set *__restrict __readfds,
 	errno = -err;
 	return -1;
 }
+
+/**
+ * Create a poll set.
+ *
+ * A poll set is the scalable alternative to select() for real-time
+ * file descriptors: descriptors are registered once with
+ * pollset_ctl_np(), then pollset_wait_np() only reports those which
+ * are ready, at a cost which does not depend on the number of
+ * registered descriptors nor on their values. Unlike select(), there
+ * is no FD_SETSIZE limit. The poll set is released by close().
+ *
+ * @return the file descriptor of the new poll set upon success,
+ * otherwise -1 is returned and errno is set.
+ *
+ * @apitags{thread-unrestricted, switch-secondary}
+ */
+int pollset_create_np(void)
+{
+	int ret;
+
+	ret = XENOMAI_SYSCALL1(sc_cobalt_pollset_create, 0);
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+
+	return ret;
+}
+
+/**
+ * Control a poll set.
+ *
+ * @param psfd the poll set descriptor;
+ * @param op POLLSET_CTL_ADD for registering @a fd, POLLSET_CTL_DEL
+ * for unregistering it, or POLLSET_CTL_MOD for changing the events
+ * it is registered for;
+ * @param fd the real-time descriptor to operate on;
+ * @param events a mask of POLLSET_IN, POLLSET_OUT and POLLSET_EXCEPT,
+ * ignored by POLLSET_CTL_DEL.
+ *
+ * A descriptor is automatically unregistered when it is closed. A
+ * failed POLLSET_CTL_MOD leaves the former registration unchanged.
+ *
+ * @return 0 upon success, otherwise -1 is returned and errno is set:
+ * - EEXIST, @a fd is already registered for some of @a events;
+ * - ENOENT, @a fd is not registered (POLLSET_CTL_DEL/MOD);
+ * - EBADF, @a fd is not a real-time descriptor;
+ * - EINVAL, invalid @a op or @a events.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int pollset_ctl_np(int psfd, int op, int fd, unsigned int events)
+{
+	int ret;
+
+	ret = XENOMAI_SYSCALL4(sc_cobalt_pollset_ctl, psfd, op, fd, events);
+	if (ret) {
+		errno = -ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Wait for events on a poll set.
+ *
+ * @param psfd the poll set descriptor;
+ * @param events array receiving one entry per ready descriptor and
+ * event type;
+ * @param maxevents the number of entries available in @a events;
+ * @param timeout relative timeout, NULL for waiting indefinitely,
+ * or zero for polling without blocking.
+ *
+ * Descriptors which remain ready are reported again by subsequent
+ * calls, in round-robin order when more of them are ready than
+ * @a maxevents permits to report at once.
+ *
+ * @return the number of entries stored into @a events, zero upon
+ * timeout, otherwise -1 is returned and errno is set.
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+int pollset_wait_np(int psfd, struct cobalt_pollset_event *events,
+		    int maxevents, const struct timespec *timeout)
+{
+	int ret, oldtype;
+
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
+
+	ret = XENOMAI_SYSCALL4(sc_cobalt_pollset_wait, psfd,
+			       events, maxevents, timeout);
+
+	pthread_setcanceltype(oldtype, NULL);
+
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+
+	return ret;
+}
@@ -0,0 +1,343 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include "hdr.h"
+
+const double hdr_percentiles[HDR_NRPERCENTILES] = {
+	50.0, 90.0, 99.0, 99.9, 99.99, 99.999, 99.9999,
+};
+
+const char *const hdr_percentile_names[HDR_NRPERCENTILES] = {
+	"50", "90", "99", "99.9", "99.99", "99.999", "99.9999",
+};
+
+/*
+ * Binary format, in host byte order: a file header, followed by
+ * nr_histograms records, each of them followed by nr_entries
+ * non-zero buckets.
+ */
+#define HDR_MAGIC	"XENOHDR"
+#define HDR_VERSION	1
+
+struct hdr_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t precision;
+	uint32_t maxbits;
+	uint32_t nr_histograms;
+	int64_t period_ns;
+	int64_t duration;
+	char kernel[128];
+};
+
+struct hdr_file_record {
+	int32_t cpu;
+	uint32_t nr_entries;
+	uint64_t count;
+	int64_t min;
+	int64_t max;
+	int64_t sum;
+};
+
+struct hdr_file_entry {
+	uint32_t index;
+	uint32_t pad;
+	uint64_t count;
+};
+
+void hdr_init(struct hdr_histogram *h, int cpu)
+{
+	memset(h, 0, sizeof(*h));
+	h->cpu = cpu;
+	h->min = INT64_MAX;
+	h->max = INT64_MIN;
+}
+
+void hdr_merge(struct hdr_histogram *dst,
+	       const struct hdr_histogram *src)
+{
+	int n;
+
+	if (src->count == 0)
+		return;
+
+	for (n = 0; n < HDR_NRBUCKETS; n++)
+		dst->buckets[n] += src->buckets[n];
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/* Largest value which would be counted in the given bucket. */
+static int64_t hdr_highest_value(unsigned int index)
+{
+	unsigned int shift, sub;
+
+	if (index < HDR_SUBBUCKETS)
+		return index;
+
+	index -= HDR_SUBBUCKETS;
+	shift = index / HDR_HALF + 1;
+	sub = index % HDR_HALF + HDR_HALF;
+
+	return ((int64_t)(sub + 1) << shift) - 1;
+}
+
+int64_t hdr_percentile(const struct hdr_histogram *h, double pct)
+{
+	uint64_t target, seen = 0;
+	int64_t value;
+	int n;
+
+	if (h->count == 0)
+		return 0;
+
+	target = ceil(pct * h->count / 100.0);
+	if (target < 1)
+		target = 1;
+	else if (target > h->count)
+		target = h->count;
+
+	for (n = 0; n < HDR_NRBUCKETS - 1; n++) {
+		seen += h->buckets[n];
+		if (seen >= target)
+			break;
+	}
+
+	value = hdr_highest_value(n);
+
+	return value > h->max ? h->max : value;
+}
+
+void hdr_print_header(FILE *fp)
+{
+	char label[16];
+	int n;
+
+	fprintf(fp, "HPH|  cpu|    samples|        min|        avg");
+	for (n = 0; n < HDR_NRPERCENTILES; n++) {
+		snprintf(label, sizeof(label), "p%s", hdr_percentile_names[n]);
+		fprintf(fp, "|%11s", label);
+	}
+	fprintf(fp, "|        max\n");
+}
+
+void hdr_print(FILE *fp, const struct hdr_histogram *h)
+{
+	int n;
+
+	if (h->cpu == HDR_ALLCPUS)
+		fprintf(fp, "HPD|  all");
+	else
+		fprintf(fp, "HPD|%5d", h->cpu);
+
+	if (h->count == 0) {
+		fprintf(fp, "|%11d|\n", 0);
+		return;
+	}
+
+	fprintf(fp, "|%11llu|%11.3f|%11.3f",
+		(unsigned long long)h->count, (double)h->min / 1000,
+		(double)h->sum / h->count / 1000);
+
+	for (n = 0; n < HDR_NRPERCENTILES; n++)
+		fprintf(fp, "|%11.3f",
+			(double)hdr_percentile(h, hdr_percentiles[n]) / 1000);
+
+	fprintf(fp, "|%11.3f\n", (double)h->max / 1000);
+}
+
+int hdr_write(FILE *fp, const struct hdr_run *run,
+	      struct hdr_histogram *const *h, int nr)
+{
+	struct hdr_file_header fh;
+	struct hdr_file_record fr;
+	struct hdr_file_entry fe;
+	int i, n;
+
+	memset(&fh, 0, sizeof(fh));
+	memcpy(fh.magic, HDR_MAGIC, sizeof(HDR_MAGIC));
+	fh.version = HDR_VERSION;
+	fh.precision = HDR_PRECISION;
+	fh.maxbits = HDR_MAXBITS;
+	fh.nr_histograms = nr;
+	fh.period_ns = run->period_ns;
+	fh.duration = run->duration;
+	snprintf(fh.kernel, sizeof(fh.kernel), "%s", run->kernel);
+
+	if (fwrite(&fh, sizeof(fh), 1, fp) != 1)
+		return -EIO;
+
+	for (i = 0; i < nr; i++) {
+		memset(&fr, 0, sizeof(fr));
+		fr.cpu = h[i]->cpu;
+		fr.count = h[i]->count;
+		fr.min = h[i]->min;
+		fr.max = h[i]->max;
+		fr.sum = h[i]->sum;
+		for (n = 0; n < HDR_NRBUCKETS; n++)
+			if (h[i]->buckets[n])
+				fr.nr_entries++;
+
+		if (fwrite(&fr, sizeof(fr), 1, fp) != 1)
+			return -EIO;
+
+		memset(&fe, 0, sizeof(fe));
+		for (n = 0; n < HDR_NRBUCKETS; n++) {
+			if (h[i]->buckets[n] == 0)
+				continue;
+			fe.index = n;
+			fe.count = h[i]->buckets[n];
+			if (fwrite(&fe, sizeof(fe), 1, fp) != 1)
+				return -EIO;
+		}
+	}
+
+	return fflush(fp) ? -EIO : 0;
+}
+
+int hdr_read(FILE *fp, struct hdr_run *run,
+	     struct hdr_histogram ***h_r, int *nr_r)
+{
+	struct hdr_histogram **h;
+	struct hdr_file_header fh;
+	struct hdr_file_record fr;
+	struct hdr_file_entry fe;
+	uint32_t i, n;
+	int ret;
+
+	if (fread(&fh, sizeof(fh), 1, fp) != 1)
+		return -EIO;
+
+	if (memcmp(fh.magic, HDR_MAGIC, sizeof(HDR_MAGIC)) ||
+	    fh.version != HDR_VERSION ||
+	    fh.precision != HDR_PRECISION ||
+	    fh.maxbits != HDR_MAXBITS ||
+	    fh.nr_histograms == 0 || fh.nr_histograms > CPU_SETSIZE)
+		return -EINVAL;
+
+	memset(run, 0, sizeof(*run));
+	memcpy(run->kernel, fh.kernel, sizeof(run->kernel) - 1);
+	run->period_ns = fh.period_ns;
+	run->duration = fh.duration;
+
+	h = calloc(fh.nr_histograms, sizeof(*h));
+	if (h == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < fh.nr_histograms; i++) {
+		h[i] = malloc(sizeof(*h[i]));
+		if (h[i] == NULL) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		ret = -EIO;
+		if (fread(&fr, sizeof(fr), 1, fp) != 1)
+			goto fail;
+
+		ret = -EINVAL;
+		if (fr.nr_entries > HDR_NRBUCKETS)
+			goto fail;
+
+		hdr_init(h[i], fr.cpu);
+		h[i]->count = fr.count;
+		h[i]->min = fr.min;
+		h[i]->max = fr.max;
+		h[i]->sum = fr.sum;
+
+		for (n = 0; n < fr.nr_entries; n++) {
+			ret = -EIO;
+			if (fread(&fe, sizeof(fe), 1, fp) != 1)
+				goto fail;
+			ret = -EINVAL;
+			if (fe.index >= HDR_NRBUCKETS)
+				goto fail;
+			h[i]->buckets[fe.index] = fe.count;
+		}
+	}
+
+	*h_r = h;
+	*nr_r = fh.nr_histograms;
+
+	return 0;
+fail:
+	for (n = 0; n <= i && n < fh.nr_histograms; n++)
+		free(h[n]);
+	free(h);
+
+	return ret;
+}
+
+static void json_string(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(fp, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(fp, "\\u%04x", *s);
+		else
+			fputc(*s, fp);
+	}
+
+	fputc('"', fp);
+}
+
+void hdr_write_json(FILE *fp, const struct hdr_run *run,
+		    struct hdr_histogram *const *h, int nr)
+{
+	int i, n, sep;
+
+	fprintf(fp, "{\n  \"kernel\": ");
+	json_string(fp, run->kernel);
+	fprintf(fp, ",\n  \"period_ns\": %lld,\n  \"duration\": %lld,\n"
+		"  \"precision\": %d,\n  \"histograms\": [",
+		(long long)run->period_ns, (long long)run->duration,
+		HDR_PRECISION);
+
+	for (i = 0; i < nr; i++) {
+		fprintf(fp, "%s\n    {\n", i ? "," : "");
+		if (h[i]->cpu == HDR_ALLCPUS)
+			fprintf(fp, "      \"cpu\": \"all\",\n");
+		else
+			fprintf(fp, "      \"cpu\": %d,\n", h[i]->cpu);
+		fprintf(fp, "      \"count\": %llu,\n",
+			(unsigned long long)h[i]->count);
+		if (h[i]->count) {
+			fprintf(fp, "      \"min\": %lld,\n"
+				"      \"max\": %lld,\n"
+				"      \"mean\": %.3f,\n",
+				(long long)h[i]->min, (long long)h[i]->max,
+				(double)h[i]->sum / h[i]->count);
+			fprintf(fp, "      \"percentiles\": {");
+			for (n = 0; n < HDR_NRPERCENTILES; n++)
+				fprintf(fp, "%s \"%s\": %lld", n ? "," : "",
+					hdr_percentile_names[n],
+					(long long)hdr_percentile(h[i],
+							  hdr_percentiles[n]));
+			fprintf(fp, " },\n");
+		}
+		fprintf(fp, "      \"buckets\": [");
+		for (n = 0, sep = 0; n < HDR_NRBUCKETS; n++) {
+			if (h[i]->buckets[n] == 0)
+				continue;
+			fprintf(fp, "%s[%d, %llu]", sep ? ", " : "", n,
+				(unsigned long long)h[i]->buckets[n]);
+			sep = 1;
+		}
+		fprintf(fp, "]\n    }");
+	}
+
+	fprintf(fp, "\n  ]\n}\n");
+}
@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _TESTSUITE_LATENCY_HDR_H
+#define _TESTSUITE_LATENCY_HDR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * High dynamic range histogram of latency values in nanoseconds.
+ *
+ * Values below HDR_SUBBUCKETS are counted exactly, larger values
+ * fall into HDR_HALF linear sub-buckets per power of two, which
+ * bounds the relative error to 1/HDR_HALF (~0.2%). Negative values
+ * are counted in the first bucket, min, max and sum remain exact.
+ */
+#define HDR_PRECISION	10
+#define HDR_SUBBUCKETS	(1 << HDR_PRECISION)
+#define HDR_HALF	(HDR_SUBBUCKETS / 2)
+#define HDR_MAXBITS	40	/* 2^40 ns, i.e. ~18 minutes. */
+#define HDR_NRBUCKETS	\
+	(HDR_SUBBUCKETS + (HDR_MAXBITS - HDR_PRECISION) * HDR_HALF)
+
+#define HDR_ALLCPUS	-1
+
+struct hdr_histogram {
+	int cpu;
+	uint64_t count;
+	int64_t min;
+	int64_t max;
+	int64_t sum;
+	uint64_t buckets[HDR_NRBUCKETS];
+};
+
+/* What a set of histograms was collected from. */
+struct hdr_run {
+	char kernel[128];
+	int64_t period_ns;
+	int64_t duration;
+};
+
+#define HDR_NRPERCENTILES  7
+
+extern const double hdr_percentiles[HDR_NRPERCENTILES];
+
+extern const char *const hdr_percentile_names[HDR_NRPERCENTILES];
+
+static inline unsigned int hdr_index(int64_t value)
+{
+	unsigned int shift;
+	uint64_t v;
+
+	if (value < HDR_SUBBUCKETS)
+		return value < 0 ? 0 : value;
+
+	v = value;
+	if (v >= 1ULL << HDR_MAXBITS)
+		v = (1ULL << HDR_MAXBITS) - 1;
+
+	shift = 63 - __builtin_clzll(v) - (HDR_PRECISION - 1);
+
+	return HDR_SUBBUCKETS + (shift - 1) * HDR_HALF +
+		(v >> shift) - HDR_HALF;
+}
+
+static inline void hdr_record(struct hdr_histogram *h, int64_t value)
+{
+	h->buckets[hdr_index(value)]++;
+	h->count++;
+	h->sum += value;
+	if (value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+}
+
+void hdr_init(struct hdr_histogram *h, int cpu);
+
+void hdr_merge(struct hdr_histogram *dst,
+	       const struct hdr_histogram *src);
+
+int64_t hdr_percentile(const struct hdr_histogram *h, double pct);
+
+void hdr_print_header(FILE *fp);
+
+void hdr_print(FILE *fp, const struct hdr_histogram *h);
+
+int hdr_write(FILE *fp, const struct hdr_run *run,
+	      struct hdr_histogram *const *h, int nr);
+
+int hdr_read(FILE *fp, struct hdr_run *run,
+	     struct hdr_histogram ***h_r, int *nr_r);
+
+void hdr_write_json(FILE *fp, const struct hdr_run *run,
+		    struct hdr_histogram *const *h, int nr);
+
+#endif /* !_TESTSUITE_LATENCY_HDR_H */
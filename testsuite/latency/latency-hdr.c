@@ -0,0 +1,231 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Merge and compare the HDR histograms saved by latency -O.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <error.h>
+#include <unistd.h>
+#include <sched.h>
+#include "hdr.h"
+
+struct run_data {
+	const char *path;
+	struct hdr_run run;
+	struct hdr_histogram **h;
+	int nr;
+};
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: latency-hdr [options] <file>...\n"
+		"-o <file>       save the merged histograms to <file>\n"
+		"-j              print the merged histograms in JSON format\n"
+		"-c              compare runs, the first file being the baseline\n");
+}
+
+static void load_run(const char *path, struct run_data *rd)
+{
+	FILE *fp;
+	int ret;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		error(1, errno, "cannot open %s", path);
+
+	ret = hdr_read(fp, &rd->run, &rd->h, &rd->nr);
+	fclose(fp);
+	if (ret)
+		error(1, -ret, "cannot load %s", path);
+
+	rd->path = path;
+}
+
+static struct hdr_histogram *new_histogram(int cpu)
+{
+	struct hdr_histogram *h;
+
+	h = malloc(sizeof(*h));
+	if (h == NULL)
+		error(1, ENOMEM, "malloc");
+
+	hdr_init(h, cpu);
+
+	return h;
+}
+
+/* Merge all histograms of a run, regardless of the CPU. */
+static struct hdr_histogram *merge_all(const struct run_data *rd)
+{
+	struct hdr_histogram *all;
+	int n;
+
+	all = new_histogram(HDR_ALLCPUS);
+	for (n = 0; n < rd->nr; n++)
+		hdr_merge(all, rd->h[n]);
+
+	return all;
+}
+
+static void print_delta(const char *name, double base, double cmp)
+{
+	printf("HCD|%10s|%11.3f|%11.3f|", name, base / 1000, cmp / 1000);
+
+	if (base == 0)
+		printf("%10s\n", "n/a");
+	else
+		printf("%+9.1f%%\n",
+		       (cmp - base) * 100.0 / (base < 0 ? -base : base));
+}
+
+static void compare_runs(struct run_data *runs, int nr_runs)
+{
+	struct hdr_histogram *base, *cmp;
+	char label[16];
+	int n, i;
+
+	base = merge_all(runs);
+
+	for (n = 1; n < nr_runs; n++) {
+		cmp = merge_all(runs + n);
+		printf("== baseline: %s (%s)\n", runs[0].path, runs[0].run.kernel);
+		printf("== compared: %s (%s)\n", runs[n].path, runs[n].run.kernel);
+		printf("HCH|%10s|%11s|%11s|%10s\n",
+		       "param", "baseline", "compared", "delta");
+		printf("HCD|%10s|%11llu|%11llu|\n", "samples",
+		       (unsigned long long)base->count,
+		       (unsigned long long)cmp->count);
+		if (base->count && cmp->count) {
+			print_delta("min", base->min, cmp->min);
+			print_delta("avg", (double)base->sum / base->count,
+				    (double)cmp->sum / cmp->count);
+			for (i = 0; i < HDR_NRPERCENTILES; i++) {
+				snprintf(label, sizeof(label), "p%s",
+					 hdr_percentile_names[i]);
+				print_delta(label,
+					    hdr_percentile(base, hdr_percentiles[i]),
+					    hdr_percentile(cmp, hdr_percentiles[i]));
+			}
+			print_delta("max", base->max, cmp->max);
+		}
+		free(cmp);
+	}
+
+	free(base);
+}
+
+static void merge_runs(struct run_data *runs, int nr_runs,
+		       const char *output, int json)
+{
+	struct hdr_histogram **merged, *h;
+	struct hdr_run run;
+	int n, i, m, nr = 0;
+	FILE *fp;
+
+	run = runs[0].run;
+	run.duration = 0;
+
+	/* One histogram per CPU, plus one for all of them. */
+	merged = calloc(CPU_SETSIZE + 1, sizeof(*merged));
+	if (merged == NULL)
+		error(1, ENOMEM, "calloc");
+
+	for (n = 0; n < nr_runs; n++) {
+		if (strcmp(runs[n].run.kernel, run.kernel))
+			fprintf(stderr, "latency-hdr: warning: merging runs "
+				"from different kernels\n");
+		run.duration += runs[n].run.duration;
+		for (i = 0; i < runs[n].nr; i++) {
+			h = runs[n].h[i];
+			for (m = 0; m < nr; m++)
+				if (merged[m]->cpu == h->cpu)
+					break;
+			if (m == nr) {
+				if (nr == CPU_SETSIZE)
+					error(1, EINVAL, "too many CPUs");
+				merged[nr++] = new_histogram(h->cpu);
+			}
+			hdr_merge(merged[m], h);
+		}
+	}
+
+	if (output) {
+		fp = fopen(output, "w");
+		if (fp == NULL)
+			error(1, errno, "cannot open %s", output);
+		if (hdr_write(fp, &run, merged, nr))
+			error(1, EIO, "cannot write %s", output);
+		fclose(fp);
+	}
+
+	if (nr > 1) {
+		merged[nr] = new_histogram(HDR_ALLCPUS);
+		for (m = 0; m < nr; m++)
+			hdr_merge(merged[nr], merged[m]);
+		nr++;
+	}
+
+	if (json)
+		hdr_write_json(stdout, &run, merged, nr);
+	else {
+		printf("== %s, %lld us period, %lld s\n", run.kernel,
+		       (long long)run.period_ns / 1000,
+		       (long long)run.duration);
+		printf("== All results in microseconds\n");
+		hdr_print_header(stdout);
+		for (m = 0; m < nr; m++)
+			hdr_print(stdout, merged[m]);
+	}
+
+	for (m = 0; m < nr; m++)
+		free(merged[m]);
+	free(merged);
+}
+
+int main(int argc, char *const argv[])
+{
+	int c, n, compare = 0, json = 0, nr_runs;
+	const char *output = NULL;
+	struct run_data *runs;
+
+	while ((c = getopt(argc, argv, "o:jc")) != EOF) {
+		switch (c) {
+		case 'o':
+			output = optarg;
+			break;
+		case 'j':
+			json = 1;
+			break;
+		case 'c':
+			compare = 1;
+			break;
+		default:
+			usage();
+			return 2;
+		}
+	}
+
+	nr_runs = argc - optind;
+	if (nr_runs < 1 || (compare && nr_runs < 2)) {
+		usage();
+		return 2;
+	}
+
+	runs = calloc(nr_runs, sizeof(*runs));
+	if (runs == NULL)
+		error(1, ENOMEM, "calloc");
+
+	for (n = 0; n < nr_runs; n++)
+		load_run(argv[optind + n], runs + n);
+
+	if (compare)
+		compare_runs(runs, nr_runs);
+	else
+		merge_runs(runs, nr_runs, output, json);
+
+	return 0;
+}
@@ -35,12 +35,14 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <sys/timerfd.h>
+#include <sys/utsname.h>
 #include <xeno_config.h>
 #include <rtdm/testing.h>
 #include <boilerplate/trace.h>
 #include <xenomai/init.h>
+#include "hdr.h"
 
-pthread_t latency_task, display_task;
+pthread_t display_task;
 
 sem_t *display_sem;
 
@@ -51,7 +53,6 @@ sem_t *display_sem;
 #define LOPRIO 0
 
 unsigned max_relaxed;
-int32_t minjitter, maxjitter, avgjitter;
 int32_t gminjitter = TEN_MILLIONS, gmaxjitter = -TEN_MILLIONS, goverrun = 0;
 int64_t gavgjitter = 0;
 
@@ -78,7 +79,26 @@ const char *test_mode_names[] = {
 };
 
 time_t test_start, test_end;	/* report test duration */
-int test_loops = 0;		/* outer loop count */
+
+/* One sampling thread per measured CPU (user task mode). */
+struct sampler {
+	int cpu;
+	pthread_t task;
+	int loops;		/* outer loop count */
+	int reports;		/* results published so far */
+	int32_t minjitter, maxjitter, avgjitter;
+	int32_t gminjitter, gmaxjitter;
+	int64_t gavgjitter;
+	int overrun;
+	int32_t *histogram_avg, *histogram_max, *histogram_min;
+	struct hdr_histogram hdr;
+};
+
+struct sampler *samplers;
+int nr_samplers;
+cpu_set_t sampling_cpus;
+
+char *hdr_file = NULL, *json_file = NULL;
 
 /* Warmup time : in order to avoid spurious cache effects on low-end machines. */
 #define WARMUP_TIME 1
@@ -110,12 +130,17 @@ static void *latency(void *cookie)
 	int err, count, nsamples, warmup = 1;
 	unsigned long long fault_threshold;
 	struct itimerspec timer_conf;
+	struct sampler *s = cookie;
 	struct timespec expected;
 	unsigned old_relaxed = 0;
 	char task_name[16];
 	int tfd;
 
-	snprintf(task_name, sizeof(task_name), "sampling-%d", getpid());
+	if (nr_samplers > 1)
+		snprintf(task_name, sizeof(task_name), "sampling%d-%d",
+			 s->cpu, getpid());
+	else
+		snprintf(task_name, sizeof(task_name), "sampling-%d", getpid());
 	err = pthread_setname_np(pthread_self(), task_name);
 	if (err)
 		error(1, err, "pthread_setname_np(latency)");
@@ -155,7 +180,7 @@ static void *latency(void *cookie)
 		uint32_t overrun = 0;
 		int64_t sumj;
 
-		test_loops++;
+		s->loops++;
 
 		for (count = sumj = 0; count < nsamples; count++) {
 			unsigned int new_relaxed;
@@ -190,38 +215,44 @@ static void *latency(void *cookie)
 				expected.tv_sec++;
 			}
 
-			if (freeze_max && (dt > gmaxjitter)
+			if (freeze_max && (dt > s->gmaxjitter)
 			    && !(finished || warmup)) {
 				xntrace_user_freeze(dt, 0);
-				gmaxjitter = dt;
+				s->gmaxjitter = dt;
 			}
 
-			if (!(finished || warmup) && need_histo())
-				add_histogram(histogram_avg, dt);
+			if (!(finished || warmup)) {
+				hdr_record(&s->hdr, dt);
+				if (need_histo())
+					add_histogram(s->histogram_avg, dt);
+			}
 		}
 
 		if (!warmup) {
 			if (!finished && need_histo()) {
-				add_histogram(histogram_max, maxj);
-				add_histogram(histogram_min, minj);
+				add_histogram(s->histogram_max, maxj);
+				add_histogram(s->histogram_min, minj);
 			}
 
-			minjitter = minj;
-			if (minj < gminjitter)
-				gminjitter = minj;
-
-			maxjitter = maxj;
-			if (maxj > gmaxjitter)
-				gmaxjitter = maxj;
-
-			avgjitter = sumj / nsamples;
-			gavgjitter += avgjitter;
-			goverrun += overrun;
-			sem_post(display_sem);
+			s->minjitter = minj;
+			if (minj < s->gminjitter)
+				s->gminjitter = minj;
+
+			s->maxjitter = maxj;
+			if (maxj > s->gmaxjitter)
+				s->gmaxjitter = maxj;
+
+			s->avgjitter = sumj / nsamples;
+			s->gavgjitter += s->avgjitter;
+			s->overrun += overrun;
+			s->reports++;
+			/* The first sampler paces the display. */
+			if (s == samplers)
+				sem_post(display_sem);
 		}
 
-		if (warmup && test_loops == WARMUP_TIME) {
-			test_loops = 0;
+		if (warmup && s->loops == WARMUP_TIME) {
+			s->loops = 0;
 			warmup = 0;
 		}
 	}
@@ -229,6 +260,42 @@ static void *latency(void *cookie)
 	return NULL;
 }
 
+/*
+ * Fold the latest results of all samplers into the figures the
+ * display reports, as if they came from a single CPU.
+ */
+static void collect_samplers(long *minj, long *avgj, long *maxj,
+			     long *gminj, long *gmaxj)
+{
+	struct sampler *s;
+	int n, nr = 0;
+
+	*minj = *gminj = TEN_MILLIONS;
+	*maxj = *gmaxj = -TEN_MILLIONS;
+	*avgj = 0;
+	goverrun = 0;
+
+	for (n = 0; n < nr_samplers; n++) {
+		s = samplers + n;
+		if (s->reports == 0)
+			continue;
+		if (s->minjitter < *minj)
+			*minj = s->minjitter;
+		if (s->maxjitter > *maxj)
+			*maxj = s->maxjitter;
+		if (s->gminjitter < *gminj)
+			*gminj = s->gminjitter;
+		if (s->gmaxjitter > *gmaxj)
+			*gmaxj = s->gmaxjitter;
+		*avgj += s->avgjitter;
+		goverrun += s->overrun;
+		nr++;
+	}
+
+	if (nr)
+		*avgj /= nr;
+}
+
 static void *display(void *cookie)
 {
 	char task_name[16];
@@ -288,12 +355,7 @@ static void *display(void *cookie)
 				return NULL;
 			}
 
-			/* convert jitters to nanoseconds. */
-			minj = minjitter;
-			gminj = gminjitter;
-			avgj = avgjitter;
-			maxj = maxjitter;
-			gmaxj = gmaxjitter;
+			collect_samplers(&minj, &avgj, &maxj, &gminj, &gmaxj);
 
 		} else {
 			struct rttst_interm_bench_res result;
@@ -477,10 +539,103 @@ static void dump_hist_stats(time_t duration)
 		dump_histo_gnuplot(histogram_avg, duration);
 }
 
+static void dump_hdr(time_t duration)
+{
+	static struct hdr_histogram all;
+	struct hdr_histogram **h;
+	struct utsname ubuf;
+	struct hdr_run run;
+	FILE *fp;
+	int n;
+
+	h = malloc(sizeof(*h) * (nr_samplers + 1));
+	if (h == NULL)
+		return;
+
+	hdr_init(&all, HDR_ALLCPUS);
+	for (n = 0; n < nr_samplers; n++) {
+		h[n] = &samplers[n].hdr;
+		hdr_merge(&all, h[n]);
+	}
+
+	if (nr_samplers > 1)
+		h[n] = &all;
+
+	hdr_print_header(stdout);
+	for (n = 0; n < nr_samplers; n++)
+		hdr_print(stdout, h[n]);
+	if (nr_samplers > 1)
+		hdr_print(stdout, &all);
+
+	memset(&run, 0, sizeof(run));
+	if (uname(&ubuf) == 0)
+		/* uname strings may be longer, bound both to fit. */
+		snprintf(run.kernel, sizeof(run.kernel), "%.*s %.*s",
+			 (int)sizeof(run.kernel) / 2 - 1, ubuf.release,
+			 (int)sizeof(run.kernel) / 2 - 1, ubuf.version);
+	run.period_ns = period_ns;
+	run.duration = duration;
+
+	if (hdr_file) {
+		fp = fopen(hdr_file, "w");
+		if (fp == NULL || hdr_write(fp, &run, h, nr_samplers))
+			warning("cannot write HDR data to %s", hdr_file);
+		if (fp)
+			fclose(fp);
+	}
+
+	if (json_file) {
+		if (strcmp(json_file, "-") == 0)
+			fp = stdout;
+		else
+			fp = fopen(json_file, "w");
+		if (fp) {
+			hdr_write_json(fp, &run, h,
+				       nr_samplers > 1 ? nr_samplers + 1 : 1);
+			if (fp != stdout)
+				fclose(fp);
+		} else
+			warning("cannot write JSON data to %s", json_file);
+	}
+
+	free(h);
+}
+
+/* Sum up the per-CPU results, once all samplers are stopped. */
+static void gather_samplers(void)
+{
+	struct sampler *s;
+	int64_t avgsum = 0;
+	int n, i;
+
+	goverrun = 0;
+
+	for (n = 0; n < nr_samplers; n++) {
+		s = samplers + n;
+		if (s->gminjitter < gminjitter)
+			gminjitter = s->gminjitter;
+		if (s->gmaxjitter > gmaxjitter)
+			gmaxjitter = s->gmaxjitter;
+		avgsum += s->gavgjitter / ((s->loops > 1 ? s->loops : 2) - 1);
+		goverrun += s->overrun;
+		if (need_histo()) {
+			for (i = 0; i < histogram_size; i++) {
+				histogram_avg[i] += s->histogram_avg[i];
+				histogram_max[i] += s->histogram_max[i];
+				histogram_min[i] += s->histogram_min[i];
+			}
+		}
+	}
+
+	if (nr_samplers)
+		gavgjitter = avgsum / nr_samplers;
+}
+
 static void cleanup(void)
 {
 	struct rttst_overall_bench_res overall;
 	time_t actual_duration;
+	int n;
 
 	time(&test_end);
 	actual_duration = test_end - test_start - WARMUP_TIME;
@@ -490,13 +645,15 @@ static void cleanup(void)
 	pthread_cancel(display_task);
 
 	if (test_mode == USER_TASK) {
-		pthread_cancel(latency_task);
-		pthread_join(latency_task, NULL);
+		for (n = 0; n < nr_samplers; n++)
+			pthread_cancel(samplers[n].task);
+		for (n = 0; n < nr_samplers; n++)
+			pthread_join(samplers[n].task, NULL);
 		pthread_join(display_task, NULL);
 
 		sem_close(display_sem);
 		sem_unlink(sem_name);
-		gavgjitter /= (test_loops > 1 ? test_loops : 2) - 1;
+		gather_samplers();
 	} else {
 		overall.histogram_min = histogram_min;
 		overall.histogram_max = histogram_max;
@@ -515,6 +672,9 @@ static void cleanup(void)
 	if (need_histo())
 		dump_hist_stats(actual_duration);
 
+	if (nr_samplers && (do_stats || hdr_file || json_file))
+		dump_hdr(actual_duration);
+
 	printf
 	    ("---|-----------|-----------|-----------|--------|------|-------------------------\n"
 	     "RTS|%11.3f|%11.3f|%11.3f|%8d|%6u|    %.2ld:%.2ld:%.2ld/%.2d:%.2d:%.2d\n",
@@ -534,6 +694,13 @@ static void cleanup(void)
 	if (histogram_min)
 		free(histogram_min);
 
+	for (n = 0; n < nr_samplers; n++) {
+		free(samplers[n].histogram_avg);
+		free(samplers[n].histogram_max);
+		free(samplers[n].histogram_min);
+	}
+	free(samplers);
+
 	exit(0);
 }
 
@@ -609,12 +776,47 @@ void application_usage(void)
 		"-D <testing_device_no>          number of testing device, default=0\n"
 		"-t <test_mode>                  0=user task (default), 1=kernel task, 2=timer IRQ\n"
 		"-f                              freeze trace for each new max latency\n"
-		"-c <cpu>                        pin measuring task down to given CPU\n"
+		"-c <cpu-list>                   measure on given CPUs, one task per CPU (e.g. 0,2-3)\n"
+		"-O <file>                       save HDR histograms to <file> (binary)\n"
+		"-J <file>                       save HDR histograms to <file> (JSON, - for stdout)\n"
 		"-P <priority>                   task priority (test mode 0 and 1 only)\n"
 		"-b                              break upon mode switch\n"
 		);
 }
 
+static void parse_cpu_list(const char *arg, cpu_set_t *cpus)
+{
+	const char *p = arg;
+	long first, last;
+	char *end;
+
+	CPU_ZERO(cpus);
+
+	for (;;) {
+		first = strtol(p, &end, 10);
+		if (end == p)
+			goto bad;
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p)
+				goto bad;
+		}
+		if (first < 0 || last < first || last >= CPU_SETSIZE)
+			goto bad;
+		while (first <= last)
+			CPU_SET(first++, cpus);
+		if (*end == '\0')
+			return;
+		if (*end != ',')
+			goto bad;
+		p = end + 1;
+	}
+bad:
+	error(1, EINVAL, "invalid CPU list '%s'", arg);
+}
+
 static void setup_sched_parameters(pthread_attr_t *attr, int prio)
 {
 	struct sched_param p;
@@ -641,12 +843,16 @@ static void setup_sched_parameters(pthread_attr_t *attr, int prio)
 int main(int argc, char *const *argv)
 {
 	struct sigaction sa __attribute__((unused));
-	int c, ret, sig, cpu = 0;
+	int c, ret, sig, cpu, n;
+	struct sampler *s;
 	pthread_attr_t tattr;
 	cpu_set_t cpus;
 	sigset_t mask;
 
-	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:b")) != EOF)
+	CPU_ZERO(&sampling_cpus);
+	CPU_SET(0, &sampling_cpus);
+
+	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:bO:J:")) != EOF)
 		switch (c) {
 		case 'g':
 			do_gnuplot = strdup(optarg);
@@ -707,9 +913,15 @@ int main(int argc, char *const *argv)
 			break;
 
 		case 'c':
-			cpu = atoi(optarg);
-			if (cpu < 0 || cpu >= CPU_SETSIZE)
-				error(1, EINVAL, "invalid CPU #%d", cpu);
+			parse_cpu_list(optarg, &sampling_cpus);
+			break;
+
+		case 'O':
+			hdr_file = strdup(optarg);
+			break;
+
+		case 'J':
+			json_file = strdup(optarg);
 			break;
 
 		case 'P':
@@ -733,6 +945,10 @@ int main(int argc, char *const *argv)
 	if (test_mode < USER_TASK || test_mode > TIMER_HANDLER)
 		error(1, EINVAL, "invalid test mode");
 
+	if (test_mode != USER_TASK &&
+	    (CPU_COUNT(&sampling_cpus) > 1 || hdr_file || json_file))
+		error(1, EINVAL, "-O, -J and multiple CPUs require -t0");
+
 #ifdef CONFIG_XENO_MERCURY
 	if (test_mode != USER_TASK)
 		error(1, EINVAL, "-t1, -t2 not allowed over Mercury");
@@ -747,6 +963,27 @@ int main(int argc, char *const *argv)
 	if (!(histogram_avg && histogram_max && histogram_min))
 		cleanup();
 
+	if (test_mode == USER_TASK) {
+		samplers = calloc(CPU_COUNT(&sampling_cpus), sizeof(*samplers));
+		if (samplers == NULL)
+			error(1, ENOMEM, "calloc(samplers)");
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (!CPU_ISSET(cpu, &sampling_cpus))
+				continue;
+			s = samplers + nr_samplers++;
+			s->cpu = cpu;
+			s->gminjitter = TEN_MILLIONS;
+			s->gmaxjitter = -TEN_MILLIONS;
+			hdr_init(&s->hdr, cpu);
+			s->histogram_avg = calloc(histogram_size, sizeof(int32_t));
+			s->histogram_max = calloc(histogram_size, sizeof(int32_t));
+			s->histogram_min = calloc(histogram_size, sizeof(int32_t));
+			if (!(s->histogram_avg && s->histogram_max &&
+			      s->histogram_min))
+				error(1, ENOMEM, "calloc(histogram)");
+		}
+	}
+
 	if (period_ns == 0)
 		period_ns = CONFIG_XENO_DEFAULT_PERIOD;	/* ns */
 
@@ -783,6 +1020,9 @@ int main(int argc, char *const *argv)
 	       "== All results in microseconds\n",
 	       period_ns / 1000, test_mode_names[test_mode]);
 
+	if (nr_samplers > 1)
+		printf("== Sampling on %d CPUs\n", nr_samplers);
+
 	if (test_mode != USER_TASK) {
 		benchdev = open("/dev/rtdm/timerbench", O_RDWR);
 		if (benchdev < 0)
@@ -797,16 +1037,17 @@ int main(int argc, char *const *argv)
 
 	pthread_attr_destroy(&tattr);
 
-	if (test_mode == USER_TASK) {
+	for (n = 0; n < nr_samplers; n++) {
+		s = samplers + n;
 		setup_sched_parameters(&tattr, priority);
 		CPU_ZERO(&cpus);
-		CPU_SET(cpu, &cpus);
+		CPU_SET(s->cpu, &cpus);
 
 		ret = pthread_attr_setaffinity_np(&tattr, sizeof(cpus), &cpus);
 		if (ret)
 			error(1, ret, "pthread_attr_setaffinity_np()");
 
-		ret = pthread_create(&latency_task, &tattr, latency, NULL);
+		ret = pthread_create(&s->task, &tattr, latency, s);
 		if (ret)
 			error(1, ret, "pthread_create(latency)");
 
@@ -0,0 +1,378 @@
+/*
+ * RTIPC size-class pool test and benchmark.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(iddp_pool,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+		   ),
+		   "Check RTIPC size-class pools, compare the send latency\n"
+		   "\twith the heap-based pool on mixed message sizes.\n"
+		   "\tloops=<N>	measurement loops (default: 100000)"
+);
+
+#define IDDP_SVPORT	16
+#define BENCH_WINDOW	32
+#define BENCH_MINSZ	16
+#define BENCH_MAXSZ	4096
+
+static const struct rtipc_pool_class bench_classes[] = {
+	{ .size = 64, .count = BENCH_WINDOW },
+	{ .size = 256, .count = BENCH_WINDOW },
+	{ .size = 1024, .count = BENCH_WINDOW },
+	{ .size = BENCH_MAXSZ, .count = BENCH_WINDOW },
+};
+
+#define BENCH_NRCLASSES	(sizeof(bench_classes) / sizeof(bench_classes[0]))
+
+static long long diff_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1000000000LL +
+		t1->tv_nsec - t0->tv_nsec;
+}
+
+static int iddp_socket(const void *poolcf, socklen_t len)
+{
+	struct sockaddr_ipc saddr;
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (s < 0)
+		return s;
+
+	ret = smokey_check_errno(setsockopt(s, SOL_IDDP, IDDP_POOLSZ,
+					    poolcf, len));
+	if (ret)
+		goto fail;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = IDDP_SVPORT;
+	ret = smokey_check_errno(bind(s, (struct sockaddr *)&saddr,
+				      sizeof(saddr)));
+	if (ret)
+		goto fail;
+
+	return s;
+fail:
+	close(s);
+
+	return ret;
+}
+
+static int iddp_client(void)
+{
+	struct sockaddr_ipc saddr;
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (s < 0)
+		return s;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = IDDP_SVPORT;
+	ret = smokey_check_errno(connect(s, (struct sockaddr *)&saddr,
+					 sizeof(saddr)));
+	if (ret) {
+		close(s);
+		return ret;
+	}
+
+	return s;
+}
+
+static int get_poolstat(int s, struct rtipc_pool_stat *stat)
+{
+	socklen_t len = sizeof(*stat);
+
+	return smokey_check_errno(getsockopt(s, SOL_IDDP, IDDP_POOLSTAT,
+					     stat, &len));
+}
+
+static int check_setup(void)
+{
+	struct rtipc_pool_setup cf;
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (s < 0)
+		return s;
+
+	memset(&cf, 0, sizeof(cf));
+	ret = setsockopt(s, SOL_IDDP, IDDP_POOLSZ, &cf, sizeof(cf));
+	if (!smokey_assert(ret && errno == EINVAL))
+		goto fail;
+
+	cf.nr_classes = 2;
+	cf.classes[0].size = 256;
+	cf.classes[0].count = 4;
+	cf.classes[1].size = 64;
+	cf.classes[1].count = 4;
+	ret = setsockopt(s, SOL_IDDP, IDDP_POOLSZ, &cf, sizeof(cf));
+	if (!smokey_assert(ret && errno == EINVAL))
+		goto fail;
+
+	cf.classes[1].size = 1024;
+	cf.classes[1].count = 0;
+	ret = setsockopt(s, SOL_IDDP, IDDP_POOLSZ, &cf, sizeof(cf));
+	if (!smokey_assert(ret && errno == EINVAL))
+		goto fail;
+
+	cf.nr_classes = RTIPC_POOL_MAXCLASSES + 1;
+	ret = setsockopt(s, SOL_IDDP, IDDP_POOLSZ, &cf, sizeof(cf));
+	if (!smokey_assert(ret && errno == EINVAL))
+		goto fail;
+
+	close(s);
+
+	return 0;
+fail:
+	close(s);
+
+	return -EINVAL;
+}
+
+static int check_classes(void)
+{
+	struct rtipc_pool_class_stat *cs;
+	struct rtipc_pool_setup cf;
+	struct rtipc_pool_stat st;
+	char buf[512];
+	int sv, cl, ret, n;
+
+	memset(&cf, 0, sizeof(cf));
+	cf.nr_classes = 2;
+	cf.classes[0].size = 64;
+	cf.classes[0].count = 2;
+	cf.classes[1].size = 256;
+	cf.classes[1].count = 1;
+
+	sv = iddp_socket(&cf, sizeof(cf));
+	if (sv < 0)
+		return sv;
+
+	cl = iddp_client();
+	if (cl < 0) {
+		ret = cl;
+		goto close_sv;
+	}
+
+	memset(buf, 0, sizeof(buf));
+
+	/* Two datagrams from the best fit, the third one falls back. */
+	for (n = 0; n < 3; n++) {
+		ret = smokey_check_errno(send(cl, buf, 32, MSG_DONTWAIT));
+		if (ret < 0)
+			goto close_cl;
+	}
+
+	ret = send(cl, buf, 32, MSG_DONTWAIT);
+	if (!smokey_assert(ret < 0 && errno == EAGAIN))
+		goto fail;
+
+	ret = send(cl, buf, 257, MSG_DONTWAIT);
+	if (!smokey_assert(ret < 0 && errno == EMSGSIZE))
+		goto fail;
+
+	for (n = 0; n < 3; n++) {
+		ret = smokey_check_errno(recv(sv, buf, sizeof(buf),
+					      MSG_DONTWAIT));
+		if (ret < 0)
+			goto close_cl;
+		if (!smokey_assert(ret == 32))
+			goto fail;
+	}
+
+	/* A 256 byte datagram may use the larger class only. */
+	ret = smokey_check_errno(send(cl, buf, 256, MSG_DONTWAIT));
+	if (ret < 0)
+		goto close_cl;
+
+	ret = smokey_check_errno(recv(sv, buf, sizeof(buf), MSG_DONTWAIT));
+	if (ret < 0)
+		goto close_cl;
+
+	ret = get_poolstat(sv, &st);
+	if (ret)
+		goto close_cl;
+
+	if (!smokey_assert(st.nr_classes == 2))
+		goto fail;
+
+	cs = st.classes;
+	if (!smokey_assert(cs[0].size == 64 && cs[0].count == 2 &&
+			   cs[0].free == 2 && cs[0].lowat == 0 &&
+			   cs[0].allocs == 2 && cs[0].fallbacks == 1 &&
+			   cs[0].misses == 1))
+		goto fail;
+
+	if (!smokey_assert(cs[1].size == 256 && cs[1].count == 1 &&
+			   cs[1].free == 1 && cs[1].lowat == 0 &&
+			   cs[1].allocs == 2 && cs[1].fallbacks == 0 &&
+			   cs[1].misses == 0))
+		goto fail;
+
+	ret = 0;
+close_cl:
+	close(cl);
+close_sv:
+	close(sv);
+
+	return ret;
+fail:
+	ret = -EINVAL;
+	goto close_cl;
+}
+
+static int cmp_ns(const void *a, const void *b)
+{
+	long long l = *(const long long *)a, r = *(const long long *)b;
+
+	return l < r ? -1 : l > r;
+}
+
+static long long percentile(const long long *samples, int nr, double pct)
+{
+	int n = (int)(pct * nr / 100.0);
+
+	return samples[n < nr ? n : nr - 1];
+}
+
+/*
+ * Send datagrams of pseudo-random sizes, keeping up to BENCH_WINDOW
+ * of them pending on the receiving side so that the pool works with
+ * a mixed population of buffers.
+ */
+static int bench_pool(const char *name, const void *poolcf, socklen_t len,
+		      long long *samples, int loops)
+{
+	struct timespec t0, t1;
+	unsigned int seed = 1;
+	int sv, cl, ret, n;
+	size_t msgsz;
+	char *buf;
+
+	buf = malloc(BENCH_MAXSZ);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	memset(buf, 0x5a, BENCH_MAXSZ);
+
+	sv = iddp_socket(poolcf, len);
+	if (sv < 0) {
+		ret = sv;
+		goto out;
+	}
+
+	cl = iddp_client();
+	if (cl < 0) {
+		ret = cl;
+		goto close_sv;
+	}
+
+	for (n = 0; n < loops; n++) {
+		if (n >= BENCH_WINDOW) {
+			ret = smokey_check_errno(recv(sv, buf, BENCH_MAXSZ,
+						      MSG_DONTWAIT));
+			if (ret < 0)
+				goto close_cl;
+		}
+		seed = seed * 1103515245 + 12345;
+		msgsz = BENCH_MINSZ + (seed >> 8) % (BENCH_MAXSZ - BENCH_MINSZ + 1);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		ret = send(cl, buf, msgsz, MSG_DONTWAIT);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		if (ret < 0) {
+			ret = smokey_check_errno(ret);
+			goto close_cl;
+		}
+		samples[n] = diff_ns(&t0, &t1);
+	}
+
+	qsort(samples, loops, sizeof(*samples), cmp_ns);
+
+	smokey_trace("%8s  %10lld  %10lld  %10lld  %10lld", name,
+		     percentile(samples, loops, 50.0),
+		     percentile(samples, loops, 99.0),
+		     percentile(samples, loops, 99.99),
+		     samples[loops - 1]);
+	ret = 0;
+close_cl:
+	close(cl);
+close_sv:
+	close(sv);
+out:
+	free(buf);
+
+	return ret;
+}
+
+static int run_iddp_pool(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct rtipc_pool_setup cf;
+	struct rtipc_pool_stat st;
+	long long *samples;
+	int ret, loops = 100000;
+	size_t poolsz = 0;
+	unsigned int n;
+	int s;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(iddp_pool, loops))
+		loops = SMOKEY_ARG_INT(iddp_pool, loops);
+
+	if (loops <= 0)
+		return -EINVAL;
+
+	ret = check_setup();
+	if (ret)
+		return ret;
+
+	ret = check_classes();
+	if (ret)
+		return ret;
+
+	/* No size class on a heap-based pool. */
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (s < 0)
+		return s;
+	ret = get_poolstat(s, &st);
+	close(s);
+	if (ret)
+		return ret;
+	if (!smokey_assert(st.nr_classes == 0))
+		return -EINVAL;
+
+	memset(&cf, 0, sizeof(cf));
+	cf.nr_classes = BENCH_NRCLASSES;
+	for (n = 0; n < BENCH_NRCLASSES; n++) {
+		cf.classes[n] = bench_classes[n];
+		poolsz += (bench_classes[n].size + 64) * bench_classes[n].count;
+	}
+
+	samples = malloc(loops * sizeof(*samples));
+	if (samples == NULL)
+		return -ENOMEM;
+
+	smokey_trace("%8s  %10s  %10s  %10s  %10s",
+		     "POOL", "P50-NS", "P99-NS", "P99.99-NS", "MAX-NS");
+
+	/* Both pools get the same amount of memory. */
+	ret = bench_pool("heap", &poolsz, sizeof(poolsz), samples, loops);
+	if (ret == 0)
+		ret = bench_pool("classes", &cf, sizeof(cf), samples, loops);
+
+	free(samples);
+
+	return ret;
+}
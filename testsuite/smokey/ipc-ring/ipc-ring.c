@@ -0,0 +1,800 @@
+/*
+ * RTIPC shared ring mode test and benchmark.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(ipc_ring,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+		   ),
+		   "Check RTIPC shared ring mode on IDDP and BUFP sockets,\n"
+		   "\tcompare with copy mode.\n"
+		   "\tloops=<N>	measurement loops (default: 10000)"
+);
+
+#define IDDP_SVPORT	14
+#define IDDP_BENCHPORT	15
+#define BUFP_SVPORT	14
+#define BUFP_BENCHPORT	15
+#define RING_SLOTS	64
+#define RING_SLOTSZ	256
+#define BENCH_BATCH	32
+#define BENCH_MSGSZ	64
+
+struct ring_map {
+	struct rtipc_ring_header *hdr;
+	size_t len;
+};
+
+static long long diff_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1000000000LL +
+		t1->tv_nsec - t0->tv_nsec;
+}
+
+static inline struct rtipc_ring_slot *
+ring_slot(struct rtipc_ring_header *hdr, uint32_t idx)
+{
+	return (void *)hdr + hdr->slot_offset +
+		(idx & (hdr->nr_slots - 1)) * hdr->slot_stride;
+}
+
+static int map_ring(int fd, struct ring_map *map)
+{
+	size_t pagesz = getpagesize();
+	void *p;
+
+	/* Peek at the header for the geometry, then map it all. */
+	p = mmap(NULL, pagesz, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return -errno;
+
+	map->len = ((struct rtipc_ring_header *)p)->map_size;
+	munmap(p, pagesz);
+
+	p = mmap(NULL, map->len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return -errno;
+
+	map->hdr = p;
+
+	return 0;
+}
+
+static void unmap_ring(struct ring_map *map)
+{
+	munmap(map->hdr, map->len);
+}
+
+/* Single producer, fill the next slot through the mapping. */
+static int ring_put(struct rtipc_ring_header *hdr, const void *buf, size_t len)
+{
+	struct rtipc_ring_slot *slot;
+	uint32_t head = hdr->head;
+
+	if (head - __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE) >= hdr->nr_slots)
+		return -EAGAIN;
+
+	slot = ring_slot(hdr, head);
+	memcpy(slot->data, buf, len);
+	slot->len = len;
+	slot->from = -1;
+	__atomic_store_n(&hdr->head, head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* Single consumer, pull the next slot through the mapping. */
+static ssize_t ring_get(struct rtipc_ring_header *hdr, void *buf, size_t len)
+{
+	struct rtipc_ring_slot *slot;
+	uint32_t tail = hdr->tail;
+
+	if (__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) == tail)
+		return -EAGAIN;
+
+	slot = ring_slot(hdr, tail);
+	if (slot->len < len)
+		len = slot->len;
+	memcpy(buf, slot->data, len);
+	__atomic_store_n(&hdr->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return len;
+}
+
+static int iddp_socket(int port, const struct rtipc_ring_setup *ringcf,
+		       size_t poolsz)
+{
+	struct sockaddr_ipc saddr;
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (s < 0)
+		return s;
+
+	if (ringcf) {
+		ret = smokey_check_errno(setsockopt(s, SOL_IDDP, IDDP_RING,
+						    ringcf, sizeof(*ringcf)));
+		if (ret)
+			goto fail;
+	}
+
+	if (poolsz) {
+		ret = smokey_check_errno(setsockopt(s, SOL_IDDP, IDDP_POOLSZ,
+						    &poolsz, sizeof(poolsz)));
+		if (ret)
+			goto fail;
+	}
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = smokey_check_errno(bind(s, (struct sockaddr *)&saddr,
+				      sizeof(saddr)));
+	if (ret)
+		goto fail;
+
+	return s;
+fail:
+	close(s);
+
+	return ret;
+}
+
+static int iddp_client(int port)
+{
+	struct sockaddr_ipc saddr;
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (s < 0)
+		return s;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = smokey_check_errno(connect(s, (struct sockaddr *)&saddr,
+					 sizeof(saddr)));
+	if (ret) {
+		close(s);
+		return ret;
+	}
+
+	return s;
+}
+
+static int bufp_socket(int port, const struct rtipc_ring_setup *ringcf,
+		       size_t bufsz)
+{
+	struct sockaddr_ipc saddr;
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP));
+	if (s < 0)
+		return s;
+
+	if (ringcf) {
+		ret = smokey_check_errno(setsockopt(s, SOL_BUFP, BUFP_RING,
+						    ringcf, sizeof(*ringcf)));
+		if (ret)
+			goto fail;
+	}
+
+	if (bufsz) {
+		ret = smokey_check_errno(setsockopt(s, SOL_BUFP, BUFP_BUFSZ,
+						    &bufsz, sizeof(bufsz)));
+		if (ret)
+			goto fail;
+	}
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = smokey_check_errno(bind(s, (struct sockaddr *)&saddr,
+				      sizeof(saddr)));
+	if (ret)
+		goto fail;
+
+	return s;
+fail:
+	close(s);
+
+	return ret;
+}
+
+static int bufp_client(int port)
+{
+	struct sockaddr_ipc saddr;
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP));
+	if (s < 0)
+		return s;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = smokey_check_errno(connect(s, (struct sockaddr *)&saddr,
+					 sizeof(saddr)));
+	if (ret) {
+		close(s);
+		return ret;
+	}
+
+	return s;
+}
+
+static int check_iddp_ring(void)
+{
+	struct rtipc_ring_setup ringcf;
+	struct ring_map svmap, clmap;
+	int sv, cl, ret, n;
+	long data;
+
+	sv = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (sv < 0)
+		return sv;
+
+	ringcf.nr_slots = 3;
+	ringcf.slot_size = RING_SLOTSZ;
+	ret = setsockopt(sv, SOL_IDDP, IDDP_RING, &ringcf, sizeof(ringcf));
+	close(sv);
+	if (!smokey_assert(ret && errno == EINVAL))
+		return -EINVAL;
+
+	ringcf.nr_slots = RING_SLOTS;
+	sv = iddp_socket(IDDP_SVPORT, &ringcf, 0);
+	if (sv < 0)
+		return sv;
+
+	ret = setsockopt(sv, SOL_IDDP, IDDP_RING, &ringcf, sizeof(ringcf));
+	if (!smokey_assert(ret && errno == EALREADY)) {
+		ret = -EINVAL;
+		goto close_sv;
+	}
+
+	cl = iddp_client(IDDP_SVPORT);
+	if (cl < 0) {
+		ret = cl;
+		goto close_sv;
+	}
+
+	/* Copy mode into the ring, until it is full. */
+	for (n = 0; n < RING_SLOTS; n++) {
+		data = n;
+		ret = smokey_check_errno(send(cl, &data, sizeof(data),
+					      MSG_DONTWAIT));
+		if (ret < 0)
+			goto close_cl;
+	}
+
+	ret = send(cl, &data, sizeof(data), MSG_DONTWAIT);
+	if (!smokey_assert(ret < 0 && errno == EAGAIN)) {
+		ret = -EINVAL;
+		goto close_cl;
+	}
+
+	for (n = 0; n < RING_SLOTS; n++) {
+		ret = smokey_check_errno(recv(sv, &data, sizeof(data),
+					      MSG_DONTWAIT));
+		if (ret < 0)
+			goto close_cl;
+		if (!smokey_assert(ret == sizeof(data) && data == n)) {
+			ret = -EINVAL;
+			goto close_cl;
+		}
+	}
+
+	ret = recv(sv, &data, sizeof(data), MSG_DONTWAIT);
+	if (!smokey_assert(ret < 0 && errno == EAGAIN)) {
+		ret = -EINVAL;
+		goto close_cl;
+	}
+
+	/* Zero-copy: the client fills the server ring directly. */
+	ret = map_ring(sv, &svmap);
+	if (ret) {
+		smokey_warning("mmap(server): %s", strerror(-ret));
+		goto close_cl;
+	}
+
+	ret = map_ring(cl, &clmap);
+	if (ret) {
+		smokey_warning("mmap(client): %s", strerror(-ret));
+		goto unmap_sv;
+	}
+
+	if (!smokey_assert(svmap.hdr->nr_slots == RING_SLOTS &&
+			   svmap.hdr->slot_size == RING_SLOTSZ &&
+			   clmap.len == svmap.len)) {
+		ret = -EINVAL;
+		goto unmap_cl;
+	}
+
+	data = 0xa5a5;
+	ret = smokey_check_status(-ring_put(clmap.hdr, &data, sizeof(data)));
+	if (ret)
+		goto unmap_cl;
+
+	/* Ring the doorbell, then receive through the socket. */
+	ret = smokey_check_errno(send(cl, NULL, 0, 0));
+	if (ret)
+		goto unmap_cl;
+
+	data = 0;
+	ret = smokey_check_errno(recv(sv, &data, sizeof(data), 0));
+	if (ret < 0)
+		goto unmap_cl;
+	if (!smokey_assert(ret == sizeof(data) && data == 0xa5a5)) {
+		ret = -EINVAL;
+		goto unmap_cl;
+	}
+
+	/* Send through the socket, receive through the mapping. */
+	data = 0x5a5a;
+	ret = smokey_check_errno(send(cl, &data, sizeof(data), 0));
+	if (ret < 0)
+		goto unmap_cl;
+
+	data = 0;
+	ret = ring_get(svmap.hdr, &data, sizeof(data));
+	if (!smokey_assert(ret == sizeof(data) && data == 0x5a5a))
+		ret = -EINVAL;
+	else
+		ret = 0;
+unmap_cl:
+	unmap_ring(&clmap);
+unmap_sv:
+	unmap_ring(&svmap);
+close_cl:
+	close(cl);
+close_sv:
+	close(sv);
+
+	return ret;
+}
+
+static int check_xddp_ring(void)
+{
+	struct rtipc_ring_setup ringcf;
+	struct sockaddr_ipc saddr;
+	struct ring_map map;
+	int s, fd, ret, n;
+	socklen_t addrlen;
+	char *devname;
+	uint32_t bell;
+	long data;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_XDDP));
+	if (s < 0)
+		return s;
+
+	ringcf.nr_slots = 16;
+	ringcf.slot_size = 64;
+	ret = smokey_check_errno(setsockopt(s, SOL_XDDP, XDDP_RING,
+					    &ringcf, sizeof(ringcf)));
+	if (ret)
+		goto close_s;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = -1;
+	ret = smokey_check_errno(bind(s, (struct sockaddr *)&saddr,
+				      sizeof(saddr)));
+	if (ret)
+		goto close_s;
+
+	addrlen = sizeof(saddr);
+	ret = smokey_check_errno(getsockname(s, (struct sockaddr *)&saddr,
+					     &addrlen));
+	if (ret)
+		goto close_s;
+
+	for (n = 1; n <= 3; n++) {
+		data = n;
+		ret = smokey_check_errno(send(s, &data, sizeof(data), 0));
+		if (ret < 0)
+			goto close_s;
+	}
+
+	if (asprintf(&devname, "/dev/rtp%d", saddr.sipc_port) < 0) {
+		ret = -ENOMEM;
+		goto close_s;
+	}
+
+	fd = smokey_check_errno(open(devname, O_RDWR | O_NONBLOCK));
+	free(devname);
+	if (fd < 0) {
+		ret = fd;
+		goto close_s;
+	}
+
+	/* A single doorbell for the empty -> non-empty transition. */
+	ret = smokey_check_errno(read(fd, &bell, sizeof(bell)));
+	if (ret < 0)
+		goto close_fd;
+	if (!smokey_assert(ret == sizeof(bell) && bell == 1)) {
+		ret = -EINVAL;
+		goto close_fd;
+	}
+
+	ret = read(fd, &bell, sizeof(bell));
+	if (!smokey_assert(ret < 0 && errno == EAGAIN)) {
+		ret = -EINVAL;
+		goto close_fd;
+	}
+
+	ret = map_ring(fd, &map);
+	if (ret) {
+		smokey_warning("mmap(/dev/rtp): %s", strerror(-ret));
+		goto close_fd;
+	}
+
+	for (n = 1; n <= 3; n++) {
+		ret = ring_get(map.hdr, &data, sizeof(data));
+		if (!smokey_assert(ret == sizeof(data) && data == n)) {
+			ret = -EINVAL;
+			goto unmap;
+		}
+	}
+
+	ret = 0;
+unmap:
+	unmap_ring(&map);
+close_fd:
+	close(fd);
+close_s:
+	close(s);
+
+	return ret;
+}
+
+static int check_bufp_ring(void)
+{
+	unsigned char in[100], out[100];
+	struct rtipc_ring_setup ringcf;
+	struct ring_map svmap, clmap;
+	int sv, cl, ret, n;
+	long data;
+
+	for (n = 0; n < (int)sizeof(in); n++)
+		in[n] = n;
+
+	/* 4 slots of 16 bytes, i.e. 64 bytes of stream. */
+	ringcf.nr_slots = 4;
+	ringcf.slot_size = 16;
+	sv = bufp_socket(BUFP_SVPORT, &ringcf, 0);
+	if (sv < 0)
+		return sv;
+
+	cl = bufp_client(BUFP_SVPORT);
+	if (cl < 0) {
+		ret = cl;
+		goto close_sv;
+	}
+
+	/* Writes are split into chunks, a full ring yields a short count. */
+	ret = smokey_check_errno(send(cl, in, 40, MSG_DONTWAIT));
+	if (ret < 0)
+		goto close_cl;
+	if (!smokey_assert(ret == 40))
+		goto fail;
+
+	ret = smokey_check_errno(send(cl, in + 40, 40, MSG_DONTWAIT));
+	if (ret < 0)
+		goto close_cl;
+	if (!smokey_assert(ret == 16))
+		goto fail;
+
+	ret = send(cl, in, 1, MSG_DONTWAIT);
+	if (!smokey_assert(ret < 0 && errno == EWOULDBLOCK))
+		goto fail;
+
+	/* Reads may span chunks, or stop in the middle of one. */
+	ret = smokey_check_errno(recv(sv, out, 10, MSG_DONTWAIT));
+	if (ret < 0)
+		goto close_cl;
+	if (!smokey_assert(ret == 10))
+		goto fail;
+
+	ret = smokey_check_errno(recv(sv, out + 10, sizeof(out) - 10,
+				      MSG_DONTWAIT));
+	if (ret < 0)
+		goto close_cl;
+	if (!smokey_assert(ret == 46 && memcmp(in, out, 56) == 0))
+		goto fail;
+
+	ret = recv(sv, out, sizeof(out), MSG_DONTWAIT);
+	if (!smokey_assert(ret < 0 && errno == EWOULDBLOCK))
+		goto fail;
+
+	/* Zero-copy in both directions. */
+	ret = map_ring(sv, &svmap);
+	if (ret) {
+		smokey_warning("mmap(server): %s", strerror(-ret));
+		goto close_cl;
+	}
+
+	ret = map_ring(cl, &clmap);
+	if (ret) {
+		smokey_warning("mmap(client): %s", strerror(-ret));
+		goto unmap_sv;
+	}
+
+	data = 0xa5a5;
+	ret = smokey_check_status(-ring_put(clmap.hdr, &data, sizeof(data)));
+	if (ret)
+		goto unmap_cl;
+
+	ret = smokey_check_errno(send(cl, NULL, 0, 0));
+	if (ret)
+		goto unmap_cl;
+
+	data = 0;
+	ret = smokey_check_errno(recv(sv, &data, sizeof(data), 0));
+	if (ret < 0)
+		goto unmap_cl;
+	if (!smokey_assert(ret == sizeof(data) && data == 0xa5a5)) {
+		ret = -EINVAL;
+		goto unmap_cl;
+	}
+
+	data = 0x5a5a;
+	ret = smokey_check_errno(send(cl, &data, sizeof(data), 0));
+	if (ret < 0)
+		goto unmap_cl;
+
+	data = 0;
+	ret = ring_get(svmap.hdr, &data, sizeof(data));
+	if (!smokey_assert(ret == sizeof(data) && data == 0x5a5a))
+		ret = -EINVAL;
+	else
+		ret = 0;
+unmap_cl:
+	unmap_ring(&clmap);
+unmap_sv:
+	unmap_ring(&svmap);
+close_cl:
+	close(cl);
+close_sv:
+	close(sv);
+
+	return ret;
+fail:
+	ret = -EINVAL;
+	goto close_cl;
+}
+
+static int bench_syscall(int sv, int cl, int loops, long long *ns)
+{
+	char msg[BENCH_MSGSZ];
+	struct timespec t0, t1;
+	int l, n, ret;
+
+	memset(msg, 0xa5, sizeof(msg));
+	*ns = 0;
+
+	for (l = 0; l < loops; l++) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (n = 0; n < BENCH_BATCH; n++) {
+			ret = send(cl, msg, sizeof(msg), MSG_DONTWAIT);
+			if (ret < 0)
+				return smokey_check_errno(ret);
+		}
+		for (n = 0; n < BENCH_BATCH; n++) {
+			ret = recv(sv, msg, sizeof(msg), MSG_DONTWAIT);
+			if (ret < 0)
+				return smokey_check_errno(ret);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		*ns += diff_ns(&t0, &t1);
+	}
+
+	return 0;
+}
+
+static int bench_mapped(int sv, int cl, int loops, long long *ns)
+{
+	struct ring_map svmap, clmap;
+	char msg[BENCH_MSGSZ];
+	struct timespec t0, t1;
+	int l, n, ret;
+
+	ret = map_ring(sv, &svmap);
+	if (ret)
+		return ret;
+
+	ret = map_ring(cl, &clmap);
+	if (ret) {
+		unmap_ring(&svmap);
+		return ret;
+	}
+
+	memset(msg, 0xa5, sizeof(msg));
+	*ns = 0;
+
+	/*
+	 * One doorbell per batch in each direction, as a producer
+	 * and consumer running on separate CPUs would issue at most.
+	 */
+	for (l = 0; l < loops; l++) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (n = 0; n < BENCH_BATCH; n++)
+			ring_put(clmap.hdr, msg, sizeof(msg));
+		send(cl, NULL, 0, 0);
+		for (n = 0; n < BENCH_BATCH; n++)
+			ring_get(svmap.hdr, msg, sizeof(msg));
+		recv(sv, NULL, 0, MSG_DONTWAIT);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		*ns += diff_ns(&t0, &t1);
+	}
+
+	unmap_ring(&clmap);
+	unmap_ring(&svmap);
+
+	return 0;
+}
+
+static void report(const char *proto, long long copy_ns, long long ring_ns,
+		   long long mapped_ns, long long nmsgs)
+{
+	smokey_trace("%6s  %8s  %10s  %12s", "PROTO", "MODE", "NS/MSG", "KMSG/S");
+	smokey_trace("%6s  %8s  %10lld  %12lld", proto, "copy",
+		     copy_ns / nmsgs, nmsgs * 1000000LL / (copy_ns ?: 1));
+	smokey_trace("%6s  %8s  %10lld  %12lld", proto, "ring",
+		     ring_ns / nmsgs, nmsgs * 1000000LL / (ring_ns ?: 1));
+	smokey_trace("%6s  %8s  %10lld  %12lld", proto, "mapped",
+		     mapped_ns / nmsgs, nmsgs * 1000000LL / (mapped_ns ?: 1));
+}
+
+static int bench_iddp(int loops)
+{
+	long long copy_ns, ring_ns, mapped_ns, nmsgs;
+	struct rtipc_ring_setup ringcf;
+	int sv, cl, ret;
+
+	nmsgs = (long long)loops * BENCH_BATCH;
+
+	sv = iddp_socket(IDDP_BENCHPORT, NULL, 65536);
+	if (sv < 0)
+		return sv;
+
+	cl = iddp_client(IDDP_BENCHPORT);
+	if (cl < 0) {
+		close(sv);
+		return cl;
+	}
+
+	ret = bench_syscall(sv, cl, loops, &copy_ns);
+	close(cl);
+	close(sv);
+	if (ret)
+		return ret;
+
+	ringcf.nr_slots = RING_SLOTS;
+	ringcf.slot_size = RING_SLOTSZ;
+	sv = iddp_socket(IDDP_BENCHPORT, &ringcf, 0);
+	if (sv < 0)
+		return sv;
+
+	cl = iddp_client(IDDP_BENCHPORT);
+	if (cl < 0) {
+		close(sv);
+		return cl;
+	}
+
+	ret = bench_syscall(sv, cl, loops, &ring_ns);
+	if (ret == 0)
+		ret = bench_mapped(sv, cl, loops, &mapped_ns);
+	close(cl);
+	close(sv);
+	if (ret)
+		return ret;
+
+	report("iddp", copy_ns, ring_ns, mapped_ns, nmsgs);
+
+	return 0;
+}
+
+static int bench_bufp(int loops)
+{
+	long long copy_ns, ring_ns, mapped_ns, nmsgs;
+	struct rtipc_ring_setup ringcf;
+	int sv, cl, ret;
+
+	nmsgs = (long long)loops * BENCH_BATCH;
+
+	sv = bufp_socket(BUFP_BENCHPORT, NULL, 65536);
+	if (sv < 0)
+		return sv;
+
+	cl = bufp_client(BUFP_BENCHPORT);
+	if (cl < 0) {
+		close(sv);
+		return cl;
+	}
+
+	ret = bench_syscall(sv, cl, loops, &copy_ns);
+	close(cl);
+	close(sv);
+	if (ret)
+		return ret;
+
+	ringcf.nr_slots = RING_SLOTS;
+	ringcf.slot_size = RING_SLOTSZ;
+	sv = bufp_socket(BUFP_BENCHPORT, &ringcf, 0);
+	if (sv < 0)
+		return sv;
+
+	cl = bufp_client(BUFP_BENCHPORT);
+	if (cl < 0) {
+		close(sv);
+		return cl;
+	}
+
+	ret = bench_syscall(sv, cl, loops, &ring_ns);
+	if (ret == 0)
+		ret = bench_mapped(sv, cl, loops, &mapped_ns);
+	close(cl);
+	close(sv);
+	if (ret)
+		return ret;
+
+	report("bufp", copy_ns, ring_ns, mapped_ns, nmsgs);
+
+	return 0;
+}
+
+static int run_ipc_ring(struct smokey_test *t, int argc, char *const argv[])
+{
+	int s, ret, loops = 10000;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(ipc_ring, loops))
+		loops = SMOKEY_ARG_INT(ipc_ring, loops);
+
+	if (loops <= 0)
+		return -EINVAL;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (s < 0) {
+		if (errno == EAFNOSUPPORT || errno == EPROTONOSUPPORT)
+			return -ENOSYS;
+	} else
+		close(s);
+
+	ret = check_iddp_ring();
+	if (ret)
+		return ret;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_XDDP);
+	if (s >= 0) {
+		close(s);
+		ret = check_xddp_ring();
+		if (ret)
+			return ret;
+	}
+
+	ret = bench_iddp(loops);
+	if (ret)
+		return ret;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP);
+	if (s < 0)
+		return 0;
+
+	close(s);
+
+	ret = check_bufp_ring();
+	if (ret)
+		return ret;
+
+	return bench_bufp(loops);
+}
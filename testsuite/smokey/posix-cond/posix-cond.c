@@ -83,6 +83,7 @@ static int cond_init(pthread_cond_t *cond, int absolute)
 	return -ret;
 }
 #define cond_signal(cond) (-pthread_cond_signal(cond))
+#define cond_broadcast(cond) (-pthread_cond_broadcast(cond))
 
 static int cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, unsigned long long ns)
 {
@@ -723,6 +724,80 @@ static void cond_ppmutex(void)
 	check("cond_destroy", cond_destroy(&cond), 0);
 }
 
+#define NR_BCAST_WAITERS 4
+
+static struct {
+	struct cond_mutex *cm;
+	int go;
+	int nr_woken;
+	int order[NR_BCAST_WAITERS];
+} bcast;
+
+static void *cond_bcast_waiter(void *cookie)
+{
+	long prio = (long)cookie;
+	/* The lowest priority waiter uses a timed wait. */
+	unsigned long long timeout = prio == 3 ? 100 * NS_PER_MS : 0;
+
+	check("mutex_lock", mutex_lock(bcast.cm->mutex), 0);
+	while (!bcast.go)
+		check("cond_wait", cond_wait(bcast.cm->cond,
+					     bcast.cm->mutex, timeout), 0);
+	bcast.order[bcast.nr_woken++] = prio;
+	/*
+	 * Keep the mutex past the deadline of the timed waiter: once
+	 * signaled, it must wait for the mutex indefinitely.
+	 */
+	if (bcast.nr_woken == 1)
+		thread_msleep(150);
+	check("mutex_unlock", mutex_unlock(bcast.cm->mutex), 0);
+
+	return NULL;
+}
+
+static void cond_broadcast_requeue(void)
+{
+	pthread_t waiter_tids[NR_BCAST_WAITERS];
+	pthread_cond_t cond;
+	pthread_mutex_t mutex;
+	struct cond_mutex cm = {
+		.mutex = &mutex,
+		.cond = &cond,
+	};
+	int n;
+
+	smokey_trace("%s", __func__);
+
+	check("mutex_init", mutex_init(&mutex, PTHREAD_MUTEX_DEFAULT,
+				       PTHREAD_PRIO_INHERIT), 0);
+	check("cond_init", cond_init(&cond, 0), 0);
+	bcast.cm = &cm;
+	bcast.go = 0;
+	bcast.nr_woken = 0;
+
+	/* Waiters outrank us, they all block on cond when spawned. */
+	for (n = 0; n < NR_BCAST_WAITERS; n++)
+		check("thread_spawn",
+		      thread_spawn(&waiter_tids[n], 3 + n, cond_bcast_waiter,
+				   (void *)(long)(3 + n)), 0);
+
+	check("mutex_lock", mutex_lock(&mutex), 0);
+	bcast.go = 1;
+	check("cond_broadcast", cond_broadcast(&cond), 0);
+	check("mutex_unlock", mutex_unlock(&mutex), 0);
+
+	for (n = 0; n < NR_BCAST_WAITERS; n++)
+		check("thread_join", thread_join(waiter_tids[n]), 0);
+
+	check("nr_woken", bcast.nr_woken, NR_BCAST_WAITERS);
+	/* Mutex handed over by decreasing priority. */
+	for (n = 0; n < NR_BCAST_WAITERS; n++)
+		check("wakeup order", bcast.order[n], 2 + NR_BCAST_WAITERS - n);
+
+	check("mutex_destroy", mutex_destroy(&mutex), 0);
+	check("cond_destroy", cond_destroy(&cond), 0);
+}
+
 int run_posix_cond(struct smokey_test *t, int argc, char *const argv[])
 {
 	struct sched_param sparam;
@@ -744,6 +819,7 @@ int run_posix_cond(struct smokey_test *t, int argc, char *const argv[])
 	sig_restart_double();
 	cond_destroy_whilewait();
 	cond_ppmutex();
+	cond_broadcast_requeue();
 
 	return 0;
 }
@@ -0,0 +1,285 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <mqueue.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(posix_mq,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+		   ),
+		   "Check POSIX message queues in regular and mapped modes,\n"
+		   "\tcompare the cost of uncontended transfers.\n"
+		   "\tloops=<N>	measurement loops (default: 10000)"
+);
+
+#define MQ_NAME		"/posix_mq_test"
+#define MQ_MSGSZ	32
+#define MQ_MAXMSG	8
+#define MQ_NRMSG	(MQ_MAXMSG * 4)
+
+static const struct {
+	const char *name;
+	long flags;
+} modes[] = {
+	{ "regular", 0 },
+	{ "mapped", MQ_MAPPED },
+};
+
+static mqd_t open_mq(long flags, int oflags)
+{
+	struct mq_attr qa;
+
+	mq_unlink(MQ_NAME);
+	memset(&qa, 0, sizeof(qa));
+	qa.mq_flags = flags;
+	qa.mq_maxmsg = MQ_MAXMSG;
+	qa.mq_msgsize = MQ_MSGSZ;
+
+	return mq_open(MQ_NAME, oflags | O_CREAT | O_EXCL, 0600, &qa);
+}
+
+static void close_mq(mqd_t mq)
+{
+	mq_close(mq);
+	mq_unlink(MQ_NAME);
+}
+
+static int check_ordering(long flags)
+{
+	static const unsigned int prios[MQ_MAXMSG] = {
+		1, 3, 2, 3, 0, 2, 3, 1
+	};
+	unsigned int n, seq, prio, lastprio = -1U, lastseq = 0;
+	char buf[MQ_MSGSZ];
+	struct mq_attr qa;
+	int ret;
+	mqd_t mq;
+
+	mq = smokey_check_errno(open_mq(flags, O_RDWR | O_NONBLOCK));
+	if (mq < 0)
+		return mq;
+
+	memset(buf, 0, sizeof(buf));
+
+	for (n = 0; n < MQ_MAXMSG; n++) {
+		buf[0] = n;
+		ret = smokey_check_errno(mq_send(mq, buf, n + 1, prios[n]));
+		if (ret)
+			goto out;
+	}
+
+	ret = mq_send(mq, buf, 1, 0);
+	if (!smokey_assert(ret == -1 && errno == EAGAIN))
+		goto fail;
+
+	ret = mq_send(mq, buf, MQ_MSGSZ + 1, 0);
+	if (!smokey_assert(ret == -1 && errno == EMSGSIZE))
+		goto fail;
+
+	ret = smokey_check_errno(mq_getattr(mq, &qa));
+	if (ret)
+		goto out;
+
+	if (!smokey_assert(qa.mq_curmsgs == MQ_MAXMSG))
+		goto fail;
+
+	/* Highest priority first, FIFO among equal priorities. */
+	for (n = 0; n < MQ_MAXMSG; n++) {
+		ret = smokey_check_errno(mq_receive(mq, buf, sizeof(buf), &prio));
+		if (ret < 0)
+			goto out;
+		seq = buf[0];
+		if (!smokey_assert(seq < MQ_MAXMSG) ||
+		    !smokey_assert(ret == (int)seq + 1) ||
+		    !smokey_assert(prio == prios[seq]) ||
+		    !smokey_assert(prio < lastprio ||
+				   (prio == lastprio && seq > lastseq)))
+			goto fail;
+		lastprio = prio;
+		lastseq = seq;
+	}
+
+	ret = mq_receive(mq, buf, sizeof(buf), &prio);
+	if (!smokey_assert(ret == -1 && errno == EAGAIN))
+		goto fail;
+
+	ret = mq_receive(mq, buf, MQ_MSGSZ - 1, &prio);
+	if (!smokey_assert(ret == -1 && errno == EMSGSIZE))
+		goto fail;
+
+	ret = 0;
+out:
+	close_mq(mq);
+
+	return ret;
+fail:
+	ret = -EINVAL;
+	goto out;
+}
+
+static void *receiver(void *arg)
+{
+	mqd_t mq = (mqd_t)(long)arg;
+	char buf[MQ_MSGSZ];
+	unsigned int n;
+	long ret;
+
+	for (n = 0; n < MQ_NRMSG; n++) {
+		ret = smokey_check_errno(mq_receive(mq, buf, sizeof(buf), NULL));
+		if (ret < 0)
+			return (void *)ret;
+		if (!smokey_assert(ret == 1 && buf[0] == (char)n))
+			return (void *)(long)-EINVAL;
+	}
+
+	return NULL;
+}
+
+/*
+ * Run a receiver above, then below the priority of the sender, so
+ * that both sides have to wait for each other.
+ */
+static int check_blocking(long flags, int rprio)
+{
+	struct sched_param param;
+	struct timespec ts;
+	pthread_attr_t tattr;
+	char buf[MQ_MSGSZ];
+	unsigned int n;
+	pthread_t tid;
+	void *status;
+	int ret;
+	mqd_t mq;
+
+	mq = smokey_check_errno(open_mq(flags, O_RDWR));
+	if (mq < 0)
+		return mq;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ret = mq_timedreceive(mq, buf, sizeof(buf), NULL, &ts);
+	if (!smokey_assert(ret == -1 && errno == ETIMEDOUT)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	pthread_attr_init(&tattr);
+	pthread_attr_setinheritsched(&tattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&tattr, SCHED_FIFO);
+	param.sched_priority = rprio;
+	pthread_attr_setschedparam(&tattr, &param);
+	ret = smokey_check_status(pthread_create(&tid, &tattr, receiver,
+						 (void *)(long)mq));
+	pthread_attr_destroy(&tattr);
+	if (ret)
+		goto out;
+
+	memset(buf, 0, sizeof(buf));
+
+	for (n = 0; n < MQ_NRMSG; n++) {
+		buf[0] = n;
+		ret = smokey_check_errno(mq_send(mq, buf, 1, 0));
+		if (ret) {
+			pthread_cancel(tid);
+			break;
+		}
+	}
+
+	pthread_join(tid, &status);
+	if (ret == 0)
+		ret = (int)(long)status;
+out:
+	close_mq(mq);
+
+	return ret;
+}
+
+static long long diff_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1000000000LL +
+		t1->tv_nsec - t0->tv_nsec;
+}
+
+static int bench_mq(const char *name, long flags, int loops)
+{
+	struct timespec t0, t1;
+	char buf[MQ_MSGSZ];
+	unsigned int prio;
+	int ret = 0, n;
+	mqd_t mq;
+
+	mq = smokey_check_errno(open_mq(flags, O_RDWR | O_NONBLOCK));
+	if (mq < 0)
+		return mq;
+
+	memset(buf, 0x5a, sizeof(buf));
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (n = 0; n < loops; n++) {
+		if (mq_send(mq, buf, sizeof(buf), 0) ||
+		    mq_receive(mq, buf, sizeof(buf), &prio) < 0) {
+			ret = smokey_check_errno(-1);
+			break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if (ret == 0)
+		smokey_trace("%8s  %10lld", name, diff_ns(&t0, &t1) / loops);
+
+	close_mq(mq);
+
+	return ret;
+}
+
+static int run_posix_mq(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct sched_param param;
+	int ret, loops = 10000;
+	unsigned int n;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(posix_mq, loops))
+		loops = SMOKEY_ARG_INT(posix_mq, loops);
+
+	if (loops <= 0)
+		return -EINVAL;
+
+	/* The user-space fast path is not available to weak threads. */
+	param.sched_priority = 10;
+	ret = smokey_check_status(pthread_setschedparam(pthread_self(),
+							SCHED_FIFO, &param));
+	if (ret)
+		return ret;
+
+	for (n = 0; n < sizeof(modes) / sizeof(modes[0]); n++) {
+		smokey_trace("checking %s queue", modes[n].name);
+		ret = check_ordering(modes[n].flags);
+		if (ret)
+			return ret;
+		ret = check_blocking(modes[n].flags, 11);
+		if (ret)
+			return ret;
+		ret = check_blocking(modes[n].flags, 9);
+		if (ret)
+			return ret;
+	}
+
+	smokey_trace("%8s  %10s", "MODE", "SEND+RECV-NS");
+
+	for (n = 0; n < sizeof(modes) / sizeof(modes[0]); n++) {
+		ret = bench_mq(modes[n].name, modes[n].flags, loops);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
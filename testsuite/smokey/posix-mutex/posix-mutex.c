@@ -17,6 +17,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <pthread.h>
+#include <sched.h>
 #include <cobalt/sys/cobalt.h>
 #include <smokey/smokey.h>
 
@@ -58,6 +59,7 @@ static void sigdebug(int sig, siginfo_t *si, void *context)
 #define THREAD_PRIO_VERY_HIGH	4
 
 #define MAX_100_MS  100000000ULL
+#define MAX_1_S     1000000000ULL
 
 struct locker_context {
 	pthread_mutex_t *mutex;
@@ -344,6 +346,18 @@ static int dynamic_init_errorcheck_contend(void)
 	return __dynamic_init_contend(PTHREAD_MUTEX_ERRORCHECK);
 }
 
+static int static_init_adaptive_contend(void)
+{
+	pthread_mutex_t mutex = PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP;
+
+	return do_contend(&mutex, PTHREAD_MUTEX_ADAPTIVE_NP);
+}
+
+static int dynamic_init_adaptive_contend(void)
+{
+	return __dynamic_init_contend(PTHREAD_MUTEX_ADAPTIVE_NP);
+}
+
 static int timed_contend(void)
 {
 	pthread_mutex_t mutex;
@@ -426,7 +440,7 @@ static int weak_mode_switch(void)
 	return 0;
 }
 
-static int do_pi_contend(int prio)
+static int do_pi_contend(int type, int prio)
 {
 	struct smokey_barrier barrier;
 	struct locker_context args;
@@ -435,8 +449,7 @@ static int do_pi_contend(int prio)
 	void *status;
 	int ret;
 
-	ret = do_init_mutex(&mutex, PTHREAD_MUTEX_NORMAL,
-			    PTHREAD_PRIO_INHERIT);
+	ret = do_init_mutex(&mutex, type, PTHREAD_PRIO_INHERIT);
 	if (ret)
 		return ret;
 
@@ -480,7 +493,12 @@ static int do_pi_contend(int prio)
 
 static int pi_contend(void)
 {
-	return do_pi_contend(THREAD_PRIO_HIGH);
+	return do_pi_contend(PTHREAD_MUTEX_NORMAL, THREAD_PRIO_HIGH);
+}
+
+static int adaptive_pi_contend(void)
+{
+	return do_pi_contend(PTHREAD_MUTEX_ADAPTIVE_NP, THREAD_PRIO_HIGH);
 }
 
 static void *mutex_locker_steal(void *arg)
@@ -788,7 +806,7 @@ static int protect_nesting_pi(void)
 		return -EINVAL;
 	
 	/* PI boost expected: HIGH -> VERY_HIGH, then back to HIGH */
-	ret = do_pi_contend(THREAD_PRIO_VERY_HIGH);
+	ret = do_pi_contend(PTHREAD_MUTEX_NORMAL, THREAD_PRIO_VERY_HIGH);
 	if (ret)
 		return ret;
 
@@ -950,6 +968,133 @@ static int protect_handover(void)
 	return 0;
 }
 
+#define BENCH_LOOPS	10000
+#define BENCH_HOLD	100
+
+struct bench_context {
+	pthread_mutex_t *mutex;
+	unsigned long *counter;
+};
+
+static void *mutex_bench_locker(void *arg)
+{
+	struct bench_context *p = arg;
+	volatile int spin;
+	int n, ret;
+
+	for (n = 0; n < BENCH_LOOPS; n++) {
+		if (!__T(ret, pthread_mutex_lock(p->mutex)))
+			return (void *)(long)ret;
+		/* Short critical section. */
+		++*p->counter;
+		for (spin = 0; spin < BENCH_HOLD; spin++)
+			;
+		if (!__T(ret, pthread_mutex_unlock(p->mutex)))
+			return (void *)(long)ret;
+	}
+
+	return NULL;
+}
+
+static int create_pinned_thread(pthread_t *tid, int prio, int cpu,
+				void *(*thread)(void *), void *arg)
+{
+	struct sched_param param;
+	pthread_attr_t thattr;
+	cpu_set_t cpus;
+	int ret;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	pthread_attr_init(&thattr);
+	param.sched_priority = prio;
+	pthread_attr_setschedpolicy(&thattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&thattr, &param);
+	pthread_attr_setinheritsched(&thattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setaffinity_np(&thattr, sizeof(cpus), &cpus);
+
+	if (!__T(ret, pthread_create(tid, &thattr, thread, arg)))
+		return ret;
+
+	return 0;
+}
+
+/*
+ * Hammer a PI mutex from two threads pinned on distinct CPUs, return
+ * the average cost of a lock/unlock cycle.
+ */
+static int do_bench_contend(int type, long long *ns_per_lock)
+{
+	struct timespec start, stop, delta;
+	struct bench_context args;
+	unsigned long counter = 0;
+	void *status[2];
+	pthread_mutex_t mutex;
+	pthread_t tid[2];
+	int ret, n;
+
+	ret = do_init_mutex(&mutex, type, PTHREAD_PRIO_INHERIT);
+	if (ret)
+		return ret;
+
+	args.mutex = &mutex;
+	args.counter = &counter;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (n = 0; n < 2; n++) {
+		ret = create_pinned_thread(&tid[n], THREAD_PRIO_MEDIUM, n,
+					   mutex_bench_locker, &args);
+		if (ret)
+			return ret;
+	}
+
+	for (n = 0; n < 2; n++) {
+		if (!__T(ret, pthread_join(tid[n], &status[n])))
+			return ret;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	if (!__Tassert(status[0] == NULL) || !__Tassert(status[1] == NULL))
+		return -EINVAL;
+
+	if (!__Tassert(counter == 2 * BENCH_LOOPS))
+		return -EINVAL;
+
+	if (!__T(ret, pthread_mutex_destroy(&mutex)))
+		return ret;
+
+	timespec_sub(&delta, &stop, &start);
+	*ns_per_lock = timespec_scalar(&delta) / (2 * BENCH_LOOPS);
+
+	return 0;
+}
+
+static int adaptive_bench(void)
+{
+	long long normal_ns, adaptive_ns;
+	int ret;
+
+	if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+		smokey_trace("   (single CPU, skipped)");
+		return 0;
+	}
+
+	ret = do_bench_contend(PTHREAD_MUTEX_NORMAL, &normal_ns);
+	if (ret)
+		return ret;
+
+	ret = do_bench_contend(PTHREAD_MUTEX_ADAPTIVE_NP, &adaptive_ns);
+	if (ret)
+		return ret;
+
+	smokey_trace("   contended lock/unlock: normal %lld ns, adaptive %lld ns",
+		     normal_ns, adaptive_ns);
+
+	return 0;
+}
+
 /* Detect obviously wrong execution times. */
 static int check_time_limit(const struct timespec *start,
 			    xnticks_t limit_ns)
@@ -997,9 +1142,12 @@ static int run_posix_mutex(struct smokey_test *t, int argc, char *const argv[])
 	do_test(dynamic_init_recursive_contend, MAX_100_MS);
 	do_test(static_init_errorcheck_contend, MAX_100_MS);
 	do_test(dynamic_init_errorcheck_contend, MAX_100_MS);
+	do_test(static_init_adaptive_contend, MAX_100_MS);
+	do_test(dynamic_init_adaptive_contend, MAX_100_MS);
 	do_test(timed_contend, MAX_100_MS);
 	do_test(weak_mode_switch, MAX_100_MS);
 	do_test(pi_contend, MAX_100_MS);
+	do_test(adaptive_pi_contend, MAX_100_MS);
 	do_test(steal, MAX_100_MS);
 	do_test(no_steal, MAX_100_MS);
 	do_test(protect_raise, MAX_100_MS);
@@ -1010,6 +1158,7 @@ static int run_posix_mutex(struct smokey_test *t, int argc, char *const argv[])
 	do_test(protect_dynamic, MAX_100_MS);
 	do_test(protect_trylock, MAX_100_MS);
 	do_test(protect_handover, MAX_100_MS);
+	do_test(adaptive_bench, MAX_1_S);
 
 	return 0;
 }
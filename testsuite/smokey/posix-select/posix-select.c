@@ -37,7 +37,7 @@
 
 smokey_test_plugin(posix_select,
 		   SMOKEY_NOARGS,
-		   "Check POSIX select service"
+		   "Check POSIX select service and poll sets"
 );
 
 static const char *tunes[] = {
@@ -102,13 +102,101 @@ static void *mq_thread(void *cookie)
 	return NULL;
 }
 
-static int run_posix_select(struct smokey_test *t, int argc, char *const argv[])
+static int pollset_fd;
+
+static void *pollset_thread(void *cookie)
+{
+	mqd_t mqd = (mqd_t)(long)cookie;
+	struct cobalt_pollset_event ev[4];
+	unsigned int i = 0, prio;
+	char buf[128];
+	int ret;
+
+	for (;;) {
+		ret = smokey_check_errno(pollset_wait_np(pollset_fd, ev, 4, NULL));
+		if (ret < 0) {
+			test_status = ret;
+			break;
+		}
+
+		if (!smokey_assert(ret == 1 && ev[0].fd == mqd &&
+				   ev[0].events == POLLSET_IN)) {
+			test_status = -EINVAL;
+			break;
+		}
+
+		ret = smokey_check_errno(mq_receive(mqd, buf, sizeof(buf), &prio));
+		if (ret < 0) {
+			test_status = ret;
+			break;
+		}
+
+		if (strcmp(buf, "/done") == 0)
+			break;
+	
+		if (!smokey_assert(strcmp(buf, tunes[i]) == 0)) {
+			test_status = -EINVAL;
+			break;
+		}
+
+		smokey_trace("received %s through poll set", buf);
+		i = (i + 1) % (sizeof(tunes) / sizeof(tunes[0]));
+	}
+
+	return NULL;
+}
+
+static int check_pollset_ctl(mqd_t mq)
+{
+	struct cobalt_pollset_event ev;
+	struct timespec ts = { 0, 0 };
+	int ret;
+
+	ret = pollset_ctl_np(pollset_fd, POLLSET_CTL_ADD, mq, POLLSET_IN);
+	if (!smokey_assert(ret == -1 && errno == EEXIST))
+		return -EINVAL;
+
+	ret = pollset_ctl_np(pollset_fd, POLLSET_CTL_ADD, mq, 0);
+	if (!smokey_assert(ret == -1 && errno == EINVAL))
+		return -EINVAL;
+
+	/* Nothing was sent yet, polling must not block. */
+	ret = smokey_check_errno(pollset_wait_np(pollset_fd, &ev, 1, &ts));
+	if (ret < 0)
+		return ret;
+
+	if (!smokey_assert(ret == 0))
+		return -EINVAL;
+
+	ret = smokey_check_errno(pollset_ctl_np(pollset_fd, POLLSET_CTL_MOD,
+						mq, POLLSET_IN));
+	if (ret)
+		return ret;
+
+	/* A failed update must leave the former registration in place. */
+	ret = pollset_ctl_np(pollset_fd, POLLSET_CTL_MOD, mq, 0);
+	if (!smokey_assert(ret == -1 && errno == EINVAL))
+		return -EINVAL;
+
+	ret = pollset_ctl_np(pollset_fd, POLLSET_CTL_ADD, mq, POLLSET_IN);
+	if (!smokey_assert(ret == -1 && errno == EEXIST))
+		return -EINVAL;
+
+	ret = pollset_ctl_np(pollset_fd, POLLSET_CTL_DEL, mq + 1, 0);
+	if (!smokey_assert(ret == -1 && errno == ENOENT))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int run_mq_test(void *(*handler)(void *))
 {
 	struct mq_attr qa;
 	pthread_t tcb;
 	int i, j, ret;
 	mqd_t mq;
 
+	test_status = 0;
 	mq_unlink("/select_test_mq");
 	qa.mq_maxmsg = 128;
 	qa.mq_msgsize = 128;
@@ -116,9 +204,19 @@ static int run_posix_select(struct smokey_test *t, int argc, char *const argv[])
 	if (mq < 0)
 		return mq;
 
-	ret = smokey_check_status(pthread_create(&tcb, NULL, mq_thread, (void *)(long)mq));
+	if (handler == pollset_thread) {
+		ret = smokey_check_errno(pollset_ctl_np(pollset_fd, POLLSET_CTL_ADD,
+							mq, POLLSET_IN));
+		if (ret)
+			goto close;
+		ret = check_pollset_ctl(mq);
+		if (ret)
+			goto close;
+	}
+
+	ret = smokey_check_status(pthread_create(&tcb, NULL, handler, (void *)(long)mq));
 	if (ret)
-		return ret;
+		goto close;
 
 	for (j = 0; j < 3; j++) {
 		for (i = 0; i < sizeof(tunes) / sizeof(tunes[0]); i++) {
@@ -140,6 +238,27 @@ static int run_posix_select(struct smokey_test *t, int argc, char *const argv[])
 	ret = test_status;
 out:
 	pthread_join(tcb, NULL);
+close:
+	mq_close(mq);
+	mq_unlink("/select_test_mq");
 	
 	return ret;
 }
+
+static int run_posix_select(struct smokey_test *t, int argc, char *const argv[])
+{
+	int ret;
+
+	ret = run_mq_test(mq_thread);
+	if (ret)
+		return ret;
+
+	pollset_fd = smokey_check_errno(pollset_create_np());
+	if (pollset_fd < 0)
+		return pollset_fd;
+
+	ret = run_mq_test(pollset_thread);
+	close(pollset_fd);
+
+	return ret;
+}
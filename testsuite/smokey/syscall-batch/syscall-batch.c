@@ -0,0 +1,221 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <mqueue.h>
+#include <semaphore.h>
+#include <cobalt/sys/cobalt.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(syscall_batch,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+		   ),
+		   "Check batched service calls, compare per-op cost.\n"
+		   "\tloops=<N>	measurement loops per batch size (default: 1000)"
+);
+
+#define MQ_NAME		"/batch_test_mq"
+#define MQ_MSGSZ	8
+#define MQ_MAXMSG	64
+
+static int check_batch_sem(void)
+{
+	cobalt_batch_t batch;
+	int ret, n, slot, val;
+	sem_t sem;
+
+	if (!smokey_assert(cobalt_batch_init(&batch, 3) == -EINVAL))
+		return -EINVAL;
+
+	ret = smokey_check_status(-cobalt_batch_init(&batch, 8));
+	if (ret)
+		return ret;
+
+	ret = smokey_check_errno(sem_init(&sem, 0, 0));
+	if (ret)
+		goto out;
+
+	for (n = 0; n < 8; n++) {
+		slot = cobalt_batch_sem_post(&batch, &sem);
+		if (!smokey_assert(slot == n)) {
+			ret = -EINVAL;
+			goto fail;
+		}
+	}
+
+	if (!smokey_assert(cobalt_batch_sem_post(&batch, &sem) == -ENOSPC)) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	ret = cobalt_batch_submit(&batch, 0);
+	if (!smokey_assert(ret == 8)) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	for (n = 0; n < 8; n++)
+		if (!smokey_assert(cobalt_batch_result(&batch, n) == 0)) {
+			ret = -EINVAL;
+			goto fail;
+		}
+
+	ret = smokey_check_errno(sem_getvalue(&sem, &val));
+	if (ret)
+		goto fail;
+
+	if (!smokey_assert(val == 8)) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	/*
+	 * A failed request stops the batch with COBALT_BATCH_STOP,
+	 * the remaining ones go with the next submission.
+	 */
+	slot = cobalt_batch_write(&batch, -1, "x", 1);
+	cobalt_batch_sem_post(&batch, &sem);
+	ret = cobalt_batch_submit(&batch, COBALT_BATCH_STOP);
+	if (!smokey_assert(ret == 1) ||
+	    !smokey_assert(cobalt_batch_result(&batch, slot) == -EBADF) ||
+	    !smokey_assert(cobalt_batch_result(&batch, slot + 1) == -EINPROGRESS)) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	ret = cobalt_batch_submit(&batch, COBALT_BATCH_STOP);
+	if (!smokey_assert(ret == 1) ||
+	    !smokey_assert(cobalt_batch_result(&batch, slot + 1) == 0)) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	ret = 0;
+fail:
+	sem_destroy(&sem);
+out:
+	cobalt_batch_destroy(&batch);
+
+	return ret;
+}
+
+static long long diff_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1000000000LL +
+		t1->tv_nsec - t0->tv_nsec;
+}
+
+static int drain_mq(mqd_t mq, int count)
+{
+	char buf[MQ_MSGSZ];
+	unsigned int prio;
+
+	while (count-- > 0)
+		if (mq_receive(mq, buf, sizeof(buf), &prio) < 0)
+			return -errno;
+
+	return 0;
+}
+
+static int bench_batch(mqd_t mq, unsigned int size, int loops)
+{
+	long long direct = 0, batched = 0;
+	struct timespec t0, t1;
+	cobalt_batch_t batch;
+	char msg[MQ_MSGSZ];
+	unsigned int n;
+	int ret, l;
+
+	ret = smokey_check_status(-cobalt_batch_init(&batch, size));
+	if (ret)
+		return ret;
+
+	memset(msg, 0xa5, sizeof(msg));
+
+	for (l = 0; l < loops; l++) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (n = 0; n < size; n++) {
+			ret = mq_send(mq, msg, sizeof(msg), 0);
+			if (ret) {
+				ret = smokey_check_errno(ret);
+				goto out;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		direct += diff_ns(&t0, &t1);
+		ret = drain_mq(mq, size);
+		if (ret)
+			goto out;
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (n = 0; n < size; n++)
+			cobalt_batch_mq_send(&batch, mq, msg, sizeof(msg), 0);
+		ret = cobalt_batch_submit(&batch, COBALT_BATCH_STOP);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		if (!smokey_assert(ret == (int)size)) {
+			ret = ret < 0 ? ret : -EINVAL;
+			goto out;
+		}
+		batched += diff_ns(&t0, &t1);
+		ret = drain_mq(mq, size);
+		if (ret)
+			goto out;
+	}
+
+	smokey_trace("%6u  %10lld  %10lld",
+		     size,
+		     direct / ((long long)loops * size),
+		     batched / ((long long)loops * size));
+out:
+	cobalt_batch_destroy(&batch);
+
+	return ret;
+}
+
+static int run_syscall_batch(struct smokey_test *t, int argc, char *const argv[])
+{
+	static const unsigned int sizes[] = { 1, 4, 16, 64 };
+	struct mq_attr qa;
+	int ret, loops = 1000;
+	unsigned int n;
+	mqd_t mq;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(syscall_batch, loops))
+		loops = SMOKEY_ARG_INT(syscall_batch, loops);
+
+	if (loops <= 0)
+		return -EINVAL;
+
+	ret = check_batch_sem();
+	if (ret)
+		return ret;
+
+	mq_unlink(MQ_NAME);
+	qa.mq_maxmsg = MQ_MAXMSG;
+	qa.mq_msgsize = MQ_MSGSZ;
+	mq = smokey_check_errno(mq_open(MQ_NAME, O_RDWR | O_CREAT | O_NONBLOCK,
+					0600, &qa));
+	if (mq < 0)
+		return mq;
+
+	smokey_trace("%6s  %10s  %10s", "BATCH", "DIRECT-NS", "BATCHED-NS");
+
+	for (n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+		ret = bench_batch(mq, sizes[n], loops);
+		if (ret)
+			break;
+	}
+
+	mq_close(mq);
+	mq_unlink(MQ_NAME);
+
+	return ret;
+}
@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <smokey/smokey.h>
+#include <rtdm/testing.h>
+
+smokey_test_plugin(timer_queue,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(timers),
+			   SMOKEY_INT(rounds),
+		   ),
+		   "Measure the cost of the core timer queue operations.\n"
+		   "\ttimers=<N>	number of armed timers (default: 10, 1k, 100k)\n"
+		   "\trounds=<N>	measurement rounds (default: 10)"
+);
+
+static int run_bench(int fd, unsigned int nrtimers, unsigned int rounds)
+{
+	struct rttst_tmqueue_bench bench;
+	int ret;
+
+	bench.nrtimers = nrtimers;
+	bench.rounds = rounds;
+	ret = smokey_check_errno(ioctl(fd, RTTST_RTIOC_TMBENCH_QUEUE, &bench));
+	if (ret)
+		return ret;
+
+	smokey_trace("%8u  %7lld  %7lld  %7lld  %7lld  %7lld  %7lld",
+		     nrtimers,
+		     (long long)bench.insert_avg_ns,
+		     (long long)bench.insert_max_ns,
+		     (long long)bench.remove_avg_ns,
+		     (long long)bench.remove_max_ns,
+		     (long long)bench.expire_avg_ns,
+		     (long long)bench.expire_max_ns);
+
+	return 0;
+}
+
+static int run_timer_queue(struct smokey_test *t, int argc, char *const argv[])
+{
+	static const unsigned int defaults[] = { 10, 1000, 100000 };
+	unsigned int rounds = 10, n;
+	int fd, ret = 0;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(timer_queue, rounds))
+		rounds = SMOKEY_ARG_INT(timer_queue, rounds);
+
+	fd = open("/dev/rtdm/timerbench", O_RDWR);
+	if (fd < 0)
+		return -ENOSYS;
+
+	smokey_trace("%8s  %7s  %7s  %7s  %7s  %7s  %7s",
+		     "TIMERS", "INS-AVG", "INS-MAX", "REM-AVG", "REM-MAX",
+		     "EXP-AVG", "EXP-MAX");
+
+	if (SMOKEY_ARG_ISSET(timer_queue, timers))
+		ret = run_bench(fd, SMOKEY_ARG_INT(timer_queue, timers), rounds);
+	else {
+		for (n = 0; n < sizeof(defaults) / sizeof(defaults[0]); n++) {
+			ret = run_bench(fd, defaults[n], rounds);
+			if (ret)
+				break;
+		}
+	}
+
+	close(fd);
+
+	return ret;
+}
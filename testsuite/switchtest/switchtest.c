@@ -1000,6 +1000,143 @@ static unsigned long xatoul(const char *str)
 	return result;
 }
 
+/*
+ * Scheduler pick benchmark: two threads of equal priority yield the
+ * CPU to each other, while a number of lower priority threads sit in
+ * the run queue of the same CPU, waiting for them to finish.
+ */
+#define PICK_BENCH_LOOPS 20000
+
+static sem_t pick_lead, pick_follow, pick_go;
+static volatile int pick_done;
+
+static void *pick_filler(void *cookie)
+{
+	sem_wait(&pick_go);
+
+	return NULL;
+}
+
+static void *pick_follower(void *cookie)
+{
+	sem_wait(&pick_follow);
+
+	while (!pick_done)
+		sched_yield();
+
+	return NULL;
+}
+
+static void *pick_leader(void *cookie)
+{
+	unsigned long long *ns = cookie;
+	unsigned int nr_fillers = *ns, n;
+	struct timespec t0, t1, delta;
+
+	sem_wait(&pick_lead);
+
+	/* Fillers become runnable, but cannot preempt us. */
+	for (n = 0; n < nr_fillers; n++)
+		sem_post(&pick_go);
+
+	sem_post(&pick_follow);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (n = 0; n < PICK_BENCH_LOOPS; n++)
+		sched_yield();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	pick_done = 1;
+
+	timespec_substract(&delta, &t1, &t0);
+	*ns = (delta.tv_sec * 1000000000ULL + delta.tv_nsec) /
+		(2 * PICK_BENCH_LOOPS);
+
+	return NULL;
+}
+
+static int pick_create(pthread_t *thread, unsigned int cpu, int prio,
+		       void *(*routine)(void *), void *cookie)
+{
+	struct sched_param sp;
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	int err;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	sp.sched_priority = prio;
+	pthread_attr_setschedparam(&attr, &sp);
+	pthread_attr_setstacksize(&attr, stack_size(32768));
+	pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	err = pthread_create(thread, &attr, routine, cookie);
+	pthread_attr_destroy(&attr);
+	if (err)
+		fprintf(stderr, "pthread_create: %s\n", strerror(err));
+
+	return err;
+}
+
+static int pick_bench(unsigned int cpu, unsigned int nr_fillers)
+{
+	pthread_t leader, follower, *fillers;
+	unsigned long long ns = nr_fillers;
+	unsigned int n, created;
+	int err;
+
+	fillers = malloc(sizeof(*fillers) * (nr_fillers ?: 1));
+	if (fillers == NULL) {
+		perror("malloc");
+		return ENOMEM;
+	}
+
+	sem_init(&pick_lead, 0, 0);
+	sem_init(&pick_follow, 0, 0);
+	sem_init(&pick_go, 0, 0);
+	pick_done = 0;
+
+	for (created = 0; created < nr_fillers; created++) {
+		err = pick_create(&fillers[created], cpu, 1, pick_filler, NULL);
+		if (err)
+			goto out_fillers;
+	}
+
+	err = pick_create(&follower, cpu, 2, pick_follower, NULL);
+	if (err)
+		goto out_fillers;
+
+	err = pick_create(&leader, cpu, 2, pick_leader, &ns);
+	if (err) {
+		pick_done = 1;
+		sem_post(&pick_follow);
+		pthread_join(follower, NULL);
+		goto out_fillers;
+	}
+
+	sem_post(&pick_lead);
+	pthread_join(leader, NULL);
+	pthread_join(follower, NULL);
+
+	printf("== pick bench on CPU %u: %u runnable threads, %llu ns per switch\n",
+	       cpu, nr_fillers + 2, ns);
+	created = 0;
+out_fillers:
+	/* Fillers were released by the leader on success. */
+	for (n = 0; n < created; n++)
+		sem_post(&pick_go);
+	for (n = 0; n < (err ? created : nr_fillers); n++)
+		pthread_join(fillers[n], NULL);
+
+	sem_destroy(&pick_go);
+	sem_destroy(&pick_follow);
+	sem_destroy(&pick_lead);
+	free(fillers);
+
+	return err;
+}
+
 static void usage(FILE *fd, const char *progname)
 {
 	unsigned i, j;
@@ -1024,7 +1161,10 @@ static void usage(FILE *fd, const char *progname)
 		"--stress <period> or -s <period> enable a stress mode where:\n"
 		"  context switches occur every <period> us;\n"
 		"  a background task uses fpu (and check) fpu all the time.\n"
-		"--freeze trace upon error.\n\n"
+		"--freeze trace upon error.\n"
+		"--pick-bench <count> or -p <count>, measure the cost of switching\n"
+		"context between two threads on each CPU, first alone then with\n"
+		"<count> lower priority threads runnable, and exit.\n\n"
 		"Each 'threadspec' specifies the characteristics of a "
 		"thread to be created:\n"
 		"threadspec = (rtk|rtup|rtus|rtuo)(_fp|_ufpp|_ufps)*[0-9]*\n"
@@ -1130,7 +1270,7 @@ static int check_fpu(void)
 
 int main(int argc, const char *argv[])
 {
-	unsigned i, j, n, use_fp = 1, stress = 0;
+	unsigned i, j, n, use_fp = 1, stress = 0, pick = 0;
 	pthread_attr_t rt_attr;
 	const char *progname = argv[0];
 	struct cpu_tasks *cpus;
@@ -1177,6 +1317,7 @@ int main(int argc, const char *argv[])
 			{ "help",    0, NULL, 'h' },
 			{ "lines",   1, NULL, 'l' },
 			{ "nofpu",   0, NULL, 'n' },
+			{ "pick-bench", 1, NULL, 'p' },
 			{ "quiet",   0, NULL, 'q' },
 			{ "really-quiet", 0, NULL, 'Q' },
 			{ "stress",  1, NULL, 's' },
@@ -1184,7 +1325,7 @@ int main(int argc, const char *argv[])
 			{ NULL,      0, NULL, 0   }
 		};
 		int i = 0;
-		int c = getopt_long(argc, (char *const *) argv, "fhl:nqQs:T:",
+		int c = getopt_long(argc, (char *const *) argv, "fhl:np:qQs:T:",
 				    long_options, &i);
 
 		if (c == -1)
@@ -1207,6 +1348,10 @@ int main(int argc, const char *argv[])
 			use_fp = 0;
 			break;
 
+		case 'p':
+			pick = xatoul(optarg);
+			break;
+
 		case 'q':
 			quiet = 1;
 			break;
@@ -1241,6 +1386,14 @@ int main(int argc, const char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	if (pick) {
+		for_each_cpu(i) {
+			if (pick_bench(i, 0) || pick_bench(i, pick))
+				exit(EXIT_FAILURE);
+		}
+		exit(EXIT_SUCCESS);
+	}
+
 	/* If no argument was passed (or only -n), replace argc and argv with
 	   default values, given by all_fp or all_nofp depending on the presence
 	   of the -n flag. */
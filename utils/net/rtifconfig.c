@@ -168,6 +168,8 @@ void help(void)
         "\trtifconfig <dev> up [<addr> [netmask <mask>]] "
             "[hw <HW> <address>] [[-]promisc]\n"
         "\trtifconfig <dev> down\n"
+        "\trtifconfig <dev> rxmode [irq|poll] [budget <frames>] "
+            "[itr <usecs>]\n"
         );
 
     exit(1);
@@ -175,6 +177,38 @@ void help(void)
 
 
 
+void print_queues(void)
+{
+    struct rtnet_poll_cmd   poll;
+    unsigned int            i;
+
+
+    memset(&poll, 0, sizeof(poll));
+    memcpy(poll.head.if_name, cmd.head.if_name, IFNAMSIZ);
+
+    /* drivers without queue accounting report no queue */
+    if (ioctl(f, IOC_RT_IFPOLL, &poll) < 0 || poll.nr_queues == 0)
+        return;
+
+    printf("          RX mode:%s budget:%u itr:",
+           (poll.rx_mode == RTNET_RX_MODE_POLL) ? "poll" : "irq",
+           poll.budget);
+    if (poll.itr)
+        printf("%uus\n", poll.itr);
+    else
+        printf("auto\n");
+
+    for (i = 0; i < poll.nr_queues && i < MAX_RT_DEV_QUEUES; i++)
+        printf("          queue %u: irqs:%llu polls:%llu packets:%llu "
+               "dropped:%llu\n", i,
+               (unsigned long long)poll.queue[i].irqs,
+               (unsigned long long)poll.queue[i].polls,
+               (unsigned long long)poll.queue[i].packets,
+               (unsigned long long)poll.queue[i].drops);
+}
+
+
+
 void print_dev(void)
 {
     struct in_addr  ip_addr;
@@ -270,6 +304,9 @@ void print_dev(void)
                tx, (unsigned long)(short_tx / 10), 
                (unsigned long)(short_tx % 10), Text);
     }
+
+    print_queues();
+
     printf("\n");
 }
 
@@ -402,6 +439,54 @@ void do_down(int argc,char *argv[])
 
 
 
+void do_rxmode(int argc, char *argv[])
+{
+    struct rtnet_poll_cmd   poll;
+    char                    *end;
+    int                     i;
+
+
+    memset(&poll, 0, sizeof(poll));
+    memcpy(poll.head.if_name, cmd.head.if_name, IFNAMSIZ);
+
+    for (i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "irq") == 0) {
+            poll.set_mask |= RTNET_POLL_SET_MODE;
+            poll.rx_mode = RTNET_RX_MODE_IRQ;
+        } else if (strcmp(argv[i], "poll") == 0) {
+            poll.set_mask |= RTNET_POLL_SET_MODE;
+            poll.rx_mode = RTNET_RX_MODE_POLL;
+        } else if (strcmp(argv[i], "budget") == 0) {
+            if (++i >= argc)
+                help();
+            poll.budget = strtoul(argv[i], &end, 0);
+            if (*end != '\0' || poll.budget == 0)
+                help();
+            poll.set_mask |= RTNET_POLL_SET_BUDGET;
+        } else if (strcmp(argv[i], "itr") == 0) {
+            if (++i >= argc)
+                help();
+            poll.itr = strtoul(argv[i], &end, 0);
+            if (*end != '\0')
+                help();
+            poll.set_mask |= RTNET_POLL_SET_ITR;
+        } else
+            help();
+    }
+
+    if (ioctl(f, IOC_RT_IFPOLL, &poll) < 0) {
+        perror("ioctl");
+        exit(1);
+    }
+
+    if (poll.set_mask == 0)
+        do_display(0);
+
+    exit(0);
+}
+
+
+
 int main(int argc, char *argv[])
 {
     if ((argc > 1) && (strcmp(argv[1], "--help") == 0))
@@ -433,6 +518,8 @@ int main(int argc, char *argv[])
         do_up(argc,argv);
     if (strcmp(argv[2], "down") == 0)
         do_down(argc,argv);
+    if (strcmp(argv[2], "rxmode") == 0)
+        do_rxmode(argc,argv);
 
     help();
 
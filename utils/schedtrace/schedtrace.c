@@ -0,0 +1,423 @@
+/*
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * This utility reads the context switch trace rings exported by
+ * /dev/rtdm/schedtrace (CONFIG_XENO_OPT_SCHED_TRACE), and computes
+ * per-thread distributions of the wakeup latency (wakeup to
+ * resumption) and response time (wakeup to blocking again).
+ */
+#include <xeno_config.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <error.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/cobalt.h>
+#include <boilerplate/atomic.h>
+#include <cobalt/uapi/kernel/schedtrace.h>
+#include <xenomai/init.h>
+
+/* Log-linear histogram: 16 sub-buckets per power of two (ns). */
+#define HIST_SUB_LOG2	4
+#define HIST_SUB	(1 << HIST_SUB_LOG2)
+#define HIST_BUCKETS	((64 - HIST_SUB_LOG2 + 1) * HIST_SUB)
+
+struct dist {
+	unsigned long long count;
+	unsigned long long sum;
+	unsigned long long min;
+	unsigned long long max;
+	unsigned long long hist[HIST_BUCKETS];
+};
+
+struct thread_stat {
+	pid_t pid;
+	uint32_t handle;
+	unsigned long long wakeup;	/* Pending wakeup date, 0 if none */
+	struct dist latency;
+	struct dist response;
+	struct thread_stat *next;
+};
+
+static const struct option options[] = {
+	{
+#define period_opt	0
+		.name = "period",
+		.has_arg = required_argument,
+	},
+	{
+#define duration_opt	1
+		.name = "duration",
+		.has_arg = required_argument,
+	},
+	{ /* Sentinel */ }
+};
+
+static const struct xnsched_trace_header *hdr;
+
+static uint32_t *tails;
+
+static struct xnsched_trace_entry *batch;
+
+static struct thread_stat *threads;
+
+static unsigned long long nr_records, nr_lost;
+
+static unsigned int period_ms = 100;
+
+static unsigned int duration;
+
+static volatile sig_atomic_t done;
+
+void application_usage(void)
+{
+        fprintf(stderr, "usage: %s [options]:\n", get_program_name());
+	fprintf(stderr, "--period=<ms>			ring polling period (default 100)\n");
+	fprintf(stderr, "--duration=<seconds>		stop after this time (default: until interrupted)\n");
+}
+
+static void sighandler(int sig)
+{
+	done = 1;
+}
+
+static inline unsigned long long ticks_to_ns(unsigned long long ticks)
+{
+	return (unsigned long long)((long double)ticks * 1000000000.0 /
+				    hdr->clock_freq);
+}
+
+static int hist_index(unsigned long long v)
+{
+	int msb;
+
+	if (v < HIST_SUB)
+		return (int)v;
+
+	msb = 63 - __builtin_clzll(v);
+
+	return (msb - HIST_SUB_LOG2 + 1) * HIST_SUB +
+		(int)((v >> (msb - HIST_SUB_LOG2)) & (HIST_SUB - 1));
+}
+
+static unsigned long long hist_value(int index)
+{
+	int shift, sub;
+
+	if (index < HIST_SUB)
+		return index;
+
+	shift = index / HIST_SUB - 1;
+	sub = index % HIST_SUB;
+
+	/* Upper bound of the bucket. */
+	return ((unsigned long long)(HIST_SUB + sub + 1) << shift) - 1;
+}
+
+static void dist_add(struct dist *d, unsigned long long ns)
+{
+	if (d->count == 0 || ns < d->min)
+		d->min = ns;
+	if (ns > d->max)
+		d->max = ns;
+	d->count++;
+	d->sum += ns;
+	d->hist[hist_index(ns)]++;
+}
+
+static unsigned long long dist_percentile(const struct dist *d, double pct)
+{
+	unsigned long long seen = 0, rank;
+	int n;
+
+	if (d->count == 0)
+		return 0;
+
+	rank = (unsigned long long)(d->count * pct / 100.0);
+	if (rank >= d->count)
+		rank = d->count - 1;
+
+	for (n = 0; n < HIST_BUCKETS; n++) {
+		seen += d->hist[n];
+		if (seen > rank)
+			break;
+	}
+
+	return hist_value(n) < d->max ? hist_value(n) : d->max;
+}
+
+static struct thread_stat *find_thread(pid_t pid, uint32_t handle)
+{
+	struct thread_stat *t;
+
+	for (t = threads; t; t = t->next)
+		if (t->pid == pid && t->handle == handle)
+			return t;
+
+	t = calloc(1, sizeof(*t));
+	if (t == NULL)
+		error(1, ENOMEM, "calloc");
+
+	t->pid = pid;
+	t->handle = handle;
+	t->next = threads;
+	threads = t;
+
+	return t;
+}
+
+static void process_entry(const struct xnsched_trace_entry *e)
+{
+	struct thread_stat *t;
+
+	/* The root thread stands for the whole Linux activity. */
+	if (e->prev_pid > 0) {
+		t = find_thread(e->prev_pid, e->prev_handle);
+		if (t->wakeup && e->reason != XNSCHED_TRACE_PREEMPT) {
+			dist_add(&t->response,
+				 ticks_to_ns(e->timestamp - t->wakeup));
+			t->wakeup = 0;
+		}
+	}
+
+	if (e->next_pid > 0 && e->delay) {
+		t = find_thread(e->next_pid, e->next_handle);
+		dist_add(&t->latency, ticks_to_ns(e->delay));
+		t->wakeup = e->timestamp - e->delay;
+	}
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct xnsched_trace_entry *ea = a, *eb = b;
+
+	if (ea->timestamp < eb->timestamp)
+		return -1;
+
+	return ea->timestamp > eb->timestamp;
+}
+
+static inline const struct xnsched_trace_ring *get_ring(int cpu)
+{
+	return (const void *)hdr + hdr->ring_offset + cpu * hdr->ring_stride;
+}
+
+/*
+ * Copy the new records out of a ring, dropping those which were
+ * overwritten before we could read them.
+ */
+static size_t fetch_ring(int cpu, struct xnsched_trace_entry *out)
+{
+	const struct xnsched_trace_ring *ring = get_ring(cpu);
+	const struct xnsched_trace_entry *e;
+	uint32_t head, pos, seq;
+	size_t n = 0;
+
+	head = *(volatile const uint32_t *)&ring->head;
+	smp_rmb();
+
+	pos = tails[cpu];
+	if (head - pos > hdr->nr_entries) {
+		nr_lost += head - pos - hdr->nr_entries;
+		pos = head - hdr->nr_entries;
+	}
+
+	for (; pos != head; pos++) {
+		e = ring->entries + (pos & (hdr->nr_entries - 1));
+		seq = *(volatile const uint32_t *)&e->seq;
+		smp_rmb();
+		out[n] = *e;
+		smp_rmb();
+		if (seq != pos + 1 ||
+		    *(volatile const uint32_t *)&e->seq != seq) {
+			nr_lost++;
+			continue;
+		}
+		n++;
+	}
+
+	tails[cpu] = head;
+
+	return n;
+}
+
+static void poll_rings(void)
+{
+	size_t n = 0, i;
+	int cpu;
+
+	for (cpu = 0; cpu < (int)hdr->nr_cpus; cpu++)
+		n += fetch_ring(cpu, batch + n);
+
+	/* Threads may migrate, merge all CPUs in time order. */
+	qsort(batch, n, sizeof(*batch), compare_entries);
+
+	for (i = 0; i < n; i++)
+		process_entry(batch + i);
+
+	nr_records += n;
+}
+
+static void get_thread_name(pid_t pid, char *buf, size_t len)
+{
+	char path[64];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+	fp = fopen(path, "r");
+	if (fp == NULL || fgets(buf, len, fp) == NULL)
+		snprintf(buf, len, "?");
+	else
+		buf[strcspn(buf, "\n")] = '\0';
+
+	if (fp)
+		fclose(fp);
+}
+
+static void print_dist(const struct dist *d)
+{
+	if (d->count == 0) {
+		printf(" %9s %9s %9s %9s", "-", "-", "-", "-");
+		return;
+	}
+
+	printf(" %9.3f %9.3f %9.3f %9.3f",
+	       d->min / 1000.0,
+	       (double)d->sum / d->count / 1000.0,
+	       dist_percentile(d, 99.0) / 1000.0,
+	       d->max / 1000.0);
+}
+
+static void report(void)
+{
+	struct thread_stat *t;
+	char name[32];
+
+	printf("%llu records, %llu lost\n", nr_records, nr_lost);
+	printf("%-6s %-16s %9s  %-39s  %-39s\n",
+	       "", "", "", "---------- latency (us) ----------",
+	       "--------- response (us) ---------");
+	printf("%-6s %-16s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+	       "PID", "NAME", "WAKEUPS",
+	       "MIN", "AVG", "P99", "MAX",
+	       "MIN", "AVG", "P99", "MAX");
+
+	for (t = threads; t; t = t->next) {
+		get_thread_name(t->pid, name, sizeof(name));
+		printf("%-6d %-16.16s %9llu", t->pid, name, t->latency.count);
+		print_dist(&t->latency);
+		print_dist(&t->response);
+		putchar('\n');
+	}
+}
+
+int main(int argc, char *const argv[])
+{
+	struct xnsched_trace_header h;
+	struct timespec ts, end;
+	int lindex, c, fd;
+	void *p;
+
+	for (;;) {
+		c = getopt_long_only(argc, argv, "", options, &lindex);
+		if (c == EOF)
+			break;
+		if (c == '?') {
+			xenomai_usage();
+			return EINVAL;
+		}
+		switch (lindex) {
+		case period_opt:
+			period_ms = atoi(optarg);
+			if (period_ms == 0)
+				error(1, EINVAL, "invalid polling period");
+			break;
+		case duration_opt:
+			duration = atoi(optarg);
+			break;
+		default:
+			return EINVAL;
+		}
+	}
+
+	fd = open("/dev/rtdm/" COBALT_SCHEDTRACE_DEV, O_RDONLY);
+	if (fd < 0)
+		error(1, errno, "cannot open /dev/rtdm/%s "
+		      "(CONFIG_XENO_OPT_SCHED_TRACE disabled?)",
+		      COBALT_SCHEDTRACE_DEV);
+
+	/* Map the header first, to learn about the overall size. */
+	p = mmap(NULL, sizeof(h), PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		error(1, errno, "mmap");
+
+	memcpy(&h, p, sizeof(h));
+	munmap(p, sizeof(h));
+
+	if (h.magic != XNSCHED_TRACE_MAGIC ||
+	    h.entry_size != sizeof(struct xnsched_trace_entry))
+		error(1, EINVAL, "trace layout mismatch");
+
+	p = mmap(NULL, h.map_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		error(1, errno, "mmap");
+
+	hdr = p;
+	tails = calloc(hdr->nr_cpus, sizeof(*tails));
+	batch = malloc((size_t)hdr->nr_cpus * hdr->nr_entries * sizeof(*batch));
+	if (tails == NULL || batch == NULL)
+		error(1, ENOMEM, "malloc");
+
+	/* Start from the current position, skip past records. */
+	for (c = 0; c < (int)hdr->nr_cpus; c++)
+		tails[c] = get_ring(c)->head;
+
+	signal(SIGINT, sighandler);
+	signal(SIGTERM, sighandler);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += duration;
+
+	ts.tv_sec = period_ms / 1000;
+	ts.tv_nsec = (period_ms % 1000) * 1000000;
+
+	while (!done) {
+		__STD(nanosleep(&ts, NULL));
+		poll_rings();
+		if (duration) {
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec > end.tv_sec ||
+			    (now.tv_sec == end.tv_sec &&
+			     now.tv_nsec >= end.tv_nsec))
+				break;
+		}
+	}
+
+	report();
+
+	munmap(p, h.map_size);
+	close(fd);
+
+	return 0;
+}